@@ -0,0 +1,316 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#include "OcclusionCoreCapture.h"
+
+#include <cstring>
+#include <utility>
+
+namespace SOCore
+{
+	namespace
+	{
+		/** Writes values byte by byte, so the captures are little endian on any host */
+		class FCaptureWriter
+		{
+		public:
+			explicit FCaptureWriter(std::vector<uint8_t>& InBytes) : Bytes(InBytes) {}
+
+			void Write(const uint32_t Value)
+			{
+				for (int32_t Byte = 0; Byte < 4; ++Byte)
+				{
+					Bytes.push_back(static_cast<uint8_t>(Value >> (Byte * 8)));
+				}
+			}
+
+			void Write(const uint16_t Value)
+			{
+				Bytes.push_back(static_cast<uint8_t>(Value));
+				Bytes.push_back(static_cast<uint8_t>(Value >> 8));
+			}
+
+			void Write(const int32_t Value)
+			{
+				Write(static_cast<uint32_t>(Value));
+			}
+
+			void Write(const float Value)
+			{
+				uint32_t Bits;
+				std::memcpy(&Bits, &Value, sizeof(Bits));
+				Write(Bits);
+			}
+
+			void Write(const FVec3& Value)
+			{
+				Write(Value.X);
+				Write(Value.Y);
+				Write(Value.Z);
+			}
+
+			void Write(const FQuantizedVertex& Value)
+			{
+				Write(Value.X);
+				Write(Value.Y);
+				Write(Value.Z);
+			}
+
+			void Write(const FMatrix44& Value)
+			{
+				for (const auto& Row : Value.M)
+				{
+					for (const float Element : Row)
+					{
+						Write(Element);
+					}
+				}
+			}
+
+			void Write(const FMeshlet& Value)
+			{
+				Write(Value.BoundsCenter);
+				Write(Value.BoundsExtent);
+				Write(Value.FirstVertex);
+				Write(Value.NumVertices);
+				Write(Value.FirstIndex);
+				Write(Value.NumIndices);
+				Write(Value.ConeAxis);
+				Write(Value.ConeCosAngle);
+				Write(Value.ConeSinAngle);
+			}
+
+			template <typename T>
+			void WriteArray(const std::vector<T>& Values)
+			{
+				Write(static_cast<uint32_t>(Values.size()));
+				for (const T& Value : Values)
+				{
+					Write(Value);
+				}
+			}
+
+		private:
+			std::vector<uint8_t>& Bytes;
+		};
+
+		class FCaptureReader
+		{
+		public:
+			FCaptureReader(const uint8_t* InData, const size_t InSize) : Data(InData), Size(InSize) {}
+
+			bool Read(uint32_t& Value)
+			{
+				if (Size - Offset < 4)
+				{
+					return false;
+				}
+				Value = 0;
+				for (int32_t Byte = 0; Byte < 4; ++Byte)
+				{
+					Value |= static_cast<uint32_t>(Data[Offset++]) << (Byte * 8);
+				}
+				return true;
+			}
+
+			bool Read(uint16_t& Value)
+			{
+				if (Size - Offset < 2)
+				{
+					return false;
+				}
+				Value = static_cast<uint16_t>(Data[Offset] | (Data[Offset + 1] << 8));
+				Offset += 2;
+				return true;
+			}
+
+			bool Read(int32_t& Value)
+			{
+				uint32_t Bits = 0;
+				if (!Read(Bits))
+				{
+					return false;
+				}
+				Value = static_cast<int32_t>(Bits);
+				return true;
+			}
+
+			bool Read(float& Value)
+			{
+				uint32_t Bits = 0;
+				if (!Read(Bits))
+				{
+					return false;
+				}
+				std::memcpy(&Value, &Bits, sizeof(Value));
+				return true;
+			}
+
+			bool Read(FVec3& Value)
+			{
+				return Read(Value.X) && Read(Value.Y) && Read(Value.Z);
+			}
+
+			bool Read(FQuantizedVertex& Value)
+			{
+				return Read(Value.X) && Read(Value.Y) && Read(Value.Z);
+			}
+
+			bool Read(FMatrix44& Value)
+			{
+				for (auto& Row : Value.M)
+				{
+					for (float& Element : Row)
+					{
+						if (!Read(Element))
+						{
+							return false;
+						}
+					}
+				}
+				return true;
+			}
+
+			bool Read(FMeshlet& Value)
+			{
+				return Read(Value.BoundsCenter) && Read(Value.BoundsExtent)
+					&& Read(Value.FirstVertex) && Read(Value.NumVertices) && Read(Value.FirstIndex) && Read(Value.NumIndices)
+					&& Read(Value.ConeAxis) && Read(Value.ConeCosAngle) && Read(Value.ConeSinAngle);
+			}
+
+			template <typename T>
+			bool ReadArray(std::vector<T>& Values)
+			{
+				// Every element takes at least two bytes, which bounds the allocation of truncated files
+				uint32_t Num = 0;
+				if (!Read(Num) || static_cast<size_t>(Num) * 2 > Size - Offset)
+				{
+					return false;
+				}
+				Values.resize(Num);
+				for (T& Value : Values)
+				{
+					if (!Read(Value))
+					{
+						return false;
+					}
+				}
+				return true;
+			}
+
+		private:
+			const uint8_t* Data;
+			size_t Size;
+			size_t Offset = 0;
+		};
+
+		// Rejects indices past the vertices of their range, the replay indexes them without checks
+		bool AreIndicesInRange(const uint16_t* Indices, const uint32_t NumIndices, const uint32_t NumVertices)
+		{
+			for (uint32_t i = 0; i < NumIndices; ++i)
+			{
+				if (Indices[i] >= NumVertices)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+	}
+
+	void WriteSceneCapture(const FScene& Scene, std::vector<uint8_t>& OutBytes)
+	{
+		FCaptureWriter Writer(OutBytes);
+		Writer.Write(SceneCaptureMagic);
+		Writer.Write(SceneCaptureVersion);
+		Writer.Write(Scene.ViewProj);
+
+		Writer.Write(static_cast<uint32_t>(Scene.Meshes.size()));
+		for (const FOccluderMesh& Mesh : Scene.Meshes)
+		{
+			Writer.Write(Mesh.QuantizationOffset);
+			Writer.Write(Mesh.QuantizationScale);
+			Writer.WriteArray(Mesh.Vertices);
+			Writer.WriteArray(Mesh.Indices);
+			Writer.WriteArray(Mesh.Meshlets);
+		}
+
+		Writer.Write(static_cast<uint32_t>(Scene.Occluders.size()));
+		for (const FOccluderInstance& Occluder : Scene.Occluders)
+		{
+			Writer.Write(Occluder.MeshIndex);
+			Writer.Write(Occluder.LocalToWorld);
+		}
+
+		Writer.WriteArray(Scene.OccluderBoxes);
+		Writer.WriteArray(Scene.OccludeeBoxMinMax);
+		Writer.WriteArray(Scene.OccludeeIds);
+		Writer.WriteArray(Scene.OccludeeInstanceIndices);
+	}
+
+	bool ReadSceneCapture(const uint8_t* Data, const size_t Size, FScene& OutScene)
+	{
+		OutScene = FScene();
+		FCaptureReader Reader(Data, Size);
+
+		uint32_t Magic = 0;
+		uint32_t Version = 0;
+		if (!Reader.Read(Magic) || !Reader.Read(Version) || Magic != SceneCaptureMagic || Version != SceneCaptureVersion)
+		{
+			return false;
+		}
+
+		uint32_t NumMeshes = 0;
+		if (!Reader.Read(OutScene.ViewProj) || !Reader.Read(NumMeshes))
+		{
+			return false;
+		}
+
+		for (uint32_t MeshIndex = 0; MeshIndex < NumMeshes; ++MeshIndex)
+		{
+			FOccluderMesh Mesh;
+			if (!Reader.Read(Mesh.QuantizationOffset) || !Reader.Read(Mesh.QuantizationScale)
+				|| !Reader.ReadArray(Mesh.Vertices) || !Reader.ReadArray(Mesh.Indices) || !Reader.ReadArray(Mesh.Meshlets))
+			{
+				return false;
+			}
+
+			if (Mesh.Meshlets.empty() && !AreIndicesInRange(Mesh.Indices.data(), static_cast<uint32_t>(Mesh.Indices.size()), static_cast<uint32_t>(Mesh.Vertices.size())))
+			{
+				return false;
+			}
+
+			// Reject ranges outside of the mesh
+			for (const FMeshlet& Meshlet : Mesh.Meshlets)
+			{
+				if (static_cast<uint64_t>(Meshlet.FirstVertex) + Meshlet.NumVertices > Mesh.Vertices.size()
+					|| static_cast<uint64_t>(Meshlet.FirstIndex) + Meshlet.NumIndices > Mesh.Indices.size()
+					|| !AreIndicesInRange(Mesh.Indices.data() + Meshlet.FirstIndex, Meshlet.NumIndices, Meshlet.NumVertices))
+				{
+					return false;
+				}
+			}
+			OutScene.Meshes.push_back(std::move(Mesh));
+		}
+
+		uint32_t NumOccluders = 0;
+		if (!Reader.Read(NumOccluders))
+		{
+			return false;
+		}
+		for (uint32_t i = 0; i < NumOccluders; ++i)
+		{
+			FOccluderInstance Occluder;
+			if (!Reader.Read(Occluder.MeshIndex) || !Reader.Read(Occluder.LocalToWorld)
+				|| Occluder.MeshIndex < 0 || Occluder.MeshIndex >= static_cast<int32_t>(NumMeshes))
+			{
+				return false;
+			}
+			OutScene.Occluders.push_back(Occluder);
+		}
+
+		return Reader.ReadArray(OutScene.OccluderBoxes)
+			&& Reader.ReadArray(OutScene.OccludeeBoxMinMax)
+			&& Reader.ReadArray(OutScene.OccludeeIds)
+			&& Reader.ReadArray(OutScene.OccludeeInstanceIndices);
+	}
+}
@@ -0,0 +1,27 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#pragma once
+
+/*=============================================================================
+	Binary capture of one occlusion frame, written by the so.CaptureScene console
+	command and replayed by the standalone tools. Every value is written little
+	endian whatever the host, and tightly packed. Occluder meshes are stored
+	quantized with their meshlets, as the engine renders them.
+=============================================================================*/
+
+#include "OcclusionCoreFrame.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace SOCore
+{
+	constexpr uint32_t SceneCaptureMagic = 0x50434F53; // "SOCP"
+	constexpr uint32_t SceneCaptureVersion = 2;
+
+	/** Appends the scene to OutBytes */
+	void WriteSceneCapture(const FScene& Scene, std::vector<uint8_t>& OutBytes);
+
+	/** Returns false when the data is not a capture of a supported version or is truncated */
+	bool ReadSceneCapture(const uint8_t* Data, size_t Size, FScene& OutScene);
+}
@@ -0,0 +1,288 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#include "OcclusionCoreFrame.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+
+namespace SOCore
+{
+	static double GetElapsedMs(const std::chrono::steady_clock::time_point Start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Start).count();
+	}
+
+	int32_t FScene::GetNumOccluderTriangles() const
+	{
+		int32_t NumTriangles = 0;
+		for (const FOccluderInstance& Occluder : Occluders)
+		{
+			NumTriangles += static_cast<int32_t>(Meshes[Occluder.MeshIndex].Indices.size() / 3);
+		}
+		return NumTriangles + static_cast<int32_t>(OccluderBoxes.size() * GetUnitCubeMesh().Indices.size() / 3);
+	}
+
+	int32_t FFrameResult::CountVisibleOccludees() const
+	{
+		int32_t NumVisible = 0;
+		for (const uint8_t bVisible : OccludeeVisibility)
+		{
+			NumVisible += bVisible != 0 ? 1 : 0;
+		}
+		return NumVisible;
+	}
+
+	FOccluderMeshView FOccluderMesh::GetView() const
+	{
+		FOccluderMeshView View;
+		View.Vertices = Vertices.data();
+		View.NumVertices = static_cast<int32_t>(Vertices.size());
+		View.Indices = Indices.data();
+		View.NumIndices = static_cast<int32_t>(Indices.size());
+		View.Meshlets = Meshlets.data();
+		View.NumMeshlets = static_cast<int32_t>(Meshlets.size());
+		View.QuantizationOffset = QuantizationOffset;
+		View.QuantizationScale = QuantizationScale;
+		return View;
+	}
+
+	/** Same as FOccluderMeshData::MAX_QUANTIZED and QUANTIZATION_TOLERANCE */
+	static constexpr float MaxQuantized = 65535.f;
+	static constexpr float QuantizationTolerance = 1e-3f;
+
+	FOccluderMesh BuildOccluderMesh(const std::vector<FVec3>& Vertices, const std::vector<uint16_t>& Indices)
+	{
+		FVec3 Min = { FLT_MAX, FLT_MAX, FLT_MAX };
+		FVec3 Max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (const FVec3& Vertex : Vertices)
+		{
+			Min = { std::min(Min.X, Vertex.X), std::min(Min.Y, Vertex.Y), std::min(Min.Z, Vertex.Z) };
+			Max = { std::max(Max.X, Vertex.X), std::max(Max.Y, Vertex.Y), std::max(Max.Z, Vertex.Z) };
+		}
+
+		FOccluderMesh Mesh;
+		if (Vertices.empty())
+		{
+			return Mesh;
+		}
+
+		const FVec3 Size = Max - Min;
+		Mesh.QuantizationOffset = Min;
+		Mesh.QuantizationScale = { std::max(Size.X / MaxQuantized, 1e-8f), std::max(Size.Y / MaxQuantized, 1e-8f), std::max(Size.Z / MaxQuantized, 1e-8f) };
+
+		auto RoundInward = [](const float Position, const float Offset, const float Scale)
+		{
+			const float Value = std::clamp((Position - Offset) / Scale, 0.f, MaxQuantized);
+			return static_cast<uint16_t>(Value > MaxQuantized * 0.5f ? std::floor(Value + QuantizationTolerance) : std::ceil(Value - QuantizationTolerance));
+		};
+
+		Mesh.Vertices.reserve(Vertices.size());
+		for (const FVec3& Vertex : Vertices)
+		{
+			Mesh.Vertices.push_back({
+				RoundInward(Vertex.X, Mesh.QuantizationOffset.X, Mesh.QuantizationScale.X),
+				RoundInward(Vertex.Y, Mesh.QuantizationOffset.Y, Mesh.QuantizationScale.Y),
+				RoundInward(Vertex.Z, Mesh.QuantizationOffset.Z, Mesh.QuantizationScale.Z)
+			});
+		}
+		Mesh.Indices = Indices;
+
+		FMeshlet& Meshlet = Mesh.Meshlets.emplace_back();
+		Meshlet.BoundsCenter = (Min + Max) * 0.5f;
+		Meshlet.BoundsExtent = Size * 0.5f;
+		Meshlet.NumVertices = static_cast<uint32_t>(Mesh.Vertices.size());
+		Meshlet.NumIndices = static_cast<uint32_t>(Mesh.Indices.size());
+		return Mesh;
+	}
+
+	const FOccluderMesh& GetUnitCubeMesh()
+	{
+		static const FOccluderMesh UnitCube = BuildOccluderMesh(
+			{
+				{ -1, -1, -1 }, { 1, -1, -1 }, { -1, 1, -1 }, { 1, 1, -1 },
+				{ -1, -1, 1 }, { 1, -1, 1 }, { -1, 1, 1 }, { 1, 1, 1 }
+			},
+			{
+				0, 2, 6, 0, 6, 4, 1, 7, 3, 1, 5, 7,
+				0, 5, 1, 0, 4, 5, 2, 3, 7, 2, 7, 6,
+				0, 1, 3, 0, 3, 2, 4, 7, 5, 4, 6, 7
+			});
+		return UnitCube;
+	}
+
+	bool ComputeConeCullingOrigin(const FMatrix44& LocalToRelativeWorld, FVec3& OutLocalViewOrigin)
+	{
+		const float (&M)[4][4] = LocalToRelativeWorld.M;
+
+		// Cofactors of the 3x3 part, in double since the view origin may be far from the mesh
+		const double C00 = static_cast<double>(M[1][1]) * M[2][2] - static_cast<double>(M[1][2]) * M[2][1];
+		const double C01 = static_cast<double>(M[1][2]) * M[2][0] - static_cast<double>(M[1][0]) * M[2][2];
+		const double C02 = static_cast<double>(M[1][0]) * M[2][1] - static_cast<double>(M[1][1]) * M[2][0];
+		const double Determinant = M[0][0] * C00 + M[0][1] * C01 + M[0][2] * C02;
+		if (Determinant <= 0.0)
+		{
+			return false;
+		}
+
+		float MinScale = FLT_MAX;
+		float MaxScale = 0.f;
+		for (int32_t Row = 0; Row < 3; ++Row)
+		{
+			const float Scale = FVec3{ M[Row][0], M[Row][1], M[Row][2] }.Size();
+			MinScale = std::min(MinScale, Scale);
+			MaxScale = std::max(MaxScale, Scale);
+		}
+		if (MaxScale > MinScale * ConeCullingMaxScaleRatio)
+		{
+			return false;
+		}
+
+		// The view origin is at zero, so its mesh space position is -Origin times the inverse of the 3x3 part
+		const double Inverse[3][3] =
+		{
+			{ C00, static_cast<double>(M[0][2]) * M[2][1] - static_cast<double>(M[0][1]) * M[2][2], static_cast<double>(M[0][1]) * M[1][2] - static_cast<double>(M[0][2]) * M[1][1] },
+			{ C01, static_cast<double>(M[0][0]) * M[2][2] - static_cast<double>(M[0][2]) * M[2][0], static_cast<double>(M[0][2]) * M[1][0] - static_cast<double>(M[0][0]) * M[1][2] },
+			{ C02, static_cast<double>(M[0][1]) * M[2][0] - static_cast<double>(M[0][0]) * M[2][1], static_cast<double>(M[0][0]) * M[1][1] - static_cast<double>(M[0][1]) * M[1][0] }
+		};
+
+		double Local[3];
+		for (int32_t Col = 0; Col < 3; ++Col)
+		{
+			Local[Col] = -(M[3][0] * Inverse[0][Col] + M[3][1] * Inverse[1][Col] + M[3][2] * Inverse[2][Col]) / Determinant;
+		}
+		OutLocalViewOrigin = { static_cast<float>(Local[0]), static_cast<float>(Local[1]), static_cast<float>(Local[2]) };
+		return true;
+	}
+
+	bool IsMeshletBackfacing(const FMeshlet& Meshlet, const FVec3& LocalViewOrigin)
+	{
+		if (Meshlet.ConeCosAngle <= 0.f)
+		{
+			return false;
+		}
+
+		const FVec3 ToCenter = Meshlet.BoundsCenter - LocalViewOrigin;
+		const double Distance = ToCenter.Size();
+		const double Radius = Meshlet.BoundsExtent.Size();
+		if (Distance <= Radius)
+		{
+			return false;
+		}
+
+		// Normals deviate at most by the cone angle from the axis, and triangles at most by the radius from the center
+		const double CosView = ToCenter.Dot(Meshlet.ConeAxis) / Distance;
+		const double SinView = std::sqrt(std::max(0.0, 1.0 - CosView * CosView));
+		const double CosViewPlusCone = CosView * Meshlet.ConeCosAngle - SinView * Meshlet.ConeSinAngle;
+		return CosView > 0.0 && Distance * CosViewPlusCone >= Radius;
+	}
+
+	static void AddQuantizedOccluderRange(const FKernelSet& Kernels, const FMatrix44& QuantToClip, const FQuantizedVertex* Vertices, const int32_t NumVertices,
+	                                      const uint16_t* Indices, const int32_t NumIndices, const float WClip,
+	                                      std::vector<FVec4>& ClipVertexBuffer, std::vector<uint8_t>& ClipFlagsBuffer, FFrameData& OutData)
+	{
+		ClipVertexBuffer.resize(NumVertices);
+		ClipFlagsBuffer.resize(NumVertices);
+
+		// Single precision straight from the quantized positions
+		Kernels.TransformQuantizedVertices(QuantToClip, Vertices, NumVertices, WClip, ClipVertexBuffer.data(), ClipFlagsBuffer.data());
+		AddOccluderTriangles(ClipVertexBuffer.data(), ClipFlagsBuffer.data(), NumVertices, Indices, NumIndices, WClip, OutData);
+	}
+
+	void AddOccluderMeshlets(const FKernelSet& Kernels, const FOccluderMeshView& Mesh, const FMatrix44& LocalToClip, const FVec3* LocalViewOrigin, const float WClip,
+	                         std::vector<FVec4>& ClipVertexBuffer, std::vector<uint8_t>& ClipFlagsBuffer, FFrameData& OutData)
+	{
+		const FMatrix44 QuantToClip = FMatrix44::MakeScaleTranslation(Mesh.QuantizationScale, Mesh.QuantizationOffset) * LocalToClip;
+
+		if (Mesh.NumMeshlets == 0)
+		{
+			AddQuantizedOccluderRange(Kernels, QuantToClip, Mesh.Vertices, Mesh.NumVertices, Mesh.Indices, Mesh.NumIndices, WClip, ClipVertexBuffer, ClipFlagsBuffer, OutData);
+			return;
+		}
+
+		for (int32_t MeshletIndex = 0; MeshletIndex < Mesh.NumMeshlets; ++MeshletIndex)
+		{
+			const FMeshlet& Meshlet = Mesh.Meshlets[MeshletIndex];
+			if (LocalViewOrigin && IsMeshletBackfacing(Meshlet, *LocalViewOrigin))
+			{
+				continue;
+			}
+
+			// Skip meshlets outside of the frustum before transforming their vertices
+			FVec4 ClipCorners[NumCubeVertices];
+			uint8_t AnyFlags;
+			if (ProjectBoxCorners(FMatrix44::MakeScaleTranslation(Meshlet.BoundsExtent, Meshlet.BoundsCenter) * LocalToClip, WClip, ClipCorners, AnyFlags) != 0)
+			{
+				continue;
+			}
+
+			AddQuantizedOccluderRange(Kernels, QuantToClip, Mesh.Vertices + Meshlet.FirstVertex, static_cast<int32_t>(Meshlet.NumVertices),
+			                          Mesh.Indices + Meshlet.FirstIndex, static_cast<int32_t>(Meshlet.NumIndices), WClip, ClipVertexBuffer, ClipFlagsBuffer, OutData);
+		}
+	}
+
+	void AddOccluderBox(const FKernelSet& Kernels, const FMatrix44& BoxToClip, const float WClip,
+	                    std::vector<FVec4>& ClipVertexBuffer, std::vector<uint8_t>& ClipFlagsBuffer, FFrameData& OutData)
+	{
+		FVec4 ClipCorners[NumCubeVertices];
+		uint8_t AnyFlags;
+		if (ProjectBoxCorners(BoxToClip, WClip, ClipCorners, AnyFlags) != 0)
+		{
+			// fully clipped
+			return;
+		}
+
+		if (AnyFlags & EClipFlags::ClippedNear)
+		{
+			// The silhouette is unbounded, let the triangle path clip the faces against the near plane
+			AddOccluderMeshlets(Kernels, GetUnitCubeMesh().GetView(), BoxToClip, nullptr, WClip, ClipVertexBuffer, ClipFlagsBuffer, OutData);
+			return;
+		}
+
+		AddOccluderBoxSilhouette(ClipCorners, OutData);
+	}
+
+	void FFrameProcessor::Process(const FScene& Scene, FFrameResult& OutResult, FCoverageDepth* OutCoverageDepth)
+	{
+		const float WClip = Scene.ViewProj.M[3][2];
+		const int32_t NumOccludees = Scene.GetNumOccludees();
+
+		FrameData.Reset();
+		FrameData.ReserveBuffers(Scene.GetNumOccluderTriangles() + NumOccludees);
+		OutResult.Coverage.Clear();
+		OutResult.OccludeeVisibility.assign(NumOccludees, 0);
+		OutResult.Timings = FStageTimings();
+
+		auto StageStart = std::chrono::steady_clock::now();
+		for (const FOccluderInstance& Occluder : Scene.Occluders)
+		{
+			FVec3 LocalViewOrigin;
+			const bool bMeshConeCulling = bConeCulling && ComputeConeCullingOrigin(Occluder.LocalToWorld, LocalViewOrigin);
+			AddOccluderMeshlets(Kernels, Scene.Meshes[Occluder.MeshIndex].GetView(), Occluder.LocalToWorld * Scene.ViewProj, bMeshConeCulling ? &LocalViewOrigin : nullptr,
+			                    WClip, ClipVertexBuffer, ClipFlagsBuffer, FrameData);
+		}
+		for (const FMatrix44& BoxToWorld : Scene.OccluderBoxes)
+		{
+			AddOccluderBox(Kernels, BoxToWorld * Scene.ViewProj, WClip, ClipVertexBuffer, ClipFlagsBuffer, FrameData);
+		}
+		OutResult.Timings.OccluderMs = GetElapsedMs(StageStart);
+
+		StageStart = std::chrono::steady_clock::now();
+		Quads.resize(NumOccludees * 4);
+		QuadDepths.resize(NumOccludees);
+		QuadClipped.resize(NumOccludees);
+		Kernels.ProjectOccludeeBoxes(Scene.ViewProj * MakeClipToFramebuffer(), Scene.OccludeeBoxMinMax.data(), NumOccludees, Quads.data(), QuadDepths.data(), QuadClipped.data());
+		AddOccludeeQuads(Quads.data(), QuadDepths.data(), QuadClipped.data(), NumOccludees, 0, OutResult.OccludeeVisibility.data(), FrameData);
+		OutResult.Timings.OccludeeMs = GetElapsedMs(StageStart);
+
+		StageStart = std::chrono::steady_clock::now();
+		SortFrame(FrameData);
+		OutResult.Timings.SortMs = GetElapsedMs(StageStart);
+
+		StageStart = std::chrono::steady_clock::now();
+		OutResult.RasterStats = RasterizeSortedFrame(FrameData, OutResult.Coverage, OutResult.OccludeeVisibility.data(), OutCoverageDepth);
+		OutResult.Timings.RasterizeMs = GetElapsedMs(StageStart);
+
+		OutResult.NumScreenTriangles = static_cast<int32_t>(FrameData.ScreenTriangles.size());
+	}
+}
@@ -0,0 +1,176 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#pragma once
+
+/*=============================================================================
+	Headless occlusion frame: the scene is described with plain types and run
+	through the core stages. Used by the standalone tools, the engine goes
+	through ProcessOcclusionFrame in Legacy/SceneSoftwareOcclusion.h. Both bin
+	their occluders with AddOccluderMeshlets and AddOccluderBox.
+=============================================================================*/
+
+#include "OcclusionCoreKernels.h"
+
+#include <vector>
+
+namespace SOCore
+{
+	/** Range of an occluder mesh, its indices are relative to FirstVertex. Same layout as FOccluderMeshlet. */
+	struct FMeshlet
+	{
+		/** Bounds in mesh space */
+		FVec3 BoundsCenter;
+		FVec3 BoundsExtent;
+
+		uint32_t FirstVertex = 0;
+		uint32_t NumVertices = 0;
+		uint32_t FirstIndex = 0;
+		uint32_t NumIndices = 0;
+
+		/** Average outward facing triangle normal in mesh space */
+		FVec3 ConeAxis;
+
+		/** Cosine and sine of the largest angle between a triangle normal and ConeAxis. No cone when the cosine is not positive */
+		float ConeCosAngle = -1.f;
+		float ConeSinAngle = 0.f;
+	};
+
+	/** Occluder mesh without ownership, so the engine meshes go through the same path as the tool ones */
+	struct FOccluderMeshView
+	{
+		const FQuantizedVertex* Vertices = nullptr;
+		int32_t NumVertices = 0;
+		const uint16_t* Indices = nullptr;
+		int32_t NumIndices = 0;
+
+		/** Optional split of the mesh, the whole mesh is a single range when empty */
+		const FMeshlet* Meshlets = nullptr;
+		int32_t NumMeshlets = 0;
+
+		/** Maps the quantized positions to mesh space */
+		FVec3 QuantizationOffset;
+		FVec3 QuantizationScale = { 1.f, 1.f, 1.f };
+	};
+
+	/** Quantized occluder mesh, like FOccluderMeshData */
+	struct FOccluderMesh
+	{
+		std::vector<FQuantizedVertex> Vertices;
+		std::vector<uint16_t> Indices;
+
+		/** Optional split of the mesh, the whole mesh is a single range when empty */
+		std::vector<FMeshlet> Meshlets;
+
+		FVec3 QuantizationOffset;
+		FVec3 QuantizationScale = { 1.f, 1.f, 1.f };
+
+		FOccluderMeshView GetView() const;
+	};
+
+	/**
+	 * Quantizes a mesh within its bounds into a single meshlet without normal cone. Positions are rounded toward
+	 * the center of the bounds like FOccluderMeshData::BuildMeshlets, so the quantized mesh never reaches past its source.
+	 */
+	FOccluderMesh BuildOccluderMesh(const std::vector<FVec3>& Vertices, const std::vector<uint16_t>& Indices);
+
+	struct FOccluderInstance
+	{
+		int32_t MeshIndex = 0;
+		FMatrix44 LocalToWorld;
+	};
+
+	/** Input of one occlusion frame. World positions are relative to the view origin. */
+	struct FScene
+	{
+		FMatrix44 ViewProj;
+
+		std::vector<FOccluderMesh> Meshes;
+		std::vector<FOccluderInstance> Occluders;
+
+		/** Box occluders, each matrix maps the [-1, 1] cube to world space */
+		std::vector<FMatrix44> OccluderBoxes;
+
+		/** Min and max corners of each occludee box */
+		std::vector<FVec3> OccludeeBoxMinMax;
+
+		/** Optional primitive id and instance index of each occludee, to match results with the engine */
+		std::vector<uint32_t> OccludeeIds;
+		std::vector<int32_t> OccludeeInstanceIndices;
+
+		int32_t GetNumOccludees() const { return static_cast<int32_t>(OccludeeBoxMinMax.size() / 2); }
+		int32_t GetNumOccluderTriangles() const;
+	};
+
+	struct FStageTimings
+	{
+		double OccluderMs = 0.0;
+		double OccludeeMs = 0.0;
+		double SortMs = 0.0;
+		double RasterizeMs = 0.0;
+
+		double GetTotalMs() const { return OccluderMs + OccludeeMs + SortMs + RasterizeMs; }
+	};
+
+	struct FFrameResult
+	{
+		FCoverageBuffer Coverage;
+
+		/** Non zero for each visible occludee */
+		std::vector<uint8_t> OccludeeVisibility;
+
+		FRasterStats RasterStats;
+		int32_t NumScreenTriangles = 0;
+		FStageTimings Timings;
+
+		int32_t CountVisibleOccludees() const;
+	};
+
+	/** Unit cube [-1, 1], front facing when seen from outside */
+	const FOccluderMesh& GetUnitCubeMesh();
+
+	/** Largest ratio between the scale axes of an occluder that still allows cone culling */
+	constexpr float ConeCullingMaxScaleRatio = 1.01f;
+
+	/**
+	 * Computes the view origin in mesh space, for IsMeshletBackfacing. LocalToRelativeWorld is relative to the view origin.
+	 * Returns false when the transform mirrors or scales non uniformly, normal cones are only valid without either.
+	 */
+	bool ComputeConeCullingOrigin(const FMatrix44& LocalToRelativeWorld, FVec3& OutLocalViewOrigin);
+
+	/** True when every triangle of the meshlet faces away from the view, the view origin is in mesh space */
+	bool IsMeshletBackfacing(const FMeshlet& Meshlet, const FVec3& LocalViewOrigin);
+
+	/**
+	 * Bins an occluder mesh. Meshlets outside of the frustum, or facing away from LocalViewOrigin when it is not null, are skipped
+	 * before their quantized vertices are transformed. The buffers are reused between calls.
+	 */
+	void AddOccluderMeshlets(const FKernelSet& Kernels, const FOccluderMeshView& Mesh, const FMatrix44& LocalToClip, const FVec3* LocalViewOrigin, float WClip,
+	                         std::vector<FVec4>& ClipVertexBuffer, std::vector<uint8_t>& ClipFlagsBuffer, FFrameData& OutData);
+
+	/** Bins a box occluder, as its screen silhouette or as a cube mesh when it crosses the near plane */
+	void AddOccluderBox(const FKernelSet& Kernels, const FMatrix44& BoxToClip, float WClip,
+	                    std::vector<FVec4>& ClipVertexBuffer, std::vector<uint8_t>& ClipFlagsBuffer, FFrameData& OutData);
+
+	/** Runs scenes through the core stages, keeping the scratch buffers between frames */
+	class FFrameProcessor
+	{
+	public:
+		explicit FFrameProcessor(const FKernelSet& InKernels = GetSIMDKernels()) : Kernels(InKernels) {}
+
+		/** OutCoverageDepth is optional, it receives the occluder depth of the covered pixels for visibility queries */
+		void Process(const FScene& Scene, FFrameResult& OutResult, FCoverageDepth* OutCoverageDepth = nullptr);
+
+		/** Same as r.so.ConeCulling, enabled by default */
+		void SetConeCulling(const bool bEnabled) { bConeCulling = bEnabled; }
+
+	private:
+		const FKernelSet& Kernels;
+		bool bConeCulling = true;
+		FFrameData FrameData;
+		std::vector<FVec4> ClipVertexBuffer;
+		std::vector<uint8_t> ClipFlagsBuffer;
+		std::vector<int32_t> Quads;
+		std::vector<float> QuadDepths;
+		std::vector<int32_t> QuadClipped;
+	};
+}
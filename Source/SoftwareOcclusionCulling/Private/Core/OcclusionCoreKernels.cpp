@@ -0,0 +1,273 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#include "OcclusionCoreKernels.h"
+
+#include <cfloat>
+
+#if SO_CORE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if SO_CORE_NEON
+#include <arm_neon.h>
+#endif
+
+namespace SOCore
+{
+	static const FKernelSet KernelSets[] =
+	{
+		{ "scalar", &ProjectOccludeeBoxes, &TransformVertices, &TransformQuantizedVertices },
+#if SO_CORE_SSE2
+		{ "sse2", &ProjectOccludeeBoxesSSE2, &TransformVerticesSSE2, &TransformQuantizedVerticesSSE2 },
+#endif
+#if SO_CORE_NEON
+		{ "neon", &ProjectOccludeeBoxesNEON, &TransformVerticesNEON, &TransformQuantizedVerticesNEON },
+#endif
+	};
+
+	static constexpr int32_t NumKernelSets = static_cast<int32_t>(sizeof(KernelSets) / sizeof(KernelSets[0]));
+
+	const FKernelSet& GetScalarKernels()
+	{
+		return KernelSets[0];
+	}
+
+	const FKernelSet& GetSIMDKernels()
+	{
+		return KernelSets[NumKernelSets - 1];
+	}
+
+	int32_t GetNumKernelSets()
+	{
+		return NumKernelSets;
+	}
+
+	const FKernelSet& GetKernelSet(const int32_t Index)
+	{
+		return KernelSets[Index];
+	}
+
+#if SO_CORE_SSE2
+	// Same operation order as FMatrix44::TransformPosition, so results match the scalar kernels bit for bit
+	static inline __m128 TransformPositionSSE2(const __m128 (&Rows)[4], const float X, const float Y, const float Z)
+	{
+		__m128 V = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(X), Rows[0]), _mm_mul_ps(_mm_set1_ps(Y), Rows[1]));
+		V = _mm_add_ps(V, _mm_mul_ps(_mm_set1_ps(Z), Rows[2]));
+		return _mm_add_ps(V, Rows[3]);
+	}
+
+	// ComputeClipFlags on all components at once
+	static inline uint8_t ComputeClipFlagsSSE2(const __m128 V, const __m128 WClip)
+	{
+		const __m128 W = _mm_shuffle_ps(V, V, _MM_SHUFFLE(3, 3, 3, 3));
+		const __m128 NegW = _mm_xor_ps(W, _mm_set1_ps(-0.f));
+
+		// Bit 0 is X, bit 1 is Y
+		const int32_t Below = _mm_movemask_ps(_mm_cmplt_ps(V, NegW));
+		const int32_t Above = _mm_movemask_ps(_mm_cmpgt_ps(V, W));
+		const int32_t Near = _mm_movemask_ps(_mm_cmplt_ps(W, WClip));
+
+		return static_cast<uint8_t>(
+			((Below & 1) ? EClipFlags::ClippedLeft : 0) | ((Above & 1) ? EClipFlags::ClippedRight : 0) |
+			((Below & 2) ? EClipFlags::ClippedTop : 0) | ((Above & 2) ? EClipFlags::ClippedBottom : 0) |
+			((Near & 1) ? EClipFlags::ClippedNear : 0));
+	}
+
+	static inline void LoadRows(const FMatrix44& Matrix, __m128 (&OutRows)[4])
+	{
+		for (int32_t Row = 0; Row < 4; ++Row)
+		{
+			OutRows[Row] = _mm_load_ps(Matrix.M[Row]);
+		}
+	}
+
+	void ProjectOccludeeBoxesSSE2(const FMatrix44& WorldToFramebuffer, const FVec3* MinMax, const int32_t Num,
+	                              int32_t* OutQuads, float* OutDepths, int32_t* OutClipped)
+	{
+		__m128 Rows[4];
+		LoadRows(WorldToFramebuffer, Rows);
+
+		const __m128 WClip = _mm_set1_ps(WorldToFramebuffer.M[3][2]);
+		const __m128 FramebufferBounds = _mm_setr_ps(FramebufferWidth - 1.f, FramebufferHeight - 1.f, 1.f, 1.f);
+		const __m128 XYHalf = _mm_setr_ps(0.5f, 0.5f, 0.f, 0.f);
+
+		for (int32_t k = 0; k < Num; ++k, MinMax += 2, OutQuads += 4)
+		{
+			const FVec3& BoxMin = MinMax[0];
+			const FVec3& BoxMax = MinMax[1];
+
+			__m128 ClippedMask = _mm_setzero_ps();
+			__m128 ScreenMin = _mm_set1_ps(FLT_MAX);
+			__m128 ScreenMax = _mm_set1_ps(-FLT_MAX);
+
+			// Unlike the scalar kernel all corners are projected, the quad of a near clipped box is not used
+			for (int32_t i = 0; i < NumCubeVertices; ++i)
+			{
+				__m128 V = TransformPositionSSE2(Rows, (i & 1) ? BoxMax.X : BoxMin.X, (i & 2) ? BoxMax.Y : BoxMin.Y, (i & 4) ? BoxMax.Z : BoxMin.Z);
+				const __m128 W = _mm_shuffle_ps(V, V, _MM_SHUFFLE(3, 3, 3, 3));
+				ClippedMask = _mm_or_ps(ClippedMask, _mm_cmplt_ps(W, WClip));
+				V = _mm_div_ps(V, W);
+
+				ScreenMin = _mm_min_ps(ScreenMin, V);
+				ScreenMax = _mm_max_ps(ScreenMax, V);
+			}
+
+			OutClipped[k] = _mm_movemask_ps(ClippedMask) != 0 ? 1 : 0;
+			if (OutClipped[k])
+			{
+				continue;
+			}
+
+			// Pixel snapping and clipping against the screen rect, Z is only clamped to 1
+			ScreenMin = _mm_max_ps(_mm_add_ps(ScreenMin, XYHalf), _mm_setzero_ps());
+			ScreenMax = _mm_min_ps(_mm_add_ps(ScreenMax, XYHalf), FramebufferBounds);
+
+			// MinX, MinY, MaxX, MaxY
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(OutQuads), _mm_cvttps_epi32(_mm_movelh_ps(ScreenMin, ScreenMax)));
+			OutDepths[k] = _mm_cvtss_f32(_mm_shuffle_ps(ScreenMax, ScreenMax, _MM_SHUFFLE(2, 2, 2, 2)));
+		}
+	}
+
+	void TransformVerticesSSE2(const FMatrix44& LocalToClip, const FVec3* Vertices, const int32_t NumVertices, const float WClip,
+	                           FVec4* OutClipVertices, uint8_t* OutClipFlags)
+	{
+		__m128 Rows[4];
+		LoadRows(LocalToClip, Rows);
+		const __m128 WClipV = _mm_set1_ps(WClip);
+
+		for (int32_t i = 0; i < NumVertices; ++i)
+		{
+			const __m128 V = TransformPositionSSE2(Rows, Vertices[i].X, Vertices[i].Y, Vertices[i].Z);
+			_mm_store_ps(&OutClipVertices[i].X, V);
+			OutClipFlags[i] = ComputeClipFlagsSSE2(V, WClipV);
+		}
+	}
+
+	void TransformQuantizedVerticesSSE2(const FMatrix44& QuantToClip, const FQuantizedVertex* Vertices, const int32_t NumVertices, const float WClip,
+	                                    FVec4* OutClipVertices, uint8_t* OutClipFlags)
+	{
+		__m128 Rows[4];
+		LoadRows(QuantToClip, Rows);
+		const __m128 WClipV = _mm_set1_ps(WClip);
+
+		for (int32_t i = 0; i < NumVertices; ++i)
+		{
+			const FQuantizedVertex& Vertex = Vertices[i];
+			const __m128 V = TransformPositionSSE2(Rows, static_cast<float>(Vertex.X), static_cast<float>(Vertex.Y), static_cast<float>(Vertex.Z));
+			_mm_store_ps(&OutClipVertices[i].X, V);
+			OutClipFlags[i] = ComputeClipFlagsSSE2(V, WClipV);
+		}
+	}
+#endif
+
+#if SO_CORE_NEON
+	// Same operation order as FMatrix44::TransformPosition, like the SSE2 kernels
+	static inline float32x4_t TransformPositionNEON(const float32x4_t (&Rows)[4], const float X, const float Y, const float Z)
+	{
+		float32x4_t V = vaddq_f32(vmulq_n_f32(Rows[0], X), vmulq_n_f32(Rows[1], Y));
+		V = vaddq_f32(V, vmulq_n_f32(Rows[2], Z));
+		return vaddq_f32(V, Rows[3]);
+	}
+
+	// ComputeClipFlags on all components at once
+	static inline uint8_t ComputeClipFlagsNEON(const float32x4_t V, const float WClip)
+	{
+		const float32x4_t W = vdupq_laneq_f32(V, 3);
+
+		// Lane 0 is X, lane 1 is Y
+		const uint32x4_t Below = vcltq_f32(V, vnegq_f32(W));
+		const uint32x4_t Above = vcgtq_f32(V, W);
+
+		return static_cast<uint8_t>(
+			(vgetq_lane_u32(Below, 0) ? EClipFlags::ClippedLeft : 0) | (vgetq_lane_u32(Above, 0) ? EClipFlags::ClippedRight : 0) |
+			(vgetq_lane_u32(Below, 1) ? EClipFlags::ClippedTop : 0) | (vgetq_lane_u32(Above, 1) ? EClipFlags::ClippedBottom : 0) |
+			(vgetq_lane_f32(V, 3) < WClip ? EClipFlags::ClippedNear : 0));
+	}
+
+	static inline void LoadRows(const FMatrix44& Matrix, float32x4_t (&OutRows)[4])
+	{
+		for (int32_t Row = 0; Row < 4; ++Row)
+		{
+			OutRows[Row] = vld1q_f32(Matrix.M[Row]);
+		}
+	}
+
+	void ProjectOccludeeBoxesNEON(const FMatrix44& WorldToFramebuffer, const FVec3* MinMax, const int32_t Num,
+	                              int32_t* OutQuads, float* OutDepths, int32_t* OutClipped)
+	{
+		float32x4_t Rows[4];
+		LoadRows(WorldToFramebuffer, Rows);
+
+		const float32x4_t WClip = vdupq_n_f32(WorldToFramebuffer.M[3][2]);
+		const float FramebufferBoundsValues[4] = { FramebufferWidth - 1.f, FramebufferHeight - 1.f, 1.f, 1.f };
+		const float XYHalfValues[4] = { 0.5f, 0.5f, 0.f, 0.f };
+		const float32x4_t FramebufferBounds = vld1q_f32(FramebufferBoundsValues);
+		const float32x4_t XYHalf = vld1q_f32(XYHalfValues);
+
+		for (int32_t k = 0; k < Num; ++k, MinMax += 2, OutQuads += 4)
+		{
+			const FVec3& BoxMin = MinMax[0];
+			const FVec3& BoxMax = MinMax[1];
+
+			uint32x4_t ClippedMask = vdupq_n_u32(0);
+			float32x4_t ScreenMin = vdupq_n_f32(FLT_MAX);
+			float32x4_t ScreenMax = vdupq_n_f32(-FLT_MAX);
+
+			// Unlike the scalar kernel all corners are projected, the quad of a near clipped box is not used
+			for (int32_t i = 0; i < NumCubeVertices; ++i)
+			{
+				float32x4_t V = TransformPositionNEON(Rows, (i & 1) ? BoxMax.X : BoxMin.X, (i & 2) ? BoxMax.Y : BoxMin.Y, (i & 4) ? BoxMax.Z : BoxMin.Z);
+				const float32x4_t W = vdupq_laneq_f32(V, 3);
+				ClippedMask = vorrq_u32(ClippedMask, vcltq_f32(W, WClip));
+				V = vdivq_f32(V, W);
+
+				ScreenMin = vminq_f32(ScreenMin, V);
+				ScreenMax = vmaxq_f32(ScreenMax, V);
+			}
+
+			OutClipped[k] = vmaxvq_u32(ClippedMask) != 0 ? 1 : 0;
+			if (OutClipped[k])
+			{
+				continue;
+			}
+
+			// Pixel snapping and clipping against the screen rect, Z is only clamped to 1
+			ScreenMin = vmaxq_f32(vaddq_f32(ScreenMin, XYHalf), vdupq_n_f32(0.f));
+			ScreenMax = vminq_f32(vaddq_f32(ScreenMax, XYHalf), FramebufferBounds);
+
+			// MinX, MinY, MaxX, MaxY
+			vst1q_s32(OutQuads, vcvtq_s32_f32(vcombine_f32(vget_low_f32(ScreenMin), vget_low_f32(ScreenMax))));
+			OutDepths[k] = vgetq_lane_f32(ScreenMax, 2);
+		}
+	}
+
+	void TransformVerticesNEON(const FMatrix44& LocalToClip, const FVec3* Vertices, const int32_t NumVertices, const float WClip,
+	                           FVec4* OutClipVertices, uint8_t* OutClipFlags)
+	{
+		float32x4_t Rows[4];
+		LoadRows(LocalToClip, Rows);
+
+		for (int32_t i = 0; i < NumVertices; ++i)
+		{
+			const float32x4_t V = TransformPositionNEON(Rows, Vertices[i].X, Vertices[i].Y, Vertices[i].Z);
+			vst1q_f32(&OutClipVertices[i].X, V);
+			OutClipFlags[i] = ComputeClipFlagsNEON(V, WClip);
+		}
+	}
+
+	void TransformQuantizedVerticesNEON(const FMatrix44& QuantToClip, const FQuantizedVertex* Vertices, const int32_t NumVertices, const float WClip,
+	                                    FVec4* OutClipVertices, uint8_t* OutClipFlags)
+	{
+		float32x4_t Rows[4];
+		LoadRows(QuantToClip, Rows);
+
+		for (int32_t i = 0; i < NumVertices; ++i)
+		{
+			const FQuantizedVertex& Vertex = Vertices[i];
+			const float32x4_t V = TransformPositionNEON(Rows, static_cast<float>(Vertex.X), static_cast<float>(Vertex.Y), static_cast<float>(Vertex.Z));
+			vst1q_f32(&OutClipVertices[i].X, V);
+			OutClipFlags[i] = ComputeClipFlagsNEON(V, WClip);
+		}
+	}
+#endif
+}
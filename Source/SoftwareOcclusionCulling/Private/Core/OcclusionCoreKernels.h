@@ -0,0 +1,80 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#pragma once
+
+/*=============================================================================
+	Variants of the per element kernels. The scalar kernels of
+	OcclusionCoreRasterizer.h are the reference: other variants must give the
+	same results, or at least never hide an occludee the reference shows.
+	Tools/OcclusionKernelCheck validates and times every variant.
+=============================================================================*/
+
+#include "OcclusionCoreRasterizer.h"
+
+#ifndef SO_CORE_SSE2
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SO_CORE_SSE2 1
+#else
+#define SO_CORE_SSE2 0
+#endif
+#endif
+
+// AArch64 only, the kernels divide with vdivq_f32
+#ifndef SO_CORE_NEON
+#if !SO_CORE_SSE2 && (defined(__aarch64__) || defined(_M_ARM64))
+#define SO_CORE_NEON 1
+#else
+#define SO_CORE_NEON 0
+#endif
+#endif
+
+namespace SOCore
+{
+	using FProjectOccludeeBoxesKernel = void (*)(const FMatrix44& WorldToFramebuffer, const FVec3* MinMax, int32_t Num,
+	                                             int32_t* OutQuads, float* OutDepths, int32_t* OutClipped);
+
+	using FTransformVerticesKernel = void (*)(const FMatrix44& LocalToClip, const FVec3* Vertices, int32_t NumVertices, float WClip,
+	                                          FVec4* OutClipVertices, uint8_t* OutClipFlags);
+
+	using FTransformQuantizedVerticesKernel = void (*)(const FMatrix44& QuantToClip, const FQuantizedVertex* Vertices, int32_t NumVertices, float WClip,
+	                                                   FVec4* OutClipVertices, uint8_t* OutClipFlags);
+
+	struct FKernelSet
+	{
+		const char* Name;
+		FProjectOccludeeBoxesKernel ProjectOccludeeBoxes;
+		FTransformVerticesKernel TransformVertices;
+		FTransformQuantizedVerticesKernel TransformQuantizedVertices;
+	};
+
+	const FKernelSet& GetScalarKernels();
+
+	/** Fastest variant of the target, the scalar kernels when none is built */
+	const FKernelSet& GetSIMDKernels();
+
+	/** Every variant built for the target, the scalar reference first */
+	int32_t GetNumKernelSets();
+	const FKernelSet& GetKernelSet(int32_t Index);
+
+#if SO_CORE_SSE2
+	void ProjectOccludeeBoxesSSE2(const FMatrix44& WorldToFramebuffer, const FVec3* MinMax, int32_t Num,
+	                              int32_t* OutQuads, float* OutDepths, int32_t* OutClipped);
+
+	void TransformVerticesSSE2(const FMatrix44& LocalToClip, const FVec3* Vertices, int32_t NumVertices, float WClip,
+	                           FVec4* OutClipVertices, uint8_t* OutClipFlags);
+
+	void TransformQuantizedVerticesSSE2(const FMatrix44& QuantToClip, const FQuantizedVertex* Vertices, int32_t NumVertices, float WClip,
+	                                    FVec4* OutClipVertices, uint8_t* OutClipFlags);
+#endif
+
+#if SO_CORE_NEON
+	void ProjectOccludeeBoxesNEON(const FMatrix44& WorldToFramebuffer, const FVec3* MinMax, int32_t Num,
+	                              int32_t* OutQuads, float* OutDepths, int32_t* OutClipped);
+
+	void TransformVerticesNEON(const FMatrix44& LocalToClip, const FVec3* Vertices, int32_t NumVertices, float WClip,
+	                           FVec4* OutClipVertices, uint8_t* OutClipFlags);
+
+	void TransformQuantizedVerticesNEON(const FMatrix44& QuantToClip, const FQuantizedVertex* Vertices, int32_t NumVertices, float WClip,
+	                                    FVec4* OutClipVertices, uint8_t* OutClipFlags);
+#endif
+}
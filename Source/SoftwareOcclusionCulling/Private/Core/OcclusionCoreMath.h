@@ -0,0 +1,123 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#pragma once
+
+/*=============================================================================
+	Plain math types of the occlusion core. They only depend on the C++ standard
+	library so the core builds outside of the engine.
+=============================================================================*/
+
+#include <cmath>
+#include <cstdint>
+
+namespace SOCore
+{
+	struct FVec3
+	{
+		float X = 0.f;
+		float Y = 0.f;
+		float Z = 0.f;
+
+		FVec3 operator+(const FVec3& V) const { return { X + V.X, Y + V.Y, Z + V.Z }; }
+		FVec3 operator-(const FVec3& V) const { return { X - V.X, Y - V.Y, Z - V.Z }; }
+		FVec3 operator*(const float S) const { return { X * S, Y * S, Z * S }; }
+
+		float Dot(const FVec3& V) const { return X * V.X + Y * V.Y + Z * V.Z; }
+		FVec3 Cross(const FVec3& V) const { return { Y * V.Z - Z * V.Y, Z * V.X - X * V.Z, X * V.Y - Y * V.X }; }
+		float Size() const { return std::sqrt(Dot(*this)); }
+		FVec3 GetSafeNormal() const { const float S = Size(); return S > 0.f ? *this * (1.f / S) : FVec3(); }
+	};
+
+	struct alignas(16) FVec4
+	{
+		float X = 0.f;
+		float Y = 0.f;
+		float Z = 0.f;
+		float W = 0.f;
+
+		FVec4 operator+(const FVec4& V) const { return { X + V.X, Y + V.Y, Z + V.Z, W + V.W }; }
+		FVec4 operator-(const FVec4& V) const { return { X - V.X, Y - V.Y, Z - V.Z, W - V.W }; }
+		FVec4 operator*(const float S) const { return { X * S, Y * S, Z * S, W * S }; }
+		FVec4 operator/(const float S) const { return { X / S, Y / S, Z / S, W / S }; }
+	};
+
+	/** Row major 4x4 matrix that transforms row vectors, like the engine matrices */
+	struct alignas(16) FMatrix44
+	{
+		float M[4][4] = { { 1.f, 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f, 0.f }, { 0.f, 0.f, 1.f, 0.f }, { 0.f, 0.f, 0.f, 1.f } };
+
+		FVec4 TransformPosition(const FVec3& P) const
+		{
+			return {
+				P.X * M[0][0] + P.Y * M[1][0] + P.Z * M[2][0] + M[3][0],
+				P.X * M[0][1] + P.Y * M[1][1] + P.Z * M[2][1] + M[3][1],
+				P.X * M[0][2] + P.Y * M[1][2] + P.Z * M[2][2] + M[3][2],
+				P.X * M[0][3] + P.Y * M[1][3] + P.Z * M[2][3] + M[3][3]
+			};
+		}
+
+		FMatrix44 operator*(const FMatrix44& Other) const
+		{
+			FMatrix44 Result;
+			for (int32_t Row = 0; Row < 4; ++Row)
+			{
+				for (int32_t Col = 0; Col < 4; ++Col)
+				{
+					Result.M[Row][Col] = M[Row][0] * Other.M[0][Col] + M[Row][1] * Other.M[1][Col] + M[Row][2] * Other.M[2][Col] + M[Row][3] * Other.M[3][Col];
+				}
+			}
+			return Result;
+		}
+
+		static FMatrix44 MakeTranslation(const FVec3& T)
+		{
+			FMatrix44 Result;
+			Result.M[3][0] = T.X;
+			Result.M[3][1] = T.Y;
+			Result.M[3][2] = T.Z;
+			return Result;
+		}
+
+		/** Scale followed by translation */
+		static FMatrix44 MakeScaleTranslation(const FVec3& S, const FVec3& T)
+		{
+			FMatrix44 Result = MakeTranslation(T);
+			Result.M[0][0] = S.X;
+			Result.M[1][1] = S.Y;
+			Result.M[2][2] = S.Z;
+			return Result;
+		}
+
+		/** View matrix looking from Eye towards Target, like FLookAtMatrix */
+		static FMatrix44 MakeLookAt(const FVec3& Eye, const FVec3& Target, const FVec3& Up)
+		{
+			const FVec3 ZAxis = (Target - Eye).GetSafeNormal();
+			const FVec3 XAxis = Up.Cross(ZAxis).GetSafeNormal();
+			const FVec3 YAxis = ZAxis.Cross(XAxis);
+
+			FMatrix44 Result;
+			const FVec3 Axes[3] = { XAxis, YAxis, ZAxis };
+			for (int32_t Col = 0; Col < 3; ++Col)
+			{
+				Result.M[0][Col] = Axes[Col].X;
+				Result.M[1][Col] = Axes[Col].Y;
+				Result.M[2][Col] = Axes[Col].Z;
+				Result.M[3][Col] = -Eye.Dot(Axes[Col]);
+			}
+			return Result;
+		}
+
+		/** Reversed Z perspective projection with an infinite far plane, like FReversedZPerspectiveMatrix */
+		static FMatrix44 MakeReversedZPerspective(const float HalfFOV, const float Width, const float Height, const float MinZ)
+		{
+			FMatrix44 Result;
+			Result.M[0][0] = 1.f / std::tan(HalfFOV);
+			Result.M[1][1] = Width / std::tan(HalfFOV) / Height;
+			Result.M[2][2] = 0.f;
+			Result.M[2][3] = 1.f;
+			Result.M[3][2] = MinZ;
+			Result.M[3][3] = 0.f;
+			return Result;
+		}
+	};
+}
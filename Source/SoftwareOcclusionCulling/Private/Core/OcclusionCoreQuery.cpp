@@ -0,0 +1,94 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#include "OcclusionCoreQuery.h"
+
+#include <algorithm>
+
+namespace SOCore
+{
+	bool TestQuadVisibility(const FCoverageBuffer& Coverage, const FCoverageDepth& CoverageDepth,
+	                        const int32_t MinX, const int32_t MinY, const int32_t MaxX, const int32_t MaxY, const float Depth)
+	{
+		for (int32_t BinIdx = MinX / BinWidth; BinIdx <= MaxX / BinWidth; ++BinIdx)
+		{
+			const int32_t BinMinX = BinIdx * BinWidth;
+			const int32_t X0 = std::max(MinX - BinMinX, 0);
+			const int32_t X1 = std::min(MaxX - BinMinX, BinWidth - 1);
+			const int32_t NumBits = (X1 - X0) + 1;
+			const uint64_t RowMask = (NumBits == BinWidth) ? ~0ull : ((1ull << NumBits) - 1) << X0;
+
+			for (int32_t Row = MinY; Row <= MaxY; ++Row)
+			{
+				if (~Coverage.Bins[BinIdx][Row] & RowMask)
+				{
+					return true;
+				}
+
+				// Every occluder covering the row is closer
+				if (CoverageDepth.RowMin[BinIdx][Row] > Depth)
+				{
+					continue;
+				}
+
+				const float* RowDepth = CoverageDepth.Pixels[BinIdx][Row];
+				for (int32_t X = X0; X <= X1; ++X)
+				{
+					if (RowDepth[X] <= Depth)
+					{
+						return true;
+					}
+				}
+			}
+		}
+
+		return false;
+	}
+
+	bool IsBoxBehindView(const FMatrix44& WorldToFramebuffer, const FVec3& BoxMin, const FVec3& BoxMax)
+	{
+		const float WClip = WorldToFramebuffer.M[3][2];
+		for (int32_t i = 0; i < NumCubeVertices; ++i)
+		{
+			const FVec3 Corner = { (i & 1) ? BoxMax.X : BoxMin.X, (i & 2) ? BoxMax.Y : BoxMin.Y, (i & 4) ? BoxMax.Z : BoxMin.Z };
+			if (WorldToFramebuffer.TransformPosition(Corner).W >= WClip)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void QueryBoxVisibility(const FKernelSet& Kernels, const FMatrix44& WorldToFramebuffer, const FCoverageBuffer& Coverage, const FCoverageDepth& CoverageDepth,
+	                        const FVec3* MinMax, const int32_t Num, uint8_t* OutVisible)
+	{
+		constexpr int32_t RunSize = 256;
+		int32_t Quads[RunSize * 4];
+		float Depths[RunSize];
+		int32_t Clipped[RunSize];
+
+		for (int32_t First = 0; First < Num; First += RunSize)
+		{
+			const int32_t Count = std::min(Num - First, RunSize);
+			const FVec3* RunMinMax = MinMax + First * 2;
+			Kernels.ProjectOccludeeBoxes(WorldToFramebuffer, RunMinMax, Count, Quads, Depths, Clipped);
+
+			for (int32_t i = 0; i < Count; ++i)
+			{
+				const int32_t* Quad = &Quads[i * 4];
+				if (Clipped[i] != 0)
+				{
+					OutVisible[First + i] = IsBoxBehindView(WorldToFramebuffer, RunMinMax[i * 2], RunMinMax[i * 2 + 1]) ? 0 : 1;
+				}
+				else if (Quad[0] > Quad[2] || Quad[1] > Quad[3])
+				{
+					// Off screen
+					OutVisible[First + i] = 0;
+				}
+				else
+				{
+					OutVisible[First + i] = TestQuadVisibility(Coverage, CoverageDepth, Quad[0], Quad[1], Quad[2], Quad[3], Depths[i]) ? 1 : 0;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,29 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#pragma once
+
+/*=============================================================================
+	Visibility queries against a rasterized frame. Boxes are tested against the
+	final coverage and the depth of the occluders that covered it, and get the
+	answer an occludee of that frame would get, or a more visible one when
+	occluders share its depth.
+=============================================================================*/
+
+#include "OcclusionCoreKernels.h"
+
+namespace SOCore
+{
+	/** Whether an inclusive, on screen framebuffer rectangle at Depth has a pixel that no closer occluder covers */
+	bool TestQuadVisibility(const FCoverageBuffer& Coverage, const FCoverageDepth& CoverageDepth,
+	                        int32_t MinX, int32_t MinY, int32_t MaxX, int32_t MaxY, float Depth);
+
+	/** Whether every corner of a box is behind the near plane. Such boxes are near clipped, and visible, as occludees of a frame. */
+	bool IsBoxBehindView(const FMatrix44& WorldToFramebuffer, const FVec3& BoxMin, const FVec3& BoxMax);
+
+	/**
+	 * Tests boxes against a rasterized frame. MinMax holds min and max corners of each box, in the space WorldToFramebuffer transforms.
+	 * Boxes crossing the near plane are visible, boxes outside of the view or behind it are not. OutVisible receives 1 for visible boxes.
+	 */
+	void QueryBoxVisibility(const FKernelSet& Kernels, const FMatrix44& WorldToFramebuffer, const FCoverageBuffer& Coverage, const FCoverageDepth& CoverageDepth,
+	                        const FVec3* MinMax, int32_t Num, uint8_t* OutVisible);
+}
@@ -0,0 +1,646 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#include "OcclusionCoreRasterizer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace SOCore
+{
+	static int32_t RoundToInt(const float F)
+	{
+		return static_cast<int32_t>(std::floor(F + 0.5f));
+	}
+
+	static int32_t CountTrailingZeros(const uint64_t Value)
+	{
+#if defined(_MSC_VER)
+		unsigned long Index;
+		_BitScanForward64(&Index, Value);
+		return static_cast<int32_t>(Index);
+#else
+		return __builtin_ctzll(Value);
+#endif
+	}
+
+	void FFrameData::ReserveBuffers(const int32_t NumTriangles)
+	{
+		const int32_t NumTrianglesPerBin = NumTriangles / BinNum + 1;
+		for (int32_t BinIdx = 0; BinIdx < BinNum; ++BinIdx)
+		{
+			SortedTriangles[BinIdx].reserve(NumTrianglesPerBin);
+		}
+
+		ScreenTriangles.reserve(NumTriangles);
+		ScreenTrianglesOccludeeIdx.reserve(NumTriangles);
+		ScreenTrianglesFlags.reserve(NumTriangles);
+	}
+
+	void FFrameData::Reset()
+	{
+		for (int32_t BinIdx = 0; BinIdx < BinNum; ++BinIdx)
+		{
+			SortedTriangles[BinIdx].clear();
+		}
+
+		ScreenTriangles.clear();
+		ScreenTrianglesOccludeeIdx.clear();
+		ScreenTrianglesFlags.clear();
+	}
+
+	void FCoverageBuffer::Clear()
+	{
+		std::memset(Bins, 0, sizeof(Bins));
+	}
+
+	void FCoverageDepth::Clear()
+	{
+		std::fill(&RowMin[0][0], &RowMin[0][0] + BinNum * FramebufferHeight, FLT_MAX);
+	}
+
+	bool FCoverageBuffer::IsCovered(const int32_t X, const int32_t Y) const
+	{
+		if (X < 0 || Y < 0 || X >= FramebufferWidth || Y >= FramebufferHeight)
+		{
+			return false;
+		}
+		return (Bins[X / BinWidth][Y] & (1ull << (X % BinWidth))) != 0;
+	}
+
+	int32_t FCoverageBuffer::CountCoveredPixels() const
+	{
+		int32_t NumCovered = 0;
+		for (int32_t BinIdx = 0; BinIdx < BinNum; ++BinIdx)
+		{
+			for (int32_t Row = 0; Row < FramebufferHeight; ++Row)
+			{
+				for (uint64_t Mask = Bins[BinIdx][Row]; Mask != 0; Mask &= Mask - 1)
+				{
+					NumCovered++;
+				}
+			}
+		}
+		return NumCovered;
+	}
+
+	FMatrix44 MakeClipToFramebuffer()
+	{
+		FMatrix44 Result;
+		Result.M[0][0] = 0.5f * static_cast<float>(FramebufferWidth);
+		Result.M[1][1] = 0.5f * static_cast<float>(FramebufferHeight);
+		Result.M[3][0] = 0.5f * static_cast<float>(FramebufferWidth);
+		Result.M[3][1] = 0.5f * static_cast<float>(FramebufferHeight);
+		return Result;
+	}
+
+	uint8_t ComputeClipFlags(const FVec4& ClipPos, const float WClip)
+	{
+		uint8_t Flags = EClipFlags::None;
+		const float W = ClipPos.W;
+
+		if (W < WClip)
+		{
+			Flags |= EClipFlags::ClippedNear;
+		}
+
+		if (ClipPos.X < -W)
+		{
+			Flags |= EClipFlags::ClippedLeft;
+		}
+
+		if (ClipPos.X > W)
+		{
+			Flags |= EClipFlags::ClippedRight;
+		}
+
+		if (ClipPos.Y < -W)
+		{
+			Flags |= EClipFlags::ClippedTop;
+		}
+
+		if (ClipPos.Y > W)
+		{
+			Flags |= EClipFlags::ClippedBottom;
+		}
+
+		return Flags;
+	}
+
+	void ClipVertexToScreen(const FVec4& ClipPos, FScreenPosition& OutPosition, float& OutDepth)
+	{
+		const FVec4 ScreenPos = ClipPos / ClipPos.W;
+		OutPosition.X = RoundToInt((ScreenPos.X + 1.f) * FramebufferWidth / 2.f);
+		OutPosition.Y = RoundToInt((ScreenPos.Y + 1.f) * FramebufferHeight / 2.f);
+		OutDepth = ScreenPos.Z;
+	}
+
+	bool TestFrontface(const FScreenTriangle& Tri)
+	{
+		const int64_t Lhs = static_cast<int64_t>(Tri.V[2].X - Tri.V[0].X) * (Tri.V[1].Y - Tri.V[0].Y);
+		const int64_t Rhs = static_cast<int64_t>(Tri.V[2].Y - Tri.V[0].Y) * (Tri.V[1].X - Tri.V[0].X);
+		return Lhs < Rhs;
+	}
+
+	bool AddTriangle(FScreenTriangle Tri, const float TriDepth, const int32_t OccludeeIndex, const bool bOccluder, FFrameData& OutData)
+	{
+		if (bOccluder)
+		{
+			// Sort vertices by Y, assumed in rasterization
+			if (Tri.V[0].Y > Tri.V[1].Y) std::swap(Tri.V[0], Tri.V[1]);
+			if (Tri.V[1].Y > Tri.V[2].Y) std::swap(Tri.V[1], Tri.V[2]);
+			if (Tri.V[0].Y > Tri.V[1].Y) std::swap(Tri.V[0], Tri.V[1]);
+
+			if (Tri.V[0].Y >= FramebufferHeight || Tri.V[2].Y < 0)
+			{
+				return false;
+			}
+		}
+
+		const int32_t TriangleID = static_cast<int32_t>(OutData.ScreenTriangles.size());
+		OutData.ScreenTriangles.push_back(Tri);
+		OutData.ScreenTrianglesOccludeeIdx.push_back(OccludeeIndex);
+		OutData.ScreenTrianglesFlags.push_back(bOccluder ? 1 : 0);
+
+		// bin
+		const int32_t MinX = std::min({ Tri.V[0].X, Tri.V[1].X, Tri.V[2].X }) / BinWidth;
+		const int32_t MaxX = std::max({ Tri.V[0].X, Tri.V[1].X, Tri.V[2].X }) / BinWidth;
+		const int32_t BinMin = std::max(MinX, 0);
+		const int32_t BinMax = std::min(MaxX, BinNum - 1);
+
+		const FSortedIndexDepth SortedIndexDepth = { TriangleID, TriDepth };
+		for (int32_t BinIdx = BinMin; BinIdx <= BinMax; ++BinIdx)
+		{
+			OutData.SortedTriangles[BinIdx].push_back(SortedIndexDepth);
+		}
+
+		return true;
+	}
+
+	void TransformVertices(const FMatrix44& LocalToClip, const FVec3* Vertices, const int32_t NumVertices, const float WClip,
+	                       FVec4* OutClipVertices, uint8_t* OutClipFlags)
+	{
+		for (int32_t i = 0; i < NumVertices; ++i)
+		{
+			OutClipVertices[i] = LocalToClip.TransformPosition(Vertices[i]);
+			OutClipFlags[i] = ComputeClipFlags(OutClipVertices[i], WClip);
+		}
+	}
+
+	void TransformQuantizedVertices(const FMatrix44& QuantToClip, const FQuantizedVertex* Vertices, const int32_t NumVertices, const float WClip,
+	                                FVec4* OutClipVertices, uint8_t* OutClipFlags)
+	{
+		for (int32_t i = 0; i < NumVertices; ++i)
+		{
+			const FVec3 Position = { static_cast<float>(Vertices[i].X), static_cast<float>(Vertices[i].Y), static_cast<float>(Vertices[i].Z) };
+			OutClipVertices[i] = QuantToClip.TransformPosition(Position);
+			OutClipFlags[i] = ComputeClipFlags(OutClipVertices[i], WClip);
+		}
+	}
+
+	static void AddOccluderTriangle(const FVec4& V0, const FVec4& V1, const FVec4& V2, FFrameData& OutData)
+	{
+		FScreenTriangle Tri;
+		float Depths[3];
+		ClipVertexToScreen(V0, Tri.V[0], Depths[0]);
+		ClipVertexToScreen(V1, Tri.V[1], Depths[1]);
+		ClipVertexToScreen(V2, Tri.V[2], Depths[2]);
+
+		if (TestFrontface(Tri))
+		{
+			// Min tri depth for occluder (further from screen)
+			const float TriDepth = std::min({ Depths[0], Depths[1], Depths[2] });
+			AddTriangle(Tri, TriDepth, -1, true, OutData);
+		}
+	}
+
+	void AddOccluderTriangles(const FVec4* ClipVertices, const uint8_t* ClipFlags, const int32_t NumVertices,
+	                          const uint16_t* Indices, const int32_t NumIndices, const float WClip, FFrameData& OutData)
+	{
+		const int32_t NumTris = NumIndices / 3;
+
+		for (int32_t i = 0; i < NumTris; ++i)
+		{
+			const uint16_t V[3] = { Indices[i * 3 + 0], Indices[i * 3 + 1], Indices[i * 3 + 2] };
+			if (V[0] >= NumVertices || V[1] >= NumVertices || V[2] >= NumVertices)
+			{
+				continue;
+			}
+
+			const uint8_t F0 = ClipFlags[V[0]];
+			const uint8_t F1 = ClipFlags[V[1]];
+			const uint8_t F2 = ClipFlags[V[2]];
+
+			if ((F0 & F1) & F2)
+			{
+				// fully clipped
+				continue;
+			}
+
+			if (((F0 | F1 | F2) & EClipFlags::ClippedNear) == 0)
+			{
+				AddOccluderTriangle(ClipVertices[V[0]], ClipVertices[V[1]], ClipVertices[V[2]], OutData);
+				continue;
+			}
+
+			static constexpr int32_t Edges[3][2] = { {0,1}, {1,2}, {2,0} };
+			FVec4 ClippedPos[4];
+			int32_t NumPos = 0;
+
+			for (int32_t EdgeIdx = 0; EdgeIdx < 3; EdgeIdx++)
+			{
+				const FVec4& P0 = ClipVertices[V[Edges[EdgeIdx][0]]];
+				const FVec4& P1 = ClipVertices[V[Edges[EdgeIdx][1]]];
+				const bool bClipped0 = P0.W < WClip;
+				const bool bClipped1 = P1.W < WClip;
+
+				if (!bClipped0)
+				{
+					ClippedPos[NumPos++] = P0;
+				}
+
+				if (bClipped0 != bClipped1)
+				{
+					const float T = (WClip - P0.W) / (P0.W - P1.W);
+					ClippedPos[NumPos++] = P0 + (P0 - P1) * T;
+				}
+			}
+
+			// triangulate clipped vertices
+			for (int32_t j = 2; j < NumPos; j++)
+			{
+				AddOccluderTriangle(ClippedPos[0], ClippedPos[j - 1], ClippedPos[j], OutData);
+			}
+		}
+	}
+
+	void AddOccluderMesh(const FMatrix44& LocalToClip, const FVec3* Vertices, const int32_t NumVertices, const uint16_t* Indices, const int32_t NumIndices,
+	                     const float WClip, std::vector<FVec4>& ClipVertexBuffer, std::vector<uint8_t>& ClipFlagsBuffer, FFrameData& OutData)
+	{
+		ClipVertexBuffer.resize(NumVertices);
+		ClipFlagsBuffer.resize(NumVertices);
+		TransformVertices(LocalToClip, Vertices, NumVertices, WClip, ClipVertexBuffer.data(), ClipFlagsBuffer.data());
+		AddOccluderTriangles(ClipVertexBuffer.data(), ClipFlagsBuffer.data(), NumVertices, Indices, NumIndices, WClip, OutData);
+	}
+
+	uint8_t ProjectBoxCorners(const FMatrix44& BoxToClip, const float WClip, FVec4 (&OutClipCorners)[NumCubeVertices], uint8_t& OutAnyFlags)
+	{
+		uint8_t AllFlags = 0xff;
+		OutAnyFlags = 0;
+
+		for (int32_t i = 0; i < NumCubeVertices; ++i)
+		{
+			const FVec3 Corner = { (i & 1) ? 1.f : -1.f, (i & 2) ? 1.f : -1.f, (i & 4) ? 1.f : -1.f };
+			OutClipCorners[i] = BoxToClip.TransformPosition(Corner);
+
+			const uint8_t Flags = ComputeClipFlags(OutClipCorners[i], WClip);
+			AllFlags &= Flags;
+			OutAnyFlags |= Flags;
+		}
+
+		return AllFlags;
+	}
+
+	static int64_t ScreenCross(const FScreenPosition& O, const FScreenPosition& A, const FScreenPosition& B)
+	{
+		return static_cast<int64_t>(A.X - O.X) * (B.Y - O.Y) - static_cast<int64_t>(A.Y - O.Y) * (B.X - O.X);
+	}
+
+	// Convex hull of the projected box corners (monotone chain), at most 6 points for a box
+	static int32_t ComputeScreenHull(FScreenPosition (&Points)[NumCubeVertices], FScreenPosition (&OutHull)[NumCubeVertices + 1])
+	{
+		std::sort(Points, Points + NumCubeVertices, [](const FScreenPosition& A, const FScreenPosition& B)
+		{
+			return A.X < B.X || (A.X == B.X && A.Y < B.Y);
+		});
+
+		int32_t NumHull = 0;
+		for (int32_t i = 0; i < NumCubeVertices; ++i)
+		{
+			while (NumHull >= 2 && ScreenCross(OutHull[NumHull - 2], OutHull[NumHull - 1], Points[i]) <= 0)
+			{
+				NumHull--;
+			}
+			OutHull[NumHull++] = Points[i];
+		}
+
+		for (int32_t i = NumCubeVertices - 2, LowerNum = NumHull + 1; i >= 0; --i)
+		{
+			while (NumHull >= LowerNum && ScreenCross(OutHull[NumHull - 2], OutHull[NumHull - 1], Points[i]) <= 0)
+			{
+				NumHull--;
+			}
+			OutHull[NumHull++] = Points[i];
+		}
+
+		// Last point is the first one again
+		return NumHull - 1;
+	}
+
+	void AddOccluderBoxSilhouette(const FVec4 (&ClipCorners)[NumCubeVertices], FFrameData& OutData)
+	{
+		FScreenPosition Corners[NumCubeVertices];
+		float Depth = FLT_MAX;
+		for (int32_t i = 0; i < NumCubeVertices; ++i)
+		{
+			float CornerDepth;
+			ClipVertexToScreen(ClipCorners[i], Corners[i], CornerDepth);
+			// Min depth for occluder (further from screen)
+			Depth = std::min(Depth, CornerDepth);
+		}
+
+		FScreenPosition Hull[NumCubeVertices + 1];
+		const int32_t NumHull = ComputeScreenHull(Corners, Hull);
+
+		// Fan triangulate the silhouette, rasterization does not depend on the winding
+		for (int32_t i = 2; i < NumHull; ++i)
+		{
+			const FScreenTriangle Tri = { { Hull[0], Hull[i - 1], Hull[i] } };
+			AddTriangle(Tri, Depth, -1, true, OutData);
+		}
+	}
+
+	void ProjectOccludeeBoxes(const FMatrix44& WorldToFramebuffer, const FVec3* MinMax, const int32_t Num,
+	                          int32_t* OutQuads, float* OutDepths, int32_t* OutClipped)
+	{
+		const float WClip = WorldToFramebuffer.M[3][2];
+
+		for (int32_t k = 0; k < Num; ++k, MinMax += 2, OutQuads += 4)
+		{
+			const FVec3& BoxMin = MinMax[0];
+			const FVec3& BoxMax = MinMax[1];
+
+			float MinX = FLT_MAX, MinY = FLT_MAX;
+			float MaxX = -FLT_MAX, MaxY = -FLT_MAX;
+			float Depth = 0.f;
+			bool bClippedNear = false;
+
+			for (int32_t i = 0; i < NumCubeVertices; ++i)
+			{
+				const FVec3 Corner = { (i & 1) ? BoxMax.X : BoxMin.X, (i & 2) ? BoxMax.Y : BoxMin.Y, (i & 4) ? BoxMax.Z : BoxMin.Z };
+				FVec4 V = WorldToFramebuffer.TransformPosition(Corner);
+
+				if (V.W < WClip)
+				{
+					bClippedNear = true;
+					break;
+				}
+
+				V = V / V.W;
+				MinX = std::min(MinX, V.X);
+				MinY = std::min(MinY, V.Y);
+				MaxX = std::max(MaxX, V.X);
+				MaxY = std::max(MaxY, V.Y);
+				Depth = std::max(Depth, V.Z);
+			}
+
+			OutClipped[k] = bClippedNear ? 1 : 0;
+			if (bClippedNear)
+			{
+				continue;
+			}
+
+			// Pixel snapping and clipping against the screen rect
+			OutQuads[0] = static_cast<int32_t>(std::max(0.f, MinX + 0.5f));
+			OutQuads[1] = static_cast<int32_t>(std::max(0.f, MinY + 0.5f));
+			OutQuads[2] = static_cast<int32_t>(std::min(FramebufferWidth - 1.f, MaxX + 0.5f));
+			OutQuads[3] = static_cast<int32_t>(std::min(FramebufferHeight - 1.f, MaxY + 0.5f));
+			OutDepths[k] = Depth;
+		}
+	}
+
+	void AddOccludeeQuads(const int32_t* Quads, const float* Depths, const int32_t* Clipped, const int32_t Num, const int32_t FirstOccludeeIndex,
+	                      uint8_t* OccludeeVisibility, FFrameData& OutData)
+	{
+		for (int32_t i = 0; i < Num; ++i, Quads += 4)
+		{
+			const int32_t OccludeeIndex = FirstOccludeeIndex + i;
+
+			if (Clipped[i] != 0)
+			{
+				// clipped by near plane, visible
+				OccludeeVisibility[OccludeeIndex] = 1;
+				continue;
+			}
+
+			const int32_t MinX = Quads[0];
+			const int32_t MinY = Quads[1];
+			const int32_t MaxX = Quads[2];
+			const int32_t MaxY = Quads[3];
+
+			if (MinX > MaxX || MinY > MaxY)
+			{
+				// Do not rasterize if not on screen, occluded
+				continue;
+			}
+
+			// add only first tri, rasterizer will figure out to render a quad
+			const FScreenTriangle Tri = { { { MinX, MinY }, { MaxX, MaxY }, { MinX, MaxY } } };
+			AddTriangle(Tri, Depths[i], OccludeeIndex, false, OutData);
+		}
+	}
+
+	static uint64_t ComputeBinRowMask(const int32_t BinMinX, const float fX0, const float fX1)
+	{
+		int32_t X0 = RoundToInt(fX0) - BinMinX;
+		int32_t X1 = RoundToInt(fX1) - BinMinX;
+		if (X0 >= BinWidth || X1 < 0)
+		{
+			// not in bin
+			return 0ull;
+		}
+
+		X0 = std::max(0, X0);
+		X1 = std::min(BinWidth - 1, X1);
+		const int32_t Num = (X1 - X0) + 1;
+		return (Num == BinWidth) ? ~0ull : ((1ull << Num) - 1) << X0;
+	}
+
+	/** Depth of the bin pixels an occluder covers first */
+	struct FBinDepth
+	{
+		float (*Pixels)[BinWidth];
+		float* RowMin;
+		float Depth;
+	};
+
+	static void WriteCoverageDepth(uint64_t NewBits, const int32_t Row, const FBinDepth& BinDepth)
+	{
+		BinDepth.RowMin[Row] = std::min(BinDepth.RowMin[Row], BinDepth.Depth);
+		for (; NewBits != 0; NewBits &= NewBits - 1)
+		{
+			BinDepth.Pixels[Row][CountTrailingZeros(NewBits)] = BinDepth.Depth;
+		}
+	}
+
+	static void RasterizeHalf(float X0, float X1, const float DX0, const float DX1, const int32_t Row0, const int32_t Row1, uint64_t* BinData, const int32_t BinMinX,
+	                          const FBinDepth* BinDepth)
+	{
+		for (int32_t Row = Row0; Row <= Row1; Row++, X0 += DX0, X1 += DX1)
+		{
+			const uint64_t FrameBufferMask = BinData[Row];
+			if (FrameBufferMask != ~0ull) // whether this row is already fully rasterized
+			{
+				if (const uint64_t RowMask = ComputeBinRowMask(BinMinX, X0, X1))
+				{
+					BinData[Row] = (FrameBufferMask | RowMask);
+
+					if (BinDepth && (RowMask & ~FrameBufferMask))
+					{
+						WriteCoverageDepth(RowMask & ~FrameBufferMask, Row, *BinDepth);
+					}
+				}
+			}
+		}
+	}
+
+	static void RasterizeOccluderTri(const FScreenTriangle& Tri, uint64_t* BinData, const int32_t BinMinX, const FBinDepth* BinDepth)
+	{
+		const FScreenPosition A = Tri.V[0];
+		const FScreenPosition B = Tri.V[1];
+		const FScreenPosition C = Tri.V[2];
+
+		const int32_t RowMin = std::max<int32_t>(A.Y, 0);
+		const int32_t RowMax = std::min<int32_t>(FramebufferHeight - 1, C.Y);
+
+		bool bRasterized = false;
+
+		int32_t RowS = RowMin;
+		if ((B.Y - RowMin) > 0)
+		{
+			// A -> B
+			const int32_t RowE = std::min<int32_t>(RowMax, B.Y);
+			// Edge gradients
+			float dX0 = static_cast<float>(B.X - A.X) / (B.Y - A.Y);
+			float dX1 = static_cast<float>(C.X - A.X) / (C.Y - A.Y);
+			if (dX0 > dX1)
+			{
+				std::swap(dX0, dX1);
+			}
+			const float X0 = A.X + dX0 * (RowS - A.Y);
+			const float X1 = A.X + dX1 * (RowS - A.Y);
+			RasterizeHalf(X0, X1, dX0, dX1, RowS, RowE, BinData, BinMinX, BinDepth);
+			bRasterized = true;
+			RowS = RowE + 1;
+		}
+
+		if ((RowMax - RowS) > 0)
+		{
+			// B -> C
+			// Edge gradients
+			float dX0 = static_cast<float>(C.X - A.X) / (C.Y - A.Y);
+			float dX1 = static_cast<float>(C.X - B.X) / (C.Y - B.Y);
+			float X0 = A.X + dX0 * (RowS - A.Y);
+			float X1 = B.X + dX1 * (RowS - B.Y);
+			if (X0 > X1)
+			{
+				std::swap(X0, X1);
+				std::swap(dX0, dX1);
+			}
+			RasterizeHalf(X0, X1, dX0, dX1, RowS, RowMax, BinData, BinMinX, BinDepth);
+			bRasterized = true;
+		}
+
+		// one line triangle
+		if (!bRasterized)
+		{
+			const float X0 = static_cast<float>(std::min({ A.X, B.X, C.X }));
+			const float X1 = static_cast<float>(std::max({ A.X, B.X, C.X }));
+			RasterizeHalf(X0, X1, 0.0f, 0.0f, RowS, RowS, BinData, BinMinX, BinDepth);
+		}
+	}
+
+	static bool RasterizeOccludeeQuad(const FScreenTriangle& Tri, const uint64_t* BinData, const int32_t BinMinX)
+	{
+		// occludee expected to be clipped to screen
+		const int32_t RowMin = Tri.V[0].Y; // Quad MinY
+		const int32_t RowMax = Tri.V[2].Y; // Quad MaxY
+
+		// clip X to bin bounds
+		const int32_t X0 = std::max(Tri.V[0].X - BinMinX, 0);
+		const int32_t X1 = std::min(Tri.V[1].X - BinMinX, BinWidth - 1);
+
+		const int32_t NumBits = (X1 - X0) + 1;
+		const uint64_t RowMask = (NumBits == BinWidth) ? ~0ull : ((1ull << NumBits) - 1) << X0;
+
+		for (int32_t Row = RowMin; Row <= RowMax; ++Row)
+		{
+			if (~BinData[Row] & RowMask)
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void SortFrame(FFrameData& FrameData)
+	{
+		for (std::vector<FSortedIndexDepth>& SortedTriangles : FrameData.SortedTriangles)
+		{
+			// Sort triangles in the bin by depth, biggerZ (closer) first
+			std::sort(SortedTriangles.begin(), SortedTriangles.end(), [](const FSortedIndexDepth& A, const FSortedIndexDepth& B)
+			{
+				return A.Depth > B.Depth;
+			});
+		}
+	}
+
+	FRasterStats RasterizeSortedFrame(const FFrameData& FrameData, FCoverageBuffer& OutCoverage, uint8_t* OccludeeVisibility, FCoverageDepth* OutDepth)
+	{
+		FRasterStats Stats;
+
+		if (OutDepth)
+		{
+			OutDepth->Clear();
+		}
+
+		const uint8_t* MeshFlags = FrameData.ScreenTrianglesFlags.data();
+		const int32_t* OccludeeIndices = FrameData.ScreenTrianglesOccludeeIdx.data();
+		const FScreenTriangle* Tris = FrameData.ScreenTriangles.data();
+
+		for (int32_t BinIdx = 0; BinIdx < BinNum; ++BinIdx)
+		{
+			const std::vector<FSortedIndexDepth>& SortedTriangles = FrameData.SortedTriangles[BinIdx];
+			const int32_t BinMinX = BinIdx * BinWidth;
+			uint64_t* BinData = OutCoverage.Bins[BinIdx];
+			FBinDepth BinDepth = { OutDepth ? OutDepth->Pixels[BinIdx] : nullptr, OutDepth ? OutDepth->RowMin[BinIdx] : nullptr, 0.f };
+
+			for (const FSortedIndexDepth& SortedTri : SortedTriangles)
+			{
+				const int32_t TriID = SortedTri.Index;
+				const FScreenTriangle& Tri = Tris[TriID];
+
+				if (MeshFlags[TriID] != 0) // Occluder
+				{
+					BinDepth.Depth = SortedTri.Depth;
+					RasterizeOccluderTri(Tri, BinData, BinMinX, OutDepth ? &BinDepth : nullptr);
+					Stats.NumOccluderTriangles++;
+				}
+				else // Occludee
+				{
+					uint8_t& bVisible = OccludeeVisibility[OccludeeIndices[TriID]];
+					if (!bVisible)
+					{
+						bVisible = RasterizeOccludeeQuad(Tri, BinData, BinMinX) ? 1 : 0;
+					}
+					Stats.NumOccludeeTriangles++;
+				}
+			}
+		}
+
+		return Stats;
+	}
+
+	FRasterStats RasterizeFrame(FFrameData& FrameData, FCoverageBuffer& OutCoverage, uint8_t* OccludeeVisibility, FCoverageDepth* OutDepth)
+	{
+		SortFrame(FrameData);
+		return RasterizeSortedFrame(FrameData, OutCoverage, OccludeeVisibility, OutDepth);
+	}
+}
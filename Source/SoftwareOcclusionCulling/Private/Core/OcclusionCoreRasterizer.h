@@ -0,0 +1,159 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#pragma once
+
+/*=============================================================================
+	Engine agnostic occlusion kernels: triangle setup, binning, coverage
+	rasterization and occludee tests. The engine adapter lives in
+	Legacy/SceneSoftwareOcclusion.h.
+=============================================================================*/
+
+#include "OcclusionCoreMath.h"
+
+#include <vector>
+
+namespace SOCore
+{
+	constexpr int32_t BinWidth = 64;
+	constexpr int32_t BinNum = 6;
+	constexpr int32_t FramebufferWidth = BinWidth * BinNum;
+	constexpr int32_t FramebufferHeight = 256;
+
+	/** Box corners, index bits are X, Y, Z */
+	constexpr int32_t NumCubeVertices = 8;
+
+	namespace EClipFlags
+	{
+		constexpr uint8_t None = 0;
+		constexpr uint8_t ClippedLeft = 1 << 0;	// Vertex is clipped by left plane
+		constexpr uint8_t ClippedRight = 1 << 1;	// Vertex is clipped by right plane
+		constexpr uint8_t ClippedTop = 1 << 2;	// Vertex is clipped by top plane
+		constexpr uint8_t ClippedBottom = 1 << 3;	// Vertex is clipped by bottom plane
+		constexpr uint8_t ClippedNear = 1 << 4;	// Vertex is clipped by near plane
+	}
+
+	struct FScreenPosition
+	{
+		int32_t X, Y;
+	};
+
+	struct FScreenTriangle
+	{
+		FScreenPosition V[3];
+	};
+
+	struct FSortedIndexDepth
+	{
+		int32_t Index;
+		float Depth;
+	};
+
+	/** Quantized mesh vertex, positions are mapped to clip space by a single matrix */
+	struct FQuantizedVertex
+	{
+		uint16_t X, Y, Z;
+	};
+
+	/** Screen triangles of one frame, binned by framebuffer column */
+	struct FFrameData
+	{
+		std::vector<FSortedIndexDepth> SortedTriangles[BinNum];
+
+		std::vector<FScreenTriangle> ScreenTriangles;
+		std::vector<int32_t> ScreenTrianglesOccludeeIdx;	// index into the occludee boxes, -1 for occluders
+		std::vector<uint8_t> ScreenTrianglesFlags;		// 1 for occluders, 0 for occludees
+
+		void ReserveBuffers(int32_t NumTriangles);
+		void Reset();
+	};
+
+	/** One bit per pixel, each bin row is a 64 bit mask */
+	struct FCoverageBuffer
+	{
+		uint64_t Bins[BinNum][FramebufferHeight] = {};
+
+		void Clear();
+		bool IsCovered(int32_t X, int32_t Y) const;
+		int32_t CountCoveredPixels() const;
+	};
+
+	/** Depth of the occluder that first covered each pixel, bigger is closer. Pixels that are not covered are left unspecified. */
+	struct FCoverageDepth
+	{
+		float Pixels[BinNum][FramebufferHeight][BinWidth];
+
+		/** Farthest covering depth of each bin row, FLT_MAX when nothing covers it */
+		float RowMin[BinNum][FramebufferHeight];
+
+		void Clear();
+	};
+
+	struct FRasterStats
+	{
+		int32_t NumOccluderTriangles = 0;
+		int32_t NumOccludeeTriangles = 0;
+	};
+
+	/** Maps clip space to framebuffer pixels, applied after the view projection */
+	FMatrix44 MakeClipToFramebuffer();
+
+	/** Frustum clip flags of a clip space vertex. WClip is the W of the near plane. */
+	uint8_t ComputeClipFlags(const FVec4& ClipPos, float WClip);
+
+	/** Projects a clip space vertex in front of the near plane to a framebuffer pixel */
+	void ClipVertexToScreen(const FVec4& ClipPos, FScreenPosition& OutPosition, float& OutDepth);
+
+	bool TestFrontface(const FScreenTriangle& Tri);
+
+	/** Bins a screen triangle. Occluder triangles are sorted by Y and rejected when outside of the framebuffer rows. */
+	bool AddTriangle(FScreenTriangle Tri, float TriDepth, int32_t OccludeeIndex, bool bOccluder, FFrameData& OutData);
+
+	/** Transforms float vertices to clip space and computes their clip flags */
+	void TransformVertices(const FMatrix44& LocalToClip, const FVec3* Vertices, int32_t NumVertices, float WClip,
+	                       FVec4* OutClipVertices, uint8_t* OutClipFlags);
+
+	/** Same as TransformVertices for quantized positions */
+	void TransformQuantizedVertices(const FMatrix44& QuantToClip, const FQuantizedVertex* Vertices, int32_t NumVertices, float WClip,
+	                                FVec4* OutClipVertices, uint8_t* OutClipFlags);
+
+	/** Clips the front facing triangles of a transformed mesh against the near plane and bins them as occluders */
+	void AddOccluderTriangles(const FVec4* ClipVertices, const uint8_t* ClipFlags, int32_t NumVertices,
+	                          const uint16_t* Indices, int32_t NumIndices, float WClip, FFrameData& OutData);
+
+	/** Convenience path for float meshes, the buffers are reused between calls */
+	void AddOccluderMesh(const FMatrix44& LocalToClip, const FVec3* Vertices, int32_t NumVertices, const uint16_t* Indices, int32_t NumIndices,
+	                     float WClip, std::vector<FVec4>& ClipVertexBuffer, std::vector<uint8_t>& ClipFlagsBuffer, FFrameData& OutData);
+
+	/**
+	 * Projects the corners of the [-1, 1] cube. Returns the clip flags shared by all corners, non zero when the box is fully clipped.
+	 * OutAnyFlags holds the flags of any corner.
+	 */
+	uint8_t ProjectBoxCorners(const FMatrix44& BoxToClip, float WClip, FVec4 (&OutClipCorners)[NumCubeVertices], uint8_t& OutAnyFlags);
+
+	/** Bins the screen silhouette of a box whose corners are all in front of the near plane */
+	void AddOccluderBoxSilhouette(const FVec4 (&ClipCorners)[NumCubeVertices], FFrameData& OutData);
+
+	/**
+	 * Projects occludee boxes to screen rectangles. MinMax holds min and max corners of each box.
+	 * OutQuads receives MinX, MinY, MaxX, MaxY per box and OutClipped is non zero for boxes crossing the near plane.
+	 * The quads and depths of those boxes are left unspecified.
+	 */
+	void ProjectOccludeeBoxes(const FMatrix44& WorldToFramebuffer, const FVec3* MinMax, int32_t Num,
+	                          int32_t* OutQuads, float* OutDepths, int32_t* OutClipped);
+
+	/** Bins projected occludee rectangles. Near clipped boxes are marked visible right away, off screen boxes stay occluded. */
+	void AddOccludeeQuads(const int32_t* Quads, const float* Depths, const int32_t* Clipped, int32_t Num, int32_t FirstOccludeeIndex,
+	                      uint8_t* OccludeeVisibility, FFrameData& OutData);
+
+	/** Sorts the triangles of every bin front to back */
+	void SortFrame(FFrameData& FrameData);
+
+	/**
+	 * Rasterizes sorted bins. Occludees set their visibility when any of their pixels passes.
+	 * OutDepth is optional and records the occluder depth of the covered pixels, for queries against the final coverage.
+	 */
+	FRasterStats RasterizeSortedFrame(const FFrameData& FrameData, FCoverageBuffer& OutCoverage, uint8_t* OccludeeVisibility, FCoverageDepth* OutDepth = nullptr);
+
+	/** SortFrame followed by RasterizeSortedFrame */
+	FRasterStats RasterizeFrame(FFrameData& FrameData, FCoverageBuffer& OutCoverage, uint8_t* OccludeeVisibility, FCoverageDepth* OutDepth = nullptr);
+}
@@ -0,0 +1,181 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#include "Data/OccluderCellSet.h"
+#include "Async/MappedFileHandle.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "Hash/CityHash.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/Paths.h"
+
+static_assert(sizeof(FOccluderCellFileHeader) == 56, "The header is written field by field and mapped as is, it must not have padding");
+static_assert(sizeof(FOccluderCellFileHeader) % sizeof(uint64) == 0, "Occluder keys must stay aligned after the header");
+
+FOccluderCellSet::FOccluderCellSet() = default;
+
+FOccluderCellSet::~FOccluderCellSet()
+{
+	// The region must be released before its file
+	FileRegion.Reset();
+	FileHandle.Reset();
+}
+
+bool FOccluderCellSet::Load(const FString& Path)
+{
+	Header = nullptr;
+	FileRegion.Reset();
+	FileHandle.Reset();
+
+#if !PLATFORM_LITTLE_ENDIAN
+	// The file is little endian and used as mapped
+	UE_LOG(LogTemp, Warning, TEXT("Ignoring occluder cell file %s on a big endian platform"), *Path);
+	return false;
+#endif
+
+	FileHandle.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*Path));
+	if (!FileHandle.IsValid())
+	{
+		return false;
+	}
+
+	FileRegion.Reset(FileHandle->MapRegion());
+	if (!FileRegion.IsValid() || FileRegion->GetMappedSize() < static_cast<int64>(sizeof(FOccluderCellFileHeader)))
+	{
+		FileRegion.Reset();
+		FileHandle.Reset();
+		return false;
+	}
+
+	const uint8* Data = FileRegion->GetMappedPtr();
+	const FOccluderCellFileHeader* FileHeader = reinterpret_cast<const FOccluderCellFileHeader*>(Data);
+	const int64 NumCells = static_cast<int64>(FileHeader->NumCells[0]) * FileHeader->NumCells[1] * FileHeader->NumCells[2];
+	const int64 ExpectedSize = sizeof(FOccluderCellFileHeader) + FileHeader->NumOccluders * sizeof(uint64)
+		+ (NumCells + 1) * sizeof(uint32) + FileHeader->NumEntries * sizeof(uint32);
+
+	if (FileHeader->Magic != FOccluderCellFileHeader::MAGIC || FileHeader->Version != FOccluderCellFileHeader::VERSION
+		|| NumCells <= 0 || FileRegion->GetMappedSize() != ExpectedSize)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Ignoring invalid occluder cell file %s"), *Path);
+		FileRegion.Reset();
+		FileHandle.Reset();
+		return false;
+	}
+
+	Header = FileHeader;
+	OccluderKeys = reinterpret_cast<const uint64*>(Data + sizeof(FOccluderCellFileHeader));
+	CellOffsets = reinterpret_cast<const uint32*>(OccluderKeys + Header->NumOccluders);
+	CellEntries = CellOffsets + NumCells + 1;
+	return true;
+}
+
+int32 FOccluderCellSet::FindCell(const FVector& Location) const
+{
+	if (!Header || Header->CellSize <= 0.f)
+	{
+		return INDEX_NONE;
+	}
+
+	int32 Cell[3];
+	for (int32 Axis = 0; Axis < 3; ++Axis)
+	{
+		const double Coordinate = FMath::FloorToDouble((Location[Axis] - Header->Origin[Axis]) / Header->CellSize);
+		if (Coordinate < 0.0 || Coordinate >= Header->NumCells[Axis])
+		{
+			return INDEX_NONE;
+		}
+		Cell[Axis] = static_cast<int32>(Coordinate);
+	}
+	return (Cell[2] * Header->NumCells[1] + Cell[1]) * Header->NumCells[0] + Cell[0];
+}
+
+TConstArrayView<uint32> FOccluderCellSet::GetCellOccluders(const int32 Cell) const
+{
+	const int64 NumCells = Header ? static_cast<int64>(Header->NumCells[0]) * Header->NumCells[1] * Header->NumCells[2] : 0;
+	if (Cell < 0 || Cell >= NumCells)
+	{
+		return TConstArrayView<uint32>();
+	}
+
+	// Offsets come from the file, keep the entries within it
+	const uint32 First = FMath::Min(CellOffsets[Cell], Header->NumEntries);
+	const uint32 Last = FMath::Clamp(CellOffsets[Cell + 1], First, Header->NumEntries);
+	return TConstArrayView<uint32>(CellEntries + First, Last - First);
+}
+
+TConstArrayView<uint64> FOccluderCellSet::GetOccluderKeys() const
+{
+	return Header ? TConstArrayView<uint64>(OccluderKeys, Header->NumOccluders) : TConstArrayView<uint64>();
+}
+
+bool FOccluderCellSet::Save(const FString& Path, const FOccluderCellSetData& Data)
+{
+	const int64 NumCells = static_cast<int64>(Data.NumCells.X) * Data.NumCells.Y * Data.NumCells.Z;
+	if (NumCells <= 0 || Data.CellOffsets.Num() != NumCells + 1)
+	{
+		return false;
+	}
+
+	FOccluderCellFileHeader FileHeader;
+	FileHeader.Origin[0] = Data.Origin.X;
+	FileHeader.Origin[1] = Data.Origin.Y;
+	FileHeader.Origin[2] = Data.Origin.Z;
+	FileHeader.CellSize = Data.CellSize;
+	FileHeader.NumCells[0] = Data.NumCells.X;
+	FileHeader.NumCells[1] = Data.NumCells.Y;
+	FileHeader.NumCells[2] = Data.NumCells.Z;
+	FileHeader.NumOccluders = Data.OccluderKeys.Num();
+	FileHeader.NumEntries = Data.CellEntries.Num();
+
+	const TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*Path));
+	if (!Writer.IsValid())
+	{
+		return false;
+	}
+
+	// Little endian whatever platform bakes it, in the layout the file is mapped with
+	Writer->SetByteSwapping(!PLATFORM_LITTLE_ENDIAN);
+	*Writer << FileHeader.Magic << FileHeader.Version;
+	for (double& Coordinate : FileHeader.Origin)
+	{
+		*Writer << Coordinate;
+	}
+	*Writer << FileHeader.CellSize;
+	for (int32& Count : FileHeader.NumCells)
+	{
+		*Writer << Count;
+	}
+	*Writer << FileHeader.NumOccluders << FileHeader.NumEntries;
+
+	for (uint64 Key : Data.OccluderKeys)
+	{
+		*Writer << Key;
+	}
+	for (uint32 Offset : Data.CellOffsets)
+	{
+		*Writer << Offset;
+	}
+	for (uint32 Entry : Data.CellEntries)
+	{
+		*Writer << Entry;
+	}
+	return Writer->Close();
+}
+
+FString FOccluderCellSet::GetPath(const UWorld* World)
+{
+	FString MapName = UWorld::RemovePIEPrefix(World->GetOutermost()->GetName());
+	MapName.ReplaceCharInline(TEXT('/'), TEXT('_'));
+	return FPaths::ProjectContentDir() / TEXT("SoftwareOcclusion") / MapName + TEXT(".occells");
+}
+
+uint64 FOccluderCellSet::MakeOccluderKey(const UPrimitiveComponent* PrimitiveComponent)
+{
+	// Level packages differ between the editor and World Partition runtime cells, the actor name and location do not
+	const AActor* Owner = PrimitiveComponent->GetOwner();
+	const FVector Location = PrimitiveComponent->GetComponentLocation();
+	const FString Key = FString::Printf(TEXT("%s.%s@%lld,%lld,%lld"), Owner ? *Owner->GetFName().ToString() : TEXT(""), *PrimitiveComponent->GetFName().ToString(),
+	                                    FMath::RoundToInt64(Location.X), FMath::RoundToInt64(Location.Y), FMath::RoundToInt64(Location.Z));
+	return CityHash64(reinterpret_cast<const char*>(*Key), Key.Len() * sizeof(TCHAR));
+}
@@ -0,0 +1,302 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#include "Data/OccluderMeshData.h"
+#include "Data/OccluderProxyAssetUserData.h"
+#include "Engine/StaticMesh.h"
+#include "Kismet/KismetSystemLibrary.h"
+#include "StaticMeshResources.h"
+
+FOccluderMeshData::FOccluderMeshData(const TArray<FVector3f>& InVertices, const TArray<uint16>& InIndices)
+{
+	TArray<FVector> SourceVertices;
+	SourceVertices.SetNumUninitialized(InVertices.Num());
+	for (int i = 0; i < InVertices.Num(); ++i)
+	{
+		SourceVertices.GetData()[i] = FVector(InVertices[i]);
+	}
+
+	TArray<uint32> SourceIndices(InIndices);
+	BuildMeshlets(SourceVertices, SourceIndices);
+}
+
+FOccluderMeshData::FOccluderMeshData(const FOccluderSourceLOD& SourceLOD)
+	: Boxes(SourceLOD.Boxes)
+{
+	if (!SourceLOD.Indices.IsEmpty())
+	{
+		BuildMeshlets(SourceLOD.Vertices, SourceLOD.Indices);
+	}
+}
+
+// Copies a render LOD, the depth only index buffer when the mesh has one. Returns false when the CPU geometry is not available.
+static bool CopyRenderLOD(const UStaticMesh* StaticMesh, const FStaticMeshLODResources& LODModel, FOccluderSourceLOD& OutSourceLOD)
+{
+	const FRawStaticIndexBuffer& IndexBuffer = LODModel.DepthOnlyIndexBuffer.GetNumIndices() > 0 ? LODModel.DepthOnlyIndexBuffer : LODModel.IndexBuffer;
+
+	const int32 NumVtx = LODModel.VertexBuffers.PositionVertexBuffer.GetNumVertices();
+	const int32 NumIndices = IndexBuffer.GetNumIndices();
+	if (NumVtx <= 0 || NumIndices <= 0)
+	{
+		return false;
+	}
+
+	OutSourceLOD.Vertices.SetNumUninitialized(NumVtx);
+	for (int i = 0; i < NumVtx; ++i)
+	{
+		OutSourceLOD.Vertices.GetData()[i] = FVector(LODModel.VertexBuffers.PositionVertexBuffer.VertexPosition(i));
+	}
+
+	// Both 16 and 32-bit index buffers, meshlets bring the indices back to 16-bit
+	IndexBuffer.GetCopy(OutSourceLOD.Indices);
+	if (OutSourceLOD.Indices.Num() != NumIndices)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Cannot access IndexBuffer for Occlusion Mesh: %s"), *GetNameSafe(StaticMesh));
+		return false;
+	}
+	return true;
+}
+
+void FOccluderMeshData::CopySourceLODs(UStaticMesh* StaticMesh, const int32 MaxLODs, TArray<FOccluderSourceLOD>& OutSourceLODs)
+{
+	check(IsInGameThread());
+	OutSourceLODs.Reset();
+
+	if (IsRunningDedicatedServer() || !IsValid(StaticMesh))
+	{
+		return;
+	}
+
+	// The offline proxy is already a handful of triangles and is inscribed in the mesh, unlike the coarser render LODs
+	const UOccluderProxyAssetUserData* Proxy = StaticMesh->GetAssetUserData<UOccluderProxyAssetUserData>();
+	if (Proxy && Proxy->HasBoxes())
+	{
+		FOccluderSourceLOD& SourceLOD = OutSourceLODs.AddDefaulted_GetRef();
+		for (const FBox3f& Box : Proxy->Boxes)
+		{
+			SourceLOD.Boxes.Add(FScaleMatrix::Make(FVector(Box.GetExtent())) * FTranslationMatrix::Make(FVector(Box.GetCenter())));
+		}
+		return;
+	}
+
+	if (Proxy && Proxy->HasProxy())
+	{
+		FOccluderSourceLOD& SourceLOD = OutSourceLODs.AddDefaulted_GetRef();
+		SourceLOD.Vertices.Reserve(Proxy->Vertices.Num());
+		for (const FVector3f& Vertex : Proxy->Vertices)
+		{
+			SourceLOD.Vertices.Add(FVector(Vertex));
+		}
+		SourceLOD.Indices = TArray<uint32>(Proxy->Indices);
+		return;
+	}
+
+	const FStaticMeshRenderData* RenderData = StaticMesh->GetRenderData();
+	if (!RenderData)
+	{
+		return;
+	}
+
+	// Streamed out LODs have no CPU geometry, the chain starts at the first resident LOD
+	const int32 FirstLODIdx = RenderData->CurrentFirstLODIdx;
+	const int32 LastLODIdx = FMath::Min(RenderData->LODResources.Num(), FirstLODIdx + FMath::Max(MaxLODs, 1)) - 1;
+	for (int32 LODIndex = FirstLODIdx; LODIndex <= LastLODIdx; ++LODIndex)
+	{
+		FOccluderSourceLOD SourceLOD;
+		if (!CopyRenderLOD(StaticMesh, RenderData->LODResources[LODIndex], SourceLOD))
+		{
+			break;
+		}
+		SourceLOD.ScreenSize = RenderData->ScreenSize[LODIndex].GetValue();
+		OutSourceLODs.Add(MoveTemp(SourceLOD));
+	}
+}
+
+void FOccluderMeshData::BuildLODs(const TConstArrayView<FOccluderSourceLOD> SourceLODs, TArray<TSharedPtr<const FOccluderMeshData>>& OutLODs,
+                                  TArray<float>& OutScreenSizes)
+{
+	OutLODs.Reset(SourceLODs.Num());
+	OutScreenSizes.Reset(SourceLODs.Num());
+
+	for (const FOccluderSourceLOD& SourceLOD : SourceLODs)
+	{
+		OutLODs.Add(MakeShared<FOccluderMeshData>(SourceLOD));
+		OutScreenSizes.Add(SourceLOD.ScreenSize);
+	}
+}
+
+TSharedRef<FOccluderMeshData> FOccluderMeshData::TransformBy(const FMatrix& Transform) const
+{
+	const TSharedRef<FOccluderMeshData> Result = MakeShared<FOccluderMeshData>();
+	for (const FMatrix& BoxToLocal : Boxes)
+	{
+		Result->Boxes.Add(BoxToLocal * Transform);
+	}
+
+	if (Indices.IsEmpty())
+	{
+		return Result;
+	}
+
+	TArray<FVector> TransformedVertices;
+	TransformedVertices.SetNumUninitialized(Vertices.Num());
+	for (int32 i = 0; i < Vertices.Num(); ++i)
+	{
+		TransformedVertices[i] = Transform.TransformPosition(GetVertex(i));
+	}
+
+	// Mirroring flips the winding, which the normal cones rely on
+	const bool bFlipWinding = Transform.Determinant() < 0.f;
+	TArray<uint32> TransformedIndices;
+	TransformedIndices.Reserve(Indices.Num());
+	auto AddTriangles = [&](const int32 FirstVertex, const int32 FirstIndex, const int32 NumIndices)
+	{
+		for (int32 i = FirstIndex; i + 2 < FirstIndex + NumIndices; i += 3)
+		{
+			TransformedIndices.Add(FirstVertex + Indices[i]);
+			TransformedIndices.Add(FirstVertex + Indices[i + (bFlipWinding ? 2 : 1)]);
+			TransformedIndices.Add(FirstVertex + Indices[i + (bFlipWinding ? 1 : 2)]);
+		}
+	};
+
+	if (Meshlets.IsEmpty())
+	{
+		AddTriangles(0, 0, Indices.Num());
+	}
+	for (const FOccluderMeshlet& Meshlet : Meshlets)
+	{
+		AddTriangles(Meshlet.FirstVertex, Meshlet.FirstIndex, Meshlet.NumIndices);
+	}
+
+	Result->BuildMeshlets(TransformedVertices, TransformedIndices);
+	return Result;
+}
+
+void FOccluderMeshData::BuildMeshlets(const TConstArrayView<FVector> InVertices, const TConstArrayView<uint32> InIndices)
+{
+	Vertices.Reset();
+	Indices.Reset(InIndices.Num());
+	Meshlets.Reset();
+
+	// 16 bits per axis over the mesh bounds, a fraction of a millimeter for most meshes
+	FBox3f SourceBounds(ForceInit);
+	for (const FVector& Vertex : InVertices)
+	{
+		SourceBounds += FVector3f(Vertex);
+	}
+	QuantizationOffset = SourceBounds.IsValid ? SourceBounds.Min : FVector3f::ZeroVector;
+	QuantizationScale = SourceBounds.IsValid ? (SourceBounds.GetSize() / MAX_QUANTIZED).ComponentMax(FVector3f(UE_SMALL_NUMBER)) : FVector3f::OneVector;
+
+	// Rounding to the nearest step could move a vertex out of the mesh and occlude what it does not, steps toward the center only shrink it
+	auto RoundInward = [](const float Value)
+	{
+		return static_cast<uint16>(Value > MAX_QUANTIZED * 0.5f ? FMath::FloorToInt(Value + QUANTIZATION_TOLERANCE) : FMath::CeilToInt(Value - QUANTIZATION_TOLERANCE));
+	};
+
+	auto Quantize = [this, &RoundInward](const FVector& Position)
+	{
+		const FVector3f Quantized = ((FVector3f(Position) - QuantizationOffset) / QuantizationScale).BoundToBox(FVector3f::ZeroVector, FVector3f(MAX_QUANTIZED));
+		FOccluderVertex Vertex;
+		Vertex.X = RoundInward(Quantized.X);
+		Vertex.Y = RoundInward(Quantized.Y);
+		Vertex.Z = RoundInward(Quantized.Z);
+		return Vertex;
+	};
+
+	// Local index of every source vertex in the current meshlet, valid when the stamp matches
+	TArray<uint16> LocalIndex;
+	TArray<int32> LocalStamp;
+	LocalIndex.SetNumUninitialized(InVertices.Num());
+	LocalStamp.Init(INDEX_NONE, InVertices.Num());
+
+	FOccluderMeshlet Meshlet;
+	FBox MeshletBounds(ForceInit);
+	auto FinishMeshlet = [&]()
+	{
+		if (Meshlet.NumIndices > 0)
+		{
+			Meshlet.BoundsCenter = FVector3f(MeshletBounds.GetCenter());
+			Meshlet.BoundsExtent = FVector3f(MeshletBounds.GetExtent());
+			ComputeNormalCone(Meshlet);
+			Meshlets.Add(Meshlet);
+		}
+		Meshlet = FOccluderMeshlet();
+		MeshletBounds = FBox(ForceInit);
+		Meshlet.FirstVertex = Vertices.Num();
+		Meshlet.FirstIndex = Indices.Num();
+	};
+
+	const int32 NumTris = InIndices.Num() / 3;
+	for (int32 TriIdx = 0; TriIdx < NumTris; ++TriIdx)
+	{
+		const uint32 Tri[3] = { InIndices[TriIdx * 3 + 0], InIndices[TriIdx * 3 + 1], InIndices[TriIdx * 3 + 2] };
+		if (!InVertices.IsValidIndex(Tri[0]) || !InVertices.IsValidIndex(Tri[1]) || !InVertices.IsValidIndex(Tri[2]))
+		{
+			continue;
+		}
+
+		// Index buffers are ordered for the vertex cache, so consecutive triangles share most vertices
+		int32 NumNewVertices = 0;
+		for (int32 Corner = 0; Corner < 3; ++Corner)
+		{
+			NumNewVertices += LocalStamp[Tri[Corner]] != Meshlets.Num() ? 1 : 0;
+		}
+
+		if (Meshlet.NumVertices + NumNewVertices > MAX_MESHLET_VERTICES || Meshlet.NumIndices / 3 >= MAX_MESHLET_TRIANGLES)
+		{
+			FinishMeshlet();
+		}
+
+		for (int32 Corner = 0; Corner < 3; ++Corner)
+		{
+			const uint32 SourceIndex = Tri[Corner];
+			if (LocalStamp[SourceIndex] != Meshlets.Num())
+			{
+				LocalStamp[SourceIndex] = Meshlets.Num();
+				LocalIndex[SourceIndex] = static_cast<uint16>(Meshlet.NumVertices++);
+				Vertices.Add(Quantize(InVertices[SourceIndex]));
+				MeshletBounds += GetVertex(Vertices.Num() - 1);
+			}
+			Indices.Add(LocalIndex[SourceIndex]);
+			Meshlet.NumIndices++;
+		}
+	}
+
+	FinishMeshlet();
+}
+
+void FOccluderMeshData::ComputeNormalCone(FOccluderMeshlet& Meshlet) const
+{
+	const uint16* MeshletIndices = Indices.GetData() + Meshlet.FirstIndex;
+	const int32 NumTris = Meshlet.NumIndices / 3;
+
+	// Outward facing normals, render geometry winding is clockwise when seen from the front
+	TArray<FVector3f, TInlineAllocator<MAX_MESHLET_TRIANGLES>> Normals;
+	FVector3f NormalSum = FVector3f::ZeroVector;
+	for (int32 TriIdx = 0; TriIdx < NumTris; ++TriIdx)
+	{
+		const FVector V0 = GetVertex(Meshlet.FirstVertex + MeshletIndices[TriIdx * 3 + 0]);
+		const FVector V1 = GetVertex(Meshlet.FirstVertex + MeshletIndices[TriIdx * 3 + 1]);
+		const FVector V2 = GetVertex(Meshlet.FirstVertex + MeshletIndices[TriIdx * 3 + 2]);
+		const FVector3f Normal = FVector3f(FVector::CrossProduct(V2 - V0, V1 - V0).GetSafeNormal());
+		if (!Normal.IsZero())
+		{
+			Normals.Add(Normal);
+			NormalSum += Normal;
+		}
+	}
+
+	Meshlet.ConeAxis = NormalSum.GetSafeNormal();
+	if (Normals.IsEmpty() || Meshlet.ConeAxis.IsZero())
+	{
+		return;
+	}
+
+	float CosAngle = 1.f;
+	for (const FVector3f& Normal : Normals)
+	{
+		CosAngle = FMath::Min(CosAngle, FVector3f::DotProduct(Meshlet.ConeAxis, Normal));
+	}
+
+	Meshlet.ConeCosAngle = CosAngle;
+	Meshlet.ConeSinAngle = FMath::Sqrt(FMath::Max(0.f, 1.f - CosAngle * CosAngle));
+}
@@ -3,56 +3,152 @@
 #pragma once
 
 #include "CoreMinimal.h"
-#include "Kismet/KismetSystemLibrary.h"
 #include "OccluderMeshData.generated.h"
 
+/** Bounded part of an occluder mesh, culled as a whole before its vertices are transformed. Same layout as SOCore::FMeshlet. */
 USTRUCT()
-struct FOccluderMeshData
+struct FOccluderMeshlet
 {
 	GENERATED_BODY()
 
+	/** Bounds in mesh space */
+	UPROPERTY()
+	FVector3f BoundsCenter = FVector3f::ZeroVector;
+
+	UPROPERTY()
+	FVector3f BoundsExtent = FVector3f::ZeroVector;
+
+	UPROPERTY()
+	int32 FirstVertex = 0;
+
+	UPROPERTY()
+	int32 NumVertices = 0;
+
+	/** Indices are relative to FirstVertex */
+	UPROPERTY()
+	int32 FirstIndex = 0;
+
+	UPROPERTY()
+	int32 NumIndices = 0;
+
+	/** Average outward facing triangle normal in mesh space */
+	UPROPERTY()
+	FVector3f ConeAxis = FVector3f::ZeroVector;
+
+	/** Cosine and sine of the largest angle between a triangle normal and ConeAxis. No cone when the cosine is not positive */
 	UPROPERTY()
+	float ConeCosAngle = -1.f;
+
+	UPROPERTY()
+	float ConeSinAngle = 0.f;
+};
+
+/** Mesh space position quantized to 16 bits per axis within the mesh bounds */
+USTRUCT()
+struct FOccluderVertex
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	uint16 X = 0;
+
+	UPROPERTY()
+	uint16 Y = 0;
+
+	UPROPERTY()
+	uint16 Z = 0;
+};
+
+/** Occluder geometry copied from its source on the game thread, to build occluder LODs on any thread */
+struct FOccluderSourceLOD
+{
 	TArray<FVector> Vertices;
+	TArray<uint32> Indices;
+
+	/** Box occluders, each matrix maps the [-1, 1] cube to mesh space */
+	TArray<FMatrix> Boxes;
+
+	/** Screen size below which the LOD is used */
+	float ScreenSize = 0.f;
+};
 
+USTRUCT()
+struct FOccluderMeshData
+{
+	GENERATED_BODY()
+
+	/** Quantized positions, GetQuantizationToLocal maps them to mesh space */
+	UPROPERTY()
+	TArray<FOccluderVertex> Vertices;
+
+	/** Triangle indices, relative to the meshlet first vertex when Meshlets is not empty */
 	UPROPERTY()
 	TArray<uint16> Indices;
 
+	/** Optional split of the mesh, each meshlet references at most MAX_MESHLET_VERTICES vertices */
+	UPROPERTY()
+	TArray<FOccluderMeshlet> Meshlets;
+
+	/** Box occluders in mesh space, each matrix maps the [-1, 1] cube. Rasterized in addition to the triangles */
+	UPROPERTY()
+	TArray<FMatrix> Boxes;
+
+	/** Mesh space position of the quantized origin and size of a quantization step */
+	UPROPERTY()
+	FVector3f QuantizationOffset = FVector3f::ZeroVector;
+
+	UPROPERTY()
+	FVector3f QuantizationScale = FVector3f::OneVector;
+
+	static constexpr int32 MAX_MESHLET_VERTICES = 128;
+	static constexpr int32 MAX_MESHLET_TRIANGLES = 256;
+
 	FOccluderMeshData() = default;
-	explicit FOccluderMeshData(UStaticMesh* StaticMesh)
+	FOccluderMeshData(const TArray<FVector3f>& InVertices, const TArray<uint16>& InIndices);
+
+	explicit FOccluderMeshData(const FOccluderSourceLOD& SourceLOD);
+
+	/**
+	 * Copies the geometry of the occluder LOD chain of a static mesh, most detailed first, from its resident render LODs.
+	 * Meshes with an offline proxy get the proxy as only LOD. Reads the mesh and its render data, so game thread only.
+	 */
+	static void CopySourceLODs(UStaticMesh* StaticMesh, int32 MaxLODs, TArray<FOccluderSourceLOD>& OutSourceLODs);
+
+	/** Builds the occluder LODs from copied geometry, on any thread. OutScreenSizes holds the screen size below which each LOD is used. */
+	static void BuildLODs(TConstArrayView<FOccluderSourceLOD> SourceLODs, TArray<TSharedPtr<const FOccluderMeshData>>& OutLODs, TArray<float>& OutScreenSizes);
+
+	/** Copy of the mesh with its vertices and boxes transformed, e.g. to bake it in world space. Quantizing again only moves vertices inward. */
+	TSharedRef<FOccluderMeshData> TransformBy(const FMatrix& Transform) const;
+
+	/**
+	 * Splits a mesh of any size into meshlets with 16-bit local indices and quantizes it, replacing the current geometry.
+	 * Positions are rounded toward the center of the mesh bounds, so the quantized mesh never reaches past its source.
+	 */
+	void BuildMeshlets(TConstArrayView<FVector> InVertices, TConstArrayView<uint32> InIndices);
+
+	FORCEINLINE FMatrix GetQuantizationToLocal() const
 	{
-		if (IsRunningDedicatedServer())
-		{
-			return;
-		}
-		
-		if(!IsValid(StaticMesh))
-		{
-			return;
-		}
-
-		const FStaticMeshLODResources& LODModel = StaticMesh->GetRenderData()->LODResources[StaticMesh->GetRenderData()->CurrentFirstLODIdx];
-		const FRawStaticIndexBuffer& IndexBuffer = LODModel.DepthOnlyIndexBuffer.GetNumIndices() > 0 ? LODModel.DepthOnlyIndexBuffer : LODModel.IndexBuffer;
-		if (!IndexBuffer.AccessStream16())
-		{
-			UE_LOG(LogTemp, Error, TEXT("Cannot access 16-bit IndexBuffer for Occlusion Mesh: %s"), *GetNameSafe(StaticMesh));
-			return;
-		}
-
-		const int32 NumVtx = LODModel.VertexBuffers.PositionVertexBuffer.GetNumVertices();
-		const int32 NumIndices = IndexBuffer.GetNumIndices();
-		if (NumVtx > 0 && NumIndices > 0 && !IndexBuffer.Is32Bit())
-		{
-			Vertices.SetNumUninitialized(NumVtx);
-			for (int i = 0; i < NumVtx; ++i)
-			{
-				Vertices.GetData()[i] = FVector(LODModel.VertexBuffers.PositionVertexBuffer.VertexPosition(i));
-			}
-
-			Indices.SetNumUninitialized(NumIndices);
-			for (int i = 0; i < NumIndices; ++i)
-			{
-				Indices.GetData()[i] = IndexBuffer.AccessStream16()[i];
-			}
-		}
+		return FScaleMatrix::Make(FVector(QuantizationScale)) * FTranslationMatrix::Make(FVector(QuantizationOffset));
 	}
-};
\ No newline at end of file
+
+	FORCEINLINE SIZE_T GetAllocatedSize() const
+	{
+		return Vertices.GetAllocatedSize() + Indices.GetAllocatedSize() + Meshlets.GetAllocatedSize() + Boxes.GetAllocatedSize();
+	}
+
+	/** Mesh space position of a vertex */
+	FORCEINLINE FVector GetVertex(const int32 Index) const
+	{
+		const FOccluderVertex& Vertex = Vertices[Index];
+		return FVector(QuantizationOffset + FVector3f(Vertex.X, Vertex.Y, Vertex.Z) * QuantizationScale);
+	}
+
+private:
+	/** Computes the normal cone of a meshlet from its triangles */
+	void ComputeNormalCone(FOccluderMeshlet& Meshlet) const;
+
+	static constexpr float MAX_QUANTIZED = MAX_uint16;
+
+	/** Quantization steps a position may be off and still round to its nearest step, absorbs float error at the bounds */
+	static constexpr float QUANTIZATION_TOLERANCE = 1e-3f;
+};
@@ -0,0 +1,169 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#include "Data/OcclusionInstancedContext.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Data/OcclusionFrameResults.h"
+
+bool UOcclusionInstancedContext::ShouldUpdateBounds() const
+{
+	if (Super::ShouldUpdateBounds())
+	{
+		return true;
+	}
+
+	// Instances added or removed at runtime
+	const UInstancedStaticMeshComponent* InstancedComponent = Cast<UInstancedStaticMeshComponent>(PrimitiveComponent);
+	return IsValid(InstancedComponent) && PrimitiveProxy.Instances.IsValid() && InstancedComponent->GetInstanceCount() != PrimitiveProxy.Instances->Num();
+}
+
+void UOcclusionInstancedContext::UpdateBoundsInternal()
+{
+	Super::UpdateBoundsInternal();
+
+	const UInstancedStaticMeshComponent* InstancedComponent = Cast<UInstancedStaticMeshComponent>(PrimitiveComponent);
+	if (!IsValid(InstancedComponent) || !IsValid(InstancedComponent->GetStaticMesh()))
+	{
+		PrimitiveProxy.Instances.Reset();
+		return;
+	}
+
+	const FBoxSphereBounds MeshBounds = InstancedComponent->GetStaticMesh()->GetBounds();
+	const int32 NumInstances = InstancedComponent->GetInstanceCount();
+
+	const TSharedRef<FOcclusionInstanceData> Instances = MakeShared<FOcclusionInstanceData>();
+	Instances->Bounds.Reserve(NumInstances);
+	Instances->LocalToWorld.Reserve(NumInstances);
+
+	/** Factor by which to grow occlusion tests **/
+	constexpr float OcclusionSlop = 1.0f;
+
+	for (int32 InstanceIndex = 0; InstanceIndex < NumInstances; ++InstanceIndex)
+	{
+		FTransform InstanceTransform;
+		InstancedComponent->GetInstanceTransform(InstanceIndex, InstanceTransform, /*bWorldSpace*/ true);
+		const FMatrix InstanceLocalToWorld = InstanceTransform.ToMatrixWithScale();
+
+		FBoxSphereBounds InstanceBounds = MeshBounds.TransformBy(InstanceLocalToWorld);
+		InstanceBounds.BoxExtent += FVector(OcclusionSlop);
+		InstanceBounds.SphereRadius += OcclusionSlop;
+
+		Instances->Bounds.Add(InstanceBounds);
+
+		if (PrimitiveProxy.bOccluderIsBox)
+		{
+			// UnitCubeScale replaces the component scale, but instances of one component keep their own scale
+			FTransform LocalInstanceTransform;
+			InstancedComponent->GetInstanceTransform(InstanceIndex, LocalInstanceTransform, /*bWorldSpace*/ false);
+			const FVector BoxExtent = MeshBounds.BoxExtent * LocalInstanceTransform.GetScale3D().GetAbs() * OcclusionSettings.UnitCubeScale;
+
+			FMatrix BoxToWorld = InstanceTransform.ToMatrixNoScale();
+			BoxToWorld.SetOrigin(InstanceBounds.Origin);
+			Instances->LocalToWorld.Add(FScaleMatrix::Make(BoxExtent) * BoxToWorld);
+		}
+		else
+		{
+			Instances->LocalToWorld.Add(InstanceLocalToWorld);
+		}
+	}
+
+	PrimitiveProxy.Instances = Instances;
+}
+
+int32 UOcclusionInstancedContext::ApplyVisibility(const FOcclusionFrameResults& Results)
+{
+	UInstancedStaticMeshComponent* InstancedComponent = Cast<UInstancedStaticMeshComponent>(PrimitiveComponent);
+	if (!IsValid(InstancedComponent) || !PrimitiveProxy.bOcluded)
+	{
+		return 0;
+	}
+
+	const int32 NumInstances = InstancedComponent->GetInstanceCount();
+	const TBitArray<>* InstanceVisibility = Results.InstanceVisibilityMap.Find(PrimitiveProxy.PrimitiveComponentId);
+
+	// The whole component is hidden only when none of its instances is visible
+	const bool* bAnyVisiblePtr = Results.VisibilityMap.Find(PrimitiveProxy.PrimitiveComponentId);
+	const bool bHidden = bAnyVisiblePtr && *bAnyVisiblePtr == false;
+	SetHiddenInGame(bHidden);
+	if (bHidden)
+	{
+		return NumInstances;
+	}
+
+	const int32 CustomDataIndex = OcclusionSettings.InstanceVisibilityCustomDataIndex;
+	if (CustomDataIndex < 0 || CustomDataIndex >= InstancedComponent->NumCustomDataFloats)
+	{
+		return 0;
+	}
+
+	// Write every instance the first time, and whenever instances were added or removed
+	const bool bWriteAll = AppliedInstanceVisibility.Num() != NumInstances;
+	if (bWriteAll)
+	{
+		AppliedInstanceVisibility.Init(true, NumInstances);
+	}
+
+	int32 NumOccluded = 0;
+	bool bMarkRenderStateDirty = false;
+	for (int32 InstanceIndex = 0; InstanceIndex < NumInstances; ++InstanceIndex)
+	{
+		// Instances that were not tested stay visible
+		const bool bVisible = !InstanceVisibility || !InstanceVisibility->IsValidIndex(InstanceIndex) || (*InstanceVisibility)[InstanceIndex];
+		NumOccluded += bVisible ? 0 : 1;
+
+		if (bWriteAll || AppliedInstanceVisibility[InstanceIndex] != bVisible)
+		{
+			AppliedInstanceVisibility[InstanceIndex] = bVisible;
+			InstancedComponent->SetCustomDataValue(InstanceIndex, CustomDataIndex, bVisible ? 1.f : 0.f, /*bMarkRenderStateDirty*/ false);
+			bMarkRenderStateDirty = true;
+		}
+	}
+
+	if (bMarkRenderStateDirty)
+	{
+		InstancedComponent->MarkRenderStateDirty();
+	}
+
+	return NumOccluded;
+}
+
+void UOcclusionInstancedContext::RestoreVisibility()
+{
+	Super::RestoreVisibility();
+
+	// Instances hidden through custom data are shown again as well
+	UInstancedStaticMeshComponent* InstancedComponent = Cast<UInstancedStaticMeshComponent>(PrimitiveComponent);
+	const int32 CustomDataIndex = OcclusionSettings.InstanceVisibilityCustomDataIndex;
+	if (IsValid(InstancedComponent) && CustomDataIndex >= 0 && CustomDataIndex < InstancedComponent->NumCustomDataFloats)
+	{
+		bool bMarkRenderStateDirty = false;
+		const int32 NumInstances = FMath::Min(AppliedInstanceVisibility.Num(), InstancedComponent->GetInstanceCount());
+		for (int32 InstanceIndex = 0; InstanceIndex < NumInstances; ++InstanceIndex)
+		{
+			if (!AppliedInstanceVisibility[InstanceIndex])
+			{
+				InstancedComponent->SetCustomDataValue(InstanceIndex, CustomDataIndex, 1.f, /*bMarkRenderStateDirty*/ false);
+				bMarkRenderStateDirty = true;
+			}
+		}
+
+		if (bMarkRenderStateDirty)
+		{
+			InstancedComponent->MarkRenderStateDirty();
+		}
+	}
+	AppliedInstanceVisibility.Reset();
+}
+
+FOcclusionRenderCost UOcclusionInstancedContext::GetCulledRenderCost(const int32 NumCulled) const
+{
+	// Instances culled through custom data are still drawn, so nothing is saved until the whole component is hidden
+	const UInstancedStaticMeshComponent* InstancedComponent = Cast<UInstancedStaticMeshComponent>(PrimitiveComponent);
+	if (!IsValid(InstancedComponent) || !IsHiddenInGame())
+	{
+		return FOcclusionRenderCost();
+	}
+
+	FOcclusionRenderCost Cost = Super::GetCulledRenderCost(NumCulled);
+	Cost.NumTriangles *= NumCulled;
+	return Cost;
+}
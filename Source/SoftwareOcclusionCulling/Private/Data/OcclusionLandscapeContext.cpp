@@ -0,0 +1,240 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#include "Data/OcclusionLandscapeContext.h"
+#include "LandscapeComponent.h"
+#include "LandscapeProxy.h"
+
+static bool GSOLandscapeOccluders = true;
+static FAutoConsoleVariableRef CVarSOLandscapeOccluders(
+	TEXT("r.so.Landscape.Occluders"),
+	GSOLandscapeOccluders,
+	TEXT("Build heightfield occluder patches for landscape components"),
+	ECVF_Default
+);
+
+static int32 GSOLandscapeSamplesPerFrame = 4096;
+static FAutoConsoleVariableRef CVarSOLandscapeSamplesPerFrame(
+	TEXT("r.so.Landscape.SamplesPerFrame"),
+	GSOLandscapeSamplesPerFrame,
+	TEXT("Maximum number of landscape height samples taken per frame while building occluder patches"),
+	ECVF_Default
+);
+
+static int32 GSOLandscapePatchQuads = 16;
+static FAutoConsoleVariableRef CVarSOLandscapePatchQuads(
+	TEXT("r.so.Landscape.PatchQuads"),
+	GSOLandscapePatchQuads,
+	TEXT("Number of quads per side of the most detailed occluder patch of a landscape component. Each next LOD halves it."),
+	ECVF_Default
+);
+
+static float GSOLandscapeLODScreenSize = 0.5f;
+static FAutoConsoleVariableRef CVarSOLandscapeLODScreenSize(
+	TEXT("r.so.Landscape.LODScreenSize"),
+	GSOLandscapeLODScreenSize,
+	TEXT("Screen size below which landscape components use their second occluder patch LOD. Each halving of it selects the next LOD."),
+	ECVF_Default
+);
+
+static constexpr int32 MAX_PATCH_QUADS = 64;
+
+/** Height samples granted for the current frame, shared by every landscape context */
+static int32 ConsumeSampleBudget(const int32 NumRequested)
+{
+	static uint64 BudgetFrame = 0;
+	static int32 BudgetRemaining = 0;
+
+	if (BudgetFrame != GFrameCounter)
+	{
+		BudgetFrame = GFrameCounter;
+		BudgetRemaining = FMath::Max(GSOLandscapeSamplesPerFrame, 1);
+	}
+
+	const int32 NumGranted = FMath::Min(NumRequested, BudgetRemaining);
+	BudgetRemaining -= NumGranted;
+	return NumGranted;
+}
+
+/**
+ * Builds a PatchQuads x PatchQuads grid whose vertices take the minimum height of every sample in their adjacent cells.
+ * Each cell then lies below all of its samples and, the heightfield being linear between samples, below the terrain.
+ */
+static TSharedRef<FOccluderMeshData> BuildPatchLOD(const TArray<float>& Heights, const int32 NumSamplesPerSide, const int32 PatchQuads,
+                                                   const FTransform& ComponentTransform, const FVector& PatchOrigin)
+{
+	const int32 NumQuads = NumSamplesPerSide - 1;
+	const int32 NumPatchVerticesPerSide = PatchQuads + 1;
+
+	auto CellStart = [NumQuads, PatchQuads](const int32 Cell)
+	{
+		return (Cell * NumQuads) / PatchQuads;
+	};
+
+	// Lowest sample of every cell, cells touching a hole are not emitted
+	TArray<float> CellMinHeight;
+	CellMinHeight.SetNumUninitialized(PatchQuads * PatchQuads);
+	TBitArray<> CellHole(false, PatchQuads * PatchQuads);
+
+	for (int32 CellY = 0; CellY < PatchQuads; ++CellY)
+	{
+		for (int32 CellX = 0; CellX < PatchQuads; ++CellX)
+		{
+			float MinHeight = MAX_flt;
+			bool bHole = false;
+			for (int32 SampleY = CellStart(CellY); SampleY <= CellStart(CellY + 1); ++SampleY)
+			{
+				for (int32 SampleX = CellStart(CellX); SampleX <= CellStart(CellX + 1); ++SampleX)
+				{
+					const float Height = Heights[SampleY * NumSamplesPerSide + SampleX];
+					bHole |= Height == MAX_flt;
+					MinHeight = FMath::Min(MinHeight, Height);
+				}
+			}
+
+			const int32 CellIndex = CellY * PatchQuads + CellX;
+			CellMinHeight[CellIndex] = MinHeight;
+			CellHole[CellIndex] = bHole;
+		}
+	}
+
+	TArray<FVector> PatchVertices;
+	TArray<uint32> PatchIndices;
+	PatchVertices.SetNumUninitialized(NumPatchVerticesPerSide * NumPatchVerticesPerSide);
+	PatchIndices.Reserve(PatchQuads * PatchQuads * 6);
+
+	for (int32 VertexY = 0; VertexY < NumPatchVerticesPerSide; ++VertexY)
+	{
+		for (int32 VertexX = 0; VertexX < NumPatchVerticesPerSide; ++VertexX)
+		{
+			float Height = MAX_flt;
+			for (int32 CellY = FMath::Max(VertexY - 1, 0); CellY <= FMath::Min(VertexY, PatchQuads - 1); ++CellY)
+			{
+				for (int32 CellX = FMath::Max(VertexX - 1, 0); CellX <= FMath::Min(VertexX, PatchQuads - 1); ++CellX)
+				{
+					const int32 CellIndex = CellY * PatchQuads + CellX;
+					if (!CellHole[CellIndex])
+					{
+						Height = FMath::Min(Height, CellMinHeight[CellIndex]);
+					}
+				}
+			}
+
+			// Vertices surrounded by holes are never referenced
+			FVector Position = ComponentTransform.TransformPosition(FVector(CellStart(VertexX), CellStart(VertexY), 0.f)) - PatchOrigin;
+			Position.Z = Height == MAX_flt ? 0.f : Height;
+			PatchVertices[VertexY * NumPatchVerticesPerSide + VertexX] = Position;
+		}
+	}
+
+	for (int32 CellY = 0; CellY < PatchQuads; ++CellY)
+	{
+		for (int32 CellX = 0; CellX < PatchQuads; ++CellX)
+		{
+			if (CellHole[CellY * PatchQuads + CellX])
+			{
+				continue;
+			}
+
+			const uint32 V00 = CellY * NumPatchVerticesPerSide + CellX;
+			const uint32 V10 = V00 + 1;
+			const uint32 V01 = V00 + NumPatchVerticesPerSide;
+			const uint32 V11 = V01 + 1;
+
+			// Front facing when seen from above
+			PatchIndices.Add(V00);
+			PatchIndices.Add(V01);
+			PatchIndices.Add(V10);
+
+			PatchIndices.Add(V01);
+			PatchIndices.Add(V11);
+			PatchIndices.Add(V10);
+		}
+	}
+
+	// Split the patch, so only the parts inside the frustum are transformed
+	const TSharedRef<FOccluderMeshData> Patch = MakeShared<FOccluderMeshData>();
+	Patch->BuildMeshlets(PatchVertices, PatchIndices);
+
+	return Patch;
+}
+
+bool UOcclusionLandscapeContext::ShouldUpdateBounds() const
+{
+	return Super::ShouldUpdateBounds() || (GSOLandscapeOccluders && OcclusionSettings.bUseAsOccluder && !bPatchesBuilt);
+}
+
+void UOcclusionLandscapeContext::UpdateBoundsInternal()
+{
+	const ULandscapeComponent* LandscapeComponent = Cast<ULandscapeComponent>(PrimitiveComponent);
+	if (IsValid(LandscapeComponent) && GSOLandscapeOccluders && OcclusionSettings.bUseAsOccluder && !bPatchesBuilt)
+	{
+		if (SampleHeights(LandscapeComponent))
+		{
+			BuildPatches(LandscapeComponent);
+		}
+	}
+
+	Super::UpdateBoundsInternal();
+
+	if (bPatchesBuilt)
+	{
+		// Patch vertices are stored relative to the component origin
+		PrimitiveProxy.LocalToWorld = FTranslationMatrix(PatchOrigin);
+	}
+}
+
+bool UOcclusionLandscapeContext::SampleHeights(const ULandscapeComponent* LandscapeComponent)
+{
+	const ALandscapeProxy* LandscapeProxy = LandscapeComponent->GetLandscapeProxy();
+	if (!IsValid(LandscapeProxy))
+	{
+		return false;
+	}
+
+	if (NumSamplesPerSide == 0)
+	{
+		NumSamplesPerSide = LandscapeComponent->ComponentSizeQuads + 1;
+		PatchOrigin = LandscapeComponent->GetComponentLocation();
+		Heights.SetNumUninitialized(NumSamplesPerSide * NumSamplesPerSide);
+		NumSampled = 0;
+	}
+
+	// Component space is one unit per landscape quad
+	const FTransform& ComponentTransform = LandscapeComponent->GetComponentTransform();
+	const int32 NumSamples = Heights.Num();
+	const int32 NumToSample = ConsumeSampleBudget(NumSamples - NumSampled);
+
+	for (int32 i = 0; i < NumToSample; ++i, ++NumSampled)
+	{
+		const int32 SampleX = NumSampled % NumSamplesPerSide;
+		const int32 SampleY = NumSampled / NumSamplesPerSide;
+		const FVector SampleLocation = ComponentTransform.TransformPosition(FVector(SampleX, SampleY, 0.f));
+
+		const TOptional<float> Height = LandscapeProxy->GetHeightAtLocation(SampleLocation);
+		Heights[NumSampled] = Height.IsSet() ? static_cast<float>(Height.GetValue() - PatchOrigin.Z) : MAX_flt;
+	}
+
+	return NumSampled == NumSamples;
+}
+
+void UOcclusionLandscapeContext::BuildPatches(const ULandscapeComponent* LandscapeComponent)
+{
+	const int32 NumQuads = NumSamplesPerSide - 1;
+	const FTransform& ComponentTransform = LandscapeComponent->GetComponentTransform();
+
+	PrimitiveProxy.OccluderLODs.Reset();
+	PrimitiveProxy.OccluderLODScreenSizes.Reset();
+
+	// Halving the patch quads with the screen size keeps the patch quads at about the same size on screen
+	float LODScreenSize = GSOLandscapeLODScreenSize * 2.f;
+	for (int32 PatchQuads = FMath::Clamp(GSOLandscapePatchQuads, 1, FMath::Min(NumQuads, MAX_PATCH_QUADS)); PatchQuads >= 1; PatchQuads /= 2)
+	{
+		PrimitiveProxy.OccluderLODs.Add(BuildPatchLOD(Heights, NumSamplesPerSide, PatchQuads, ComponentTransform, PatchOrigin));
+		PrimitiveProxy.OccluderLODScreenSizes.Add(LODScreenSize);
+		LODScreenSize *= 0.5f;
+	}
+
+	PrimitiveProxy.OccluderData = PrimitiveProxy.OccluderLODs[0];
+	Heights.Empty();
+	bPatchesBuilt = true;
+}
@@ -12,8 +12,7 @@ struct FOcclusionMeshData
 	UPROPERTY()
 	FMatrix	LocalToWorld;
 
-	UPROPERTY()
-	FOccluderMeshData Data;
+	TSharedPtr<const FOccluderMeshData> Data;
 	
 	FPrimitiveComponentId PrimId;
 };
\ No newline at end of file
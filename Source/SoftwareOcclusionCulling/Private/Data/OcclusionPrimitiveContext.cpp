@@ -1,42 +1,323 @@
 ﻿// Copyright to Kat Code Labs, SRL. All Rights Reserved.
 
 #include "Data/OcclusionPrimitiveContext.h"
+#include "FusedOccluderComponent.h"
+#include "Components/StaticMeshComponent.h"
+#include "Data/OcclusionFrameResults.h"
 #include "DrawDebugHelpers.h"
+#include "Engine/StaticMesh.h"
+#include "StaticMeshResources.h"
+#include "UObject/ObjectKey.h"
 
-void UOcclusionPrimitiveContext::Setup(UStaticMeshComponent* InStaticMeshComponent,
+static int32 GSOMaxOccluderLODs = 4;
+static FAutoConsoleVariableRef CVarSOMaxOccluderLODs(
+	TEXT("r.so.MaxOccluderLODs"),
+	GSOMaxOccluderLODs,
+	TEXT("Maximum number of render LODs extracted as occluder LODs per static mesh, taken when the primitive registers"),
+	ECVF_Default
+);
+
+static bool GSOStaticOccluderCache = true;
+static FAutoConsoleVariableRef CVarSOStaticOccluderCache(
+	TEXT("r.so.StaticOccluderCache"),
+	GSOStaticOccluderCache,
+	TEXT("Bake the occluder geometry of static primitives in world space once, instead of transforming it from mesh space every frame"),
+	ECVF_Default
+);
+
+static bool GSOAsyncOccluderExtraction = true;
+static FAutoConsoleVariableRef CVarSOAsyncOccluderExtraction(
+	TEXT("r.so.AsyncOccluderExtraction"),
+	GSOAsyncOccluderExtraction,
+	TEXT("Extract occluder geometry on worker threads. Primitives are occludees right away and become occluders once their geometry is ready."),
+	ECVF_Default
+);
+
+static int32 GSOOccluderExtractionsPerFrame = 16;
+static FAutoConsoleVariableRef CVarSOOccluderExtractionsPerFrame(
+	TEXT("r.so.OccluderExtractionsPerFrame"),
+	GSOOccluderExtractionsPerFrame,
+	TEXT("Maximum number of occluder extractions started per frame, asynchronous or not"),
+	ECVF_Default
+);
+
+/** Occluder LODs in mesh space, shared by every primitive of the same static mesh */
+struct FOccluderLODSet
+{
+	TArray<TSharedPtr<const FOccluderMeshData>> LODs;
+	TArray<float> ScreenSizes;
+
+	/** r.so.MaxOccluderLODs when the LODs were extracted */
+	int32 MaxLODs = 0;
+
+	SIZE_T GetAllocatedSize() const
+	{
+		SIZE_T AllocatedSize = 0;
+		for (const TSharedPtr<const FOccluderMeshData>& LOD : LODs)
+		{
+			AllocatedSize += LOD->GetAllocatedSize();
+		}
+		return AllocatedSize;
+	}
+};
+
+/** Mesh space LODs of the static meshes in use, released with the last primitive that holds them. Game thread only. */
+static TMap<TObjectKey<UStaticMesh>, TWeakPtr<const FOccluderLODSet>> GOccluderLODCache;
+
+static TSharedPtr<const FOccluderLODSet> FindCachedLODSet(const TObjectKey<UStaticMesh>& StaticMesh, const int32 MaxLODs)
+{
+	const TWeakPtr<const FOccluderLODSet>* CachedLODSet = GOccluderLODCache.Find(StaticMesh);
+	TSharedPtr<const FOccluderLODSet> LODSet = CachedLODSet ? CachedLODSet->Pin() : TSharedPtr<const FOccluderLODSet>();
+	if (!LODSet.IsValid() || LODSet->MaxLODs != MaxLODs)
+	{
+		return nullptr;
+	}
+	return LODSet;
+}
+
+/** Shares the LODs of a mesh with the primitives extracting it later. Returns the LODs to use, which were already shared if another primitive got there first. */
+static TSharedPtr<const FOccluderLODSet> AddCachedLODSet(const TObjectKey<UStaticMesh>& StaticMesh, const TSharedPtr<const FOccluderLODSet>& LODSet)
+{
+	if (TSharedPtr<const FOccluderLODSet> CachedLODSet = FindCachedLODSet(StaticMesh, LODSet->MaxLODs))
+	{
+		return CachedLODSet;
+	}
+
+	// Drop the meshes no primitive holds anymore
+	for (auto It = GOccluderLODCache.CreateIterator(); It; ++It)
+	{
+		if (!It.Value().IsValid())
+		{
+			It.RemoveCurrent();
+		}
+	}
+	GOccluderLODCache.Add(StaticMesh, LODSet);
+	return LODSet;
+}
+
+/**
+ * Occluder geometry of a primitive, built and baked away from the game thread. The task shares ownership,
+ * so a context that drops an extraction in flight lets it finish unobserved.
+ */
+struct FOccluderExtraction
+{
+	/** Geometry copied on the game thread, the worker never reads the primitive or its mesh */
+	TArray<FOccluderSourceLOD> SourceLODs;
+
+	/** Mesh the LODs are shared for, null for fused occluders */
+	TObjectKey<UStaticMesh> StaticMesh;
+	int32 MaxLODs = 0;
+
+	/** Mesh space LODs, found in the cache or built from SourceLODs */
+	TSharedPtr<const FOccluderLODSet> LODSet;
+
+	/** Also bake the LODs in world space relative to Anchor, when set */
+	TOptional<FMatrix> LocalToWorld;
+	FVector Anchor = FVector::ZeroVector;
+	TArray<TSharedPtr<const FOccluderMeshData>> BakedLODs;
+
+	/** Whether Run has anything to do, cached LODs that are not baked are ready as they are */
+	bool NeedsRun() const
+	{
+		return !LODSet.IsValid() || LocalToWorld.IsSet();
+	}
+
+	void Run()
+	{
+		if (!LODSet.IsValid())
+		{
+			const TSharedRef<FOccluderLODSet> NewLODSet = MakeShared<FOccluderLODSet>();
+			FOccluderMeshData::BuildLODs(SourceLODs, NewLODSet->LODs, NewLODSet->ScreenSizes);
+			NewLODSet->MaxLODs = MaxLODs;
+			LODSet = NewLODSet;
+			SourceLODs.Empty();
+		}
+
+		if (LocalToWorld.IsSet() && !LODSet->LODs.IsEmpty())
+		{
+			BakeLODs(LODSet->LODs, LocalToWorld.GetValue(), Anchor, BakedLODs);
+		}
+	}
+
+	/** Bakes the LODs relative to the anchor, so the 16-bit positions keep their precision in large worlds */
+	static void BakeLODs(const TArray<TSharedPtr<const FOccluderMeshData>>& InLODs, const FMatrix& InLocalToWorld, const FVector& InAnchor,
+	                     TArray<TSharedPtr<const FOccluderMeshData>>& OutLODs)
+	{
+		const FMatrix LocalToAnchor = InLocalToWorld * FTranslationMatrix::Make(-InAnchor);
+		OutLODs.Reset(InLODs.Num());
+		for (const TSharedPtr<const FOccluderMeshData>& LocalLOD : InLODs)
+		{
+			OutLODs.Add(LocalLOD->TransformBy(LocalToAnchor));
+		}
+	}
+};
+
+/** Extractions granted for the current frame, shared by every primitive context */
+static bool ConsumeExtractionBudget()
+{
+	static uint64 BudgetFrame = 0;
+	static int32 BudgetRemaining = 0;
+
+	if (BudgetFrame != GFrameCounter)
+	{
+		BudgetFrame = GFrameCounter;
+		BudgetRemaining = FMath::Max(GSOOccluderExtractionsPerFrame, 1);
+	}
+
+	if (BudgetRemaining <= 0)
+	{
+		return false;
+	}
+	BudgetRemaining--;
+	return true;
+}
+
+void UOcclusionPrimitiveContext::Setup(UPrimitiveComponent* InPrimitiveComponent,
                                     const FOcclusionSettings& NewOcclusionSettings)
 {
 	SetOcclusionSettings(NewOcclusionSettings);
-	SetMesh(InStaticMeshComponent);
+	SetPrimitive(InPrimitiveComponent);
 }
 
-void UOcclusionPrimitiveContext::SetMesh(UStaticMeshComponent* InStaticMeshComponent)
+void UOcclusionPrimitiveContext::SetPrimitive(UPrimitiveComponent* InPrimitiveComponent)
 {
-	StaticMeshComponent = InStaticMeshComponent;
-	PrimitiveProxy.PrimitiveComponentId = StaticMeshComponent->GetPrimitiveSceneId();
-	if(OcclusionSettings.bUseAsOccluder)
+	PrimitiveComponent = InPrimitiveComponent;
+	PrimitiveProxy.PrimitiveComponentId = PrimitiveComponent->GetPrimitiveSceneId();
+
+	// Any primitive can be occluded by its bounds, only static meshes and fused occluders provide occluder geometry
+	PrimitiveProxy.bOccluderIsBox = OcclusionSettings.bOccluderIsScaledUnitCube;
+	MeshLODs.Reset();
+	CachedLocalToWorld.Reset();
+	Extraction.Reset();
+	ExtractionTask = nullptr;
+	PrimitiveProxy.bOccluderEvicted = false;
+	bOccluderExtractionPending = HasOccluderSource();
+
+	// Not an occluder until the new geometry is extracted
+	if (bOccluderExtractionPending)
 	{
-		PrimitiveProxy.OccluderData = FOccluderMeshData(StaticMeshComponent->GetStaticMesh());
+		PrimitiveProxy.OccluderData.Reset();
+		PrimitiveProxy.OccluderLODs.Reset();
+		PrimitiveProxy.OccluderLODScreenSizes.Reset();
 	}
 	UpdateBoundsInternal();
 }
 
-bool UOcclusionPrimitiveContext::PerformFrustumCull(const APlayerCameraManager* PlayerCameraManager) const
+bool UOcclusionPrimitiveContext::HasOccluderSource() const
+{
+	if(!OcclusionSettings.bUseAsOccluder || PrimitiveProxy.bOccluderIsBox)
+	{
+		return false;
+	}
+
+	if (const UStaticMeshComponent* StaticMeshComponent = Cast<UStaticMeshComponent>(PrimitiveComponent); StaticMeshComponent && IsValid(StaticMeshComponent->GetStaticMesh()))
+	{
+		return true;
+	}
+
+	const UFusedOccluderComponent* FusedComponent = Cast<UFusedOccluderComponent>(PrimitiveComponent);
+	return FusedComponent && FusedComponent->HasOccluder();
+}
+
+TSharedRef<FOccluderExtraction> UOcclusionPrimitiveContext::CreateOccluderExtraction() const
+{
+	const TSharedRef<FOccluderExtraction> NewExtraction = MakeShared<FOccluderExtraction>();
+
+	if (const UStaticMeshComponent* StaticMeshComponent = Cast<UStaticMeshComponent>(PrimitiveComponent); StaticMeshComponent && IsValid(StaticMeshComponent->GetStaticMesh()))
+	{
+		// Meshes already extracted for another primitive are not copied again
+		NewExtraction->StaticMesh = TObjectKey<UStaticMesh>(StaticMeshComponent->GetStaticMesh());
+		NewExtraction->MaxLODs = GSOMaxOccluderLODs;
+		NewExtraction->LODSet = FindCachedLODSet(NewExtraction->StaticMesh, NewExtraction->MaxLODs);
+		if (!NewExtraction->LODSet.IsValid())
+		{
+			FOccluderMeshData::CopySourceLODs(StaticMeshComponent->GetStaticMesh(), GSOMaxOccluderLODs, NewExtraction->SourceLODs);
+		}
+	}
+	else if (const UFusedOccluderComponent* FusedComponent = Cast<UFusedOccluderComponent>(PrimitiveComponent); FusedComponent && FusedComponent->HasOccluder())
+	{
+		FOccluderSourceLOD& SourceLOD = NewExtraction->SourceLODs.AddDefaulted_GetRef();
+		SourceLOD.Vertices.Reserve(FusedComponent->Vertices.Num());
+		for (const FVector3f& Vertex : FusedComponent->Vertices)
+		{
+			SourceLOD.Vertices.Add(FVector(Vertex));
+		}
+		SourceLOD.Indices = TArray<uint32>(FusedComponent->Indices);
+	}
+
+	// Static occluders are baked on the worker as well
+	if (ShouldCacheWorldSpaceOccluder())
+	{
+		NewExtraction->LocalToWorld = PrimitiveComponent->GetComponentTransform().ToMatrixWithScale();
+		NewExtraction->Anchor = PrimitiveProxy.Bounds.Origin;
+	}
+	return NewExtraction;
+}
+
+SIZE_T UOcclusionPrimitiveContext::GetOccluderAllocatedSize() const
+{
+	SIZE_T AllocatedSize = 0;
+
+	// Each primitive of a mesh accounts for its share of the mesh space LODs
+	if (MeshLODs.IsValid())
+	{
+		AllocatedSize += MeshLODs->GetAllocatedSize() / MeshLODs.GetSharedReferenceCount();
+	}
+
+	// Landscape patches are built by their context and are not evictable
+	if (CachedLocalToWorld.IsSet())
+	{
+		for (const TSharedPtr<const FOccluderMeshData>& LOD : PrimitiveProxy.OccluderLODs)
+		{
+			AllocatedSize += LOD->GetAllocatedSize();
+		}
+	}
+	return AllocatedSize;
+}
+
+void UOcclusionPrimitiveContext::EvictOccluder()
+{
+	if (!MeshLODs.IsValid() && !CachedLocalToWorld.IsSet())
+	{
+		return;
+	}
+
+	MeshLODs.Reset();
+	CachedLocalToWorld.Reset();
+	PrimitiveProxy.OccluderData.Reset();
+	PrimitiveProxy.OccluderLODs.Empty();
+	PrimitiveProxy.OccluderLODScreenSizes.Empty();
+	PrimitiveProxy.bOccluder = false;
+	PrimitiveProxy.bOccluderEvicted = true;
+}
+
+void UOcclusionPrimitiveContext::MarkOccluderUsed(const uint64 FrameNumber)
 {
-	if(!IsValid(StaticMeshComponent))
+	LastOccluderUseFrame = FrameNumber;
+
+	if (PrimitiveProxy.bOccluderEvicted && !ExtractionTask.IsValid())
+	{
+		PrimitiveProxy.bOccluderEvicted = false;
+		bOccluderExtractionPending = HasOccluderSource();
+	}
+}
+
+bool UOcclusionPrimitiveContext::PerformFrustumCull(const APlayerCameraManager* PlayerCameraManager)
+{
+	if(!IsValid(PrimitiveComponent) || !PrimitiveProxy.bOcluded)
 	{
 		return false;
 	}
 
 	// A CachedMaxDrawDistance of 0 indicates that the primitive should not be culled by distance.
-	if (StaticMeshComponent->CachedMaxDrawDistance == 0)
+	if (PrimitiveComponent->CachedMaxDrawDistance == 0)
 	{
 		return false;
 	}
 
 	// Skip objects where the bounds center is within the draw distance
 	const float Distance = FVector::Distance(PlayerCameraManager->GetCameraLocation(), PrimitiveProxy.Bounds.Origin);
-	if(FMath::IsWithin(Distance, StaticMeshComponent->MinDrawDistance, StaticMeshComponent->LDMaxDrawDistance))
+	if(FMath::IsWithin(Distance, PrimitiveComponent->MinDrawDistance, PrimitiveComponent->LDMaxDrawDistance))
 	{
 		return false;
 	}
@@ -49,21 +330,21 @@ bool UOcclusionPrimitiveContext::PerformFrustumCull(const APlayerCameraManager*
 		return false;
 	}
 
-	StaticMeshComponent->SetHiddenInGame(true);
+	SetHiddenInGame(true);
 	return true;
 }
 
 void UOcclusionPrimitiveContext::UpdateBoundsInternal()
 {
-	if(!IsValid(StaticMeshComponent))
+	if(!IsValid(PrimitiveComponent))
 	{
 		return;
 	}
 		
-	const FMatrix NewLocalToWorld = StaticMeshComponent->GetComponentTransform().ToMatrixWithScale();
+	const FMatrix NewLocalToWorld = PrimitiveComponent->GetComponentTransform().ToMatrixWithScale();
 
 	// Store occlusion bounds.
-	FBoxSphereBounds OcclusionBounds = StaticMeshComponent->Bounds;
+	FBoxSphereBounds OcclusionBounds = PrimitiveComponent->Bounds;
 	if (OcclusionSettings.bUseCustomBounds)
 	{
 		const FVector HalfExtent = OcclusionSettings.CustomBounds * 0.5f;
@@ -80,49 +361,232 @@ void UOcclusionPrimitiveContext::UpdateBoundsInternal()
 
 	PrimitiveProxy.Bounds = OcclusionBounds;
 	PrimitiveProxy.LocalToWorld = NewLocalToWorld;
+
+	if (MeshLODs.IsValid() || CachedLocalToWorld.IsSet())
+	{
+		UpdateOccluderLODs();
+	}
 	
-	if (OcclusionSettings.bOccluderIsScaledUnitCube)
+	if (PrimitiveProxy.bOccluderIsBox)
 	{
-		PrimitiveProxy.LocalToWorld = StaticMeshComponent->GetComponentTransform().ToMatrixNoScale();
+		PrimitiveProxy.LocalToWorld = PrimitiveComponent->GetComponentTransform().ToMatrixNoScale();
 		PrimitiveProxy.LocalToWorld.SetOrigin(PrimitiveProxy.Bounds.Origin);
-		PrimitiveProxy.LocalToWorld = FScaleMatrix::Make(OcclusionSettings.UnitCubeScale) * PrimitiveProxy.LocalToWorld;
+		const FVector BoxExtent = PrimitiveComponent->CalcBounds(FTransform::Identity).BoxExtent * OcclusionSettings.UnitCubeScale;
+		PrimitiveProxy.LocalToWorld = FScaleMatrix::Make(BoxExtent) * PrimitiveProxy.LocalToWorld;
 	}
 
+	UpdateProxyFlags();
+}
+
+void UOcclusionPrimitiveContext::UpdateProxyFlags()
+{
 	const bool bHasHugeBounds = PrimitiveProxy.Bounds.SphereRadius > HALF_WORLD_MAX / 2.0f;
-	PrimitiveProxy.bOccluder = !bHasHugeBounds && OcclusionSettings.bUseAsOccluder;
+	PrimitiveProxy.bOccluder = !bHasHugeBounds && OcclusionSettings.bUseAsOccluder && (PrimitiveProxy.bOccluderIsBox || PrimitiveProxy.OccluderData.IsValid());
 	PrimitiveProxy.bOcluded = !bHasHugeBounds && OcclusionSettings.bCanBeOcluded;
 }
 
+bool UOcclusionPrimitiveContext::ShouldCacheWorldSpaceOccluder() const
+{
+	return GSOStaticOccluderCache && PrimitiveComponent->Mobility == EComponentMobility::Static;
+}
+
+void UOcclusionPrimitiveContext::TickOccluderExtraction()
+{
+	if (!ExtractionTask.IsValid())
+	{
+		if (!bOccluderExtractionPending || !IsValid(PrimitiveComponent) || !ConsumeExtractionBudget())
+		{
+			return;
+		}
+
+		// Copying the geometry is the only part that reads the mesh
+		bOccluderExtractionPending = false;
+		Extraction = CreateOccluderExtraction();
+
+		if (!GSOAsyncOccluderExtraction || !Extraction->NeedsRun())
+		{
+			Extraction->Run();
+		}
+		else
+		{
+			ExtractionTask = FFunctionGraphTask::CreateAndDispatchWhenReady(
+				[InExtraction = Extraction]()
+				{
+					InExtraction->Run();
+				},
+				TStatId(),
+				nullptr,
+				ENamedThreads::AnyBackgroundThreadNormalTask
+			);
+			return;
+		}
+	}
+	else if (!ExtractionTask->IsComplete())
+	{
+		return;
+	}
+
+	MeshLODs = Extraction->LODSet;
+	if (MeshLODs.IsValid() && MeshLODs->LODs.IsEmpty())
+	{
+		MeshLODs.Reset();
+	}
+	else if (MeshLODs.IsValid() && Extraction->StaticMesh != TObjectKey<UStaticMesh>())
+	{
+		MeshLODs = AddCachedLODSet(Extraction->StaticMesh, MeshLODs);
+	}
+
+	if (Extraction->LocalToWorld.IsSet() && !Extraction->BakedLODs.IsEmpty())
+	{
+		PrimitiveProxy.OccluderLODs = MoveTemp(Extraction->BakedLODs);
+		CachedLocalToWorld = Extraction->LocalToWorld;
+		CachedAnchor = Extraction->Anchor;
+	}
+
+	Extraction.Reset();
+	ExtractionTask = nullptr;
+
+	if ((MeshLODs.IsValid() || CachedLocalToWorld.IsSet()) && IsValid(PrimitiveComponent))
+	{
+		UpdateOccluderLODs();
+	}
+	UpdateProxyFlags();
+}
+
+void UOcclusionPrimitiveContext::RequestOccluderExtraction()
+{
+	// The extraction in flight already brings them back
+	if (!ExtractionTask.IsValid())
+	{
+		bOccluderExtractionPending = HasOccluderSource();
+	}
+}
+
+void UOcclusionPrimitiveContext::UpdateOccluderLODs()
+{
+	// The proxy transform is replaced by the anchor once the LODs are baked
+	const FMatrix LocalToWorld = PrimitiveComponent->GetComponentTransform().ToMatrixWithScale();
+	const bool bCacheWorldSpace = ShouldCacheWorldSpaceOccluder();
+	const bool bBakedLODsFit = bCacheWorldSpace && CachedLocalToWorld.IsSet() && CachedLocalToWorld->Equals(LocalToWorld);
+	if (!MeshLODs.IsValid() && !bBakedLODsFit)
+	{
+		// Keep occluding with the baked LODs until the mesh space ones are back
+		RequestOccluderExtraction();
+		PrimitiveProxy.LocalToWorld = FTranslationMatrix::Make(CachedAnchor);
+		return;
+	}
+
+	if (!bCacheWorldSpace)
+	{
+		CachedLocalToWorld.Reset();
+		PrimitiveProxy.LocalToWorld = LocalToWorld;
+		PrimitiveProxy.OccluderLODs = MeshLODs->LODs;
+	}
+	else if (!bBakedLODsFit)
+	{
+		CachedAnchor = PrimitiveProxy.Bounds.Origin;
+		FOccluderExtraction::BakeLODs(MeshLODs->LODs, LocalToWorld, CachedAnchor, PrimitiveProxy.OccluderLODs);
+		CachedLocalToWorld = LocalToWorld;
+	}
+
+	if (MeshLODs.IsValid())
+	{
+		PrimitiveProxy.OccluderLODScreenSizes = MeshLODs->ScreenSizes;
+	}
+
+	if (CachedLocalToWorld.IsSet())
+	{
+		// Only the world space bake is kept per primitive, the mesh space LODs stay cached while other primitives hold them
+		PrimitiveProxy.LocalToWorld = FTranslationMatrix::Make(CachedAnchor);
+		MeshLODs.Reset();
+	}
+
+	PrimitiveProxy.OccluderData = PrimitiveProxy.OccluderLODs[0];
+}
+
 bool UOcclusionPrimitiveContext::ShouldUpdateBounds() const
 {
-	if(!IsValid(StaticMeshComponent))
+	if(!IsValid(PrimitiveComponent))
 	{
 		return false;
 	}
-	return OcclusionSettings.bAllowBoundsUpdate && StaticMeshComponent->Mobility == EComponentMobility::Movable;
+	return OcclusionSettings.bAllowBoundsUpdate && PrimitiveComponent->Mobility == EComponentMobility::Movable;
 }
 
-void UOcclusionPrimitiveContext::SetHiddenInGame(const bool bHidden) const
+void UOcclusionPrimitiveContext::SetHiddenInGame(const bool bHidden)
 {
-	if(!IsValid(StaticMeshComponent))
+	if(!IsValid(PrimitiveComponent))
 	{
 		return;
 	}
 		
 	// TODO: A developer callback would be a nice additional to the override component.
-	StaticMeshComponent->SetHiddenInGame(bHidden);
+	PrimitiveComponent->SetHiddenInGame(bHidden);
+	bHiddenInGame = bHidden;
+}
+
+void UOcclusionPrimitiveContext::RestoreVisibility()
+{
+	if (bHiddenInGame)
+	{
+		SetHiddenInGame(false);
+	}
+}
+
+int32 UOcclusionPrimitiveContext::ApplyVisibility(const FOcclusionFrameResults& Results)
+{
+	// Leave the visibility of occluder only primitives untouched
+	if (!PrimitiveProxy.bOcluded)
+	{
+		return 0;
+	}
+
+	// Visible by default
+	bool bHidden = false;
+	if (const bool* bVisiblePtr = Results.VisibilityMap.Find(PrimitiveProxy.PrimitiveComponentId))
+	{
+		bHidden = *bVisiblePtr == false;
+	}
+
+	SetHiddenInGame(bHidden);
+	return bHidden ? 1 : 0;
+}
+
+FOcclusionRenderCost UOcclusionPrimitiveContext::GetCulledRenderCost(const int32 NumCulled) const
+{
+	FOcclusionRenderCost Cost;
+	if (NumCulled <= 0 || !IsValid(PrimitiveComponent))
+	{
+		return Cost;
+	}
+
+	// Most detailed resident LOD, so an upper bound for distant meshes
+	const UStaticMeshComponent* StaticMeshComponent = Cast<UStaticMeshComponent>(PrimitiveComponent);
+	const UStaticMesh* StaticMesh = StaticMeshComponent ? StaticMeshComponent->GetStaticMesh() : nullptr;
+	const FStaticMeshRenderData* RenderData = StaticMesh ? StaticMesh->GetRenderData() : nullptr;
+	if (RenderData && RenderData->LODResources.IsValidIndex(RenderData->CurrentFirstLODIdx))
+	{
+		const FStaticMeshLODResources& LODResources = RenderData->LODResources[RenderData->CurrentFirstLODIdx];
+		Cost.NumTriangles = LODResources.GetNumTriangles();
+		Cost.NumDrawCalls = LODResources.Sections.Num();
+		return Cost;
+	}
+
+	// Other primitives count one draw per material
+	Cost.NumDrawCalls = PrimitiveComponent->GetNumMaterials();
+	return Cost;
 }
 
 void UOcclusionPrimitiveContext::DebugBounds() const
 {
-	// Check if StaticMeshComponent is valid
-	if (!IsValid(StaticMeshComponent))
+	// Check if PrimitiveComponent is valid
+	if (!IsValid(PrimitiveComponent))
 	{
-		UE_LOG(LogTemp, Warning, TEXT("DebugBounds: StaticMeshComponent is null."));
+		UE_LOG(LogTemp, Warning, TEXT("DebugBounds: PrimitiveComponent is null."));
 		return;
 	}
 
-	const UWorld* World = StaticMeshComponent->GetWorld();
+	const UWorld* World = PrimitiveComponent->GetWorld();
 	if (!World)
 	{
 		UE_LOG(LogTemp, Warning, TEXT("DebugBounds: World is null."));
@@ -6,6 +6,18 @@
 #include "OccluderMeshData.h"
 #include "OcclusionPrimitiveProxy.generated.h"
 
+/** Per-instance data of an instanced primitive, shared between the primitive context and the scene proxies */
+struct FOcclusionInstanceData
+{
+	TArray<FBoxSphereBounds> Bounds;
+	TArray<FMatrix> LocalToWorld;
+
+	FORCEINLINE int32 Num() const
+	{
+		return Bounds.Num();
+	}
+};
+
 USTRUCT()
 struct FOcclusionPrimitiveProxy
 {
@@ -13,8 +25,16 @@ struct FOcclusionPrimitiveProxy
 
 	FPrimitiveComponentId PrimitiveComponentId;
 
-	UPROPERTY()
-	FOccluderMeshData OccluderData;
+	TSharedPtr<const FOccluderMeshData> OccluderData;
+
+	/** Optional occluder LOD chain, most detailed first. Selected by screen size instead of OccluderData when not empty */
+	TArray<TSharedPtr<const FOccluderMeshData>> OccluderLODs;
+
+	/** Screen size below which each of OccluderLODs is used, same convention as the static mesh LOD screen sizes */
+	TArray<float> OccluderLODScreenSizes;
+
+	/** Valid for instanced primitives, which are culled per instance instead of using Bounds */
+	TSharedPtr<const FOcclusionInstanceData> Instances;
 
 	UPROPERTY()
 	FBoxSphereBounds Bounds;
@@ -25,6 +45,18 @@ struct FOcclusionPrimitiveProxy
 	UPROPERTY()
 	bool bOccluder = true;
 
+	/** Occluder is the [-1, 1] cube transformed by LocalToWorld, rasterized by its silhouette instead of OccluderData */
+	UPROPERTY()
+	bool bOccluderIsBox = false;
+
 	UPROPERTY()
 	bool bOcluded = true;
+
+	/** Occluder geometry was dropped to stay within the occluder memory budget, it is extracted again when requested */
+	UPROPERTY()
+	bool bOccluderEvicted = false;
+
+	/** Index of the primitive in the baked occluder cells, only a candidate occluder in the cells listing it */
+	UPROPERTY()
+	int32 BakedOccluderIndex = INDEX_NONE;
 };
@@ -0,0 +1,54 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#include "Data/OcclusionSkinnedContext.h"
+#include "Rendering/SkeletalMeshLODRenderData.h"
+#include "Rendering/SkeletalMeshRenderData.h"
+
+void UOcclusionSkinnedContext::SetHiddenInGame(const bool bHidden)
+{
+	Super::SetHiddenInGame(bHidden);
+
+	USkinnedMeshComponent* SkinnedComponent = Cast<USkinnedMeshComponent>(PrimitiveComponent);
+	if (!IsValid(SkinnedComponent) || bHidden == bAnimationThrottled)
+	{
+		return;
+	}
+
+	if (bHidden)
+	{
+		// Only meshes that tick their pose regardless of rendering are switched, the other options already throttle
+		// on the renderer visibility or must keep refreshing their bones
+		if (SkinnedComponent->VisibilityBasedAnimTickOption != EVisibilityBasedAnimTickOption::AlwaysTickPose)
+		{
+			return;
+		}
+
+		// Montages keep ticking so gameplay notifies still fire while the pose is not evaluated
+		RestoreAnimTickOption = SkinnedComponent->VisibilityBasedAnimTickOption;
+		SkinnedComponent->VisibilityBasedAnimTickOption = EVisibilityBasedAnimTickOption::OnlyTickMontagesWhenNotRendered;
+	}
+	else if (SkinnedComponent->VisibilityBasedAnimTickOption == EVisibilityBasedAnimTickOption::OnlyTickMontagesWhenNotRendered)
+	{
+		// Gameplay may have picked another option while the mesh was occluded, that one is kept
+		SkinnedComponent->VisibilityBasedAnimTickOption = RestoreAnimTickOption;
+	}
+
+	bAnimationThrottled = bHidden;
+}
+
+FOcclusionRenderCost UOcclusionSkinnedContext::GetCulledRenderCost(const int32 NumCulled) const
+{
+	const USkinnedMeshComponent* SkinnedComponent = Cast<USkinnedMeshComponent>(PrimitiveComponent);
+	const FSkeletalMeshRenderData* RenderData = IsValid(SkinnedComponent) ? SkinnedComponent->GetSkeletalMeshRenderData() : nullptr;
+	if (NumCulled <= 0 || !RenderData || !RenderData->LODRenderData.IsValidIndex(RenderData->CurrentFirstLODIdx))
+	{
+		return Super::GetCulledRenderCost(NumCulled);
+	}
+
+	// Most detailed resident LOD, the skinning cost is not included
+	const FSkeletalMeshLODRenderData& LODData = RenderData->LODRenderData[RenderData->CurrentFirstLODIdx];
+	FOcclusionRenderCost Cost;
+	Cost.NumTriangles = LODData.GetTotalFaces();
+	Cost.NumDrawCalls = LODData.RenderSections.Num();
+	return Cost;
+}
@@ -0,0 +1,76 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#include "Data/OcclusionVisibilitySnapshot.h"
+#include "Core/OcclusionCoreQuery.h"
+
+FOcclusionVisibilitySnapshot::FOcclusionVisibilitySnapshot(const FMatrix& ViewProj, const FVector& InViewOrigin, const uint64 InFrameNumber,
+                                                           TUniquePtr<SOCore::FCoverageBuffer> InCoverage, TUniquePtr<SOCore::FCoverageDepth> InCoverageDepth)
+	: ViewOrigin(InViewOrigin)
+	, FrameNumber(InFrameNumber)
+	, Coverage(MoveTemp(InCoverage))
+	, CoverageDepth(MoveTemp(InCoverageDepth))
+{
+	// Camera relative, like the occludees of the frame
+	SOCore::FMatrix44 RelativeViewProj;
+	const FMatrix44f RelativeViewProjF(FTranslationMatrix::Make(ViewOrigin) * ViewProj);
+	FMemory::Memcpy(RelativeViewProj.M, RelativeViewProjF.M, sizeof(RelativeViewProj.M));
+
+	const SOCore::FMatrix44 CoreWorldToFramebuffer = RelativeViewProj * SOCore::MakeClipToFramebuffer();
+	FMemory::Memcpy(WorldToFramebuffer.M, CoreWorldToFramebuffer.M, sizeof(WorldToFramebuffer.M));
+}
+
+FOcclusionVisibilitySnapshot::~FOcclusionVisibilitySnapshot() = default;
+
+void FOcclusionVisibilitySnapshot::QueryBoxes(TConstArrayView<FBox> Boxes, TArrayView<bool> OutVisible) const
+{
+	Query(Boxes.Num(), [Boxes](const int32 Index, FVector& OutMin, FVector& OutMax)
+	{
+		OutMin = Boxes[Index].Min;
+		OutMax = Boxes[Index].Max;
+	}, OutVisible);
+}
+
+void FOcclusionVisibilitySnapshot::QueryPoints(TConstArrayView<FVector> Points, TArrayView<bool> OutVisible) const
+{
+	// Points are tested as empty boxes
+	Query(Points.Num(), [Points](const int32 Index, FVector& OutMin, FVector& OutMax)
+	{
+		OutMin = Points[Index];
+		OutMax = Points[Index];
+	}, OutVisible);
+}
+
+void FOcclusionVisibilitySnapshot::Query(const int32 Num, TFunctionRef<void(int32 Index, FVector& OutMin, FVector& OutMax)> GetBox, TArrayView<bool> OutVisible) const
+{
+	check(OutVisible.Num() == Num);
+
+	constexpr int32 RUN_SIZE = 256;
+	SOCore::FVec3 RelativeMinMax[RUN_SIZE * 2];
+	uint8 Visible[RUN_SIZE];
+
+	SOCore::FMatrix44 CoreWorldToFramebuffer;
+	FMemory::Memcpy(CoreWorldToFramebuffer.M, WorldToFramebuffer.M, sizeof(CoreWorldToFramebuffer.M));
+
+	for (int32 First = 0; First < Num; First += RUN_SIZE)
+	{
+		const int32 RunSize = FMath::Min(Num - First, RUN_SIZE);
+		for (int32 i = 0; i < RunSize; ++i)
+		{
+			FVector Min, Max;
+			GetBox(First + i, Min, Max);
+
+			// Boxes are projected camera relative, which keeps them precise in single precision
+			const FVector3f RelativeMin(Min - ViewOrigin);
+			const FVector3f RelativeMax(Max - ViewOrigin);
+			RelativeMinMax[i * 2] = { RelativeMin.X, RelativeMin.Y, RelativeMin.Z };
+			RelativeMinMax[i * 2 + 1] = { RelativeMax.X, RelativeMax.Y, RelativeMax.Z };
+		}
+
+		SOCore::QueryBoxVisibility(SOCore::GetSIMDKernels(), CoreWorldToFramebuffer, *Coverage, *CoverageDepth, RelativeMinMax, RunSize, Visible);
+
+		for (int32 i = 0; i < RunSize; ++i)
+		{
+			OutVisible[First + i] = Visible[i] != 0;
+		}
+	}
+}
@@ -0,0 +1,50 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+
+#include "FusedOccluderActor.h"
+#include "FusedOccluderComponent.h"
+#include "OcclusionCullingSubsystem.h"
+#include "Components/StaticMeshComponent.h"
+
+AFusedOccluderActor::AFusedOccluderActor()
+{
+	PrimaryActorTick.bCanEverTick = false;
+
+	FusedOccluderComponent = CreateDefaultSubobject<UFusedOccluderComponent>(TEXT("FusedOccluderComponent"));
+	RootComponent = FusedOccluderComponent;
+}
+
+void AFusedOccluderActor::BeginPlay()
+{
+	Super::BeginPlay();
+
+	UOcclusionCullingSubsystem* OcclusionCullingSubsystem = GetWorld()->GetFirstPlayerController()->GetLocalPlayer()->GetSubsystem<UOcclusionCullingSubsystem>();
+	checkf(OcclusionCullingSubsystem, TEXT("AFusedOccluderActor used without a UOcclusionCullingSubsystem present!"));
+
+	FOcclusionSettings OccluderSettings;
+	OccluderSettings.bUseAsOccluder = true;
+	OccluderSettings.bCanBeOcluded = false;
+	OccluderSettings.bAllowBoundsUpdate = false;
+	OcclusionCullingSubsystem->RegisterOcclusionSettings(FusedOccluderComponent, OccluderSettings);
+
+	// The fused occluder stands in for the sources
+	FOcclusionSettings SourceSettings = GetDefault<USoftwareOcclusionSettings>()->DefaultOcclusionSettings;
+	SourceSettings.bUseAsOccluder = false;
+	for (UStaticMeshComponent* SourceComponent : SourceComponents)
+	{
+		OcclusionCullingSubsystem->RegisterOcclusionSettings(SourceComponent, SourceSettings);
+	}
+}
+
+void AFusedOccluderActor::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (const APlayerController* PlayerController = GetWorld()->GetFirstPlayerController())
+	{
+		if (UOcclusionCullingSubsystem* OcclusionCullingSubsystem = ULocalPlayer::GetSubsystem<UOcclusionCullingSubsystem>(PlayerController->GetLocalPlayer()))
+		{
+			OcclusionCullingSubsystem->UnregisterOcclusionSettings(FusedOccluderComponent);
+		}
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
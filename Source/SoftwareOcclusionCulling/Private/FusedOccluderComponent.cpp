@@ -0,0 +1,26 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+
+#include "FusedOccluderComponent.h"
+
+UFusedOccluderComponent::UFusedOccluderComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+
+	SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	SetGenerateOverlapEvents(false);
+	SetHiddenInGame(true);
+	CastShadow = false;
+	Mobility = EComponentMobility::Static;
+}
+
+FBoxSphereBounds UFusedOccluderComponent::CalcBounds(const FTransform& LocalToWorld) const
+{
+	if (!HasOccluder())
+	{
+		return FBoxSphereBounds(LocalToWorld.GetLocation(), FVector::ZeroVector, 0.f);
+	}
+
+	const FBox LocalBox(FBox3f(Vertices));
+	return FBoxSphereBounds(LocalBox).TransformBy(LocalToWorld);
+}
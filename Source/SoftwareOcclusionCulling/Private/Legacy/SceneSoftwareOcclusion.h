@@ -9,6 +9,14 @@
 #include "Data/OcclusionFrameResults.h"
 #include "Data/OcclusionPrimitiveProxy.h"
 #include "Data/OcclusionSceneData.h"
+#include "Core/OcclusionCoreCapture.h"
+#include "Core/OcclusionCoreKernels.h"
+#include "Core/OcclusionCoreRasterizer.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "ProfilingDebugging/CountersTrace.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
 
 // //////////////////////////////////////////////////////
 
@@ -27,6 +35,37 @@ DECLARE_DWORD_COUNTER_STAT(TEXT("Total triangles"), STAT_SoftwareTriangles, STAT
 DECLARE_DWORD_COUNTER_STAT(TEXT("Rasterized occluder tris"), STAT_SoftwareOccluderTris, STATGROUP_SoftwareOcclusion);
 DECLARE_DWORD_COUNTER_STAT(TEXT("Rasterized occludee tris"), STAT_SoftwareOccludeeTris, STATGROUP_SoftwareOcclusion);
 
+// Insights timing events of every stage, recorded with -trace=cpu,SoftwareOcclusion
+UE_TRACE_CHANNEL(SoftwareOcclusionChannel);
+#define SO_TRACE_SCOPE(Name) TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL(Name, SoftwareOcclusionChannel)
+
+// Insights counters, recorded with -trace=counters
+TRACE_DECLARE_FLOAT_COUNTER(SOPopulateMs, TEXT("SoftwareOcclusion/PopulateMs"));
+TRACE_DECLARE_FLOAT_COUNTER(SOGatherMs, TEXT("SoftwareOcclusion/GatherMs"));
+TRACE_DECLARE_FLOAT_COUNTER(SOProcessMs, TEXT("SoftwareOcclusion/ProcessMs"));
+TRACE_DECLARE_FLOAT_COUNTER(SOFlushWaitMs, TEXT("SoftwareOcclusion/FlushWaitMs"));
+TRACE_DECLARE_INT_COUNTER(SOResultsLatency, TEXT("SoftwareOcclusion/ResultsLatencyFrames"));
+TRACE_DECLARE_INT_COUNTER(SOCandidateOccluders, TEXT("SoftwareOcclusion/CandidateOccluders"));
+TRACE_DECLARE_INT_COUNTER(SOSelectedOccluders, TEXT("SoftwareOcclusion/SelectedOccluders"));
+TRACE_DECLARE_INT_COUNTER(SOOccludees, TEXT("SoftwareOcclusion/Occludees"));
+TRACE_DECLARE_INT_COUNTER(SOCulledPrimitives, TEXT("SoftwareOcclusion/CulledPrimitives"));
+TRACE_DECLARE_INT_COUNTER(SOScreenTriangles, TEXT("SoftwareOcclusion/ScreenTriangles"));
+TRACE_DECLARE_INT_COUNTER(SOOccluderTriangles, TEXT("SoftwareOcclusion/RasterizedOccluderTriangles"));
+TRACE_DECLARE_INT_COUNTER(SOOccludeeTriangles, TEXT("SoftwareOcclusion/RasterizedOccludeeTriangles"));
+TRACE_DECLARE_INT_COUNTER(SOBin0Triangles, TEXT("SoftwareOcclusion/Bin0/Triangles"));
+TRACE_DECLARE_INT_COUNTER(SOBin1Triangles, TEXT("SoftwareOcclusion/Bin1/Triangles"));
+TRACE_DECLARE_INT_COUNTER(SOBin2Triangles, TEXT("SoftwareOcclusion/Bin2/Triangles"));
+TRACE_DECLARE_INT_COUNTER(SOBin3Triangles, TEXT("SoftwareOcclusion/Bin3/Triangles"));
+TRACE_DECLARE_INT_COUNTER(SOBin4Triangles, TEXT("SoftwareOcclusion/Bin4/Triangles"));
+TRACE_DECLARE_INT_COUNTER(SOBin5Triangles, TEXT("SoftwareOcclusion/Bin5/Triangles"));
+TRACE_DECLARE_FLOAT_COUNTER(SOBin0Coverage, TEXT("SoftwareOcclusion/Bin0/Coverage"));
+TRACE_DECLARE_FLOAT_COUNTER(SOBin1Coverage, TEXT("SoftwareOcclusion/Bin1/Coverage"));
+TRACE_DECLARE_FLOAT_COUNTER(SOBin2Coverage, TEXT("SoftwareOcclusion/Bin2/Coverage"));
+TRACE_DECLARE_FLOAT_COUNTER(SOBin3Coverage, TEXT("SoftwareOcclusion/Bin3/Coverage"));
+TRACE_DECLARE_FLOAT_COUNTER(SOBin4Coverage, TEXT("SoftwareOcclusion/Bin4/Coverage"));
+TRACE_DECLARE_FLOAT_COUNTER(SOBin5Coverage, TEXT("SoftwareOcclusion/Bin5/Coverage"));
+static_assert(BIN_NUM == 6, "Update the per bin trace counters");
+
 inline float GSOMinScreenRadiusForOccluder = 0.075f;
 static FAutoConsoleVariableRef CVarSOMinScreenRadiusForOccluder(
 	TEXT("r.so.MinScreenRadiusForOccluder"),
@@ -51,792 +90,434 @@ static FAutoConsoleVariableRef CVarSOMaxOccluderNum(
 	ECVF_RenderThreadSafe
 );
 
+inline float GSOOccluderLODScale = 1.f;
+static FAutoConsoleVariableRef CVarSOOccluderLODScale(
+	TEXT("r.so.OccluderLODScale"),
+	GSOOccluderLODScale,
+	TEXT("Scales the screen size used to select occluder LODs. Bigger values keep the detailed LODs further away."),
+	ECVF_RenderThreadSafe
+);
+
+inline int32 GSOConeCulling = 1;
+static FAutoConsoleVariableRef CVarSOConeCulling(
+	TEXT("r.so.ConeCulling"),
+	GSOConeCulling,
+	TEXT("Skip occluder meshlets whose normal cone faces away from the view before transforming them"),
+	ECVF_RenderThreadSafe
+);
+
+inline int32 GSODebugOccludeeQuads = 0;
+static FAutoConsoleVariableRef CVarSODebugOccludeeQuads(
+	TEXT("r.so.DebugView.Occludees"),
+	GSODebugOccludeeQuads,
+	TEXT("Record the occludee rectangles and outline them in the coverage debug view, green when visible and red when occluded"),
+	ECVF_RenderThreadSafe
+);
+
 static int32 GSOSIMD = 1;
 static FAutoConsoleVariableRef CVarSOSIMD(
 	TEXT("r.so.SIMD"),
 	GSOSIMD,
-	TEXT("Use SIMD routines in software occlusion"),
+	TEXT("Use the SIMD kernel variants in software occlusion, the scalar ones on targets without a SIMD variant"),
 	ECVF_RenderThreadSafe
 );
 
 
-namespace EScreenVertexFlags
-{
-	constexpr uint8 None = 0;
-	constexpr uint8 ClippedLeft = 1 << 0;	// Vertex is clipped by left plane
-	constexpr uint8 ClippedRight = 1 << 1;	// Vertex is clipped by right plane
-	constexpr uint8 ClippedTop = 1 << 2;	// Vertex is clipped by top plane
-	constexpr uint8 ClippedBottom = 1 << 3;	// Vertex is clipped by bottom plane
-	constexpr uint8 ClippedNear = 1 << 4;   // Vertex is clipped by near plane
-	constexpr uint8 Discard = 1 << 5;	// Polygon using this vertex should be discarded
-}
-
-
+static_assert(SOCore::BinWidth == BIN_WIDTH && SOCore::BinNum == BIN_NUM && SOCore::FramebufferHeight == FRAMEBUFFER_HEIGHT,
+              "Occlusion core framebuffer layout differs from the frame results");
+static_assert(sizeof(FOccluderVertex) == sizeof(SOCore::FQuantizedVertex), "Occlusion core quantized vertex layout differs");
+static_assert(sizeof(FOccluderMeshlet) == sizeof(SOCore::FMeshlet)
+              && STRUCT_OFFSET(FOccluderMeshlet, FirstVertex) == STRUCT_OFFSET(SOCore::FMeshlet, FirstVertex)
+              && STRUCT_OFFSET(FOccluderMeshlet, ConeAxis) == STRUCT_OFFSET(SOCore::FMeshlet, ConeAxis)
+              && STRUCT_OFFSET(FOccluderMeshlet, ConeSinAngle) == STRUCT_OFFSET(SOCore::FMeshlet, ConeSinAngle),
+              "Occlusion core meshlet layout differs");
 
-struct FScreenPosition
+static SOCore::FMatrix44 ToCoreMatrix(const FMatrix44f& Matrix)
 {
-	int32 X, Y;
-};
+	SOCore::FMatrix44 Result;
+	FMemory::Memcpy(Result.M, Matrix.M, sizeof(Result.M));
+	return Result;
+}
 
-struct FScreenTriangle
+static SOCore::FMatrix44 ToCoreMatrix(const FMatrix& Matrix)
 {
-	FScreenPosition V[3];
-};
-
-
+	return ToCoreMatrix(FMatrix44f(Matrix));
+}
 
-struct FSortedIndexDepth
+/** Kernel variants selected by r.so.SIMD, validated against the scalar ones by Tools/OcclusionKernelCheck */
+static const SOCore::FKernelSet& GetOcclusionKernels()
 {
-	int32 Index;
-	float Depth;
-};
+	return GSOSIMD ? SOCore::GetSIMDKernels() : SOCore::GetScalarKernels();
+}
 
-struct FOcclusionFrameData
+static bool ProcessOccludeeGeom(const FOcclusionSceneData& SceneData, SOCore::FFrameData& FrameData, TArray<uint8>& OccludeeVisibility,
+                                TArray<FIntRect>* OutDebugQuads)
 {
-	// binned tris
-	TArray<FSortedIndexDepth>		SortedTriangles[BIN_NUM];
+	constexpr int32 RUN_SIZE = 512;
+	const SOCore::FKernelSet& Kernels = GetOcclusionKernels();
 
-	// tris data	
-	TArray<FScreenTriangle>			ScreenTriangles;
-	TArray<FPrimitiveComponentId>	ScreenTrianglesPrimID;
-	TArray<uint8>					ScreenTrianglesFlags;
+	const int32 NumBoxes = SceneData.OccludeeBoxMinMax.Num() / 2;
+	const FVector* MinMax = SceneData.OccludeeBoxMinMax.GetData();
 
-	void ReserveBuffers(int32 NumTriangles)
-	{
-		const int32 NumTrianglesPerBin = NumTriangles / BIN_NUM + 1;
-		for (int32 BinIdx = 0; BinIdx < BIN_NUM; ++BinIdx)
-		{
-			SortedTriangles[BinIdx].Reserve(NumTrianglesPerBin);
-		}
+	// Boxes are projected camera relative, which keeps them precise in single precision
+	const FMatrix RelativeViewProj = FTranslationMatrix::Make(SceneData.ViewOrigin) * SceneData.ViewProj;
+	const SOCore::FMatrix44 WorldToFB = ToCoreMatrix(RelativeViewProj) * SOCore::MakeClipToFramebuffer();
 
-		ScreenTriangles.Reserve(NumTriangles);
-		ScreenTrianglesPrimID.Reserve(NumTriangles);
-		ScreenTrianglesFlags.Reserve(NumTriangles);
-	}
-};
+	// on stack mem for each run output
+	int32 Quads[RUN_SIZE * 4];
+	SOCore::FVec3 RelativeMinMax[RUN_SIZE * 2];
 
-inline uint64 ComputeBinRowMask(int32 BinMinX, float fX0, float fX1)
-{
-	int32 X0 = FMath::RoundToInt(fX0) - BinMinX;
-	int32 X1 = FMath::RoundToInt(fX1) - BinMinX;
-	if (X0 >= BIN_WIDTH || X1 < 0)
+	for (int32 NumBoxesProcessed = 0; NumBoxesProcessed < NumBoxes; NumBoxesProcessed += RUN_SIZE)
 	{
-		// not in bin
-		return 0ull;
-	}
+		float QuadDepths[RUN_SIZE];
+		int32 QuadClipFlags[RUN_SIZE];
+		const int32 RunSize = FMath::Min(NumBoxes - NumBoxesProcessed, RUN_SIZE);
 
-	X0 = FMath::Max(0, X0);
-	X1 = FMath::Min(BIN_WIDTH - 1, X1);
-	const int32 Num = (X1 - X0) + 1;
-	return (Num == BIN_WIDTH) ? ~0ull : ((1ull << Num) - 1) << X0;
-}
+		for (int32 i = 0; i < RunSize * 2; ++i)
+		{
+			const FVector3f Corner(*(MinMax++) - SceneData.ViewOrigin);
+			RelativeMinMax[i] = { Corner.X, Corner.Y, Corner.Z };
+		}
 
-inline void RasterizeHalf(float X0, float X1, float DX0, float DX1, int32 Row0, int32 Row1, uint64* BinData, int32 BinMinX)
-{
-	checkSlow(Row0 <= Row1);
-	checkSlow(Row0 >= 0 && Row1 < FRAMEBUFFER_HEIGHT);
+		// Generate quads
+		Kernels.ProjectOccludeeBoxes(WorldToFB, RelativeMinMax, RunSize, Quads, QuadDepths, QuadClipFlags);
 
-	for (int32 Row = Row0; Row <= Row1; Row++, X0 += DX0, X1 += DX1)
-	{
-		const uint64 FrameBufferMask = BinData[Row];
-		if (FrameBufferMask != ~0ull) // whether this row is already fully rasterized
+		if (OutDebugQuads)
 		{
-			if (const uint64 RowMask = ComputeBinRowMask(BinMinX, X0, X1))
+			for (int32 i = 0; i < RunSize; ++i)
 			{
-				BinData[Row] = (FrameBufferMask | RowMask);
+				const int32* Quad = &Quads[i * 4];
+				const bool bOnScreen = QuadClipFlags[i] == 0 && Quad[0] <= Quad[2] && Quad[1] <= Quad[3];
+				OutDebugQuads->Add(bOnScreen ? FIntRect(Quad[0], Quad[1], Quad[2] + 1, Quad[3] + 1) : FIntRect());
 			}
 		}
+
+		// Triangulate generated quads
+		SOCore::AddOccludeeQuads(Quads, QuadDepths, QuadClipFlags, RunSize, NumBoxesProcessed, OccludeeVisibility.GetData(), FrameData);
 	}
+
+	return true;
 }
 
-static void RasterizeOccluderTri(const FScreenTriangle& Tri, uint64* BinData, const int32 BinMinX)
+static void CollectOccludeeGeom(const FBoxSphereBounds& Bounds, FPrimitiveComponentId PrimitiveId, int32 InstanceIndex, FOcclusionSceneData& SceneData)
 {
-	const FScreenPosition A = Tri.V[0];
-	const FScreenPosition B = Tri.V[1];
-	const FScreenPosition C = Tri.V[2];
-
-	const int32 RowMin = FMath::Max<int32>(A.Y, 0);
-	const int32 RowMax = FMath::Min<int32>(FRAMEBUFFER_HEIGHT - 1, C.Y);
-
-	bool bRasterized = false;
-
-	int32 RowS = RowMin;
-	if ((B.Y - RowMin) > 0)
-	{
-		// A -> B
-		int32 RowE = FMath::Min<int32>(RowMax, B.Y);
-		// Edge gradients
-		float dX0 = static_cast<float>(B.X - A.X) / (B.Y - A.Y);
-		float dX1 = static_cast<float>(C.X - A.X) / (C.Y - A.Y);
-		if (dX0 > dX1)
-		{
-			Swap(dX0, dX1);
-		}
-		const float X0 = A.X + dX0 * (RowS - A.Y);
-		const float X1 = A.X + dX1 * (RowS - A.Y);
-		ensure(X0 <= X1);
-		RasterizeHalf(X0, X1, dX0, dX1, RowS, RowE, BinData, BinMinX);
-		bRasterized |= true;
-		RowS = RowE + 1;
-	}
+	const FBox Box = Bounds.GetBox();
 
-	if ((RowMax - RowS) > 0)
-	{
-		// B -> C
-		// Edge gradients
-		float dX0 = float(C.X - A.X) / (C.Y - A.Y);
-		float dX1 = float(C.X - B.X) / (C.Y - B.Y);
-		float X0 = A.X + dX0 * (RowS - A.Y);
-		float X1 = B.X + dX1 * (RowS - B.Y);
-		if (X0 > X1)
-		{
-			Swap(X0, X1);
-			Swap(dX0, dX1);
-		}
-		RasterizeHalf(X0, X1, dX0, dX1, RowS, RowMax, BinData, BinMinX);
-		bRasterized |= true;
-	}
+	SceneData.OccludeeBoxMinMax.Add(Box.Min);
+	SceneData.OccludeeBoxMinMax.Add(Box.Max);
+	SceneData.OccludeeBoxPrimId.Add(PrimitiveId);
+	SceneData.OccludeeBoxInstanceIdx.Add(InstanceIndex);
+}
 
-	// one line triangle
-	if (!bRasterized)
-	{
-		const float X0 = FMath::Min3(A.X, B.X, C.X);
-		const float X1 = FMath::Max3(A.X, B.X, C.X);
-		RasterizeHalf(X0, X1, 0.0f, 0.0f, RowS, RowS, BinData, BinMinX);
-	}
+static SOCore::FOccluderMeshView ToCoreMeshView(const FOccluderMeshData& MeshData)
+{
+	SOCore::FOccluderMeshView View;
+	View.Vertices = reinterpret_cast<const SOCore::FQuantizedVertex*>(MeshData.Vertices.GetData());
+	View.NumVertices = MeshData.Vertices.Num();
+	View.Indices = MeshData.Indices.GetData();
+	View.NumIndices = MeshData.Indices.Num();
+	View.Meshlets = reinterpret_cast<const SOCore::FMeshlet*>(MeshData.Meshlets.GetData());
+	View.NumMeshlets = MeshData.Meshlets.Num();
+	View.QuantizationOffset = { MeshData.QuantizationOffset.X, MeshData.QuantizationOffset.Y, MeshData.QuantizationOffset.Z };
+	View.QuantizationScale = { MeshData.QuantizationScale.X, MeshData.QuantizationScale.Y, MeshData.QuantizationScale.Z };
+	return View;
 }
 
-static bool RasterizeOccludeeQuad(const FScreenTriangle& Tri, uint64* BinData, int32 BinMinX)
+// Meshlet culling, quantized transform and box silhouettes are shared with the replay tool through SOCore
+static void ProcessOccluderGeom(const FOcclusionSceneData& SceneData, SOCore::FFrameData& OutData)
 {
-	const int32 RowMin = Tri.V[0].Y; // Quad MinY
-	const int32 RowMax = Tri.V[2].Y; // Quad MaxY
-	// occludee expected to be clipped to screen
-	checkSlow(RowMin >= 0);
-	checkSlow(RowMax < FRAMEBUFFER_HEIGHT);
+	const float W_CLIP = SceneData.ViewProj.M[3][2];
+	const SOCore::FKernelSet& Kernels = GetOcclusionKernels();
 
-	// clip X to bin bounds
-	const int32 X0 = FMath::Max(Tri.V[0].X - BinMinX, 0);
-	const int32 X1 = FMath::Min(Tri.V[1].X - BinMinX, BIN_WIDTH - 1);
-	checkSlow(X0 <= X1);
+	std::vector<SOCore::FVec4> ClipVertexBuffer;
+	std::vector<uint8> ClipVertexFlagsBuffer;
 
-	const int32 NumBits = (X1 - X0) + 1;
-	const uint64 RowMask = (NumBits == BIN_WIDTH) ? ~0ull : ((1ull << NumBits) - 1) << X0;
+	// Camera relative transforms keep large world coordinates precise once the matrices are converted to float
+	const FMatrix RelativeViewProj = FTranslationMatrix::Make(SceneData.ViewOrigin) * SceneData.ViewProj;
 
-	for (int32 Row = RowMin; Row <= RowMax; ++Row)
+	for (const FOcclusionMeshData& Mesh : SceneData.OccluderData)
 	{
-		const uint64 FrameBufferMask = BinData[Row];
-		if ((~FrameBufferMask & RowMask))
-		{
-			return true;
-		}
-	}
+		FMatrix LocalToRelativeWorld = Mesh.LocalToWorld;
+		LocalToRelativeWorld.SetOrigin(Mesh.LocalToWorld.GetOrigin() - SceneData.ViewOrigin);
 
-	return false;
-}
+		SOCore::FVec3 LocalViewOrigin;
+		const bool bConeCulling = GSOConeCulling && SOCore::ComputeConeCullingOrigin(ToCoreMatrix(LocalToRelativeWorld), LocalViewOrigin);
 
-static bool TestFrontface(const FScreenTriangle& Tri)
-{
-	if ((Tri.V[2].X - Tri.V[0].X) * (Tri.V[1].Y - Tri.V[0].Y) >= (Tri.V[2].Y - Tri.V[0].Y) * (Tri.V[1].X - Tri.V[0].X))
+		SOCore::AddOccluderMeshlets(Kernels, ToCoreMeshView(*Mesh.Data), ToCoreMatrix(LocalToRelativeWorld * RelativeViewProj), bConeCulling ? &LocalViewOrigin : nullptr,
+		                            W_CLIP, ClipVertexBuffer, ClipVertexFlagsBuffer, OutData);
+	}
+
+	for (const FMatrix& BoxToWorld : SceneData.OccluderBoxes)
 	{
-		return false;
+		FMatrix BoxToRelativeWorld = BoxToWorld;
+		BoxToRelativeWorld.SetOrigin(BoxToWorld.GetOrigin() - SceneData.ViewOrigin);
+		SOCore::AddOccluderBox(Kernels, ToCoreMatrix(BoxToRelativeWorld * RelativeViewProj), W_CLIP, ClipVertexBuffer, ClipVertexFlagsBuffer, OutData);
 	}
-	return true;
 }
 
-inline bool AddTriangle(FScreenTriangle& Tri, float TriDepth, const FPrimitiveComponentId PrimitiveId, const uint8 MeshFlags, FOcclusionFrameData& InData)
+class FSWOccluderElementsCollector
 {
-	if (MeshFlags == 1) // occluder tri
+public:
+	explicit FSWOccluderElementsCollector(FOcclusionSceneData& InData) : SceneData(InData)
 	{
-		// Sort vertices by Y, assumed in rasterization
-		if (Tri.V[0].Y > Tri.V[1].Y) Swap(Tri.V[0], Tri.V[1]);
-		if (Tri.V[1].Y > Tri.V[2].Y) Swap(Tri.V[1], Tri.V[2]);
-		if (Tri.V[0].Y > Tri.V[1].Y) Swap(Tri.V[0], Tri.V[1]);
-
-		if (Tri.V[0].Y >= FRAMEBUFFER_HEIGHT || Tri.V[2].Y < 0)
-		{
-			return false;
-		}
+		SceneData.NumOccluderTriangles = 0;
 	}
 
-	const int32 TriangleID = InData.ScreenTriangles.Add(Tri);
-	InData.ScreenTrianglesPrimID.Add(PrimitiveId);
-	InData.ScreenTrianglesFlags.Add(MeshFlags);
-
-	// bin
-	const int32 MinX = FMath::Min3(Tri.V[0].X, Tri.V[1].X, Tri.V[2].X) / BIN_WIDTH;
-	const int32 MaxX = FMath::Max3(Tri.V[0].X, Tri.V[1].X, Tri.V[2].X) / BIN_WIDTH;
-	const int32 BinMin = FMath::Max(MinX, 0);
-	const int32 BinMax = FMath::Min(MaxX, BIN_NUM - 1);
-
-	FSortedIndexDepth SortedIndexDepth;
-	SortedIndexDepth.Index = TriangleID;
-	SortedIndexDepth.Depth = TriDepth;
-
-	for (int32 BinIdx = BinMin; BinIdx <= BinMax; ++BinIdx)
+	void SetPrimitiveID(FPrimitiveComponentId PrimitiveId)
 	{
-		InData.SortedTriangles[BinIdx].Add(SortedIndexDepth);
+		CurrentPrimitiveId = PrimitiveId;
 	}
 
-	return true;
-}
-
-static const VectorRegister vFramebufferBounds = MakeVectorRegister(FRAMEBUFFER_WIDTH - 1, FRAMEBUFFER_HEIGHT - 1, 1.0f, 1.0f);
-static const VectorRegister vXYHalf = MakeVectorRegister(0.5f, 0.5f, 0.0f, 0.0f);
-
-// BEGIN Intel
-static const int32 NUM_CUBE_VTX = 8;
-// 0 = min corner, 1 = max corner
-static const uint32 sBBxInd[NUM_CUBE_VTX] = { 1, 0, 0, 1, 1, 1, 0, 0 };
-static const uint32 sBByInd[NUM_CUBE_VTX] = { 1, 1, 1, 1, 0, 0, 0, 0 };
-static const uint32 sBBzInd[NUM_CUBE_VTX] = { 1, 1, 0, 0, 0, 1, 1, 0 };
-// END Intel
-
-static void ProcessOccludeeGeomSIMD(const FMatrix& InMat, const FVector* InMinMax, int32 Num, int32* RESTRICT OutQuads, float* RESTRICT OutQuadDepth, int32* RESTRICT OutQuadClipped)
-{
-	const float W_CLIP = InMat.M[3][2];
-	const VectorRegister vClippingW = VectorLoadFloat1(&W_CLIP);
-	const VectorRegister mRow0 = VectorLoadAligned(InMat.M[0]);
-	const VectorRegister mRow1 = VectorLoadAligned(InMat.M[1]);
-	const VectorRegister mRow2 = VectorLoadAligned(InMat.M[2]);
-	const VectorRegister mRow3 = VectorLoadAligned(InMat.M[3]);
-	VectorRegister xRow[2], yRow[2], zRow[2];
-
-	for (int32 k = 0; k < Num; ++k)
+	void AddElements(const TSharedPtr<const FOccluderMeshData>& OccluderData, const FMatrix& LocalToWorld) const
 	{
-		FVector BoxMin = *(InMinMax++);
-		FVector BoxMax = *(InMinMax++);
-
-		// BEGIN Intel
-				// Project primitive bounding box to screen
-		xRow[0] = VectorMultiply(VectorLoadFloat1(&BoxMin.X), mRow0);
-		xRow[1] = VectorMultiply(VectorLoadFloat1(&BoxMax.X), mRow0);
-		yRow[0] = VectorMultiply(VectorLoadFloat1(&BoxMin.Y), mRow1);
-		yRow[1] = VectorMultiply(VectorLoadFloat1(&BoxMax.Y), mRow1);
-		zRow[0] = VectorMultiply(VectorLoadFloat1(&BoxMin.Z), mRow2);
-		zRow[1] = VectorMultiply(VectorLoadFloat1(&BoxMax.Z), mRow2);
-
-		VectorRegister vClippedFlag = VectorZero();
-		VectorRegister vScreenMin = GlobalVectorConstants::BigNumber;
-		VectorRegister vScreenMax = VectorNegate(vScreenMin);
-
-		for (int32 i = 0; i < NUM_CUBE_VTX; ++i)
+		for (const FMatrix& BoxToLocal : OccluderData->Boxes)
 		{
-			VectorRegister V;
-			V = VectorAdd(mRow3, xRow[sBBxInd[i]]);
-			V = VectorAdd(V, yRow[sBByInd[i]]);
-			V = VectorAdd(V, zRow[sBBzInd[i]]);
-
-			VectorRegister W = VectorReplicate(V, 3);
-			vClippedFlag = VectorBitwiseOr(vClippedFlag, VectorCompareLT(W, vClippingW));
-			V = VectorDivide(V, W);
-
-			vScreenMin = VectorMin(vScreenMin, V);
-			vScreenMax = VectorMax(vScreenMax, V);
+			AddBox(BoxToLocal * LocalToWorld);
 		}
-		// END Intel
 
-				// For pixel snapping
-		vScreenMin = VectorAdd(vScreenMin, vXYHalf);
-		vScreenMax = VectorAdd(vScreenMax, vXYHalf);
-
-		// Clip against screen rect
-		vScreenMin = VectorMax(vScreenMin, VectorZero());
-		vScreenMax = VectorMin(vScreenMax, vFramebufferBounds); // Z should be unaffected
+		if (OccluderData->Indices.IsEmpty())
+		{
+			return;
+		}
 
-		// Make: MinX, MinY, MaxX, MaxY
-		const VectorRegister4Int IntMinMax = VectorFloatToInt(VectorCombineLow(vScreenMin, vScreenMax));
+		SceneData.OccluderData.AddDefaulted();
+		FOcclusionMeshData& MeshData = SceneData.OccluderData.Last();
 
-		// Store
-		VectorIntStoreAligned(IntMinMax, OutQuads);
-		VectorStoreFloat1(vClippedFlag, OutQuadClipped);
-		*OutQuadDepth = VectorGetComponent(vScreenMax, 2);
+		MeshData.PrimId = CurrentPrimitiveId;
+		MeshData.LocalToWorld = LocalToWorld;
+		MeshData.Data = OccluderData;
 
-		OutQuads += 4;
-		OutQuadDepth++;
-		OutQuadClipped++;
+		SceneData.NumOccluderTriangles += OccluderData->Indices.Num() / 3;
 	}
-}
 
-static void ProcessOccludeeGeomScalar(const FMatrix& InMat, const FVector* InMinMax, int32 Num, int32* RESTRICT OutQuads, float* RESTRICT OutQuadDepth, int32* RESTRICT OutQuadClipped)
-{
-	const float W_CLIP = InMat.M[3][2];
-	FVector4 AX = FVector4(InMat.M[0][0], InMat.M[0][1], InMat.M[0][2], InMat.M[0][3]);
-	FVector4 AY = FVector4(InMat.M[1][0], InMat.M[1][1], InMat.M[1][2], InMat.M[1][3]);
-	FVector4 AZ = FVector4(InMat.M[2][0], InMat.M[2][1], InMat.M[2][2], InMat.M[2][3]);
-	FVector4 AW = FVector4(InMat.M[3][0], InMat.M[3][1], InMat.M[3][2], InMat.M[3][3]);
-	FVector4 xRow[2], yRow[2], zRow[2];
-
-	for (int32 k = 0; k < Num; ++k)
+	void AddBox(const FMatrix& BoxToWorld) const
 	{
-		FVector BoxMin = *(InMinMax++);
-		FVector BoxMax = *(InMinMax++);
-		// Project primitive bounding box to screen
-		xRow[0] = FVector4(BoxMin.X, BoxMin.X, BoxMin.X, BoxMin.X) * AX;
-		xRow[1] = FVector4(BoxMax.X, BoxMax.X, BoxMax.X, BoxMax.X) * AX;
-		yRow[0] = FVector4(BoxMin.Y, BoxMin.Y, BoxMin.Y, BoxMin.Y) * AY;
-		yRow[1] = FVector4(BoxMax.Y, BoxMax.Y, BoxMax.Y, BoxMax.Y) * AY;
-		zRow[0] = FVector4(BoxMin.Z, BoxMin.Z, BoxMin.Z, BoxMin.Z) * AZ;
-		zRow[1] = FVector4(BoxMax.Z, BoxMax.Z, BoxMax.Z, BoxMax.Z) * AZ;
-
-		FVector2D MinXY = FVector2D(MAX_flt, MAX_flt);
-		FVector2D MaxXY = FVector2D(-MAX_flt, -MAX_flt);
-		float Depth = 0.f;
-		bool bClippedNear = false;
-
-		for (int32 i = 0; i < NUM_CUBE_VTX; i++)
-		{
-			FVector4 V = AW;
-			V = V + xRow[sBBxInd[i]];
-			V = V + yRow[sBByInd[i]];
-			V = V + zRow[sBBzInd[i]];
-
-			if (V.W < W_CLIP)
-			{
-				bClippedNear = true;
-				break;
-			}
-
-			V = V / V.W;
-
-			MinXY.X = FMath::Min(MinXY.X, V.X);
-			MinXY.Y = FMath::Min(MinXY.Y, V.Y);
-			MaxXY.X = FMath::Max(MaxXY.X, V.X);
-			MaxXY.Y = FMath::Max(MaxXY.Y, V.Y);
-			Depth = FMath::Max(Depth, V.Z);
-		}
-
-		if (bClippedNear)
-		{
-			OutQuadClipped[0] = 1;
-		}
-		else
-		{
-			// For pixel snapping
-			MinXY = MinXY + FVector2D(0.5f, 0.5f);
-			MaxXY = MaxXY + FVector2D(0.5f, 0.5f);
-
-			// Clip against screen rect
-			MinXY.X = FMath::Max(0.f, MinXY.X);
-			MinXY.Y = FMath::Max(0.f, MinXY.Y);
-			MaxXY.X = FMath::Min(FRAMEBUFFER_WIDTH - 1.f, MaxXY.X);
-			MaxXY.Y = FMath::Min(FRAMEBUFFER_HEIGHT - 1.f, MaxXY.Y);
-
-			// Make MinX, MinY, MaxX, MaxY
-			OutQuads[0] = static_cast<int32>(MinXY.X);
-			OutQuads[1] = static_cast<int32>(MinXY.Y);
-			OutQuads[2] = static_cast<int32>(MaxXY.X);
-			OutQuads[3] = static_cast<int32>(MaxXY.Y);
-
-			OutQuadDepth[0] = Depth;
-			OutQuadClipped[0] = 0;
-		}
+		SceneData.OccluderBoxes.Add(BoxToWorld);
 
-		OutQuads += 4;
-		OutQuadDepth++;
-		OutQuadClipped++;
+		// Worst case, when the box is near clipped and rasterized as a cube mesh
+		SceneData.NumOccluderTriangles += static_cast<int32>(SOCore::GetUnitCubeMesh().Indices.size() / 3);
 	}
-}
 
-const FMatrix FramebufferMat(
-	FVector(0.5f * static_cast<float>(FRAMEBUFFER_WIDTH), 0.0f, 0.0f),
-	FVector(0.0f, 0.5f * static_cast<float>(FRAMEBUFFER_HEIGHT), 0.0f),
-	FVector(0.0f, 0.0f, 1.0f),
-	FVector(0.5f * static_cast<float>(FRAMEBUFFER_WIDTH), 0.5f * static_cast<float>(FRAMEBUFFER_HEIGHT), 0.0f)
-);
+public:
+	FOcclusionSceneData& SceneData;
+	FPrimitiveComponentId CurrentPrimitiveId;
+};
 
-static bool ProcessOccludeeGeom(const FOcclusionSceneData& SceneData, FOcclusionFrameData& FrameData, TMap<FPrimitiveComponentId, bool>& VisibilityMap)
+// Triangles binned in every framebuffer column and the fraction of its pixels covered by occluders
+static void TraceBinCounters(const SOCore::FFrameData& FrameData, const SOCore::FCoverageBuffer& Coverage)
 {
-	constexpr int32 RUN_SIZE = 512;
-	const bool bUseSIMD = GSOSIMD != 0;
-
-	const int32 NumBoxes = SceneData.OccludeeBoxMinMax.Num() / 2;
-	const FVector* MinMax = SceneData.OccludeeBoxMinMax.GetData();
-	const FPrimitiveComponentId* PrimIds = SceneData.OccludeeBoxPrimId.GetData();
-
-	const FMatrix WorldToFB = SceneData.ViewProj * FramebufferMat;
-
-	// on stack mem for each run output
-	MS_ALIGN(SIMD_ALIGNMENT) int32 Quads[RUN_SIZE * 4] GCC_ALIGN(SIMD_ALIGNMENT);
-
-	const int32 NumRuns = NumBoxes / RUN_SIZE + 1;
-	int32 NumBoxesProcessed = 0;
-
-	for (int32 RunIdx = 0; RunIdx < NumRuns; ++RunIdx)
+#if COUNTERSTRACE_ENABLED
+	int64 Triangles[BIN_NUM];
+	double Occupancy[BIN_NUM];
+	for (int32 BinIdx = 0; BinIdx < BIN_NUM; ++BinIdx)
 	{
-		float QuadDepths[RUN_SIZE];
-		int32 QuadClipFlags[RUN_SIZE];
-		const int32 RunSize = FMath::Min(NumBoxes - NumBoxesProcessed, RUN_SIZE);
-
-		// Generate quads
-		if (bUseSIMD)
-		{
-			ProcessOccludeeGeomSIMD(WorldToFB, MinMax, RunSize, Quads, QuadDepths, QuadClipFlags);
-		}
-		else
-		{
-			ProcessOccludeeGeomScalar(WorldToFB, MinMax, RunSize, Quads, QuadDepths, QuadClipFlags);
-		}
-
-		// Triangulate generated quads
-		int32 QuadIdx = 0;
-		for (int32 i = 0; i < RunSize; ++i)
+		int32 NumCovered = 0;
+		for (const uint64 Row : Coverage.Bins[BinIdx])
 		{
-			const int32 MinX = Quads[QuadIdx++];
-			const int32 MinY = Quads[QuadIdx++];
-			const int32 MaxX = Quads[QuadIdx++];
-			const int32 MaxY = Quads[QuadIdx++];
-
-			FPrimitiveComponentId PrimitiveId = PrimIds[i];
-
-			if (QuadClipFlags[i] != 0)
-			{
-				// clipped by near plane, visible
-				VisibilityMap.FindOrAdd(PrimitiveId) = true;
-				continue;
-			}
-
-			// Check MinX <= MaxX and MinY <= MaxY
-			if (MinX > MaxX || MinY > MaxY)
-			{
-				// Do not rasterize if not on screen, occluded
-				VisibilityMap.FindOrAdd(PrimitiveId) = false;
-				continue;
-			}
-
-			float Depth = QuadDepths[i];
-
-			// add only first tri, rasterizer will figure out to render a quad
-			FScreenTriangle ST;
-			ST.V[0] = { MinX, MinY };
-			ST.V[1] = { MaxX, MaxY };
-			ST.V[2] = { MinX, MaxY };
-			AddTriangle(ST, Depth, PrimitiveId, 0, FrameData);
+			NumCovered += FMath::CountBits(Row);
 		}
+		Triangles[BinIdx] = static_cast<int64>(FrameData.SortedTriangles[BinIdx].size());
+		Occupancy[BinIdx] = static_cast<double>(NumCovered) / (BIN_WIDTH * FRAMEBUFFER_HEIGHT);
+	}
 
-		MinMax += (RunSize * 2);
-		PrimIds += RunSize;
-		NumBoxesProcessed += RunSize;
-
-	} // for each run
-
-	return true;
-}
-
-static void CollectOccludeeGeom(const FBoxSphereBounds& Bounds, FPrimitiveComponentId PrimitiveId, FOcclusionSceneData& SceneData)
-{
-	const FBox Box = Bounds.GetBox();
-
-	SceneData.OccludeeBoxMinMax.Add(Box.Min);
-	SceneData.OccludeeBoxMinMax.Add(Box.Max);
-	SceneData.OccludeeBoxPrimId.Add(PrimitiveId);
+	TRACE_COUNTER_SET(SOBin0Triangles, Triangles[0]);
+	TRACE_COUNTER_SET(SOBin1Triangles, Triangles[1]);
+	TRACE_COUNTER_SET(SOBin2Triangles, Triangles[2]);
+	TRACE_COUNTER_SET(SOBin3Triangles, Triangles[3]);
+	TRACE_COUNTER_SET(SOBin4Triangles, Triangles[4]);
+	TRACE_COUNTER_SET(SOBin5Triangles, Triangles[5]);
+	TRACE_COUNTER_SET(SOBin0Coverage, Occupancy[0]);
+	TRACE_COUNTER_SET(SOBin1Coverage, Occupancy[1]);
+	TRACE_COUNTER_SET(SOBin2Coverage, Occupancy[2]);
+	TRACE_COUNTER_SET(SOBin3Coverage, Occupancy[3]);
+	TRACE_COUNTER_SET(SOBin4Coverage, Occupancy[4]);
+	TRACE_COUNTER_SET(SOBin5Coverage, Occupancy[5]);
+#endif
 }
 
-static bool ClippedVertexToScreen(const FVector4& XFV, FScreenPosition& OutSP, float& OutDepth)
+static void ProcessOcclusionFrame(const FOcclusionSceneData InSceneData, FOcclusionFrameResults& OutResults)
 {
-	checkSlow(XFV.W >= 0.f);
+	SO_TRACE_SCOPE(SoftwareOcclusion_ProcessFrame);
 
-	const FVector4 FSP = XFV / XFV.W;
-	const int32 X = FMath::RoundToInt((FSP.X + 1.f) * FRAMEBUFFER_WIDTH / 2.0);
-	const int32 Y = FMath::RoundToInt((FSP.Y + 1.f) * FRAMEBUFFER_HEIGHT / 2.0);
+	SOCore::FFrameData FrameData;
+	const int32 NumOccludees = InSceneData.OccludeeBoxPrimId.Num();
+	const int32 NumExpectedTriangles = InSceneData.NumOccluderTriangles + NumOccludees; // one triangle for each occludee
+	FrameData.ReserveBuffers(NumExpectedTriangles);
 
-	OutSP.X = X;
-	OutSP.Y = Y;
-	OutDepth = FSP.Z;
-	return false;
-}
+	// Occluded by default, set when near clipped or when any of the occludee quad pixels passes
+	TArray<uint8> OccludeeVisibility;
+	OccludeeVisibility.SetNumZeroed(NumOccludees);
 
-static uint8 ProcessXFormVertex(const FVector4& XFV, float W_CLIP)
-{
-	uint8 Flags = 0;
-	float W = XFV.W;
+	const bool bDebugOccludeeQuads = GSODebugOccludeeQuads != 0;
 
-	if (W < W_CLIP)
 	{
-		Flags |= EScreenVertexFlags::ClippedNear;
+		SCOPE_CYCLE_COUNTER(STAT_SoftwareOcclusionProcessOccluder)
+		SO_TRACE_SCOPE(SoftwareOcclusion_ProcessOccluders);
+			ProcessOccluderGeom(InSceneData, FrameData);
 	}
 
-	if (XFV.X < -W)
 	{
-		Flags |= EScreenVertexFlags::ClippedLeft;
+		SCOPE_CYCLE_COUNTER(STAT_SoftwareOcclusionProcessOccludee)
+		SO_TRACE_SCOPE(SoftwareOcclusion_ProcessOccludees);
+			// Generate screen quads from all collected occludee bboxes
+			ProcessOccludeeGeom(InSceneData, FrameData, OccludeeVisibility, bDebugOccludeeQuads ? &OutResults.DebugOccludeeQuads : nullptr);
 	}
 
-	if (XFV.X > W)
 	{
-		Flags |= EScreenVertexFlags::ClippedRight;
+		SCOPE_CYCLE_COUNTER(STAT_SoftwareOcclusionSort);
+		SO_TRACE_SCOPE(SoftwareOcclusion_Sort);
+		SOCore::SortFrame(FrameData);
 	}
 
-	if (XFV.Y < -W)
+	SOCore::FRasterStats RasterStats;
 	{
-		Flags |= EScreenVertexFlags::ClippedTop;
+		SCOPE_CYCLE_COUNTER(STAT_SoftwareOcclusionRasterize);
+		SO_TRACE_SCOPE(SoftwareOcclusion_Rasterize);
+
+		SOCore::FCoverageBuffer Coverage;
+		TUniquePtr<SOCore::FCoverageDepth> CoverageDepth = InSceneData.bRecordVisibilitySnapshot ? MakeUnique<SOCore::FCoverageDepth>() : nullptr;
+		RasterStats = SOCore::RasterizeSortedFrame(FrameData, Coverage, OccludeeVisibility.GetData(), CoverageDepth.Get());
+		for (int32 BinIdx = 0; BinIdx < BIN_NUM; ++BinIdx)
+		{
+			FMemory::Memcpy(OutResults.Bins[BinIdx].Data, Coverage.Bins[BinIdx], sizeof(OutResults.Bins[BinIdx].Data));
+		}
+		TraceBinCounters(FrameData, Coverage);
+
+		if (CoverageDepth)
+		{
+			OutResults.VisibilitySnapshot = MakeShared<FOcclusionVisibilitySnapshot, ESPMode::ThreadSafe>(
+				InSceneData.ViewProj, InSceneData.ViewOrigin, OutResults.GatherFrameNumber, MakeUnique<SOCore::FCoverageBuffer>(Coverage), MoveTemp(CoverageDepth));
+		}
 	}
 
-	if (XFV.Y > W)
+	if (bDebugOccludeeQuads)
 	{
-		Flags |= EScreenVertexFlags::ClippedBottom;
+		OutResults.DebugOccludeeVisibility = OccludeeVisibility;
 	}
 
-	return Flags;
-}
-
-static void ProcessOccluderGeom(const FOcclusionSceneData& SceneData, FOcclusionFrameData& OutData)
-{
-	const float W_CLIP = SceneData.ViewProj.M[3][2];
-
-	const int32 NumMeshes = SceneData.OccluderData.Num();
-
-	TArray<FVector4>	ClipVertexBuffer;
-	TArray<uint8>		ClipVertexFlagsBuffer;
-
-	for (int32 MeshIdx = 0; MeshIdx < NumMeshes; ++MeshIdx)
+	// Resolve occludee boxes into primitive and instance visibility
 	{
-		const FOcclusionMeshData& Mesh = SceneData.OccluderData[MeshIdx];
-		int32 NumVtx = Mesh.Data.Vertices.Num();
-
-		ClipVertexBuffer.SetNumUninitialized(NumVtx, EAllowShrinking::Yes);
-		ClipVertexFlagsBuffer.SetNumUninitialized(NumVtx, EAllowShrinking::Yes);
-
-		const FVector* MeshVertices = Mesh.Data.Vertices.GetData();
-		FVector4* MeshClipVertices = ClipVertexBuffer.GetData();
-		uint8* MeshClipVertexFlags = ClipVertexFlagsBuffer.GetData();
-
-		// Transform mesh to clip space
-		{
-			const FMatrix LocalToClip = Mesh.LocalToWorld * SceneData.ViewProj;
-			VectorRegister mRow0 = VectorLoadAligned(LocalToClip.M[0]);
-			VectorRegister mRow1 = VectorLoadAligned(LocalToClip.M[1]);
-			VectorRegister mRow2 = VectorLoadAligned(LocalToClip.M[2]);
-			VectorRegister mRow3 = VectorLoadAligned(LocalToClip.M[3]);
-
-			for (int32 i = 0; i < NumVtx; ++i)
-			{
-				VectorRegister VTempX = VectorLoadFloat1(&MeshVertices[i].X);
-				VectorRegister VTempY = VectorLoadFloat1(&MeshVertices[i].Y);
-				VectorRegister VTempZ = VectorLoadFloat1(&MeshVertices[i].Z);
-				VectorRegister VTempW;
-				// Mul by the matrix
-				VTempX = VectorMultiply(VTempX, mRow0);
-				VTempY = VectorMultiply(VTempY, mRow1);
-				VTempZ = VectorMultiply(VTempZ, mRow2);
-				VTempW = VectorMultiply(GlobalVectorConstants::FloatOne, mRow3);
-				// Add them all together
-				VTempX = VectorAdd(VTempX, VTempY);
-				VTempZ = VectorAdd(VTempZ, VTempW);
-				VTempX = VectorAdd(VTempX, VTempZ);
-				// Store
-				VectorStoreAligned(VTempX, &MeshClipVertices[i]);
-
-				uint8 VertexFlags = ProcessXFormVertex(MeshClipVertices[i], W_CLIP);
-				MeshClipVertexFlags[i] = VertexFlags;
-			}
-		}
+		SO_TRACE_SCOPE(SoftwareOcclusion_ResolveVisibility);
+		const FPrimitiveComponentId* PrimitiveIds = InSceneData.OccludeeBoxPrimId.GetData();
+		const int32* InstanceIndices = InSceneData.OccludeeBoxInstanceIdx.GetData();
 
-		const uint16* MeshIndices = Mesh.Data.Indices.GetData();
-		int32 NumTris = Mesh.Data.Indices.Num() / 3;
+		OutResults.VisibilityMap.Reserve(NumOccludees);
+		FPrimitiveComponentId LastInstancedPrimId;
+		TBitArray<>* InstanceVisibility = nullptr;
 
-		// Create triangles
-		for (int32 i = 0; i < NumTris; ++i)
+		for (int32 OccludeeIdx = 0; OccludeeIdx < NumOccludees; ++OccludeeIdx)
 		{
-			uint16 I0 = MeshIndices[i * 3 + 0];
-			uint16 I1 = MeshIndices[i * 3 + 1];
-			uint16 I2 = MeshIndices[i * 3 + 2];
-
-			uint8 F0 = MeshClipVertexFlags[I0];
-			uint8 F1 = MeshClipVertexFlags[I1];
-			uint8 F2 = MeshClipVertexFlags[I2];
+			const bool bVisible = OccludeeVisibility[OccludeeIdx] != 0;
+			const FPrimitiveComponentId PrimitiveId = PrimitiveIds[OccludeeIdx];
+			const int32 InstanceIdx = InstanceIndices[OccludeeIdx];
 
-			if ((F0 & F1) & F2)
+			if (InstanceIdx == INDEX_NONE)
 			{
-				// fully clipped
+				OutResults.VisibilityMap.Add(PrimitiveId, bVisible);
 				continue;
 			}
-			
-			const uint16 V[3] =
-			{
-				I0,
-				I1,
-				I2
-			};
 
-			if (uint8 TriFlags = F0 | F1 | F2; TriFlags & EScreenVertexFlags::ClippedNear)
+			// Instances of a primitive are collected contiguously
+			if (!InstanceVisibility || LastInstancedPrimId.PrimIDValue != PrimitiveId.PrimIDValue)
 			{
-				static constexpr int32 Edges[3][2] = { {0,1}, {1,2}, {2,0} };
-				FVector4 ClippedPos[4];
-				int32 NumPos = 0;
-
-				for (int32 EdgeIdx = 0; EdgeIdx < 3; EdgeIdx++)
-				{
-					int32 i0 = Edges[EdgeIdx][0];
-					int32 i1 = Edges[EdgeIdx][1];
-
-					if (!ClipVertexBuffer.IsValidIndex(V[i0])
-						|| !ClipVertexBuffer.IsValidIndex(V[i1]))
-					{
-						continue;
-					}
-					
-					bool dot0 = MeshClipVertices[V[i0]].W < W_CLIP;
-					bool dot1 = MeshClipVertices[V[i1]].W < W_CLIP;
-
-					if (!dot0)
-					{
-						ClippedPos[NumPos] = MeshClipVertices[V[i0]];
-						NumPos++;
-					}
-
-					if (dot0 != dot1)
-					{
-						float t = (W_CLIP - MeshClipVertices[V[i0]].W) / (MeshClipVertices[V[i0]].W - MeshClipVertices[V[i1]].W);
-						ClippedPos[NumPos] = MeshClipVertices[V[i0]] + t * (MeshClipVertices[V[i0]] - MeshClipVertices[V[i1]]);
-						NumPos++;
-					}
-				}
-
-				// triangulate clipped vertices
-				for (int32 j = 2; j < NumPos; j++)
-				{
-					FScreenTriangle Tri;
-					float Depths[3];
-					bool bShouldDiscard = false;
-
-					bShouldDiscard |= ClippedVertexToScreen(ClippedPos[0], Tri.V[0], Depths[0]);
-					bShouldDiscard |= ClippedVertexToScreen(ClippedPos[j - 1], Tri.V[1], Depths[1]);
-					bShouldDiscard |= ClippedVertexToScreen(ClippedPos[j], Tri.V[2], Depths[2]);
-
-					if (!bShouldDiscard && TestFrontface(Tri))
-					{
-						// Min tri depth for occluder (further from screen)
-						float TriDepth = FMath::Min3(Depths[0], Depths[1], Depths[2]);
-						AddTriangle(Tri, TriDepth, Mesh.PrimId, 1, OutData);
-					}
-				}
+				LastInstancedPrimId = PrimitiveId;
+				InstanceVisibility = &OutResults.InstanceVisibilityMap.FindOrAdd(PrimitiveId);
 			}
-			else
+
+			if (InstanceVisibility->Num() <= InstanceIdx)
 			{
-				FScreenTriangle Tri;
-				float Depths[3];
-				bool bShouldDiscard = false;
-
-				for (int32 j = 0; j < 3 && !bShouldDiscard; ++j)
-				{
-					if (ClipVertexBuffer.IsValidIndex(V[j]))
-					{
-						bShouldDiscard |= ClippedVertexToScreen(MeshClipVertices[V[j]], Tri.V[j], Depths[j]);
-					}
-					else
-					{
-						bShouldDiscard |= true;						
-					}
-				}
-
-				if (!bShouldDiscard && TestFrontface(Tri))
-				{
-					// Min tri depth for occluder (further from screen)
-					float TriDepth = FMath::Min3(Depths[0], Depths[1], Depths[2]);
-					AddTriangle(Tri, TriDepth, Mesh.PrimId, /*MeshFlags*/ 1, OutData);
-				}
+				// Instances that were not tested stay visible
+				InstanceVisibility->Add(true, InstanceIdx + 1 - InstanceVisibility->Num());
 			}
-		} // for each triangle
-	}// for each mesh
+			(*InstanceVisibility)[InstanceIdx] = bVisible;
+
+			bool& bAnyInstanceVisible = OutResults.VisibilityMap.FindOrAdd(PrimitiveId, false);
+			bAnyInstanceVisible |= bVisible;
+		}
+	}
+
+	const int32 NumTotalTris = static_cast<int32>(FrameData.ScreenTriangles.size());
+	INC_DWORD_STAT_BY(STAT_SoftwareTriangles, NumTotalTris);
+	INC_DWORD_STAT_BY(STAT_SoftwareOccluderTris, RasterStats.NumOccluderTriangles);
+	INC_DWORD_STAT_BY(STAT_SoftwareOccludeeTris, RasterStats.NumOccludeeTriangles);
+	OutResults.NumOccluderTriangles = RasterStats.NumOccluderTriangles;
+	TRACE_COUNTER_SET(SOScreenTriangles, NumTotalTris);
+	TRACE_COUNTER_SET(SOOccluderTriangles, RasterStats.NumOccluderTriangles);
+	TRACE_COUNTER_SET(SOOccludeeTriangles, RasterStats.NumOccludeeTriangles);
 }
 
-class FSWOccluderElementsCollector
+/** Converts the scene data to the camera relative core scene, meshes shared by several occluders are stored once */
+static void ToCoreScene(const FOcclusionSceneData& SceneData, SOCore::FScene& OutScene)
 {
-public:
-	explicit FSWOccluderElementsCollector(FOcclusionSceneData& InData) : SceneData(InData)
-	{
-		SceneData.NumOccluderTriangles = 0;
-	}
+	OutScene = SOCore::FScene();
+	OutScene.ViewProj = ToCoreMatrix(FTranslationMatrix::Make(SceneData.ViewOrigin) * SceneData.ViewProj);
 
-	void SetPrimitiveID(FPrimitiveComponentId PrimitiveId)
+	TMap<const FOccluderMeshData*, int32> MeshIndices;
+	for (const FOcclusionMeshData& Mesh : SceneData.OccluderData)
 	{
-		CurrentPrimitiveId = PrimitiveId;
+		const FOccluderMeshData& MeshData = *Mesh.Data;
+		int32& MeshIndex = MeshIndices.FindOrAdd(&MeshData, INDEX_NONE);
+		if (MeshIndex == INDEX_NONE)
+		{
+			MeshIndex = static_cast<int32>(OutScene.Meshes.size());
+			SOCore::FOccluderMesh& CoreMesh = OutScene.Meshes.emplace_back();
+
+			// Stored as rendered, quantized and split in meshlets with their normal cones
+			const SOCore::FOccluderMeshView View = ToCoreMeshView(MeshData);
+			CoreMesh.Vertices.assign(View.Vertices, View.Vertices + View.NumVertices);
+			CoreMesh.Indices.assign(View.Indices, View.Indices + View.NumIndices);
+			CoreMesh.Meshlets.assign(View.Meshlets, View.Meshlets + View.NumMeshlets);
+			CoreMesh.QuantizationOffset = View.QuantizationOffset;
+			CoreMesh.QuantizationScale = View.QuantizationScale;
+		}
+
+		FMatrix LocalToRelativeWorld = Mesh.LocalToWorld;
+		LocalToRelativeWorld.SetOrigin(Mesh.LocalToWorld.GetOrigin() - SceneData.ViewOrigin);
+		OutScene.Occluders.push_back({ MeshIndex, ToCoreMatrix(LocalToRelativeWorld) });
 	}
 
-	void AddElements(const TArray<FVector>& Vertices, const TArray<uint16>& Indices, const FMatrix& LocalToWorld) const
+	for (const FMatrix& BoxToWorld : SceneData.OccluderBoxes)
 	{
-		SceneData.OccluderData.AddDefaulted();
-		FOcclusionMeshData& MeshData = SceneData.OccluderData.Last();
-
-		MeshData.PrimId = CurrentPrimitiveId;
-		MeshData.LocalToWorld = LocalToWorld;
-		MeshData.Data.Vertices = Vertices;
-		MeshData.Data.Indices = Indices;
-
-		SceneData.NumOccluderTriangles += Indices.Num() / 3;
+		FMatrix BoxToRelativeWorld = BoxToWorld;
+		BoxToRelativeWorld.SetOrigin(BoxToWorld.GetOrigin() - SceneData.ViewOrigin);
+		OutScene.OccluderBoxes.push_back(ToCoreMatrix(BoxToRelativeWorld));
 	}
 
-public:
-	FOcclusionSceneData& SceneData;
-	FPrimitiveComponentId CurrentPrimitiveId;
-};
-
-static void ProcessOcclusionFrame(const FOcclusionSceneData InSceneData, FOcclusionFrameResults& OutResults)
-{
-	FOcclusionFrameData FrameData;
-	const int32 NumExpectedTriangles = InSceneData.NumOccluderTriangles + InSceneData.OccludeeBoxPrimId.Num(); // one triangle for each occludee
-	FrameData.ReserveBuffers(NumExpectedTriangles);
-
+	OutScene.OccludeeBoxMinMax.reserve(SceneData.OccludeeBoxMinMax.Num());
+	for (const FVector& Corner : SceneData.OccludeeBoxMinMax)
 	{
-		SCOPE_CYCLE_COUNTER(STAT_SoftwareOcclusionProcessOccluder)
-			ProcessOccluderGeom(InSceneData, FrameData);
+		const FVector3f RelativeCorner(Corner - SceneData.ViewOrigin);
+		OutScene.OccludeeBoxMinMax.push_back({ RelativeCorner.X, RelativeCorner.Y, RelativeCorner.Z });
 	}
-
+	for (const FPrimitiveComponentId& PrimitiveId : SceneData.OccludeeBoxPrimId)
 	{
-		SCOPE_CYCLE_COUNTER(STAT_SoftwareOcclusionProcessOccludee)
-			// Generate screen quads from all collected occludee bboxes
-			ProcessOccludeeGeom(InSceneData, FrameData, OutResults.VisibilityMap);
+		OutScene.OccludeeIds.push_back(PrimitiveId.PrimIDValue);
 	}
+	OutScene.OccludeeInstanceIndices.assign(SceneData.OccludeeBoxInstanceIdx.GetData(), SceneData.OccludeeBoxInstanceIdx.GetData() + SceneData.OccludeeBoxInstanceIdx.Num());
+}
 
-	int32 NumRasterizedOccluderTris = 0;
-	int32 NumRasterizedOccludeeTris = 0;
-	{
-		SCOPE_CYCLE_COUNTER(STAT_SoftwareOcclusionRasterize);
+/** Writes the scene data to Saved/Profiling/SoftwareOcclusion, to be replayed with the OcclusionReplay tool. Returns the file path, empty on failure. */
+static FString SaveSceneCapture(const FOcclusionSceneData& SceneData, const FString& FileName)
+{
+	SOCore::FScene Scene;
+	ToCoreScene(SceneData, Scene);
 
-		const uint8* MeshFlags = FrameData.ScreenTrianglesFlags.GetData();
-		const FPrimitiveComponentId* PrimitiveIds = FrameData.ScreenTrianglesPrimID.GetData();
-		const FScreenTriangle* Tris = FrameData.ScreenTriangles.GetData();
+	std::vector<uint8_t> Bytes;
+	SOCore::WriteSceneCapture(Scene, Bytes);
 
-		for (int32 BinIdx = 0; BinIdx < BIN_NUM; ++BinIdx)
-		{
-			// Sort triangles in the bin by depth
-			FrameData.SortedTriangles[BinIdx].Sort([](const FSortedIndexDepth& A, const FSortedIndexDepth& B) {
-				// biggerZ (closer) first 
-				return A.Depth > B.Depth;
-			});
-
-			const FSortedIndexDepth* SortedTriIndices = FrameData.SortedTriangles[BinIdx].GetData();
-			const int32 NumTris = FrameData.SortedTriangles[BinIdx].Num();
-			const int32 BinMinX = BinIdx * BIN_WIDTH;
-			FFramebufferBin& Bin = OutResults.Bins[BinIdx];
-			// TODO: add a way to check when bin is already fully rasterized, so we can skip this work
-
-			for (int32 TriIdx = 0; TriIdx < NumTris; ++TriIdx)
-			{
-				const int32 TriID = SortedTriIndices[TriIdx].Index;
-				const uint8 Flags = MeshFlags[TriID];
-				FPrimitiveComponentId PrimitiveId = PrimitiveIds[TriID];
-				const FScreenTriangle& Tri = Tris[TriID];
-
-				if (Flags != 0) // Occluder
-				{
-					RasterizeOccluderTri(Tri, Bin.Data, BinMinX);
-					NumRasterizedOccluderTris++;
-				}
-				else // Occluded
-				{
-					bool& VisBit = OutResults.VisibilityMap.FindOrAdd(PrimitiveId);
-					const bool bVisible = RasterizeOccludeeQuad(Tri, Bin.Data, BinMinX);
-					VisBit |= bVisible;
-					NumRasterizedOccludeeTris++;
-				}
-			}
-		}
+	const FString BaseName = FileName.IsEmpty() ? FString::Printf(TEXT("Scene_%s"), *FDateTime::Now().ToString()) : FPaths::GetBaseFilename(FileName);
+	const FString Path = FPaths::Combine(FPaths::ProfilingDir(), TEXT("SoftwareOcclusion"), BaseName + TEXT(".socap"));
+	IFileManager::Get().MakeDirectory(*FPaths::GetPath(Path), true);
+
+	if (!FFileHelper::SaveArrayToFile(TArrayView<const uint8>(Bytes.data(), static_cast<int32>(Bytes.size())), *Path))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to write occlusion scene capture %s"), *Path);
+		return FString();
 	}
 
-	const int32 NumTotalTris = FrameData.ScreenTriangles.Num();
-	INC_DWORD_STAT_BY(STAT_SoftwareTriangles, NumTotalTris);
-	INC_DWORD_STAT_BY(STAT_SoftwareOccluderTris, NumRasterizedOccluderTris);
-	INC_DWORD_STAT_BY(STAT_SoftwareOccludeeTris, NumRasterizedOccludeeTris);
+	UE_LOG(LogTemp, Log, TEXT("Captured occlusion scene to %s: %d occluders, %d occluder boxes, %d occludees"),
+	       *Path, SceneData.OccluderData.Num(), SceneData.OccluderBoxes.Num(), SceneData.OccludeeBoxPrimId.Num());
+	return Path;
 }
 
 
@@ -873,8 +554,9 @@ static ENamedThreads::Type GetOcclusionThreadName()
 struct FPotentialOccluderPrimitive // TODO: Assignment operator for nicer code?
 {
 	FPrimitiveComponentId PrimitiveComponentId;
-	FOccluderMeshData OccluderData;
+	TSharedPtr<const FOccluderMeshData> OccluderData;
 	FMatrix LocalToWorld;
+	bool bBox;
 
 	float Weight;
 };
@@ -883,4 +565,24 @@ static constexpr float OCCLUDER_DISTANCE_WEIGHT = 10000.f;
 static float ComputePotentialOccluderWeight(const float ScreenSize, const float DistanceSquared)
 {
 	return ScreenSize + OCCLUDER_DISTANCE_WEIGHT / DistanceSquared;
+}
+
+static const TSharedPtr<const FOccluderMeshData>& SelectOccluderLOD(const FOcclusionPrimitiveProxy& Proxy, const float ScreenSize)
+{
+	const int32 NumLODs = FMath::Min(Proxy.OccluderLODs.Num(), Proxy.OccluderLODScreenSizes.Num());
+	if (NumLODs == 0)
+	{
+		return Proxy.OccluderData;
+	}
+
+	// Coarsest LOD whose screen size is still above the primitive one, like the static mesh LOD selection
+	const float ScaledScreenSize = ScreenSize * GSOOccluderLODScale;
+	for (int32 LODIndex = NumLODs - 1; LODIndex > 0; --LODIndex)
+	{
+		if (Proxy.OccluderLODScreenSizes[LODIndex] > ScaledScreenSize)
+		{
+			return Proxy.OccluderLODs[LODIndex];
+		}
+	}
+	return Proxy.OccluderLODs[0];
 }
\ No newline at end of file
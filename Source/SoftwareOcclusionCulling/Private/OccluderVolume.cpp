@@ -0,0 +1,47 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+
+#include "OccluderVolume.h"
+#include "OcclusionCullingSubsystem.h"
+#include "Components/BoxComponent.h"
+
+AOccluderVolume::AOccluderVolume()
+{
+	PrimaryActorTick.bCanEverTick = false;
+
+	BoxComponent = CreateDefaultSubobject<UBoxComponent>(TEXT("BoxComponent"));
+	BoxComponent->SetBoxExtent(FVector(100.f));
+	BoxComponent->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	BoxComponent->SetGenerateOverlapEvents(false);
+	BoxComponent->SetHiddenInGame(true);
+	BoxComponent->SetMobility(EComponentMobility::Static);
+	RootComponent = BoxComponent;
+}
+
+void AOccluderVolume::BeginPlay()
+{
+	Super::BeginPlay();
+
+	UOcclusionCullingSubsystem* OcclusionCullingSubsystem = GetWorld()->GetFirstPlayerController()->GetLocalPlayer()->GetSubsystem<UOcclusionCullingSubsystem>();
+	checkf(OcclusionCullingSubsystem, TEXT("AOccluderVolume used without a UOcclusionCullingSubsystem present!"));
+
+	FOcclusionSettings OcclusionSettings;
+	OcclusionSettings.bUseAsOccluder = true;
+	OcclusionSettings.bCanBeOcluded = false;
+	OcclusionSettings.bOccluderIsScaledUnitCube = true;
+	OcclusionSettings.UnitCubeScale = BoxComponent->GetComponentScale();
+	OcclusionCullingSubsystem->RegisterOcclusionSettings(BoxComponent, OcclusionSettings);
+}
+
+void AOccluderVolume::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (const APlayerController* PlayerController = GetWorld()->GetFirstPlayerController())
+	{
+		if (UOcclusionCullingSubsystem* OcclusionCullingSubsystem = ULocalPlayer::GetSubsystem<UOcclusionCullingSubsystem>(PlayerController->GetLocalPlayer()))
+		{
+			OcclusionCullingSubsystem->UnregisterOcclusionSettings(BoxComponent);
+		}
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
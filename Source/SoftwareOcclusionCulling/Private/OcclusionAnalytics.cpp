@@ -0,0 +1,105 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#include "OcclusionAnalytics.h"
+#include "Misc/FileHelper.h"
+
+static int32 GSOAnalytics = 0;
+static FAutoConsoleVariableRef CVarSOAnalytics(
+	TEXT("r.so.Analytics"),
+	GSOAnalytics,
+	TEXT("0 = Off (Default)\n")
+	TEXT("1 = Record the cost and savings of every occlusion frame, exported with so.Analytics.Export\n")
+	TEXT("2 = Same as 1 and export the session to Saved/Profiling/SoftwareOcclusion when the subsystem shuts down"),
+	ECVF_Default
+);
+
+static int32 GSOAnalyticsMaxFrames = 216000;
+static FAutoConsoleVariableRef CVarSOAnalyticsMaxFrames(
+	TEXT("r.so.Analytics.MaxFrames"),
+	GSOAnalyticsMaxFrames,
+	TEXT("Frames recorded per session before recording stops, one hour at 60 FPS by default"),
+	ECVF_Default
+);
+
+bool FOcclusionAnalytics::IsEnabled()
+{
+	return GSOAnalytics > 0;
+}
+
+bool FOcclusionAnalytics::ShouldExportOnEnd()
+{
+	return GSOAnalytics > 1;
+}
+
+void FOcclusionAnalytics::AddFrame(const FOcclusionFrameAnalytics& Frame)
+{
+	if (Frames.Num() < GSOAnalyticsMaxFrames)
+	{
+		Frames.Add(Frame);
+	}
+}
+
+void FOcclusionAnalytics::Reset()
+{
+	Frames.Reset();
+}
+
+FString FOcclusionAnalytics::GetSummary() const
+{
+	double CostMs = 0.0;
+	int64 NumOccludees = 0;
+	int64 NumCulled = 0;
+	int64 NumFalseVisible = 0;
+	int64 SavedTriangles = 0;
+	int64 SavedDrawCalls = 0;
+
+	for (const FOcclusionFrameAnalytics& Frame : Frames)
+	{
+		CostMs += Frame.GetCostMs();
+		NumOccludees += Frame.NumOccludees;
+		NumCulled += Frame.NumCulled;
+		NumFalseVisible += Frame.NumFalseVisible;
+		SavedTriangles += Frame.SavedTriangles;
+		SavedDrawCalls += Frame.SavedDrawCalls;
+	}
+
+	const double NumFrames = FMath::Max(1, Frames.Num());
+	const double NumVisible = static_cast<double>(NumOccludees - NumCulled);
+	return FString::Printf(TEXT("%d frames, cost %.3f ms/frame, cull rate %.1f %%, false visible %.1f %% of visible, saved %.0f triangles and %.1f draws/frame, %.0f triangles and %.1f draws saved per ms"),
+	                       Frames.Num(), CostMs / NumFrames,
+	                       NumOccludees > 0 ? 100.0 * NumCulled / NumOccludees : 0.0,
+	                       NumVisible > 0.0 ? 100.0 * NumFalseVisible / NumVisible : 0.0,
+	                       SavedTriangles / NumFrames, SavedDrawCalls / NumFrames,
+	                       CostMs > 0.0 ? SavedTriangles / CostMs : 0.0, CostMs > 0.0 ? SavedDrawCalls / CostMs : 0.0);
+}
+
+bool FOcclusionAnalytics::Export(const FString& BasePath) const
+{
+	FString Csv = TEXT("Frame,GatherMs,ProcessMs,ApplyMs,FlushWaitMs,CostMs,Latency,Occluders,OccluderTriangles,Occludees,Culled,CustomDataCulled,CullRate,FalseVisible,SavedTriangles,SavedDrawCalls,SavedTrianglesPerMs\n");
+	FString Json = TEXT("{\n\t\"frames\": [\n");
+
+	for (int32 FrameIndex = 0; FrameIndex < Frames.Num(); ++FrameIndex)
+	{
+		const FOcclusionFrameAnalytics& Frame = Frames[FrameIndex];
+		const float CostMs = Frame.GetCostMs();
+		const float CullRate = Frame.NumOccludees > 0 ? static_cast<float>(Frame.NumCulled) / Frame.NumOccludees : 0.f;
+		const double SavedTrianglesPerMs = CostMs > 0.f ? Frame.SavedTriangles / CostMs : 0.0;
+
+		Csv += FString::Printf(TEXT("%llu,%.4f,%.4f,%.4f,%.4f,%.4f,%d,%d,%d,%d,%d,%d,%.4f,%d,%lld,%d,%.1f\n"),
+		                       Frame.FrameNumber, Frame.GatherTimeMs, Frame.ProcessTimeMs, Frame.ApplyTimeMs, Frame.FlushWaitTimeMs, CostMs, Frame.ResultsLatency,
+		                       Frame.NumOccluders, Frame.NumOccluderTriangles, Frame.NumOccludees, Frame.NumCulled, Frame.NumCustomDataCulled, CullRate, Frame.NumFalseVisible,
+		                       Frame.SavedTriangles, Frame.SavedDrawCalls, SavedTrianglesPerMs);
+
+		Json += FString::Printf(TEXT("\t\t{ \"frame\": %llu, \"gatherMs\": %.4f, \"processMs\": %.4f, \"applyMs\": %.4f, \"flushWaitMs\": %.4f, \"costMs\": %.4f, \"latency\": %d, ")
+		                        TEXT("\"occluders\": %d, \"occluderTriangles\": %d, \"occludees\": %d, \"culled\": %d, \"customDataCulled\": %d, \"cullRate\": %.4f, \"falseVisible\": %d, ")
+		                        TEXT("\"savedTriangles\": %lld, \"savedDrawCalls\": %d, \"savedTrianglesPerMs\": %.1f }%s\n"),
+		                        Frame.FrameNumber, Frame.GatherTimeMs, Frame.ProcessTimeMs, Frame.ApplyTimeMs, Frame.FlushWaitTimeMs, CostMs, Frame.ResultsLatency,
+		                        Frame.NumOccluders, Frame.NumOccluderTriangles, Frame.NumOccludees, Frame.NumCulled, Frame.NumCustomDataCulled, CullRate, Frame.NumFalseVisible,
+		                        Frame.SavedTriangles, Frame.SavedDrawCalls, SavedTrianglesPerMs, FrameIndex + 1 < Frames.Num() ? TEXT(",") : TEXT(""));
+	}
+
+	Json += FString::Printf(TEXT("\t],\n\t\"summary\": \"%s\"\n}\n"), *GetSummary());
+
+	return FFileHelper::SaveStringToFile(Csv, *(BasePath + TEXT(".csv")))
+		&& FFileHelper::SaveStringToFile(Json, *(BasePath + TEXT(".json")));
+}
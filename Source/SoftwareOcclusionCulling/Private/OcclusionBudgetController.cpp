@@ -0,0 +1,99 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#include "OcclusionBudgetController.h"
+
+static bool GSOBudgetEnable = false;
+static FAutoConsoleVariableRef CVarSOBudgetEnable(
+	TEXT("r.so.Budget.Enable"),
+	GSOBudgetEnable,
+	TEXT("Automatically scale r.so.MaxOccluderNum, r.so.MaxDistanceForOccluder and r.so.MinScreenRadiusForOccluder to hold r.so.Budget.TargetMs"),
+	ECVF_Default
+);
+
+static float GSOBudgetTargetMs = 1.0f;
+static FAutoConsoleVariableRef CVarSOBudgetTargetMs(
+	TEXT("r.so.Budget.TargetMs"),
+	GSOBudgetTargetMs,
+	TEXT("Target CPU time in milliseconds for one occlusion frame (gather + process task)."),
+	ECVF_Default
+);
+
+static float GSOBudgetDamping = 0.9f;
+static FAutoConsoleVariableRef CVarSOBudgetDamping(
+	TEXT("r.so.Budget.Damping"),
+	GSOBudgetDamping,
+	TEXT("Damping [0..1) applied to the measured cost and to the quality adjustment. Higher values react slower."),
+	ECVF_Default
+);
+
+static float GSOBudgetMinScale = 0.1f;
+static FAutoConsoleVariableRef CVarSOBudgetMinScale(
+	TEXT("r.so.Budget.MinScale"),
+	GSOBudgetMinScale,
+	TEXT("Lowest quality scale the budget controller may apply to the default occluder limits."),
+	ECVF_Default
+);
+
+static float GSOBudgetMaxScale = 4.0f;
+static FAutoConsoleVariableRef CVarSOBudgetMaxScale(
+	TEXT("r.so.Budget.MaxScale"),
+	GSOBudgetMaxScale,
+	TEXT("Highest quality scale the budget controller may apply to the default occluder limits."),
+	ECVF_Default
+);
+
+/** Relative error around the target inside which the quality scale is left untouched. */
+static constexpr float BUDGET_DEADBAND = 0.05f;
+
+/** Largest relative change of the quality scale in a single frame. */
+static constexpr float BUDGET_MAX_STEP = 0.25f;
+
+void FOcclusionBudgetController::Update(const float FrameCostMs)
+{
+	if (!GSOBudgetEnable)
+	{
+		Reset();
+		return;
+	}
+
+	// Frames that did not run an occlusion task carry no information
+	if (FrameCostMs <= 0.f)
+	{
+		return;
+	}
+
+	const float Damping = FMath::Clamp(GSOBudgetDamping, 0.f, 0.99f);
+	SmoothedCostMs = SmoothedCostMs > 0.f ? FMath::Lerp(FrameCostMs, SmoothedCostMs, Damping) : FrameCostMs;
+
+	const float TargetMs = FMath::Max(GSOBudgetTargetMs, UE_KINDA_SMALL_NUMBER);
+	const float Ratio = TargetMs / SmoothedCostMs;
+	if (FMath::Abs(Ratio - 1.f) < BUDGET_DEADBAND)
+	{
+		return;
+	}
+
+	// Cost is roughly linear in the number of occluders, so step towards the ratio and let damping smooth it out
+	const float Step = FMath::Clamp(FMath::Lerp(Ratio, 1.f, Damping), 1.f - BUDGET_MAX_STEP, 1.f + BUDGET_MAX_STEP);
+	const float MinScale = FMath::Max(GSOBudgetMinScale, UE_KINDA_SMALL_NUMBER);
+	QualityScale = FMath::Clamp(QualityScale * Step, MinScale, FMath::Max(MinScale, GSOBudgetMaxScale));
+}
+
+FOcclusionBudget FOcclusionBudgetController::GetBudget(const FOcclusionBudget& DefaultBudget) const
+{
+	if (!GSOBudgetEnable)
+	{
+		return DefaultBudget;
+	}
+
+	FOcclusionBudget Budget;
+	Budget.MaxOccluderNum = FMath::Max(1, FMath::RoundToInt(DefaultBudget.MaxOccluderNum * QualityScale));
+	Budget.MaxDistanceForOccluder = DefaultBudget.MaxDistanceForOccluder * QualityScale;
+	Budget.MinScreenRadiusForOccluder = DefaultBudget.MinScreenRadiusForOccluder / QualityScale;
+	return Budget;
+}
+
+void FOcclusionBudgetController::Reset()
+{
+	SmoothedCostMs = 0.f;
+	QualityScale = 1.f;
+}
@@ -1,11 +1,23 @@
 // Copyright to Kat Code Labs, SRL. All Rights Reserved.
 
 #include "OcclusionCullingSubsystem.h"
+#include "CanvasItem.h"
 #include "CanvasTypes.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Data/OcclusionInstancedContext.h"
+#include "Data/OcclusionLandscapeContext.h"
 #include "Data/OcclusionPrimitiveProxy.h"
+#include "Data/OcclusionSkinnedContext.h"
 #include "Data/OcclusionViewInfo.h"
 #include "Engine/Canvas.h"
+#include "Engine/Engine.h"
+#include "Engine/Level.h"
+#include "Engine/LocalPlayer.h"
+#include "Engine/Texture2D.h"
+#include "Engine/World.h"
+#include "LandscapeComponent.h"
 #include "Legacy//SceneSoftwareOcclusion.h"
+#include "RHI.h"
 
 #if WITH_EDITOR
 #include "Editor.h"
@@ -27,6 +39,93 @@ static FAutoConsoleVariableRef CVarVisualizeBoundsRef(
 	ECVF_Cheat
 );
 
+static float GSOOccluderMemoryBudgetMB = 64.f;
+static FAutoConsoleVariableRef CVarSOOccluderMemoryBudgetMB(
+	TEXT("r.so.OccluderMemoryBudgetMB"),
+	GSOOccluderMemoryBudgetMB,
+	TEXT("Memory allowed for extracted occluder geometry. The least recently used occluders are evicted above it and extracted again when needed. 0 disables the budget."),
+	ECVF_Default
+);
+
+static bool GSOBakedOccluderCells = true;
+static FAutoConsoleVariableRef CVarSOBakedOccluderCells(
+	TEXT("r.so.BakedOccluderCells"),
+	GSOBakedOccluderCells,
+	TEXT("Use the occluder cells baked with so.Editor.BakeOccluderCells to limit the static occluder candidates to those of the view cell"),
+	ECVF_Default
+);
+
+static bool GSODebugViewOccupancy = true;
+static FAutoConsoleVariableRef CVarSODebugViewOccupancy(
+	TEXT("r.so.DebugView.Occupancy"),
+	GSODebugViewOccupancy,
+	TEXT("Draw the covered fraction of each bin above the coverage debug view"),
+	ECVF_Default
+);
+
+static int32 GSOVisibilityQueries = 1;
+static FAutoConsoleVariableRef CVarSOVisibilityQueries(
+	TEXT("r.so.VisibilityQueries"),
+	GSOVisibilityQueries,
+	TEXT("Record the occluder depth of occlusion frames for visibility queries. 0: never, 1: while queries were made in the last frames, 2: always"),
+	ECVF_Default
+);
+
+// Frames the occluder depth keeps being recorded after the last visibility query
+static constexpr uint64 VISIBILITY_QUERY_IDLE_FRAMES = 60;
+
+// Set by so.CaptureScene, consumed by the next processed frame
+static bool GSOCaptureScenePending = false;
+static FString GSOCaptureSceneFileName;
+
+static void CaptureScene(const TArray<FString>& Args)
+{
+	GSOCaptureScenePending = true;
+	GSOCaptureSceneFileName = Args.Num() > 0 ? Args[0] : FString();
+}
+
+static FAutoConsoleCommand CaptureSceneCommand(
+	TEXT("so.CaptureScene"),
+	TEXT("Writes the occlusion scene of the next frame to Saved/Profiling/SoftwareOcclusion, to be replayed with the OcclusionReplay tool. Arguments: [FileName]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&CaptureScene)
+);
+
+static UOcclusionCullingSubsystem* FindOcclusionSubsystem(const UWorld* World)
+{
+	const ULocalPlayer* LocalPlayer = World ? World->GetFirstLocalPlayerFromController() : nullptr;
+	return LocalPlayer ? LocalPlayer->GetSubsystem<UOcclusionCullingSubsystem>() : nullptr;
+}
+
+static FAutoConsoleCommandWithWorldAndArgs ExportAnalyticsCommand(
+	TEXT("so.Analytics.Export"),
+	TEXT("Writes the occlusion frames recorded with r.so.Analytics to Saved/Profiling/SoftwareOcclusion as CSV and JSON. Arguments: [FileName]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (const UOcclusionCullingSubsystem* Subsystem = FindOcclusionSubsystem(World))
+		{
+			Subsystem->ExportAnalytics(Args.Num() > 0 ? Args[0] : FString());
+		}
+	})
+);
+
+static FAutoConsoleCommandWithWorldAndArgs ResetAnalyticsCommand(
+	TEXT("so.Analytics.Reset"),
+	TEXT("Drops the occlusion frames recorded with r.so.Analytics"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UOcclusionCullingSubsystem* Subsystem = FindOcclusionSubsystem(World))
+		{
+			Subsystem->ResetAnalytics();
+		}
+	})
+);
+
+/** Frames between two visits of every context for destroyed primitives */
+static constexpr uint64 DESTROYED_PRIMITIVE_SWEEP_FRAMES = 64;
+
+/** Seconds a primitive left visible may go undrawn by the renderer before it counts as false visible */
+static constexpr float FALSE_VISIBLE_RENDER_TOLERANCE = 0.1f;
+
 UOcclusionCullingSubsystem::UOcclusionCullingSubsystem() = default;
 UOcclusionCullingSubsystem::~UOcclusionCullingSubsystem() = default;
 
@@ -35,6 +134,15 @@ UOcclusionCullingSubsystem::UOcclusionCullingSubsystem(FVTableHelper& Helper)
 {
 }
 
+void UOcclusionCullingSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	// Level streaming and World Partition cells add and remove their primitives through levels
+	LevelAddedHandle = FWorldDelegates::LevelAddedToWorld.AddUObject(this, &UOcclusionCullingSubsystem::OnLevelAddedToWorld);
+	LevelRemovedHandle = FWorldDelegates::LevelRemovedFromWorld.AddUObject(this, &UOcclusionCullingSubsystem::OnLevelRemovedFromWorld);
+}
+
 void UOcclusionCullingSubsystem::PlayerControllerChanged(APlayerController* NewPlayerController)
 {
 	Super::PlayerControllerChanged(NewPlayerController);
@@ -46,7 +154,267 @@ void UOcclusionCullingSubsystem::Deinitialize()
 {
 	Super::Deinitialize();
 
+	FWorldDelegates::LevelAddedToWorld.Remove(LevelAddedHandle);
+	FWorldDelegates::LevelRemovedFromWorld.Remove(LevelRemovedHandle);
+
 	FlushSceneProcessing();
+
+	if (FOcclusionAnalytics::ShouldExportOnEnd() && Analytics.GetNumFrames() > 0)
+	{
+		ExportAnalytics(FString());
+	}
+}
+
+void UOcclusionCullingSubsystem::ExportAnalytics(const FString& FileName) const
+{
+	const FString BaseName = FileName.IsEmpty() ? FString::Printf(TEXT("Analytics_%s"), *FDateTime::Now().ToString()) : FPaths::GetBaseFilename(FileName);
+	const FString BasePath = FPaths::Combine(FPaths::ProfilingDir(), TEXT("SoftwareOcclusion"), BaseName);
+	IFileManager::Get().MakeDirectory(*FPaths::GetPath(BasePath), true);
+
+	if (!Analytics.Export(BasePath))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to write occlusion analytics %s"), *BasePath);
+		return;
+	}
+	UE_LOG(LogTemp, Log, TEXT("Exported occlusion analytics to %s.csv/.json: %s"), *BasePath, *Analytics.GetSummary());
+}
+
+void UOcclusionCullingSubsystem::ResetAnalytics()
+{
+	Analytics.Reset();
+}
+
+void UOcclusionCullingSubsystem::OnLevelAddedToWorld(ULevel* Level, UWorld* World)
+{
+	if (World == GetLocalPlayer()->GetWorld())
+	{
+		RegisterLevelPrimitives(Level);
+	}
+}
+
+void UOcclusionCullingSubsystem::OnLevelRemovedFromWorld(ULevel* Level, UWorld* World)
+{
+	if (World == GetLocalPlayer()->GetWorld())
+	{
+		ReleaseLevelPrimitives(Level);
+	}
+}
+
+void UOcclusionCullingSubsystem::RegisterLevelPrimitives(ULevel* Level)
+{
+	if (!IsValid(Level))
+	{
+		return;
+	}
+
+	for (const AActor* Actor : Level->Actors)
+	{
+		if (!IsValid(Actor))
+		{
+			continue;
+		}
+
+		TInlineComponentArray<UPrimitiveComponent*> PrimitiveComponents(Actor);
+		for (UPrimitiveComponent* PrimitiveComponent : PrimitiveComponents)
+		{
+			if (PrimitiveComponent->IsRegistered() && !PrimitiveComponent->IsEditorOnly()
+				&& !PrimitiveContextMap.Contains(PrimitiveComponent->GetPrimitiveSceneId().PrimIDValue))
+			{
+				RegisterDefaultOcclusionSettings(PrimitiveComponent);
+			}
+		}
+	}
+}
+
+void UOcclusionCullingSubsystem::ReleaseLevelPrimitives(const ULevel* Level)
+{
+	// A null level means that every level of the world is removed
+	for (auto It = PrimitiveContextMap.CreateIterator(); It; ++It)
+	{
+		const UPrimitiveComponent* PrimitiveComponent = IsValid(It->Value) ? It->Value->GetPrimitiveComponent() : nullptr;
+		if (!IsValid(PrimitiveComponent) || !Level || PrimitiveComponent->GetComponentLevel() == Level)
+		{
+			// Hidden primitives are not registered again when the level comes back
+			if (IsValid(It->Value))
+			{
+				It->Value->RestoreVisibility();
+			}
+			RemoveResidentOccluder(It->Value);
+			It.RemoveCurrent();
+		}
+	}
+}
+
+UOcclusionPrimitiveContext* UOcclusionCullingSubsystem::FindPrimitiveContext(const UPrimitiveComponent* PrimitiveComponent) const
+{
+	UOcclusionPrimitiveContext* const* PrimitiveInfo = IsValid(PrimitiveComponent) ? PrimitiveContextMap.Find(PrimitiveComponent->GetPrimitiveSceneId().PrimIDValue) : nullptr;
+	return PrimitiveInfo ? *PrimitiveInfo : nullptr;
+}
+
+void UOcclusionCullingSubsystem::UpdateOccluderCells(const FVector& ViewOrigin)
+{
+	SO_TRACE_SCOPE(SoftwareOcclusion_UpdateOccluderCells);
+
+	const UWorld* World = GetLocalPlayer()->GetWorld();
+	const FString Path = GSOBakedOccluderCells && World ? FOccluderCellSet::GetPath(World) : FString();
+	if (Path != OccluderCellsPath)
+	{
+		OccluderCellsPath = Path;
+		BakedOccluderIndices.Reset();
+		CurrentOccluderCell = INDEX_NONE;
+
+		if (!Path.IsEmpty() && OccluderCells.Load(Path))
+		{
+			const TConstArrayView<uint64> Keys = OccluderCells.GetOccluderKeys();
+			for (int32 Index = 0; Index < Keys.Num(); ++Index)
+			{
+				BakedOccluderIndices.Add(Keys[Index], Index);
+			}
+			CellOccluderCandidates.Init(false, Keys.Num());
+		}
+
+		for (const TPair<uint32, UOcclusionPrimitiveContext*>& Pair : PrimitiveContextMap)
+		{
+			if (IsValid(Pair.Value) && IsValid(Pair.Value->GetPrimitiveComponent()))
+			{
+				Pair.Value->SetBakedOccluderIndex(FindBakedOccluderIndex(Pair.Value->GetPrimitiveComponent()));
+			}
+		}
+	}
+
+	if (BakedOccluderIndices.IsEmpty())
+	{
+		return;
+	}
+
+	// Only the cells the view visits are paged in from the mapped file
+	const int32 Cell = OccluderCells.FindCell(ViewOrigin);
+	if (Cell != CurrentOccluderCell)
+	{
+		for (const uint32 Index : OccluderCells.GetCellOccluders(CurrentOccluderCell))
+		{
+			if (CellOccluderCandidates.IsValidIndex(Index))
+			{
+				CellOccluderCandidates[Index] = false;
+			}
+		}
+		for (const uint32 Index : OccluderCells.GetCellOccluders(Cell))
+		{
+			if (CellOccluderCandidates.IsValidIndex(Index))
+			{
+				CellOccluderCandidates[Index] = true;
+			}
+		}
+		CurrentOccluderCell = Cell;
+	}
+}
+
+int32 UOcclusionCullingSubsystem::FindBakedOccluderIndex(const UPrimitiveComponent* PrimitiveComponent) const
+{
+	if (BakedOccluderIndices.IsEmpty() || PrimitiveComponent->Mobility != EComponentMobility::Static)
+	{
+		return INDEX_NONE;
+	}
+
+	const int32* Index = BakedOccluderIndices.Find(FOccluderCellSet::MakeOccluderKey(PrimitiveComponent));
+	return Index ? *Index : INDEX_NONE;
+}
+
+void UOcclusionCullingSubsystem::UpdateOccluderResidency(const TArray<uint32>& RequestedOccluders)
+{
+	SO_TRACE_SCOPE(SoftwareOcclusion_UpdateOccluderResidency);
+
+	RemoveDestroyedPrimitives();
+
+	for (const uint32 PrimIDValue : RequestedOccluders)
+	{
+		if (UOcclusionPrimitiveContext* const* PrimitiveInfo = PrimitiveContextMap.Find(PrimIDValue); PrimitiveInfo && IsValid(*PrimitiveInfo))
+		{
+			(*PrimitiveInfo)->MarkOccluderUsed(GFrameCounter);
+
+			// Most recently used first
+			if (UOcclusionPrimitiveContext::FResidentNode* Node = (*PrimitiveInfo)->GetResidentNode(); Node && Node != ResidentOccluders.GetHead())
+			{
+				ResidentOccluders.RemoveNode(Node, false);
+				ResidentOccluders.AddHead(Node);
+			}
+		}
+	}
+
+	const SIZE_T BudgetSize = static_cast<SIZE_T>(FMath::Max(GSOOccluderMemoryBudgetMB, 0.f) * 1024.f * 1024.f);
+	if (BudgetSize == 0)
+	{
+		return;
+	}
+
+	// Only the resident occluders are visited, shared geometry makes their sizes change from frame to frame
+	SIZE_T TotalSize = 0;
+	for (UOcclusionPrimitiveContext::FResidentNode* Node = ResidentOccluders.GetHead(); Node;)
+	{
+		UOcclusionPrimitiveContext* PrimitiveInfo = Node->GetValue();
+		UOcclusionPrimitiveContext::FResidentNode* NextNode = Node->GetNextNode();
+
+		if (!IsValid(PrimitiveInfo->GetPrimitiveComponent()))
+		{
+			PrimitiveInfo->EvictOccluder();
+		}
+
+		if (!PrimitiveInfo->HasEvictableOccluder())
+		{
+			RemoveResidentOccluder(PrimitiveInfo);
+		}
+		else
+		{
+			TotalSize += PrimitiveInfo->GetOccluderAllocatedSize();
+		}
+		Node = NextNode;
+	}
+
+	// Evict the least recently used occluders, never the ones requested this frame
+	while (TotalSize > BudgetSize && ResidentOccluders.GetTail())
+	{
+		UOcclusionPrimitiveContext* PrimitiveInfo = ResidentOccluders.GetTail()->GetValue();
+		if (PrimitiveInfo->GetLastOccluderUseFrame() == GFrameCounter)
+		{
+			break;
+		}
+
+		TotalSize -= FMath::Min(TotalSize, PrimitiveInfo->GetOccluderAllocatedSize());
+		PrimitiveInfo->EvictOccluder();
+		RemoveResidentOccluder(PrimitiveInfo);
+	}
+}
+
+void UOcclusionCullingSubsystem::AddResidentOccluder(UOcclusionPrimitiveContext* PrimitiveInfo)
+{
+	ResidentOccluders.AddTail(PrimitiveInfo);
+	PrimitiveInfo->SetResidentNode(ResidentOccluders.GetTail());
+}
+
+void UOcclusionCullingSubsystem::RemoveResidentOccluder(UOcclusionPrimitiveContext* PrimitiveInfo)
+{
+	if (PrimitiveInfo && PrimitiveInfo->GetResidentNode())
+	{
+		ResidentOccluders.RemoveNode(PrimitiveInfo->GetResidentNode());
+		PrimitiveInfo->SetResidentNode(nullptr);
+	}
+}
+
+void UOcclusionCullingSubsystem::RemoveDestroyedPrimitives()
+{
+	if (GFrameCounter % DESTROYED_PRIMITIVE_SWEEP_FRAMES != 0)
+	{
+		return;
+	}
+
+	for (auto It = PrimitiveContextMap.CreateIterator(); It; ++It)
+	{
+		if (!IsValid(It->Value) || !IsValid(It->Value->GetPrimitiveComponent()))
+		{
+			RemoveResidentOccluder(It->Value);
+			It.RemoveCurrent();
+		}
+	}
 }
 
 TStatId UOcclusionCullingSubsystem::GetStatId() const
@@ -73,115 +441,219 @@ bool UOcclusionCullingSubsystem::IsAllowedToTick() const
 
 void UOcclusionCullingSubsystem::Tick(float DeltaTime)
 {
+	SO_TRACE_SCOPE(SoftwareOcclusion_Tick);
+
+	const double PopulateStartTime = FPlatformTime::Seconds();
 	TArray<FOcclusionPrimitiveProxy> Scene;
 	PopulateScene(Scene);
+	PopulateTimeMs = static_cast<float>((FPlatformTime::Seconds() - PopulateStartTime) * 1000.0);
+	TRACE_COUNTER_SET(SOPopulateMs, PopulateTimeMs);
+
 	ProcessScene(Scene);
 }
 
-inline bool BinRowTestBit(const uint64 Mask, const int32 Bit)
+void UOcclusionCullingSubsystem::UpdateDebugTexture()
 {
-	return (Mask & (1ull << Bit)) != 0;
+	if (!DebugTexture)
+	{
+		DebugTexture = UTexture2D::CreateTransient(FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, PF_B8G8R8A8);
+		DebugTexture->Filter = TF_Nearest;
+		DebugTexture->UpdateResource();
+	}
+	else if (DebugTextureFrameNumber == LastFrameResults.GatherFrameNumber)
+	{
+		return;
+	}
+	DebugTextureFrameNumber = LastFrameResults.GatherFrameNumber;
+
+	const FColor ColorBuffer[2] =
+	{
+		FLinearColor(0.1f, 0.1f, 0.1f).ToFColor(true), // Un-Occluded
+		FColor::White // Occluded
+	};
+
+	// Freed by the render thread once uploaded
+	FColor* Texels = static_cast<FColor*>(FMemory::Malloc(FRAMEBUFFER_WIDTH * FRAMEBUFFER_HEIGHT * sizeof(FColor)));
+
+	for (int32 i = 0; i < BIN_NUM; ++i)
+	{
+		const FFramebufferBin& Bin = LastFrameResults.Bins[i];
+		int32 NumCovered = 0;
+
+		for (int32 j = 0; j < FRAMEBUFFER_HEIGHT; ++j)
+		{
+			const uint64 RowData = Bin.Data[j];
+			NumCovered += FMath::CountBits(RowData);
+
+			// flip image by Y axis
+			FColor* Row = Texels + (FRAMEBUFFER_HEIGHT - 1 - j) * FRAMEBUFFER_WIDTH + i * BIN_WIDTH;
+			for (int32 k = 0; k < BIN_WIDTH; ++k)
+			{
+				Row[k] = ColorBuffer[(RowData >> k) & 1ull];
+			}
+		}
+
+		DebugBinOccupancy[i] = static_cast<float>(NumCovered) / (BIN_WIDTH * FRAMEBUFFER_HEIGHT);
+	}
+
+	static const FUpdateTextureRegion2D Region(0, 0, 0, 0, FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT);
+	DebugTexture->UpdateTextureRegions(0, 1, &Region, FRAMEBUFFER_WIDTH * sizeof(FColor), sizeof(FColor), reinterpret_cast<uint8*>(Texels),
+		[](uint8* SrcData, const FUpdateTextureRegion2D*)
+		{
+			FMemory::Free(SrcData);
+		});
 }
 
 void UOcclusionCullingSubsystem::DebugDrawToCanvas(const UCanvas* Canvas, int32 InX, int32 InY)
 {
 #if !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
+	SO_TRACE_SCOPE(SoftwareOcclusion_DebugDraw);
 
-	const FLinearColor ColorBuffer[2] =
-	{
-		FLinearColor(0.1f, 0.1f, 0.1f), // Un-Occluded
-		FLinearColor::White // Occluded
-	};
+	// One tile for the whole coverage buffer, so debugging does not distort the measurements
+	UpdateDebugTexture();
+	FCanvasTileItem TileItem(FVector2D(InX, InY), DebugTexture->GetResource(), FVector2D(FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT), FLinearColor::White);
+	TileItem.BlendMode = SE_BLEND_Opaque;
+	Canvas->Canvas->DrawItem(TileItem);
 
 	FBatchedElements* BatchedElements = Canvas->Canvas->GetBatchedElements(FCanvas::ET_Line);
 
-	for (int32 i = 0; i < BIN_NUM; ++i)
+	// vertical line for each bin border
+	for (int32 i = 0; i <= BIN_NUM; ++i)
 	{
-		const int32 BinStartX = InX + i * BIN_WIDTH;
-		const int32 BinStartY = InY;
-
-		// vertical line for each bin border
-		BatchedElements->AddLine(FVector(BinStartX, BinStartY, 0.f), FVector(BinStartX, BinStartY + FRAMEBUFFER_HEIGHT, 0.f), FColor::Blue, FHitProxyId());
+		const int32 BinX = InX + i * BIN_WIDTH;
+		BatchedElements->AddLine(FVector(BinX, InY, 0.f), FVector(BinX, InY + FRAMEBUFFER_HEIGHT, 0.f), FColor::Blue, FHitProxyId());
+	}
 
-		const FFramebufferBin& Bin = LastFrameResults.Bins[i];
-		for (int32 j = 0; j < FRAMEBUFFER_HEIGHT; ++j)
+	if (GSODebugViewOccupancy)
+	{
+		constexpr float BarHeight = 6.f;
+		for (int32 i = 0; i < BIN_NUM; ++i)
 		{
-			const uint64 RowData = Bin.Data[j];
-			const int32 BitY = (FRAMEBUFFER_HEIGHT + InY) - j; // flip image by Y axis
+			const float BinX = InX + i * BIN_WIDTH;
 
-			FVector Pos0 = FVector(BinStartX, BitY, 0.f);
-			int32 Bit0 = BinRowTestBit(RowData, 0) ? 1 : 0;
+			FCanvasTileItem BarItem(FVector2D(BinX, InY - BarHeight), FVector2D(BIN_WIDTH * DebugBinOccupancy[i], BarHeight), FLinearColor::Green);
+			Canvas->Canvas->DrawItem(BarItem);
 
-			for (int32 k = 1; k < BIN_WIDTH; ++k)
+			FCanvasTextItem TextItem(FVector2D(BinX + 2.f, InY - BarHeight - 12.f), FText::FromString(FString::Printf(TEXT("%.0f%%"), DebugBinOccupancy[i] * 100.f)),
+			                         GEngine->GetTinyFont(), FLinearColor::Yellow);
+			Canvas->Canvas->DrawItem(TextItem);
+		}
+	}
+
+	if (GSODebugOccludeeQuads)
+	{
+		const FIntRect Framebuffer(0, 0, FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT);
+		for (int32 i = 0; i < LastFrameResults.DebugOccludeeQuads.Num(); ++i)
+		{
+			FIntRect Quad = LastFrameResults.DebugOccludeeQuads[i];
+			Quad.Clip(Framebuffer);
+			if (Quad.Width() <= 0 || Quad.Height() <= 0)
 			{
-				if (const int32 Bit1 = BinRowTestBit(RowData, k) ? 1 : 0; Bit0 != Bit1 || (k == (BIN_WIDTH - 1)))
-				{
-					const int32 BitX = BinStartX + k;
-					FVector Pos1 = FVector(BitX, BitY, 0.f);
-					BatchedElements->AddLine(Pos0, Pos1, ColorBuffer[Bit0], FHitProxyId());
-					Pos0 = Pos1;
-					Bit0 = Bit1;
-				}
+				continue;
 			}
+
+			const bool bVisible = LastFrameResults.DebugOccludeeVisibility.IsValidIndex(i) && LastFrameResults.DebugOccludeeVisibility[i] != 0;
+			const FColor Color = bVisible ? FColor::Green : FColor::Red;
+
+			// flip image by Y axis
+			const FVector P0(InX + Quad.Min.X, InY + FRAMEBUFFER_HEIGHT - Quad.Max.Y, 0.f);
+			const FVector P1(InX + Quad.Max.X, InY + FRAMEBUFFER_HEIGHT - Quad.Max.Y, 0.f);
+			const FVector P2(InX + Quad.Max.X, InY + FRAMEBUFFER_HEIGHT - Quad.Min.Y, 0.f);
+			const FVector P3(InX + Quad.Min.X, InY + FRAMEBUFFER_HEIGHT - Quad.Min.Y, 0.f);
+			BatchedElements->AddLine(P0, P1, Color, FHitProxyId());
+			BatchedElements->AddLine(P1, P2, Color, FHitProxyId());
+			BatchedElements->AddLine(P2, P3, Color, FHitProxyId());
+			BatchedElements->AddLine(P3, P0, Color, FHitProxyId());
 		}
 	}
-
-	// Vertical line for last bin border
-	const int32 BinX = InX + BIN_NUM * BIN_WIDTH;
-	const int32 BinY = InY;
-	BatchedElements->AddLine(FVector(BinX, BinY, 0.f), FVector(BinX, BinY + FRAMEBUFFER_HEIGHT, 0.f), FColor::Blue, FHitProxyId());
 #endif//!(UE_BUILD_SHIPPING || UE_BUILD_TEST)
 }
 
-bool UOcclusionCullingSubsystem::RegisterOcclusionSettings(UStaticMeshComponent* StaticMeshComponent, const FOcclusionSettings& OcclusionSettings)
+static UClass* GetPrimitiveContextClass(const UPrimitiveComponent* PrimitiveComponent)
 {
-	if(!IsValid(StaticMeshComponent))
+	if(PrimitiveComponent->IsA<UInstancedStaticMeshComponent>())
+	{
+		return UOcclusionInstancedContext::StaticClass();
+	}
+
+	if(PrimitiveComponent->IsA<USkinnedMeshComponent>())
+	{
+		return UOcclusionSkinnedContext::StaticClass();
+	}
+
+	if(PrimitiveComponent->IsA<ULandscapeComponent>())
+	{
+		return UOcclusionLandscapeContext::StaticClass();
+	}
+
+	return UOcclusionPrimitiveContext::StaticClass();
+}
+
+bool UOcclusionCullingSubsystem::RegisterOcclusionSettings(UPrimitiveComponent* PrimitiveComponent, const FOcclusionSettings& OcclusionSettings)
+{
+	if(!IsValid(PrimitiveComponent))
 	{
 		return false;
 	}
 
-	// Do not register meshes that do no have valid owners
-	const AActor* MeshOwner = StaticMeshComponent->GetOwner();
-	if(!IsValid(MeshOwner))
+	// Do not register primitives that do no have valid owners
+	const AActor* PrimitiveOwner = PrimitiveComponent->GetOwner();
+	if(!IsValid(PrimitiveOwner))
 	{
 		return false;
 	}
 
-	// Do not register meshes that are hidden in game 
-	if(StaticMeshComponent->bHiddenInGame || MeshOwner->IsHidden())
+	// Do not register primitives that are hidden in game, unless they are only used as occluders (e.g. occluder volumes)
+	const bool bOccluderOnly = OcclusionSettings.bUseAsOccluder && !OcclusionSettings.bCanBeOcluded;
+	if(!bOccluderOnly && (PrimitiveComponent->bHiddenInGame || PrimitiveOwner->IsHidden()))
 	{
 		return false;
 	}
 
-	if(StaticMeshComponent->HasAnyFlags(RF_ClassDefaultObject | RF_ArchetypeObject))
+	if(PrimitiveComponent->HasAnyFlags(RF_ClassDefaultObject | RF_ArchetypeObject))
 	{
 		return false;
 	}
 
-	if(const auto FoundPrimitiveInfo = PrimitiveContextMap.Find(StaticMeshComponent->GetPrimitiveSceneId().PrimIDValue))
+	if(const auto FoundPrimitiveInfo = PrimitiveContextMap.Find(PrimitiveComponent->GetPrimitiveSceneId().PrimIDValue))
 	{
+		// Setup again, the occluder representation depends on the settings
 		UOcclusionPrimitiveContext* PrimitiveInfo = *FoundPrimitiveInfo;
-		PrimitiveInfo->SetOcclusionSettings(OcclusionSettings);
+		PrimitiveInfo->Setup(PrimitiveComponent, OcclusionSettings);
 	}
 	else
 	{
-		UOcclusionPrimitiveContext* PrimitiveInfo = NewObject<UOcclusionPrimitiveContext>();
-		PrimitiveInfo->Setup(StaticMeshComponent, OcclusionSettings);
-		PrimitiveContextMap.Add(StaticMeshComponent->GetPrimitiveSceneId().PrimIDValue, PrimitiveInfo);
+		UOcclusionPrimitiveContext* PrimitiveInfo = NewObject<UOcclusionPrimitiveContext>(GetTransientPackage(), GetPrimitiveContextClass(PrimitiveComponent));
+		PrimitiveInfo->Setup(PrimitiveComponent, OcclusionSettings);
+		PrimitiveInfo->SetBakedOccluderIndex(FindBakedOccluderIndex(PrimitiveComponent));
+		PrimitiveContextMap.Add(PrimitiveComponent->GetPrimitiveSceneId().PrimIDValue, PrimitiveInfo);
 	}
 	return true;
 }
 
-void UOcclusionCullingSubsystem::UnregisterOcclusionSettings(const UStaticMeshComponent* StaticMeshComponent)
+void UOcclusionCullingSubsystem::UnregisterOcclusionSettings(const UPrimitiveComponent* PrimitiveComponent)
 {
-	PrimitiveContextMap.Remove(StaticMeshComponent->GetPrimitiveSceneId().PrimIDValue);
+	UOcclusionPrimitiveContext* PrimitiveInfo = nullptr;
+	if (PrimitiveContextMap.RemoveAndCopyValue(PrimitiveComponent->GetPrimitiveSceneId().PrimIDValue, PrimitiveInfo) && IsValid(PrimitiveInfo))
+	{
+		PrimitiveInfo->RestoreVisibility();
+		RemoveResidentOccluder(PrimitiveInfo);
+	}
+}
+
+bool UOcclusionCullingSubsystem::RegisterDefaultOcclusionSettings(UPrimitiveComponent* PrimitiveComponent)
+{
+	const FOcclusionSettings& OcclusionSettings = GetDefault<USoftwareOcclusionSettings>()->DefaultOcclusionSettings;
+	return RegisterOcclusionSettings(PrimitiveComponent, OcclusionSettings);
 }
 
 void UOcclusionCullingSubsystem::PopulateScene(TArray<FOcclusionPrimitiveProxy>& Scene)
 {
-	for (TObjectIterator<UStaticMeshComponent> Itr; Itr; ++Itr)
+	SO_TRACE_SCOPE(SoftwareOcclusion_PopulateScene);
+
+	for (TObjectIterator<UPrimitiveComponent> Itr; Itr; ++Itr)
 	{
-		UStaticMeshComponent* Component = *Itr;
+		UPrimitiveComponent* Component = *Itr;
 		if(!IsValid(Component))
 		{
 			continue;
@@ -191,6 +663,12 @@ void UOcclusionCullingSubsystem::PopulateScene(TArray<FOcclusionPrimitiveProxy>&
 		{
 			continue;
 		}
+
+		// Only primitives that are part of the scene can be culled
+		if(!Component->IsRegistered() || Component->IsEditorOnly())
+		{
+			continue;
+		}
 		
 		if(Component->GetWorld() != GetLocalPlayer()->GetWorld())
 		{
@@ -199,8 +677,7 @@ void UOcclusionCullingSubsystem::PopulateScene(TArray<FOcclusionPrimitiveProxy>&
 
 		if(!PrimitiveContextMap.Contains(Component->GetPrimitiveSceneId().PrimIDValue))
 		{
-			const FOcclusionSettings& OcclusionSettings = GetDefault<USoftwareOcclusionSettings>()->DefaultOcclusionSettings;
-			const bool bRegistered = RegisterOcclusionSettings(Component, OcclusionSettings);
+			const bool bRegistered = RegisterDefaultOcclusionSettings(Component);
 			if(!bRegistered) continue;
 		}
 
@@ -210,6 +687,11 @@ void UOcclusionCullingSubsystem::PopulateScene(TArray<FOcclusionPrimitiveProxy>&
 			continue;
 		}
 		
+		PrimitiveInfo->TickOccluderExtraction();
+		if (!PrimitiveInfo->GetResidentNode() && PrimitiveInfo->HasEvictableOccluder())
+		{
+			AddResidentOccluder(PrimitiveInfo);
+		}
 		PrimitiveInfo->UpdateBounds();
 		if (PrimitiveInfo->PerformFrustumCull(PlayerCameraManager))
 		{
@@ -232,22 +714,59 @@ int32 UOcclusionCullingSubsystem::ProcessScene(const TArray<FOcclusionPrimitiveP
 		return 0;
 	}
 
+	SO_TRACE_SCOPE(SoftwareOcclusion_ProcessScene);
+
 	// Make sure occlusion task issued last frame is completed
 	FlushSceneProcessing();
 	
 	// Finished processing occlusion, set results as available
 	LastFrameResults = MoveTemp(FrameResults);
+	TRACE_COUNTER_SET(SOProcessMs, LastFrameResults.ProcessTimeMs);
+
+	{
+		// Frames without a snapshot drop the previous one, its view is outdated
+		FScopeLock Lock(&VisibilitySnapshotLock);
+		VisibilitySnapshot = LastFrameResults.VisibilitySnapshot;
+	}
+
+	// Adjust occluder limits from the cost of the frame that just finished
+	BudgetController.Update(LastFrameResults.GatherTimeMs + LastFrameResults.ProcessTimeMs);
+
+	FOcclusionBudget DefaultBudget;
+	DefaultBudget.MaxOccluderNum = GSOMaxOccluderNum;
+	DefaultBudget.MaxDistanceForOccluder = GSOMaxDistanceForOccluder;
+	DefaultBudget.MinScreenRadiusForOccluder = GSOMinScreenRadiusForOccluder;
 
 	// Submit occlusion scene for next frame
 	FrameResults = FOcclusionFrameResults();
+	FrameResults.GatherFrameNumber = GFrameCounter;
+	const double GatherStartTime = FPlatformTime::Seconds();
 	const FOcclusionViewInfo ViewInfo = FOcclusionViewInfo(PlayerCameraManager);
-	FOcclusionSceneData SceneData = CollectSceneData(Scene, ViewInfo);
+	UpdateOccluderCells(ViewInfo.Origin);
+	TArray<uint32> RequestedOccluders;
+	FOcclusionSceneData SceneData = CollectSceneData(Scene, ViewInfo, BudgetController.GetBudget(DefaultBudget), RequestedOccluders);
+	UpdateOccluderResidency(RequestedOccluders);
+	FrameResults.GatherTimeMs = PopulateTimeMs + static_cast<float>((FPlatformTime::Seconds() - GatherStartTime) * 1000.0);
+	FrameResults.NumOccluders = SceneData.OccluderData.Num() + SceneData.OccluderBoxes.Num();
+	FrameResults.NumOccludees = SceneData.OccludeeBoxPrimId.Num();
+	TRACE_COUNTER_SET(SOGatherMs, FrameResults.GatherTimeMs);
+
+	SceneData.bRecordVisibilitySnapshot = GSOVisibilityQueries == 2 ||
+		(GSOVisibilityQueries == 1 && GFrameCounter - LastVisibilityQueryFrame.load(std::memory_order_relaxed) <= VISIBILITY_QUERY_IDLE_FRAMES);
+
+	if (GSOCaptureScenePending)
+	{
+		GSOCaptureScenePending = false;
+		SaveSceneCapture(SceneData, GSOCaptureSceneFileName);
+	}
 
 	// Submit occlusion task
 	TaskRef = FFunctionGraphTask::CreateAndDispatchWhenReady(
 		[SceneData = MoveTemp(SceneData), FrameResults = &FrameResults]()
 		{
+			const double ProcessStartTime = FPlatformTime::Seconds();
 			ProcessOcclusionFrame(SceneData, *FrameResults);
+			FrameResults->ProcessTimeMs = static_cast<float>((FPlatformTime::Seconds() - ProcessStartTime) * 1000.0);
 		}, 
 		GET_STATID(STAT_SoftwareOcclusionProcess), 
 		NULL, 
@@ -255,49 +774,115 @@ int32 UOcclusionCullingSubsystem::ProcessScene(const TArray<FOcclusionPrimitiveP
 	);
 
 	// Apply available occlusion results
-	return ApplyResults(Scene);
+	FOcclusionFrameAnalytics FrameAnalytics;
+	const bool bAnalytics = FOcclusionAnalytics::IsEnabled() && LastFrameResults.GatherFrameNumber != 0;
+	const double ApplyStartTime = FPlatformTime::Seconds();
+	const int32 NumOccluded = ApplyResults(Scene, bAnalytics ? &FrameAnalytics : nullptr);
+
+	if (bAnalytics)
+	{
+		// Attributed to the frame the applied results were gathered in
+		FrameAnalytics.FrameNumber = LastFrameResults.GatherFrameNumber;
+		FrameAnalytics.GatherTimeMs = LastFrameResults.GatherTimeMs;
+		FrameAnalytics.ProcessTimeMs = LastFrameResults.ProcessTimeMs;
+		FrameAnalytics.ApplyTimeMs = static_cast<float>((FPlatformTime::Seconds() - ApplyStartTime) * 1000.0);
+		FrameAnalytics.FlushWaitTimeMs = FlushWaitTimeMs;
+		FrameAnalytics.ResultsLatency = static_cast<int32>(GFrameCounter - LastFrameResults.GatherFrameNumber);
+		FrameAnalytics.NumOccluders = LastFrameResults.NumOccluders;
+		FrameAnalytics.NumOccluderTriangles = LastFrameResults.NumOccluderTriangles;
+		FrameAnalytics.NumOccludees = LastFrameResults.NumOccludees;
+		FrameAnalytics.NumCulled = NumOccluded;
+		Analytics.AddFrame(FrameAnalytics);
+	}
+
+	return NumOccluded;
+}
+
+TSharedPtr<const FOcclusionVisibilitySnapshot, ESPMode::ThreadSafe> UOcclusionCullingSubsystem::GetVisibilitySnapshot() const
+{
+	LastVisibilityQueryFrame.store(GFrameCounter, std::memory_order_relaxed);
+
+	FScopeLock Lock(&VisibilitySnapshotLock);
+	return VisibilitySnapshot;
+}
+
+void UOcclusionCullingSubsystem::QueryBoxVisibility(TConstArrayView<FBox> Boxes, TArray<bool>& OutVisible) const
+{
+	const TSharedPtr<const FOcclusionVisibilitySnapshot, ESPMode::ThreadSafe> Snapshot = GetVisibilitySnapshot();
+	if (!Snapshot)
+	{
+		OutVisible.Init(true, Boxes.Num());
+		return;
+	}
+
+	OutVisible.SetNumUninitialized(Boxes.Num());
+	Snapshot->QueryBoxes(Boxes, OutVisible);
+}
+
+void UOcclusionCullingSubsystem::QueryPointVisibility(TConstArrayView<FVector> Points, TArray<bool>& OutVisible) const
+{
+	const TSharedPtr<const FOcclusionVisibilitySnapshot, ESPMode::ThreadSafe> Snapshot = GetVisibilitySnapshot();
+	if (!Snapshot)
+	{
+		OutVisible.Init(true, Points.Num());
+		return;
+	}
+
+	OutVisible.SetNumUninitialized(Points.Num());
+	Snapshot->QueryPoints(Points, OutVisible);
 }
 
 FOcclusionSceneData UOcclusionCullingSubsystem::CollectSceneData(const TArray<FOcclusionPrimitiveProxy>& Scene,
-                                                                 FOcclusionViewInfo View)
+                                                                 FOcclusionViewInfo View, const FOcclusionBudget& Budget,
+                                                                 TArray<uint32>& OutRequestedOccluders)
 {
 	int32 NumCollectedOccluders = 0;
 	int32 NumCollectedOccludees = 0;
 
 	const FMatrix ViewProjMat = View.ViewMatrix * View.ProjectionMatrix;
 	const FVector ViewOrigin = View.Origin;
-	const float MaxDistanceSquared = FMath::Square(GSOMaxDistanceForOccluder);
+	const float MaxDistanceSquared = FMath::Square(Budget.MaxDistanceForOccluder);
+	const bool bUseOccluderCells = CurrentOccluderCell != INDEX_NONE;
 
 	// Allocate occlusion scene
 	FOcclusionSceneData SceneData;
 	SceneData.ViewProj = ViewProjMat;
+	SceneData.ViewOrigin = ViewOrigin;
 
 	constexpr int32 NumReserveOccludee = 1024;
 	SceneData.OccludeeBoxPrimId.Reserve(NumReserveOccludee);
+	SceneData.OccludeeBoxInstanceIdx.Reserve(NumReserveOccludee);
 	SceneData.OccludeeBoxMinMax.Reserve(NumReserveOccludee * 2);
-	SceneData.OccluderData.Reserve(GSOMaxOccluderNum);
+	SceneData.OccluderData.Reserve(Budget.MaxOccluderNum);
 
 	// Collect scene geometry for occluder/occluded
 	{
 		SCOPE_CYCLE_COUNTER(STAT_SoftwareOcclusionGather);
+		SO_TRACE_SCOPE(SoftwareOcclusion_CollectSceneData);
 
 		FSWOccluderElementsCollector Collector(SceneData);
 
 		TArray<FPotentialOccluderPrimitive> PotentialOccluders;
-		PotentialOccluders.Reserve(GSOMaxOccluderNum);
+		PotentialOccluders.Reserve(Budget.MaxOccluderNum);
 
-		for (const FOcclusionPrimitiveProxy& Info : Scene)
+		// Collects a primitive, or one of its instances, as potential occluder and/or occludee
+		auto CollectElement = [&](const FOcclusionPrimitiveProxy& Info, const FBoxSphereBounds& Bounds, const FMatrix& LocalToWorld, const int32 InstanceIndex)
 		{
-			FBoxSphereBounds Bounds = Info.Bounds;
 			const FPrimitiveComponentId PrimitiveComponentId = Info.PrimitiveComponentId;
-			FMatrix LocalToWorld = Info.LocalToWorld;
 
 			const bool bHasHugeBounds = Bounds.SphereRadius > HALF_WORLD_MAX / 2.0f; // big objects like skybox
 			float DistanceSquared = 0.f;
 			float ScreenSize = 0.f;
 
 			// Find out whether primitive can/should be occluder or occludee
-			bool bCanBeOccluder = !bHasHugeBounds && Info.bOccluder;
+			bool bCanBeOccluder = !bHasHugeBounds && (Info.bOccluderEvicted || (Info.bOccluder && (Info.bOccluderIsBox || Info.OccluderData.IsValid())));
+
+			// Static occluders known to the bake are only candidates in the cells that list them
+			if (bCanBeOccluder && bUseOccluderCells && Info.BakedOccluderIndex != INDEX_NONE)
+			{
+				bCanBeOccluder = CellOccluderCandidates[Info.BakedOccluderIndex];
+			}
+
 			if (bCanBeOccluder)
 			{
 				// Size/distance requirements
@@ -307,15 +892,23 @@ FOcclusionSceneData UOcclusionCullingSubsystem::CollectSceneData(const TArray<FO
 					ScreenSize = ComputeBoundsScreenSize(Bounds.Origin, Bounds.SphereRadius, View.Origin, View.ProjectionMatrix);
 				}
 
-				bCanBeOccluder = GSOMinScreenRadiusForOccluder < ScreenSize;
+				bCanBeOccluder = Budget.MinScreenRadiusForOccluder < ScreenSize;
+			}
+
+			// Evicted occluders are extracted again and take part once ready
+			if (bCanBeOccluder)
+			{
+				OutRequestedOccluders.Add(PrimitiveComponentId.PrimIDValue);
+				bCanBeOccluder = !Info.bOccluderEvicted;
 			}
 
 			if (bCanBeOccluder)
 			{
 				FPotentialOccluderPrimitive PotentialOccluder;
 				PotentialOccluder.PrimitiveComponentId = PrimitiveComponentId;
-				PotentialOccluder.OccluderData = Info.OccluderData;
+				PotentialOccluder.OccluderData = SelectOccluderLOD(Info, ScreenSize);
 				PotentialOccluder.LocalToWorld = LocalToWorld;
+				PotentialOccluder.bBox = Info.bOccluderIsBox;
 				PotentialOccluder.Weight = ComputePotentialOccluderWeight(ScreenSize, DistanceSquared);
 				PotentialOccluders.Add(PotentialOccluder);
 			}
@@ -323,27 +916,58 @@ FOcclusionSceneData UOcclusionCullingSubsystem::CollectSceneData(const TArray<FO
 			if (!bHasHugeBounds && Info.bOcluded)
 			{
 				// Collect occluded box
-				CollectOccludeeGeom(Bounds, PrimitiveComponentId, SceneData);
+				CollectOccludeeGeom(Bounds, PrimitiveComponentId, InstanceIndex, SceneData);
 				NumCollectedOccludees++;
 			}
+		};
+
+		{
+			SO_TRACE_SCOPE(SoftwareOcclusion_CollectCandidates);
+			for (const FOcclusionPrimitiveProxy& Info : Scene)
+			{
+				if (Info.Instances.IsValid())
+				{
+					const FOcclusionInstanceData& Instances = *Info.Instances;
+					for (int32 InstanceIndex = 0; InstanceIndex < Instances.Num(); ++InstanceIndex)
+					{
+						CollectElement(Info, Instances.Bounds[InstanceIndex], Instances.LocalToWorld[InstanceIndex], InstanceIndex);
+					}
+				}
+				else
+				{
+					CollectElement(Info, Info.Bounds, Info.LocalToWorld, INDEX_NONE);
+				}
+			}
 		}
 
 		// Sort potential occluders by weight
-		PotentialOccluders.Sort([&](const FPotentialOccluderPrimitive& A, const FPotentialOccluderPrimitive& B) {
-			return A.Weight > B.Weight;
-		});
+		{
+			SO_TRACE_SCOPE(SoftwareOcclusion_SortCandidates);
+			PotentialOccluders.Sort([&](const FPotentialOccluderPrimitive& A, const FPotentialOccluderPrimitive& B) {
+				return A.Weight > B.Weight;
+			});
+		}
+		TRACE_COUNTER_SET(SOCandidateOccluders, PotentialOccluders.Num());
 
-		// Add sorted occluders to scene up to GSOMaxOccluderNum
+		// Add sorted occluders to scene up to the occluder budget
+		SO_TRACE_SCOPE(SoftwareOcclusion_AddOccluders);
 		for (const FPotentialOccluderPrimitive& PotentialOccluder : PotentialOccluders)
 		{
 			const FPrimitiveComponentId PrimitiveComponentId = PotentialOccluder.PrimitiveComponentId;
 
 			// Collect occluder geometry
 			Collector.SetPrimitiveID(PrimitiveComponentId);
-			Collector.AddElements(PotentialOccluder.OccluderData.Vertices, PotentialOccluder.OccluderData.Indices, PotentialOccluder.LocalToWorld);
+			if (PotentialOccluder.bBox)
+			{
+				Collector.AddBox(PotentialOccluder.LocalToWorld);
+			}
+			else
+			{
+				Collector.AddElements(PotentialOccluder.OccluderData, PotentialOccluder.LocalToWorld);
+			}
 			NumCollectedOccluders++;
 
-			if (NumCollectedOccluders >= GSOMaxOccluderNum)
+			if (NumCollectedOccluders >= Budget.MaxOccluderNum)
 			{
 				break;
 			}
@@ -352,36 +976,62 @@ FOcclusionSceneData UOcclusionCullingSubsystem::CollectSceneData(const TArray<FO
 
 	INC_DWORD_STAT_BY(STAT_SoftwareOccluders, NumCollectedOccluders);
 	INC_DWORD_STAT_BY(STAT_SoftwareOccludees, NumCollectedOccludees);
+	TRACE_COUNTER_SET(SOSelectedOccluders, NumCollectedOccluders);
+	TRACE_COUNTER_SET(SOOccludees, NumCollectedOccludees);
 
 	return SceneData;
 }
 
-int32 UOcclusionCullingSubsystem::ApplyResults(const TArray<FOcclusionPrimitiveProxy> Scene)
+int32 UOcclusionCullingSubsystem::ApplyResults(const TArray<FOcclusionPrimitiveProxy> Scene, FOcclusionFrameAnalytics* OutAnalytics)
 {
+	SO_TRACE_SCOPE(SoftwareOcclusion_ApplyResults);
+
 	int32 NumOccluded = 0;
 
 	for (const FOcclusionPrimitiveProxy& Proxy : Scene)
 	{
-		// Visible by default
-		bool bHidden = false;
-		FPrimitiveComponentId PrimId = Proxy.PrimitiveComponentId;
-		if (const bool* bVisiblePtr = LastFrameResults.VisibilityMap.Find(PrimId))
+		UOcclusionPrimitiveContext* const* PrimitiveInfo = PrimitiveContextMap.Find(Proxy.PrimitiveComponentId.PrimIDValue);
+		if(!PrimitiveInfo || !IsValid(*PrimitiveInfo))
 		{
-			if (*bVisiblePtr == false)
-			{
-				bHidden = true;
-				NumOccluded++;
-			}
+			continue;
 		}
+		UOcclusionPrimitiveContext* Context = *PrimitiveInfo;
+		const bool bWasHidden = Context->IsHiddenInGame();
+		const int32 NumCulled = Context->ApplyVisibility(LastFrameResults);
+		NumOccluded += NumCulled;
 
-		if(!PrimitiveContextMap.Contains(Proxy.PrimitiveComponentId.PrimIDValue))
+		if (OutAnalytics)
 		{
-			continue;
+			const FOcclusionRenderCost SavedCost = Context->GetCulledRenderCost(NumCulled);
+			OutAnalytics->SavedTriangles += SavedCost.NumTriangles;
+			OutAnalytics->SavedDrawCalls += SavedCost.NumDrawCalls;
+
+			// Instances culled while their component stays visible are only marked for the material
+			const bool bHidden = Context->IsHiddenInGame();
+			if (!bHidden)
+			{
+				OutAnalytics->NumCustomDataCulled += NumCulled;
+			}
+
+			// Shown by the test for a while, but not drawn by the renderer either, e.g. because of its own occlusion culling.
+			// Nothing is drawn without an RHI, so it is not measured there.
+			const UPrimitiveComponent* Component = Context->GetPrimitiveComponent();
+			if (!GUsingNullRHI && !bHidden && !bWasHidden && Proxy.bOcluded && IsValid(Component) && LastFrameResults.VisibilityMap.Contains(Proxy.PrimitiveComponentId)
+				&& !Component->WasRecentlyRendered(FALSE_VISIBLE_RENDER_TOLERANCE))
+			{
+				OutAnalytics->NumFalseVisible++;
+			}
 		}
-		PrimitiveContextMap[Proxy.PrimitiveComponentId.PrimIDValue]->SetHiddenInGame(bHidden);
 	}
 
 	INC_DWORD_STAT_BY(STAT_SoftwareCulledPrimitives, NumOccluded);
+	TRACE_COUNTER_SET(SOCulledPrimitives, NumOccluded);
+
+	// Frames between gathering the scene and applying its results
+	if (LastFrameResults.GatherFrameNumber != 0)
+	{
+		TRACE_COUNTER_SET(SOResultsLatency, static_cast<int64>(GFrameCounter - LastFrameResults.GatherFrameNumber));
+	}
 
 	return NumOccluded;
 }
@@ -390,7 +1040,12 @@ void UOcclusionCullingSubsystem::FlushSceneProcessing()
 {
 	if (TaskRef.IsValid())
 	{
+		SO_TRACE_SCOPE(SoftwareOcclusion_FlushWait);
+
+		const double WaitStartTime = FPlatformTime::Seconds();
 		FTaskGraphInterface::Get().WaitUntilTaskCompletes(TaskRef);
 		TaskRef = nullptr;
+		FlushWaitTimeMs = static_cast<float>((FPlatformTime::Seconds() - WaitStartTime) * 1000.0);
+		TRACE_COUNTER_SET(SOFlushWaitMs, FlushWaitTimeMs);
 	}
 }
\ No newline at end of file
@@ -17,10 +17,10 @@ void USoftwareOcclusionCullingOverride::BeginPlay()
 	UOcclusionCullingSubsystem* OcclusionCullingSubsystem = GetWorld()->GetFirstPlayerController()->GetLocalPlayer()->GetSubsystem<UOcclusionCullingSubsystem>();
 	checkf(OcclusionCullingSubsystem, TEXT("USoftwareOcclusionCullingOverride used without a UOcclusionCullingSubsystem present! Make sure the WorldFoundation plugin is enabled"));
 	
-	TArray<UStaticMeshComponent*> StaticMeshComponents;
-	GetOwner()->GetComponents<UStaticMeshComponent>(StaticMeshComponents);
-	for(UStaticMeshComponent* StaticMeshComponent : StaticMeshComponents)
+	TArray<UPrimitiveComponent*> PrimitiveComponents;
+	GetOwner()->GetComponents<UPrimitiveComponent>(PrimitiveComponents);
+	for(UPrimitiveComponent* PrimitiveComponent : PrimitiveComponents)
 	{
-		OcclusionCullingSubsystem->RegisterOcclusionSettings(StaticMeshComponent, OcclusionSettings);	
+		OcclusionCullingSubsystem->RegisterOcclusionSettings(PrimitiveComponent, OcclusionSettings);	
 	}
 }
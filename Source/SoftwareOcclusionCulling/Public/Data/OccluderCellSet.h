@@ -0,0 +1,85 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+/**
+ * Header of a baked occluder cell file. It is followed by NumOccluders occluder keys (uint64),
+ * NumCells + 1 cell offsets (uint32) and NumEntries cell entries (uint32), so the file is used as mapped.
+ * Everything is little endian.
+ */
+struct FOccluderCellFileHeader
+{
+	static constexpr uint32 MAGIC = 0x4C43534F;
+	static constexpr uint32 VERSION = 1;
+
+	uint32 Magic = MAGIC;
+	uint32 Version = VERSION;
+	double Origin[3] = { 0.0, 0.0, 0.0 };
+	float CellSize = 0.f;
+	int32 NumCells[3] = { 0, 0, 0 };
+	uint32 NumOccluders = 0;
+	uint32 NumEntries = 0;
+};
+
+/** Baked cells in the layout of the file */
+struct FOccluderCellSetData
+{
+	FVector Origin = FVector::ZeroVector;
+	float CellSize = 0.f;
+	FIntVector NumCells = FIntVector::ZeroValue;
+
+	/** Stable identifiers of the static occluders, see FOccluderCellSet::MakeOccluderKey */
+	TArray<uint64> OccluderKeys;
+
+	/** Cell C lists CellEntries[CellOffsets[C]] to CellEntries[CellOffsets[C + 1]], indices into OccluderKeys */
+	TArray<uint32> CellOffsets;
+	TArray<uint32> CellEntries;
+};
+
+/**
+ * Potential occluder sets of view cells, baked offline for the static occluders of a world.
+ * The file is memory mapped, so only the cells the camera visits are paged in.
+ */
+class SOFTWAREOCCLUSIONCULLING_API FOccluderCellSet
+{
+public:
+	FOccluderCellSet();
+	~FOccluderCellSet();
+
+	bool Load(const FString& Path);
+
+	FORCEINLINE bool IsLoaded() const
+	{
+		return Header != nullptr;
+	}
+
+	/** Returns INDEX_NONE outside of the baked cells */
+	int32 FindCell(const FVector& Location) const;
+
+	/** Occluders of a cell, most important first */
+	TConstArrayView<uint32> GetCellOccluders(int32 Cell) const;
+
+	TConstArrayView<uint64> GetOccluderKeys() const;
+
+	static bool Save(const FString& Path, const FOccluderCellSetData& Data);
+
+	/** File of the baked cells of a world */
+	static FString GetPath(const UWorld* World);
+
+	/** Identifier of a static primitive that is the same in the editor, PIE and cooked builds */
+	static uint64 MakeOccluderKey(const UPrimitiveComponent* PrimitiveComponent);
+
+private:
+	TUniquePtr<IMappedFileHandle> FileHandle;
+	TUniquePtr<IMappedFileRegion> FileRegion;
+
+	const FOccluderCellFileHeader* Header = nullptr;
+	const uint64* OccluderKeys = nullptr;
+	const uint32* CellOffsets = nullptr;
+	const uint32* CellEntries = nullptr;
+};
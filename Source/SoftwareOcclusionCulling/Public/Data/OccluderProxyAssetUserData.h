@@ -0,0 +1,45 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/AssetUserData.h"
+#include "OccluderProxyAssetUserData.generated.h"
+
+/**
+ * Low-poly occluder proxy stored on a static mesh. Generated offline to be inscribed in the render geometry,
+ * so it never occludes more than the mesh itself. Used by the occlusion culling instead of the render LOD.
+ * Inscribed boxes take precedence over the proxy triangles when present.
+ */
+UCLASS()
+class SOFTWAREOCCLUSIONCULLING_API UOccluderProxyAssetUserData : public UAssetUserData
+{
+	GENERATED_BODY()
+
+public:
+	FORCEINLINE bool HasProxy() const
+	{
+		return Vertices.Num() > 0 && Indices.Num() > 0;
+	}
+
+	FORCEINLINE bool HasBoxes() const
+	{
+		return Boxes.Num() > 0;
+	}
+
+	/** Proxy vertices in mesh space */
+	UPROPERTY(VisibleAnywhere, Category = "Occluder Proxy")
+	TArray<FVector3f> Vertices;
+
+	/** Proxy triangles, same winding as the render geometry */
+	UPROPERTY(VisibleAnywhere, Category = "Occluder Proxy")
+	TArray<uint16> Indices;
+
+	/** Boxes inscribed in the mesh, in mesh space */
+	UPROPERTY(VisibleAnywhere, Category = "Occluder Proxy")
+	TArray<FBox3f> Boxes;
+
+	/** Triangle count of the render LOD the proxy was generated from */
+	UPROPERTY(VisibleAnywhere, Category = "Occluder Proxy")
+	int32 SourceTriangleCount = 0;
+};
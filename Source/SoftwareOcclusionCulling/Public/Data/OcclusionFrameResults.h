@@ -1,6 +1,7 @@
 ﻿#pragma once
 
 #include "CoreMinimal.h"
+#include "Data/OcclusionVisibilitySnapshot.h"
 #include "OcclusionFrameResults.generated.h"
 
 static constexpr int32 BIN_WIDTH = 64;
@@ -25,4 +26,29 @@ struct FOcclusionFrameResults
 	FFramebufferBin	Bins[BIN_NUM];
 
 	TMap<FPrimitiveComponentId, bool> VisibilityMap;
+
+	/** Per-instance visibility of instanced primitives. VisibilityMap holds whether any of their instances is visible */
+	TMap<FPrimitiveComponentId, TBitArray<>> InstanceVisibilityMap;
+
+	/** Game thread time spent gathering the scene for this frame, in milliseconds */
+	float GatherTimeMs = 0.f;
+
+	/** Wall time of the occlusion task that produced these results, in milliseconds */
+	float ProcessTimeMs = 0.f;
+
+	/** GFrameCounter when the scene of these results was gathered, 0 before the first frame */
+	uint64 GatherFrameNumber = 0;
+
+	int32 NumOccluders = 0;
+	int32 NumOccludees = 0;
+
+	/** Occluder triangles that reached the rasterizer */
+	int32 NumOccluderTriangles = 0;
+
+	/** Framebuffer rectangle of every occludee, recorded with r.so.DebugView.Occludees. Empty for near clipped and off screen boxes */
+	TArray<FIntRect> DebugOccludeeQuads;
+	TArray<uint8> DebugOccludeeVisibility;
+
+	/** Coverage and occluder depth of the frame for visibility queries, null when the scene did not record them */
+	TSharedPtr<const FOcclusionVisibilitySnapshot, ESPMode::ThreadSafe> VisibilitySnapshot;
 };
\ No newline at end of file
@@ -0,0 +1,36 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Data/OcclusionPrimitiveContext.h"
+#include "OcclusionInstancedContext.generated.h"
+
+/**
+ * Occlusion context of an instanced static mesh component. Every instance is tested as a separate occludee
+ * and can be selected as a separate occluder.
+ */
+UCLASS()
+class UOcclusionInstancedContext : public UOcclusionPrimitiveContext
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool ShouldUpdateBounds() const override;
+	virtual int32 ApplyVisibility(const FOcclusionFrameResults& Results) override;
+	virtual void RestoreVisibility() override;
+	virtual FOcclusionRenderCost GetCulledRenderCost(int32 NumCulled) const override;
+
+protected:
+	virtual void UpdateBoundsInternal() override;
+
+	/** Instances share the mesh space LODs */
+	virtual bool ShouldCacheWorldSpaceOccluder() const override
+	{
+		return false;
+	}
+
+private:
+	/** Instance visibility last written to the custom data of the component */
+	TBitArray<> AppliedInstanceVisibility;
+};
@@ -0,0 +1,40 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Data/OcclusionPrimitiveContext.h"
+#include "OcclusionLandscapeContext.generated.h"
+
+class ULandscapeComponent;
+
+/**
+ * Occlusion context of a landscape component. The component heightfield is sampled over several frames
+ * and turned into a chain of coarse occluder patches that stay below the terrain surface.
+ */
+UCLASS()
+class UOcclusionLandscapeContext : public UOcclusionPrimitiveContext
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool ShouldUpdateBounds() const override;
+
+protected:
+	virtual void UpdateBoundsInternal() override;
+
+private:
+	/** Samples the heightfield within the per-frame budget. Returns true once every sample is available. */
+	bool SampleHeights(const ULandscapeComponent* LandscapeComponent);
+
+	/** Builds the occluder patch LODs from the sampled heights */
+	void BuildPatches(const ULandscapeComponent* LandscapeComponent);
+
+	/** Heights relative to PatchOrigin, MAX_flt for holes. Released once the patches are built. */
+	TArray<float> Heights;
+
+	FVector PatchOrigin = FVector::ZeroVector;
+	int32 NumSamplesPerSide = 0;
+	int32 NumSampled = 0;
+	bool bPatchesBuilt = false;
+};
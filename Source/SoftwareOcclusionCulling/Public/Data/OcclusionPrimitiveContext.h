@@ -3,10 +3,23 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "Containers/List.h"
 #include "Data/OcclusionPrimitiveProxy.h"
 #include "Data/SoftwareOcclusionSettings.h"
 #include "OcclusionPrimitiveContext.generated.h"
 
+struct FOcclusionFrameResults;
+struct FOccluderExtraction;
+struct FOccluderLODSet;
+
+/** Rendering work of a primitive, estimated from its mesh */
+struct FOcclusionRenderCost
+{
+	int64 NumTriangles = 0;
+	int32 NumDrawCalls = 0;
+};
+
 UCLASS()
 class UOcclusionPrimitiveContext : public UObject
 {
@@ -14,13 +27,28 @@ class UOcclusionPrimitiveContext : public UObject
 
 public:
 	UOcclusionPrimitiveContext()=default;
-	void Setup(UStaticMeshComponent* InStaticMeshComponent, const FOcclusionSettings& NewOcclusionSettings);
-	void SetMesh(UStaticMeshComponent* InStaticMeshComponent);
-	bool PerformFrustumCull(const APlayerCameraManager* PlayerCameraManager) const;
-	bool ShouldUpdateBounds() const;
-	void SetHiddenInGame(const bool bHidden) const;
+	void Setup(UPrimitiveComponent* InPrimitiveComponent, const FOcclusionSettings& NewOcclusionSettings);
+	virtual void SetPrimitive(UPrimitiveComponent* InPrimitiveComponent);
+	bool PerformFrustumCull(const APlayerCameraManager* PlayerCameraManager);
+	virtual bool ShouldUpdateBounds() const;
+	virtual void SetHiddenInGame(const bool bHidden);
 	void DebugBounds() const;
 
+	/** Applies the occlusion results to the primitive. Returns the number of culled primitives or instances. */
+	virtual int32 ApplyVisibility(const FOcclusionFrameResults& Results);
+
+	/** Rendering work saved by the NumCulled primitives or instances returned by ApplyVisibility */
+	virtual FOcclusionRenderCost GetCulledRenderCost(int32 NumCulled) const;
+
+	/** Shows what the plugin hid, before the context is released */
+	virtual void RestoreVisibility();
+
+	/** Whether the primitive is currently hidden by the plugin */
+	FORCEINLINE bool IsHiddenInGame() const
+	{
+		return bHiddenInGame;
+	}
+
 	FORCEINLINE void SetOcclusionSettings(const FOcclusionSettings& NewOcclusionSettings)
 	{
 		OcclusionSettings = NewOcclusionSettings;
@@ -34,17 +62,101 @@ public:
 		}
 	}
 
+	/** Launches the pending occluder extraction within the frame budget, and makes the primitive an occluder once it completed */
+	void TickOccluderExtraction();
+
 	FORCEINLINE FOcclusionPrimitiveProxy GetProxy()
 	{
 		return PrimitiveProxy;
 	}
 
-private:
-	void UpdateBoundsInternal();
+	FORCEINLINE UPrimitiveComponent* GetPrimitiveComponent() const
+	{
+		return PrimitiveComponent;
+	}
+
+	/** Memory held by the extracted occluder geometry that can be evicted */
+	SIZE_T GetOccluderAllocatedSize() const;
+
+	/** Whether the primitive holds extracted occluder geometry that can be evicted */
+	FORCEINLINE bool HasEvictableOccluder() const
+	{
+		return MeshLODs.IsValid() || CachedLocalToWorld.IsSet();
+	}
+
+	/** Drops the extracted occluder geometry until the primitive is requested as occluder again */
+	void EvictOccluder();
+
+	/** Records that the primitive qualified as occluder, extracting its geometry again if it was evicted */
+	void MarkOccluderUsed(uint64 FrameNumber);
+
+	FORCEINLINE uint64 GetLastOccluderUseFrame() const
+	{
+		return LastOccluderUseFrame;
+	}
+
+	FORCEINLINE void SetBakedOccluderIndex(const int32 Index)
+	{
+		PrimitiveProxy.BakedOccluderIndex = Index;
+	}
+
+	using FResidentNode = TDoubleLinkedList<UOcclusionPrimitiveContext*>::TDoubleLinkedListNode;
+
+	/** Node of the primitive in the resident occluder list of the subsystem, null while it is not listed */
+	FORCEINLINE FResidentNode* GetResidentNode() const
+	{
+		return ResidentNode;
+	}
+
+	FORCEINLINE void SetResidentNode(FResidentNode* Node)
+	{
+		ResidentNode = Node;
+	}
+
+protected:
+	virtual void UpdateBoundsInternal();
+
+	/** Whether the occluder LODs can be baked in world space, which needs a single transform that never changes */
+	virtual bool ShouldCacheWorldSpaceOccluder() const;
 
 	UPROPERTY()
-	UStaticMeshComponent* StaticMeshComponent;
+	UPrimitiveComponent* PrimitiveComponent;
 	
 	FOcclusionSettings OcclusionSettings;
 	FOcclusionPrimitiveProxy PrimitiveProxy;
+
+private:
+	/** Whether the primitive provides occluder geometry, static meshes and fused occluders do */
+	bool HasOccluderSource() const;
+
+	/** Copies the occluder geometry of the primitive, to be built away from the game thread */
+	TSharedRef<FOccluderExtraction> CreateOccluderExtraction() const;
+
+	/** Sets whether the proxy is an occluder and an occludee, from its bounds, settings and occluder geometry */
+	void UpdateProxyFlags();
+
+	/** Points the proxy at the mesh space LODs, or at LODs baked with the current transform for static occluders */
+	void UpdateOccluderLODs();
+
+	/** Extracts the LODs again, once the baked ones no longer fit and the mesh space ones were released */
+	void RequestOccluderExtraction();
+
+	/** Occluder geometry waiting for extraction budget */
+	bool bOccluderExtractionPending = false;
+
+	/** Occluder geometry being extracted by ExtractionTask */
+	TSharedPtr<FOccluderExtraction> Extraction;
+	FGraphEventRef ExtractionTask;
+
+	/** Occluder LODs in mesh space, shared with the primitives of the same mesh. Released once baked in world space. */
+	TSharedPtr<const FOccluderLODSet> MeshLODs;
+
+	/** Transform the world space LODs were baked with, if any, and the world position they are relative to */
+	TOptional<FMatrix> CachedLocalToWorld;
+	FVector CachedAnchor = FVector::ZeroVector;
+
+	uint64 LastOccluderUseFrame = 0;
+	FResidentNode* ResidentNode = nullptr;
+
+	bool bHiddenInGame = false;
 };
\ No newline at end of file
@@ -12,14 +12,27 @@ struct FOcclusionSceneData
 	UPROPERTY()
 	FMatrix ViewProj;
 
+	UPROPERTY()
+	FVector ViewOrigin = FVector::ZeroVector;
+
 	UPROPERTY()
 	TArray<FVector> OccludeeBoxMinMax;
 
 	TArray<FPrimitiveComponentId> OccludeeBoxPrimId;
 
+	/** Instance index of each occludee box, INDEX_NONE when the box covers the whole primitive */
+	TArray<int32> OccludeeBoxInstanceIdx;
+
 	UPROPERTY()
 	TArray<FOcclusionMeshData> OccluderData;
 
+	/** Box occluders, each matrix maps the [-1, 1] cube to world space */
+	UPROPERTY()
+	TArray<FMatrix> OccluderBoxes;
+
 	UPROPERTY()
 	int32 NumOccluderTriangles = 0;
+
+	/** Record the occluder depth and publish a visibility snapshot with the results, see r.so.VisibilityQueries */
+	bool bRecordVisibilitySnapshot = false;
 };
@@ -0,0 +1,28 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/SkinnedMeshComponent.h"
+#include "Data/OcclusionPrimitiveContext.h"
+#include "OcclusionSkinnedContext.generated.h"
+
+/**
+ * Occlusion context of a skinned mesh component. Occluded meshes that always tick their pose stop ticking it,
+ * so culling saves the animation cost and not only the draw.
+ */
+UCLASS()
+class UOcclusionSkinnedContext : public UOcclusionPrimitiveContext
+{
+	GENERATED_BODY()
+
+public:
+	virtual void SetHiddenInGame(const bool bHidden) override;
+	virtual FOcclusionRenderCost GetCulledRenderCost(int32 NumCulled) const override;
+
+private:
+	/** Tick option of the component before it was occluded */
+	EVisibilityBasedAnimTickOption RestoreAnimTickOption = EVisibilityBasedAnimTickOption::AlwaysTickPose;
+
+	bool bAnimationThrottled = false;
+};
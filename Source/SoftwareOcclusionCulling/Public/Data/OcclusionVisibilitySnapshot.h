@@ -0,0 +1,52 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+namespace SOCore
+{
+	struct FCoverageBuffer;
+	struct FCoverageDepth;
+}
+
+/**
+ * Coverage, occluder depth and view of one occlusion frame, published by UOcclusionCullingSubsystem for visibility queries.
+ * It is immutable, so any thread may query it while the next frames are processed. Boxes and points get the answer an
+ * occludee of that frame would get: hidden when closer occluders cover them, or when they are outside of the view.
+ */
+class SOFTWAREOCCLUSIONCULLING_API FOcclusionVisibilitySnapshot
+{
+public:
+	FOcclusionVisibilitySnapshot(const FMatrix& ViewProj, const FVector& InViewOrigin, uint64 InFrameNumber,
+	                             TUniquePtr<SOCore::FCoverageBuffer> InCoverage, TUniquePtr<SOCore::FCoverageDepth> InCoverageDepth);
+	~FOcclusionVisibilitySnapshot();
+
+	/** OutVisible receives the visibility of each box and must have as many entries as Boxes */
+	void QueryBoxes(TConstArrayView<FBox> Boxes, TArrayView<bool> OutVisible) const;
+
+	/** OutVisible receives the visibility of each point and must have as many entries as Points */
+	void QueryPoints(TConstArrayView<FVector> Points, TArrayView<bool> OutVisible) const;
+
+	/** GFrameCounter when the scene of the snapshot was gathered */
+	FORCEINLINE uint64 GetFrameNumber() const
+	{
+		return FrameNumber;
+	}
+
+	FORCEINLINE const FVector& GetViewOrigin() const
+	{
+		return ViewOrigin;
+	}
+
+private:
+	void Query(int32 Num, TFunctionRef<void(int32 Index, FVector& OutMin, FVector& OutMax)> GetBox, TArrayView<bool> OutVisible) const;
+
+	/** Camera relative world to framebuffer pixels */
+	FMatrix44f WorldToFramebuffer;
+	FVector ViewOrigin;
+	uint64 FrameNumber;
+
+	TUniquePtr<SOCore::FCoverageBuffer> Coverage;
+	TUniquePtr<SOCore::FCoverageDepth> CoverageDepth;
+};
@@ -17,8 +17,10 @@ struct FOcclusionSettings
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	bool bAllowBoundsUpdate = true;
 	
+	/** Occlude with an oriented box centered on the bounds instead of the mesh. Much cheaper to rasterize */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	bool bOccluderIsScaledUnitCube = false;
+	/** Scale of the occluder box relative to the local bounds of the primitive, ignoring the component scale like the mesh occluder it replaces. Instances keep their own scale. */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (EditCondition = "bOccluderIsScaledUnitCube"))
 	FVector UnitCubeScale = FVector::OneVector;
 
@@ -28,6 +30,14 @@ struct FOcclusionSettings
 	FVector CustomBounds = FVector::OneVector;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (EditCondition = "bUseCustomBounds"))
 	FVector CustomBoundsOffset = FVector::ZeroVector;
+
+	/**
+	 * Per-instance custom data slot that receives 1 for visible and 0 for occluded instances of instanced static meshes.
+	 * The material is expected to clip or collapse occluded instances. When unset, instanced meshes are only hidden
+	 * once all of their instances are occluded.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "-1"))
+	int32 InstanceVisibilityCustomDataIndex = INDEX_NONE;
 };
 
 /**
@@ -0,0 +1,39 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "FusedOccluderActor.generated.h"
+
+class UFusedOccluderComponent;
+class UStaticMeshComponent;
+
+/**
+ * Single occluder replacing a cluster of adjacent modular static meshes, generated by so.Editor.FuseOccluders.
+ * The source meshes stay occludees but stop being occluders on their own.
+ */
+UCLASS(NotBlueprintable, ClassGroup=(Custom))
+class SOFTWAREOCCLUSIONCULLING_API AFusedOccluderActor : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	AFusedOccluderActor();
+
+	FORCEINLINE UFusedOccluderComponent* GetFusedOccluderComponent() const
+	{
+		return FusedOccluderComponent;
+	}
+
+	/** Static meshes fused into this occluder */
+	UPROPERTY(VisibleAnywhere, Category = "Fused Occluder")
+	TArray<TObjectPtr<UStaticMeshComponent>> SourceComponents;
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	TObjectPtr<UFusedOccluderComponent> FusedOccluderComponent;
+};
@@ -0,0 +1,35 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/PrimitiveComponent.h"
+#include "FusedOccluderComponent.generated.h"
+
+/**
+ * Invisible primitive holding occluder geometry fused from several static meshes.
+ * It is not rendered, it only feeds the software occlusion culling.
+ */
+UCLASS(ClassGroup=(Custom))
+class SOFTWAREOCCLUSIONCULLING_API UFusedOccluderComponent : public UPrimitiveComponent
+{
+	GENERATED_BODY()
+
+public:
+	UFusedOccluderComponent();
+
+	FORCEINLINE bool HasOccluder() const
+	{
+		return Vertices.Num() > 0 && Indices.Num() > 0;
+	}
+
+	virtual FBoxSphereBounds CalcBounds(const FTransform& LocalToWorld) const override;
+
+	/** Fused occluder vertices in component space */
+	UPROPERTY(VisibleAnywhere, Category = "Fused Occluder")
+	TArray<FVector3f> Vertices;
+
+	/** Fused occluder triangles, same winding as render geometry */
+	UPROPERTY(VisibleAnywhere, Category = "Fused Occluder")
+	TArray<uint16> Indices;
+};
@@ -0,0 +1,30 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "OccluderVolume.generated.h"
+
+class UBoxComponent;
+
+/**
+ * Invisible box that only acts as an occluder. Place it inside walls, terrain or buildings whose meshes are
+ * too detailed or unsuitable to be used as occluders. The box is rasterized by its screen silhouette.
+ */
+UCLASS(Blueprintable, ClassGroup=(Custom))
+class SOFTWAREOCCLUSIONCULLING_API AOccluderVolume : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	AOccluderVolume();
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/** Occluding box, its scaled extent at BeginPlay defines the occluder */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	TObjectPtr<UBoxComponent> BoxComponent;
+};
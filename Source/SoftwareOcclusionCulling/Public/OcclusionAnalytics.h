@@ -0,0 +1,76 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** What one occlusion frame cost and what it saved the renderer */
+struct FOcclusionFrameAnalytics
+{
+	uint64 FrameNumber = 0;
+
+	/** Game thread gather including PopulateScene, occlusion task and result application, in milliseconds */
+	float GatherTimeMs = 0.f;
+	float ProcessTimeMs = 0.f;
+	float ApplyTimeMs = 0.f;
+
+	/** Game thread time spent waiting for the previous task, in milliseconds */
+	float FlushWaitTimeMs = 0.f;
+
+	/** Frames between gathering the scene and applying its results */
+	int32 ResultsLatency = 0;
+
+	int32 NumOccluders = 0;
+	int32 NumOccluderTriangles = 0;
+
+	/** Tested primitives and instances, and how many of them were culled */
+	int32 NumOccludees = 0;
+	int32 NumCulled = 0;
+
+	/** Culled instances of visible components, only marked in their custom data. They are still drawn and save nothing by themselves. */
+	int32 NumCustomDataCulled = 0;
+
+	/** Primitives left visible that the renderer did not draw either, which a better occluder set could have culled. Always 0 with -nullrhi. */
+	int32 NumFalseVisible = 0;
+
+	/** Triangles and draw calls of the culled primitives, estimated from their meshes */
+	int64 SavedTriangles = 0;
+	int32 SavedDrawCalls = 0;
+
+	FORCEINLINE float GetCostMs() const
+	{
+		return GatherTimeMs + ProcessTimeMs + ApplyTimeMs;
+	}
+};
+
+/** Per frame culling efficiency of a session, enabled with r.so.Analytics */
+class SOFTWAREOCCLUSIONCULLING_API FOcclusionAnalytics
+{
+public:
+	static bool IsEnabled();
+
+	void AddFrame(const FOcclusionFrameAnalytics& Frame);
+	void Reset();
+
+	/** Writes BasePath.csv with one row per frame and BasePath.json with the frames and a summary. Returns false if a file could not be written. */
+	bool Export(const FString& BasePath) const;
+
+	/** One line summary of the session: cull rate, false visible rate, savings and the savings per millisecond of occlusion cost */
+	FString GetSummary() const;
+
+	/** True when the session should be exported when the subsystem shuts down */
+	static bool ShouldExportOnEnd();
+
+	FORCEINLINE int32 GetNumFrames() const
+	{
+		return Frames.Num();
+	}
+
+	FORCEINLINE const TArray<FOcclusionFrameAnalytics>& GetFrames() const
+	{
+		return Frames;
+	}
+
+private:
+	TArray<FOcclusionFrameAnalytics> Frames;
+};
@@ -0,0 +1,43 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** Occluder selection limits used when collecting the occlusion scene. */
+struct FOcclusionBudget
+{
+	int32 MaxOccluderNum = 0;
+	float MaxDistanceForOccluder = 0.f;
+	float MinScreenRadiusForOccluder = 0.f;
+};
+
+/**
+ * Scales the occluder selection limits each frame so that the measured occlusion cost
+ * (gather on the game thread + processing task) converges to r.so.Budget.TargetMs.
+ */
+class FOcclusionBudgetController
+{
+public:
+	/** Feeds the cost of the last completed occlusion frame and moves the quality scale towards the target. */
+	void Update(const float FrameCostMs);
+
+	/** Returns the limits to use for the next occlusion frame, derived from the r.so.* defaults. */
+	FOcclusionBudget GetBudget(const FOcclusionBudget& DefaultBudget) const;
+
+	void Reset();
+
+	FORCEINLINE float GetQualityScale() const
+	{
+		return QualityScale;
+	}
+
+	FORCEINLINE float GetSmoothedCostMs() const
+	{
+		return SmoothedCostMs;
+	}
+
+private:
+	float SmoothedCostMs = 0.f;
+	float QualityScale = 1.f;
+};
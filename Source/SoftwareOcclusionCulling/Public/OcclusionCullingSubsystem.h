@@ -10,8 +10,14 @@
 #include "Data/OcclusionFrameResults.h"
 #include "Data/OcclusionSceneData.h"
 #include "Data/OcclusionViewInfo.h"
+#include "OcclusionAnalytics.h"
+#include "OcclusionBudgetController.h"
+#include "Data/OccluderCellSet.h"
+#include <atomic>
 #include "OcclusionCullingSubsystem.generated.h"
 
+class UTexture2D;
+
 /**
  * 
  */
@@ -25,6 +31,7 @@ public:
 	~UOcclusionCullingSubsystem();
 	UOcclusionCullingSubsystem(FVTableHelper& Helper);
 
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
 	virtual void PlayerControllerChanged(APlayerController* NewPlayerController) override;
 	virtual void Deinitialize() override;
 
@@ -36,25 +43,99 @@ public:
 	void DebugDrawToCanvas(const UCanvas* Canvas, int32 InX, int32 InY);
 
 	UFUNCTION(BlueprintCallable)
-	bool RegisterOcclusionSettings(UStaticMeshComponent* StaticMeshComponent,
+	bool RegisterOcclusionSettings(UPrimitiveComponent* PrimitiveComponent,
 	                               const FOcclusionSettings& OcclusionSettings);
 
+	/** Stops culling the primitive, showing it again if it was occluded */
 	UFUNCTION(BlueprintCallable)
-	void UnregisterOcclusionSettings(const UStaticMeshComponent* StaticMeshComponent);
+	void UnregisterOcclusionSettings(const UPrimitiveComponent* PrimitiveComponent);
+
+	/** Registers the primitives of a level that became visible */
+	void RegisterLevelPrimitives(ULevel* Level);
+
+	/** Releases the primitives of a level that is no longer visible, of every level when Level is null. Occluded primitives are shown again. */
+	void ReleaseLevelPrimitives(const ULevel* Level);
+
+	/** Context of a registered primitive, null when it is not registered */
+	UOcclusionPrimitiveContext* FindPrimitiveContext(const UPrimitiveComponent* PrimitiveComponent) const;
+
+	/** Writes the frames recorded with r.so.Analytics to Saved/Profiling/SoftwareOcclusion as CSV and JSON, a timestamped name when FileName is empty */
+	void ExportAnalytics(const FString& FileName) const;
+
+	void ResetAnalytics();
+
+	FORCEINLINE const FOcclusionAnalytics& GetAnalytics() const
+	{
+		return Analytics;
+	}
+
+	/**
+	 * Coverage and view of the latest occlusion results, for visibility queries from any thread. Null while no frame recorded one,
+	 * recording starts with the next frames once queries are made, see r.so.VisibilityQueries.
+	 */
+	TSharedPtr<const FOcclusionVisibilitySnapshot, ESPMode::ThreadSafe> GetVisibilitySnapshot() const;
+
+	/** Tests boxes against the latest visibility snapshot, all of them are visible while there is none. Safe to call from any thread. */
+	void QueryBoxVisibility(TConstArrayView<FBox> Boxes, TArray<bool>& OutVisible) const;
+
+	/** Tests points against the latest visibility snapshot, all of them are visible while there is none. Safe to call from any thread. */
+	void QueryPointVisibility(TConstArrayView<FVector> Points, TArray<bool>& OutVisible) const;
 
 private:
 	void PopulateScene(TArray<FOcclusionPrimitiveProxy>& Scene);
 	int32 ProcessScene(const TArray<FOcclusionPrimitiveProxy>& Scene);
-	FOcclusionSceneData CollectSceneData(const TArray<FOcclusionPrimitiveProxy>& Scene, FOcclusionViewInfo View);
-	int32 ApplyResults(const TArray<FOcclusionPrimitiveProxy> Scene);
+	FOcclusionSceneData CollectSceneData(const TArray<FOcclusionPrimitiveProxy>& Scene, FOcclusionViewInfo View, const FOcclusionBudget& Budget,
+	                                     TArray<uint32>& OutRequestedOccluders);
+	int32 ApplyResults(const TArray<FOcclusionPrimitiveProxy> Scene, FOcclusionFrameAnalytics* OutAnalytics);
 	void FlushSceneProcessing();
 
+	/** Uploads the coverage of LastFrameResults to DebugTexture, once per occlusion frame */
+	void UpdateDebugTexture();
+
+	/** Registers a primitive of the local player world with the default settings. Returns false if it is not culled. */
+	bool RegisterDefaultOcclusionSettings(UPrimitiveComponent* PrimitiveComponent);
+
+	void OnLevelAddedToWorld(ULevel* Level, UWorld* World);
+	void OnLevelRemovedFromWorld(ULevel* Level, UWorld* World);
+
+	/** Stamps the requested occluders and evicts the least recently used occluder geometry above the memory budget */
+	void UpdateOccluderResidency(const TArray<uint32>& RequestedOccluders);
+
+	/** Lists a context that just received occluder geometry, as the least recently used */
+	void AddResidentOccluder(UOcclusionPrimitiveContext* PrimitiveInfo);
+
+	/** Unlists a context, which must happen before it is released */
+	void RemoveResidentOccluder(UOcclusionPrimitiveContext* PrimitiveInfo);
+
+	/** Drops the contexts of destroyed primitives, every few frames as it visits every context */
+	void RemoveDestroyedPrimitives();
+
+	FDelegateHandle LevelAddedHandle;
+	FDelegateHandle LevelRemovedHandle;
+
+	/** Loads the baked occluder cells of the local player world and selects the cell of the view */
+	void UpdateOccluderCells(const FVector& ViewOrigin);
+
+	/** Index of a static primitive in the baked occluder cells */
+	int32 FindBakedOccluderIndex(const UPrimitiveComponent* PrimitiveComponent) const;
+
+	FOccluderCellSet OccluderCells;
+	FString OccluderCellsPath;
+	TMap<uint64, int32> BakedOccluderIndices;
+
+	/** Baked occluders that are candidates in the current cell, valid when CurrentOccluderCell is not INDEX_NONE */
+	TBitArray<> CellOccluderCandidates;
+	int32 CurrentOccluderCell = INDEX_NONE;
+
 	UPROPERTY()
 	APlayerCameraManager* PlayerCameraManager;
 
 	UPROPERTY()
 	TMap<uint32, UOcclusionPrimitiveContext*> PrimitiveContextMap;
 
+	/** Contexts of PrimitiveContextMap holding occluder geometry, the most recently used first */
+	TDoubleLinkedList<UOcclusionPrimitiveContext*> ResidentOccluders;
+
 	UPROPERTY()
     FOcclusionFrameResults LastFrameResults;
 
@@ -62,4 +143,30 @@ private:
 	FOcclusionFrameResults FrameResults;
 
 	FGraphEventRef TaskRef;
+
+	FOcclusionBudgetController BudgetController;
+
+	/** Time spent in PopulateScene this frame, in milliseconds */
+	float PopulateTimeMs = 0.f;
+
+	/** Time the last flush waited for the occlusion task, in milliseconds */
+	float FlushWaitTimeMs = 0.f;
+
+	FOcclusionAnalytics Analytics;
+
+	UPROPERTY()
+	UTexture2D* DebugTexture = nullptr;
+
+	/** GatherFrameNumber of the results in DebugTexture */
+	uint64 DebugTextureFrameNumber = 0;
+
+	/** Covered fraction of each bin in DebugTexture */
+	float DebugBinOccupancy[BIN_NUM] = {};
+
+	/** VisibilitySnapshot of LastFrameResults, guarded by VisibilitySnapshotLock for queries from other threads */
+	TSharedPtr<const FOcclusionVisibilitySnapshot, ESPMode::ThreadSafe> VisibilitySnapshot;
+	mutable FCriticalSection VisibilitySnapshotLock;
+
+	/** GFrameCounter of the last visibility query */
+	mutable std::atomic<uint64> LastVisibilityQueryFrame = 0;
 };
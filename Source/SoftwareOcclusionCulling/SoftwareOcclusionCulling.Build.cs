@@ -39,7 +39,9 @@ public class SoftwareOcclusionCulling : ModuleRules
 				"Slate",
 				"SlateCore",
 				"HeadMountedDisplay",
-				"DeveloperSettings"
+				"DeveloperSettings",
+				"Landscape",
+				"RHI"
 				// ... add private dependencies that you statically link with here ...	
 			}
 			);
@@ -0,0 +1,125 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#include "GenerateOccluderProxiesCommandlet.h"
+#include "OccluderProxyBuilder.h"
+#include "AssetRegistry/AssetRegistryModule.h"
+#include "Data/OccluderProxyAssetUserData.h"
+#include "Engine/StaticMesh.h"
+#include "Misc/PackageName.h"
+#include "UObject/SavePackage.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogOccluderProxies, Log, All);
+
+UGenerateOccluderProxiesCommandlet::UGenerateOccluderProxiesCommandlet()
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UGenerateOccluderProxiesCommandlet::Main(const FString& Params)
+{
+	FString Path = TEXT("/Game");
+	FParse::Value(*Params, TEXT("Path="), Path);
+
+	FOccluderProxyBuildSettings Settings;
+	FParse::Value(*Params, TEXT("MaxTriangles="), Settings.MaxTriangles);
+	FParse::Value(*Params, TEXT("Resolution="), Settings.MaxResolution);
+	FParse::Value(*Params, TEXT("MaxBoxes="), Settings.MaxBoxes);
+	FParse::Value(*Params, TEXT("BoxCoverage="), Settings.MinBoxCoverage);
+	Settings.bBuildBoxes = !FParse::Param(*Params, TEXT("NoBoxes"));
+
+	// Meshes that are already cheap occluders are left alone
+	int32 MinSourceTriangles = Settings.MaxTriangles * 2;
+	FParse::Value(*Params, TEXT("MinSourceTriangles="), MinSourceTriangles);
+
+	const bool bForce = FParse::Param(*Params, TEXT("Force"));
+
+	IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>("AssetRegistry").Get();
+	AssetRegistry.SearchAllAssets(true);
+
+	FARFilter Filter;
+	Filter.PackagePaths.Add(*Path);
+	Filter.bRecursivePaths = true;
+	Filter.ClassPaths.Add(UStaticMesh::StaticClass()->GetClassPathName());
+
+	TArray<FAssetData> Assets;
+	AssetRegistry.GetAssets(Filter, Assets);
+	UE_LOG(LogOccluderProxies, Display, TEXT("Found %d static meshes under %s"), Assets.Num(), *Path);
+
+	int32 NumBuilt = 0;
+	int32 NumSkipped = 0;
+	int32 NumFailed = 0;
+	int64 NumSourceTriangles = 0;
+	int64 NumProxyTriangles = 0;
+
+	for (const FAssetData& Asset : Assets)
+	{
+		UStaticMesh* StaticMesh = Cast<UStaticMesh>(Asset.GetAsset());
+		if (!IsValid(StaticMesh) || !StaticMesh->GetRenderData() || StaticMesh->GetRenderData()->LODResources.IsEmpty())
+		{
+			NumFailed++;
+			UE_LOG(LogOccluderProxies, Warning, TEXT("%s: failed to load the mesh or its render data"), *Asset.GetObjectPathString());
+			continue;
+		}
+
+		const int32 NumTriangles = StaticMesh->GetRenderData()->LODResources[0].GetNumTriangles();
+		if (NumTriangles < MinSourceTriangles)
+		{
+			NumSkipped++;
+			continue;
+		}
+
+		if (!bForce && StaticMesh->GetAssetUserData<UOccluderProxyAssetUserData>())
+		{
+			NumSkipped++;
+			continue;
+		}
+
+		if (!FOccluderProxyBuilder::BuildForStaticMesh(StaticMesh, Settings))
+		{
+			NumFailed++;
+			UE_LOG(LogOccluderProxies, Warning, TEXT("%s: failed to build the proxy"), *StaticMesh->GetPathName());
+			continue;
+		}
+
+		UPackage* Package = StaticMesh->GetPackage();
+		const FString Filename = FPackageName::LongPackageNameToFilename(Package->GetName(), FPackageName::GetAssetPackageExtension());
+
+		FSavePackageArgs SaveArgs;
+		SaveArgs.TopLevelFlags = RF_Public | RF_Standalone;
+		if (!UPackage::SavePackage(Package, nullptr, *Filename, SaveArgs))
+		{
+			NumFailed++;
+			UE_LOG(LogOccluderProxies, Error, TEXT("Failed to save %s, make sure the file is writable"), *Filename);
+			continue;
+		}
+
+		const UOccluderProxyAssetUserData* Proxy = StaticMesh->GetAssetUserData<UOccluderProxyAssetUserData>();
+		if (Proxy && Proxy->HasBoxes())
+		{
+			// Rasterized as boxes, at most 12 triangles each
+			NumBuilt++;
+			NumSourceTriangles += NumTriangles;
+			NumProxyTriangles += Proxy->Boxes.Num() * 12;
+			UE_LOG(LogOccluderProxies, Display, TEXT("%s: %d triangles -> %d boxes"), *StaticMesh->GetPathName(), NumTriangles, Proxy->Boxes.Num());
+		}
+		else if (Proxy && Proxy->HasProxy())
+		{
+			NumBuilt++;
+			NumSourceTriangles += NumTriangles;
+			NumProxyTriangles += Proxy->Indices.Num() / 3;
+			UE_LOG(LogOccluderProxies, Display, TEXT("%s: %d -> %d triangles"), *StaticMesh->GetPathName(), NumTriangles, Proxy->Indices.Num() / 3);
+		}
+		else
+		{
+			NumFailed++;
+			UE_LOG(LogOccluderProxies, Warning, TEXT("%s: no proxy, the mesh is open or too thin"), *StaticMesh->GetPathName());
+		}
+	}
+
+	UE_LOG(LogOccluderProxies, Display, TEXT("Built %d proxies (%lld -> %lld triangles), skipped %d meshes, %d meshes kept their render geometry"),
+		NumBuilt, NumSourceTriangles, NumProxyTriangles, NumSkipped, NumFailed);
+	return 0;
+}
@@ -0,0 +1,148 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#include "OccluderCellBaker.h"
+#include "FusedOccluderComponent.h"
+#include "OccluderVolume.h"
+#include "Async/ParallelFor.h"
+#include "Components/BoxComponent.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Data/OccluderCellSet.h"
+#include "Engine/Level.h"
+#include "Engine/World.h"
+#include "HAL/FileManager.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogOccluderCellBaker, Log, All);
+
+// Static primitives that provide occluder geometry at runtime
+static bool IsStaticOccluder(const UPrimitiveComponent* Component)
+{
+	if (!IsValid(Component) || Component->Mobility != EComponentMobility::Static || Component->IsEditorOnly())
+	{
+		return false;
+	}
+
+	if (Component->IsA<UFusedOccluderComponent>())
+	{
+		return true;
+	}
+
+	if (Component->IsA<UBoxComponent>())
+	{
+		return Component->GetOwner() && Component->GetOwner()->IsA<AOccluderVolume>();
+	}
+
+	return Component->IsA<UStaticMeshComponent>() && !Component->IsA<UInstancedStaticMeshComponent>() && Component->IsVisible();
+}
+
+bool FOccluderCellBaker::Bake(UWorld* World, const FOccluderCellBakeSettings& Settings, FString& OutPath)
+{
+	if (!IsValid(World) || Settings.CellSize <= 0.f)
+	{
+		return false;
+	}
+
+	TArray<FBoxSphereBounds> OccluderBounds;
+	FOccluderCellSetData Data;
+	FBox WorldBounds(ForceInit);
+	for (const ULevel* Level : World->GetLevels())
+	{
+		for (const AActor* Actor : Level->Actors)
+		{
+			if (!IsValid(Actor))
+			{
+				continue;
+			}
+
+			TInlineComponentArray<UPrimitiveComponent*> PrimitiveComponents(Actor);
+			for (const UPrimitiveComponent* Component : PrimitiveComponents)
+			{
+				if (IsStaticOccluder(Component))
+				{
+					OccluderBounds.Add(Component->Bounds);
+					Data.OccluderKeys.Add(FOccluderCellSet::MakeOccluderKey(Component));
+					WorldBounds += Component->Bounds.GetBox();
+				}
+			}
+		}
+	}
+
+	if (OccluderBounds.IsEmpty())
+	{
+		UE_LOG(LogOccluderCellBaker, Warning, TEXT("No static occluders in %s"), *World->GetName());
+		return false;
+	}
+
+	// The view can be up to a cell away from the outermost occluders
+	WorldBounds = WorldBounds.ExpandBy(Settings.CellSize);
+	Data.Origin = WorldBounds.Min;
+	Data.CellSize = Settings.CellSize;
+	Data.NumCells = FIntVector(
+		FMath::CeilToInt(WorldBounds.GetSize().X / Settings.CellSize),
+		FMath::CeilToInt(WorldBounds.GetSize().Y / Settings.CellSize),
+		FMath::CeilToInt(WorldBounds.GetSize().Z / Settings.CellSize));
+
+	const int64 NumCells = static_cast<int64>(Data.NumCells.X) * Data.NumCells.Y * Data.NumCells.Z;
+	if (NumCells > Settings.MaxCells)
+	{
+		UE_LOG(LogOccluderCellBaker, Error, TEXT("%s needs %lld cells, more than %d. Use a bigger cell size."), *World->GetName(), NumCells, Settings.MaxCells);
+		return false;
+	}
+
+	// Screen size estimate of the runtime selection, from the point of the cell closest to the occluder
+	TArray<TArray<uint32>> CellOccluders;
+	CellOccluders.SetNum(NumCells);
+	ParallelFor(static_cast<int32>(NumCells), [&](const int32 Cell)
+	{
+		const FIntVector CellCoord(Cell % Data.NumCells.X, (Cell / Data.NumCells.X) % Data.NumCells.Y, Cell / (Data.NumCells.X * Data.NumCells.Y));
+		const FVector CellMin = Data.Origin + FVector(CellCoord) * Settings.CellSize;
+		const FBox CellBox(CellMin, CellMin + FVector(Settings.CellSize));
+
+		TArray<TPair<float, uint32>> Scored;
+		for (int32 Index = 0; Index < OccluderBounds.Num(); ++Index)
+		{
+			const FBoxSphereBounds& Bounds = OccluderBounds[Index];
+			const float Distance = FMath::Sqrt(CellBox.ComputeSquaredDistanceToPoint(Bounds.Origin));
+			if (Distance - Bounds.SphereRadius > Settings.MaxDistance)
+			{
+				continue;
+			}
+
+			const float ScreenSize = Bounds.SphereRadius / FMath::Max(Distance, 1.f);
+			if (ScreenSize > Settings.MinScreenSize)
+			{
+				Scored.Emplace(ScreenSize, Index);
+			}
+		}
+
+		Scored.Sort([](const TPair<float, uint32>& A, const TPair<float, uint32>& B)
+		{
+			return A.Key > B.Key;
+		});
+
+		TArray<uint32>& Occluders = CellOccluders[Cell];
+		Occluders.Reserve(FMath::Min(Scored.Num(), Settings.MaxOccludersPerCell));
+		for (int32 i = 0; i < Scored.Num() && i < Settings.MaxOccludersPerCell; ++i)
+		{
+			Occluders.Add(Scored[i].Value);
+		}
+	});
+
+	Data.CellOffsets.Reserve(NumCells + 1);
+	for (const TArray<uint32>& Occluders : CellOccluders)
+	{
+		Data.CellOffsets.Add(Data.CellEntries.Num());
+		Data.CellEntries.Append(Occluders);
+	}
+	Data.CellOffsets.Add(Data.CellEntries.Num());
+
+	OutPath = FOccluderCellSet::GetPath(World);
+	IFileManager::Get().MakeDirectory(*FPaths::GetPath(OutPath), true);
+	if (!FOccluderCellSet::Save(OutPath, Data))
+	{
+		UE_LOG(LogOccluderCellBaker, Error, TEXT("Failed to write %s"), *OutPath);
+		return false;
+	}
+
+	UE_LOG(LogOccluderCellBaker, Display, TEXT("Baked %lld cells with %d occluders and %d entries to %s"), NumCells, Data.OccluderKeys.Num(), Data.CellEntries.Num(), *OutPath);
+	return true;
+}
@@ -0,0 +1,36 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UWorld;
+
+struct FOccluderCellBakeSettings
+{
+	/** Size of the cubic view cells */
+	float CellSize = 2000.f;
+
+	/** Largest number of occluders listed per cell */
+	int32 MaxOccludersPerCell = 64;
+
+	/** Smallest screen size an occluder must reach from somewhere in the cell, matching r.so.MinScreenRadiusForOccluder */
+	float MinScreenSize = 0.075f;
+
+	/** Occluders further than this from a cell are not listed, matching r.so.MaxDistanceForOccluder */
+	float MaxDistance = 20000.f;
+
+	/** Largest number of cells, the bake fails for bigger worlds and needs a bigger cell size */
+	int32 MaxCells = 1 << 20;
+};
+
+/**
+ * Splits a world into view cells and lists, for every cell, the static occluders with the biggest screen size
+ * seen from anywhere in the cell. The result is saved next to the content as an FOccluderCellSet file.
+ */
+class FOccluderCellBaker
+{
+public:
+	/** Returns false when the world has no static occluders or the file could not be written. */
+	static bool Bake(UWorld* World, const FOccluderCellBakeSettings& Settings, FString& OutPath);
+};
@@ -0,0 +1,199 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#include "OccluderFusion.h"
+#include "FusedOccluderActor.h"
+#include "FusedOccluderComponent.h"
+#include "OccluderVoxelGrid.h"
+#include "SoftwareOcclusionCullingOverride.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Engine/Level.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/World.h"
+#include "StaticMeshResources.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogOccluderFusion, Log, All);
+
+// Meshes with their own occlusion settings or without a solid render geometry are never fused
+static bool CanFuse(const UStaticMeshComponent* Component, const FOccluderFusionSettings& Settings)
+{
+	if (!IsValid(Component) || Component->IsA<UInstancedStaticMeshComponent>() || Component->Mobility != EComponentMobility::Static)
+	{
+		return false;
+	}
+
+	if (!Component->IsVisible() || Component->bHiddenInGame || Component->IsEditorOnly())
+	{
+		return false;
+	}
+
+	const UStaticMesh* StaticMesh = Component->GetStaticMesh();
+	if (!IsValid(StaticMesh) || !StaticMesh->GetRenderData() || StaticMesh->GetRenderData()->LODResources.IsEmpty())
+	{
+		return false;
+	}
+
+	const AActor* Owner = Component->GetOwner();
+	return Owner && !Owner->FindComponentByClass<USoftwareOcclusionCullingOverride>() && Component->Bounds.SphereRadius <= Settings.MaxPieceRadius;
+}
+
+// Render geometry of the component relative to the origin
+static FOccluderVoxelMesh GetFusionMesh(const UStaticMeshComponent* Component, const FVector& Origin)
+{
+	const FStaticMeshLODResources& LODModel = Component->GetStaticMesh()->GetRenderData()->LODResources[0];
+	const FTransform& ComponentTransform = Component->GetComponentTransform();
+
+	FOccluderVoxelMesh Mesh;
+	const int32 NumVtx = LODModel.VertexBuffers.PositionVertexBuffer.GetNumVertices();
+	Mesh.Vertices.SetNumUninitialized(NumVtx);
+	for (int32 i = 0; i < NumVtx; ++i)
+	{
+		const FVector Position = ComponentTransform.TransformPosition(FVector(LODModel.VertexBuffers.PositionVertexBuffer.VertexPosition(i)));
+		Mesh.Vertices[i] = FVector3f(Position - Origin);
+	}
+	LODModel.IndexBuffer.GetCopy(Mesh.Indices);
+	return Mesh;
+}
+
+int32 FOccluderFusion::FuseLevel(ULevel* Level, const FOccluderFusionSettings& Settings)
+{
+	if (!IsValid(Level) || !Level->OwningWorld)
+	{
+		return 0;
+	}
+
+	UWorld* World = Level->OwningWorld;
+
+	// Start over, the level may have changed since the last fusion
+	bool bLevelChanged = false;
+	TArray<UStaticMeshComponent*> Candidates;
+	for (AActor* Actor : TArray<AActor*>(Level->Actors))
+	{
+		if (!IsValid(Actor))
+		{
+			continue;
+		}
+
+		if (Actor->IsA<AFusedOccluderActor>())
+		{
+			World->EditorDestroyActor(Actor, true);
+			bLevelChanged = true;
+			continue;
+		}
+
+		TArray<UStaticMeshComponent*> Components;
+		Actor->GetComponents<UStaticMeshComponent>(Components);
+		for (UStaticMeshComponent* Component : Components)
+		{
+			if (CanFuse(Component, Settings))
+			{
+				Candidates.Add(Component);
+			}
+		}
+	}
+
+	// Bucket the meshes into level cells
+	TMap<FIntVector, TArray<int32>> Cells;
+	for (int32 Index = 0; Index < Candidates.Num(); ++Index)
+	{
+		const FVector Cell = Candidates[Index]->Bounds.Origin / FMath::Max(Settings.CellSize, 1.f);
+		Cells.FindOrAdd(FIntVector(FMath::FloorToInt(Cell.X), FMath::FloorToInt(Cell.Y), FMath::FloorToInt(Cell.Z))).Add(Index);
+	}
+
+	int32 NumFused = 0;
+	for (const TPair<FIntVector, TArray<int32>>& Cell : Cells)
+	{
+		const TArray<int32>& Members = Cell.Value;
+
+		// Union adjacent meshes
+		TArray<int32> Parents;
+		Parents.SetNumUninitialized(Members.Num());
+		for (int32 i = 0; i < Members.Num(); ++i)
+		{
+			Parents[i] = i;
+		}
+
+		auto FindRoot = [&Parents](int32 i)
+		{
+			while (Parents[i] != i)
+			{
+				Parents[i] = Parents[Parents[i]];
+				i = Parents[i];
+			}
+			return i;
+		};
+
+		for (int32 i = 0; i < Members.Num(); ++i)
+		{
+			const FBox BoxA = Candidates[Members[i]]->Bounds.GetBox().ExpandBy(Settings.AdjacencyTolerance);
+			for (int32 j = i + 1; j < Members.Num(); ++j)
+			{
+				if (BoxA.Intersect(Candidates[Members[j]]->Bounds.GetBox()))
+				{
+					Parents[FindRoot(j)] = FindRoot(i);
+				}
+			}
+		}
+
+		TMap<int32, TArray<UStaticMeshComponent*>> Clusters;
+		for (int32 i = 0; i < Members.Num(); ++i)
+		{
+			Clusters.FindOrAdd(FindRoot(i)).Add(Candidates[Members[i]]);
+		}
+
+		for (const TPair<int32, TArray<UStaticMeshComponent*>>& Cluster : Clusters)
+		{
+			const TArray<UStaticMeshComponent*>& Components = Cluster.Value;
+			if (Components.Num() < Settings.MinClusterSize)
+			{
+				continue;
+			}
+
+			FBox ClusterBounds(ForceInit);
+			for (const UStaticMeshComponent* Component : Components)
+			{
+				ClusterBounds += Component->Bounds.GetBox();
+			}
+
+			// Fuse around the cluster center to keep float precision
+			const FVector Origin = ClusterBounds.GetCenter();
+			TArray<FOccluderVoxelMesh> Meshes;
+			for (const UStaticMeshComponent* Component : Components)
+			{
+				Meshes.Add(GetFusionMesh(Component, Origin));
+			}
+
+			TArray<FVector3f> Vertices;
+			TArray<uint16> Indices;
+			if (!FOccluderProxyBuilder::BuildFused(Meshes, Settings.BuildSettings, Vertices, Indices))
+			{
+				continue;
+			}
+
+			FActorSpawnParameters SpawnParameters;
+			SpawnParameters.OverrideLevel = Level;
+			AFusedOccluderActor* FusedActor = World->SpawnActor<AFusedOccluderActor>(Origin, FRotator::ZeroRotator, SpawnParameters);
+			if (!FusedActor)
+			{
+				continue;
+			}
+
+			FusedActor->Modify();
+			FusedActor->SourceComponents.Append(Components);
+			FusedActor->SetActorLabel(TEXT("FusedOccluder"));
+
+			UFusedOccluderComponent* FusedComponent = FusedActor->GetFusedOccluderComponent();
+			FusedComponent->Vertices = MoveTemp(Vertices);
+			FusedComponent->Indices = MoveTemp(Indices);
+			FusedComponent->UpdateBounds();
+			NumFused++;
+
+			UE_LOG(LogOccluderFusion, Display, TEXT("Fused %d meshes into %d occluder triangles"), Components.Num(), FusedComponent->Indices.Num() / 3);
+		}
+	}
+
+	if (bLevelChanged || NumFused > 0)
+	{
+		Level->MarkPackageDirty();
+	}
+	return NumFused;
+}
@@ -0,0 +1,36 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OccluderProxyBuilder.h"
+
+class ULevel;
+
+struct FOccluderFusionSettings
+{
+	/** Size of the level cells clusters may not span */
+	float CellSize = 4000.f;
+
+	/** Only meshes up to this bounds radius are fused, bigger ones are good occluders on their own */
+	float MaxPieceRadius = 1000.f;
+
+	/** Distance below which two meshes count as adjacent */
+	float AdjacencyTolerance = 10.f;
+
+	/** Smallest number of meshes worth fusing */
+	int32 MinClusterSize = 2;
+
+	FOccluderProxyBuildSettings BuildSettings;
+};
+
+/**
+ * Clusters adjacent static meshes of a level, e.g. modular walls and floors, and merges each cluster into
+ * one simplified occluder owned by an AFusedOccluderActor.
+ */
+class FOccluderFusion
+{
+public:
+	/** Replaces the fused occluders of the level. Returns the number of fused occluders created. */
+	static int32 FuseLevel(ULevel* Level, const FOccluderFusionSettings& Settings);
+};
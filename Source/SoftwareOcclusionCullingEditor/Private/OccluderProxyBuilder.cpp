@@ -0,0 +1,455 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#include "OccluderProxyBuilder.h"
+#include "OccluderVoxelGrid.h"
+#include "Data/OccluderProxyAssetUserData.h"
+#include "Engine/StaticMesh.h"
+#include "StaticMeshResources.h"
+
+/** Number of the deepest voxels each box is grown from */
+static constexpr int32 NUM_BOX_SEEDS = 16;
+
+/** Boxes smaller than this fraction of the mesh interior are not worth a draw */
+static constexpr float MIN_BOX_VOLUME_RATIO = 0.05f;
+
+// Extracts the faces between solid and empty voxels, merging coplanar faces into rectangles
+static void ExtractSurface(const FOccluderVoxelGrid& Grid, TArray<FVector3f>& OutVertices, TArray<uint32>& OutIndices)
+{
+	OutVertices.Reset();
+	OutIndices.Reset();
+
+	TMap<FIntVector, uint32> CornerToVertex;
+	auto GetVertex = [&](const FIntVector& Corner)
+	{
+		if (const uint32* Found = CornerToVertex.Find(Corner))
+		{
+			return *Found;
+		}
+		const uint32 Index = OutVertices.Add(Grid.GetCorner(Corner));
+		CornerToVertex.Add(Corner, Index);
+		return Index;
+	};
+
+	const FIntVector& Size = Grid.GetSize();
+	TBitArray<> Mask;
+
+	for (int32 Axis = 0; Axis < 3; ++Axis)
+	{
+		const int32 U = (Axis + 1) % 3;
+		const int32 V = (Axis + 2) % 3;
+
+		for (const int32 Dir : { -1, 1 })
+		{
+			for (int32 Slice = 0; Slice < Size[Axis]; ++Slice)
+			{
+				// Faces of this slice that look at empty space
+				Mask.Init(false, Size[U] * Size[V]);
+				for (int32 IV = 0; IV < Size[V]; ++IV)
+				{
+					for (int32 IU = 0; IU < Size[U]; ++IU)
+					{
+						FIntVector Voxel;
+						Voxel[Axis] = Slice;
+						Voxel[U] = IU;
+						Voxel[V] = IV;
+						FIntVector Neighbor = Voxel;
+						Neighbor[Axis] += Dir;
+						Mask[IV * Size[U] + IU] = Grid.IsSolid(Voxel) && !Grid.IsSolid(Neighbor);
+					}
+				}
+
+				for (int32 IV = 0; IV < Size[V]; ++IV)
+				{
+					for (int32 IU = 0; IU < Size[U]; ++IU)
+					{
+						if (!Mask[IV * Size[U] + IU])
+						{
+							continue;
+						}
+
+						// Grow the rectangle along U, then along V while whole rows are set
+						int32 Width = 1;
+						while (IU + Width < Size[U] && Mask[IV * Size[U] + IU + Width])
+						{
+							Width++;
+						}
+
+						int32 Height = 1;
+						for (; IV + Height < Size[V]; ++Height)
+						{
+							bool bRowSet = true;
+							for (int32 K = 0; K < Width && bRowSet; ++K)
+							{
+								bRowSet = Mask[(IV + Height) * Size[U] + IU + K];
+							}
+							if (!bRowSet)
+							{
+								break;
+							}
+						}
+
+						for (int32 H = 0; H < Height; ++H)
+						{
+							for (int32 K = 0; K < Width; ++K)
+							{
+								Mask[(IV + H) * Size[U] + IU + K] = false;
+							}
+						}
+
+						FIntVector Corners[4];
+						for (FIntVector& Corner : Corners)
+						{
+							Corner[Axis] = Slice + (Dir > 0 ? 1 : 0);
+						}
+						Corners[0][U] = IU;			Corners[0][V] = IV;
+						Corners[1][U] = IU + Width;	Corners[1][V] = IV;
+						Corners[2][U] = IU + Width;	Corners[2][V] = IV + Height;
+						Corners[3][U] = IU;			Corners[3][V] = IV + Height;
+
+						uint32 Quad[4];
+						for (int32 K = 0; K < 4; ++K)
+						{
+							Quad[K] = GetVertex(Corners[K]);
+						}
+
+						// Same winding as render geometry, the triangle normal points into the mesh
+						if (Dir > 0)
+						{
+							OutIndices.Append({ Quad[0], Quad[2], Quad[1], Quad[0], Quad[3], Quad[2] });
+						}
+						else
+						{
+							OutIndices.Append({ Quad[0], Quad[1], Quad[2], Quad[0], Quad[2], Quad[3] });
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+// Voxelizes at decreasing resolutions until the extracted surface meets the triangle target
+static bool BuildSurface(const TFunctionRef<bool(FOccluderVoxelGrid&, int32)> Voxelize, const FOccluderProxyBuildSettings& Settings,
+                         TArray<FVector3f>& OutVertices, TArray<uint16>& OutIndices)
+{
+	FOccluderVoxelGrid Grid;
+	TArray<FVector3f> SurfaceVertices;
+	TArray<uint32> SurfaceIndices;
+	bool bHasSurface = false;
+
+	for (int32 Resolution = Settings.MaxResolution; Resolution >= Settings.MinResolution; Resolution = FMath::Min(Resolution - 1, Resolution * 3 / 4))
+	{
+		if (!Voxelize(Grid, Resolution))
+		{
+			// Open mesh, other resolutions will not help
+			return false;
+		}
+
+		TArray<FVector3f> CandidateVertices;
+		TArray<uint32> CandidateIndices;
+		ExtractSurface(Grid, CandidateVertices, CandidateIndices);
+		if (CandidateIndices.IsEmpty())
+		{
+			// Coarser voxels fit even less
+			break;
+		}
+
+		if (CandidateVertices.Num() <= MAX_uint16)
+		{
+			SurfaceVertices = MoveTemp(CandidateVertices);
+			SurfaceIndices = MoveTemp(CandidateIndices);
+			bHasSurface = true;
+		}
+
+		if (bHasSurface && SurfaceIndices.Num() / 3 <= Settings.MaxTriangles)
+		{
+			break;
+		}
+	}
+
+	if (!bHasSurface)
+	{
+		return false;
+	}
+
+	// Best effort when the target could not be met, the coarsest surface is used
+	OutVertices = MoveTemp(SurfaceVertices);
+	OutIndices.SetNumUninitialized(SurfaceIndices.Num());
+	for (int32 i = 0; i < SurfaceIndices.Num(); ++i)
+	{
+		OutIndices[i] = static_cast<uint16>(SurfaceIndices[i]);
+	}
+	return true;
+}
+
+bool FOccluderProxyBuilder::Build(const TArray<FVector3f>& Vertices, const TArray<uint32>& Indices, const FOccluderProxyBuildSettings& Settings,
+                                  TArray<FVector3f>& OutVertices, TArray<uint16>& OutIndices)
+{
+	return BuildSurface([&](FOccluderVoxelGrid& Grid, const int32 Resolution)
+	{
+		return Grid.Build(Vertices, Indices, Resolution);
+	}, Settings, OutVertices, OutIndices);
+}
+
+bool FOccluderProxyBuilder::BuildFused(const TConstArrayView<FOccluderVoxelMesh> Meshes, const FOccluderProxyBuildSettings& Settings,
+                                       TArray<FVector3f>& OutVertices, TArray<uint16>& OutIndices)
+{
+	return BuildSurface([&](FOccluderVoxelGrid& Grid, const int32 Resolution)
+	{
+		return Grid.BuildUnion(Meshes, Resolution);
+	}, Settings, OutVertices, OutIndices);
+}
+
+bool FOccluderProxyBuilder::BuildBoxes(const TArray<FVector3f>& Vertices, const TArray<uint32>& Indices, const FOccluderProxyBuildSettings& Settings,
+                                       TArray<FBox3f>& OutBoxes)
+{
+	OutBoxes.Reset();
+
+	FOccluderVoxelGrid Grid;
+	if (!Grid.Build(Vertices, Indices, Settings.BoxResolution))
+	{
+		return false;
+	}
+
+	const int32 NumSolid = Grid.GetNumSolid();
+	if (NumSolid == 0)
+	{
+		return false;
+	}
+
+	const FIntVector& Size = Grid.GetSize();
+	auto GetIndex = [&Size](const FIntVector& Voxel)
+	{
+		return (Voxel.Z * Size.Y + Voxel.Y) * Size.X + Voxel.X;
+	};
+
+	// Solid voxels not claimed by a box yet
+	TBitArray<> Free(false, Size.X * Size.Y * Size.Z);
+	for (int32 Z = 0; Z < Size.Z; ++Z)
+	{
+		for (int32 Y = 0; Y < Size.Y; ++Y)
+		{
+			for (int32 X = 0; X < Size.X; ++X)
+			{
+				Free[GetIndex(FIntVector(X, Y, Z))] = Grid.IsSolid(X, Y, Z);
+			}
+		}
+	}
+
+	auto IsFree = [&](const FIntVector& Voxel)
+	{
+		return Voxel.X >= 0 && Voxel.Y >= 0 && Voxel.Z >= 0 && Voxel.X < Size.X && Voxel.Y < Size.Y && Voxel.Z < Size.Z && Free[GetIndex(Voxel)];
+	};
+
+	// Grows a box from the seed, one layer at a time in every direction while the layer is free
+	auto GrowBox = [&](const FIntVector& Seed, FIntVector& OutMin, FIntVector& OutMax)
+	{
+		OutMin = Seed;
+		OutMax = Seed;
+		for (bool bGrew = true; bGrew;)
+		{
+			bGrew = false;
+			for (int32 Axis = 0; Axis < 3; ++Axis)
+			{
+				const int32 U = (Axis + 1) % 3;
+				const int32 V = (Axis + 2) % 3;
+				for (const int32 Dir : { -1, 1 })
+				{
+					const int32 Layer = Dir < 0 ? OutMin[Axis] - 1 : OutMax[Axis] + 1;
+					bool bLayerFree = Layer >= 0 && Layer < Size[Axis];
+					for (int32 IV = OutMin[V]; IV <= OutMax[V] && bLayerFree; ++IV)
+					{
+						for (int32 IU = OutMin[U]; IU <= OutMax[U] && bLayerFree; ++IU)
+						{
+							FIntVector Voxel;
+							Voxel[Axis] = Layer;
+							Voxel[U] = IU;
+							Voxel[V] = IV;
+							bLayerFree = IsFree(Voxel);
+						}
+					}
+
+					if (bLayerFree)
+					{
+						(Dir < 0 ? OutMin[Axis] : OutMax[Axis]) = Layer;
+						bGrew = true;
+					}
+				}
+			}
+		}
+	};
+
+	int32 NumCovered = 0;
+	TArray<uint8> Depth;
+	TArray<FIntVector> Seeds;
+
+	for (int32 BoxIdx = 0; BoxIdx < Settings.MaxBoxes; ++BoxIdx)
+	{
+		// Erode the free voxels to find the ones deepest inside, they make the best seeds
+		Depth.SetNumZeroed(Size.X * Size.Y * Size.Z);
+		for (int32 Index = 0; Index < Depth.Num(); ++Index)
+		{
+			Depth[Index] = Free[Index] ? 1 : 0;
+		}
+
+		bool bEroded = true;
+		for (uint8 Level = 1; bEroded && Level < MAX_uint8; ++Level)
+		{
+			bEroded = false;
+			for (int32 Z = 0; Z < Size.Z; ++Z)
+			{
+				for (int32 Y = 0; Y < Size.Y; ++Y)
+				{
+					for (int32 X = 0; X < Size.X; ++X)
+					{
+						const FIntVector Voxel(X, Y, Z);
+						if (Depth[GetIndex(Voxel)] != Level)
+						{
+							continue;
+						}
+
+						bool bInterior = true;
+						for (int32 Axis = 0; Axis < 3 && bInterior; ++Axis)
+						{
+							for (const int32 Dir : { -1, 1 })
+							{
+								FIntVector Neighbor = Voxel;
+								Neighbor[Axis] += Dir;
+								bInterior &= IsFree(Neighbor) && Depth[GetIndex(Neighbor)] >= Level;
+							}
+						}
+
+						if (bInterior)
+						{
+							Depth[GetIndex(Voxel)] = Level + 1;
+							bEroded = true;
+						}
+					}
+				}
+			}
+		}
+
+		Seeds.Reset();
+		for (int32 Z = 0; Z < Size.Z; ++Z)
+		{
+			for (int32 Y = 0; Y < Size.Y; ++Y)
+			{
+				for (int32 X = 0; X < Size.X; ++X)
+				{
+					if (Depth[GetIndex(FIntVector(X, Y, Z))] > 0)
+					{
+						Seeds.Add(FIntVector(X, Y, Z));
+					}
+				}
+			}
+		}
+
+		if (Seeds.IsEmpty())
+		{
+			break;
+		}
+
+		Seeds.Sort([&](const FIntVector& A, const FIntVector& B)
+		{
+			return Depth[GetIndex(A)] > Depth[GetIndex(B)];
+		});
+
+		FIntVector BestMin, BestMax;
+		int32 BestVolume = 0;
+		for (int32 SeedIdx = 0; SeedIdx < FMath::Min(Seeds.Num(), NUM_BOX_SEEDS); ++SeedIdx)
+		{
+			FIntVector Min, Max;
+			GrowBox(Seeds[SeedIdx], Min, Max);
+			const FIntVector Extent = Max - Min + FIntVector(1);
+			const int32 Volume = Extent.X * Extent.Y * Extent.Z;
+			if (Volume > BestVolume)
+			{
+				BestVolume = Volume;
+				BestMin = Min;
+				BestMax = Max;
+			}
+		}
+
+		if (BestVolume < NumSolid * MIN_BOX_VOLUME_RATIO)
+		{
+			break;
+		}
+
+		for (int32 Z = BestMin.Z; Z <= BestMax.Z; ++Z)
+		{
+			for (int32 Y = BestMin.Y; Y <= BestMax.Y; ++Y)
+			{
+				for (int32 X = BestMin.X; X <= BestMax.X; ++X)
+				{
+					Free[GetIndex(FIntVector(X, Y, Z))] = false;
+				}
+			}
+		}
+
+		NumCovered += BestVolume;
+		OutBoxes.Add(FBox3f(Grid.GetCorner(BestMin), Grid.GetCorner(BestMax + FIntVector(1))));
+	}
+
+	if (NumCovered < NumSolid * Settings.MinBoxCoverage)
+	{
+		OutBoxes.Reset();
+		return false;
+	}
+	return true;
+}
+
+bool FOccluderProxyBuilder::BuildForStaticMesh(UStaticMesh* StaticMesh, const FOccluderProxyBuildSettings& Settings)
+{
+	if (!IsValid(StaticMesh) || !StaticMesh->GetRenderData() || StaticMesh->GetRenderData()->LODResources.IsEmpty())
+	{
+		return false;
+	}
+
+	const FStaticMeshLODResources& LODModel = StaticMesh->GetRenderData()->LODResources[0];
+	const int32 NumVtx = LODModel.VertexBuffers.PositionVertexBuffer.GetNumVertices();
+
+	TArray<FVector3f> SourceVertices;
+	SourceVertices.SetNumUninitialized(NumVtx);
+	for (int32 i = 0; i < NumVtx; ++i)
+	{
+		SourceVertices[i] = LODModel.VertexBuffers.PositionVertexBuffer.VertexPosition(i);
+	}
+
+	TArray<uint32> SourceIndices;
+	LODModel.IndexBuffer.GetCopy(SourceIndices);
+	const int32 NumSourceTriangles = SourceIndices.Num() / 3;
+
+	TArray<FVector3f> ProxyVertices;
+	TArray<uint16> ProxyIndices;
+	const bool bBuiltProxy = Build(SourceVertices, SourceIndices, Settings, ProxyVertices, ProxyIndices) && ProxyIndices.Num() / 3 < NumSourceTriangles;
+
+	TArray<FBox3f> Boxes;
+	const bool bBuiltBoxes = Settings.bBuildBoxes && BuildBoxes(SourceVertices, SourceIndices, Settings, Boxes);
+
+	UOccluderProxyAssetUserData* UserData = StaticMesh->GetAssetUserData<UOccluderProxyAssetUserData>();
+	if (!bBuiltProxy && !bBuiltBoxes)
+	{
+		// Drop stale proxies, the render geometry is used instead
+		if (UserData)
+		{
+			StaticMesh->Modify();
+			StaticMesh->RemoveUserDataOfClass(UOccluderProxyAssetUserData::StaticClass());
+			return true;
+		}
+		return false;
+	}
+
+	StaticMesh->Modify();
+	if (!UserData)
+	{
+		UserData = NewObject<UOccluderProxyAssetUserData>(StaticMesh, NAME_None, RF_Transactional);
+		StaticMesh->AddAssetUserData(UserData);
+	}
+
+	UserData->Modify();
+	UserData->Vertices = MoveTemp(ProxyVertices);
+	UserData->Indices = MoveTemp(ProxyIndices);
+	UserData->Boxes = MoveTemp(Boxes);
+	UserData->SourceTriangleCount = NumSourceTriangles;
+	return true;
+}
@@ -0,0 +1,55 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UStaticMesh;
+struct FOccluderVoxelMesh;
+
+struct FOccluderProxyBuildSettings
+{
+	/** Largest triangle count the proxy may have */
+	int32 MaxTriangles = 128;
+
+	/** Voxels along the longest mesh axis for the first attempt, lowered until MaxTriangles is met */
+	int32 MaxResolution = 32;
+
+	/** Lowest resolution tried before giving up */
+	int32 MinResolution = 2;
+
+	/** Also fit inscribed boxes, which replace the proxy triangles at runtime */
+	bool bBuildBoxes = true;
+
+	/** Voxels along the longest mesh axis used to fit the boxes */
+	int32 BoxResolution = 24;
+
+	/** Largest number of boxes per mesh */
+	int32 MaxBoxes = 4;
+
+	/** Fraction of the mesh interior the boxes must cover, otherwise no boxes are stored */
+	float MinBoxCoverage = 0.6f;
+};
+
+/**
+ * Builds low-poly occluder proxies that are inscribed in the source mesh. The mesh is voxelized conservatively
+ * and the surface of the solid voxels is extracted with greedy quad merging. Boxes are grown inside the solid voxels.
+ */
+class FOccluderProxyBuilder
+{
+public:
+	/** Returns false when no proxy could be built, e.g. for open meshes or meshes thinner than a voxel. */
+	static bool Build(const TArray<FVector3f>& Vertices, const TArray<uint32>& Indices, const FOccluderProxyBuildSettings& Settings,
+	                  TArray<FVector3f>& OutVertices, TArray<uint16>& OutIndices);
+
+	/** Builds one proxy for the union of several meshes in a shared space. Returns false when the meshes have no common solid. */
+	static bool BuildFused(TConstArrayView<FOccluderVoxelMesh> Meshes, const FOccluderProxyBuildSettings& Settings,
+	                       TArray<FVector3f>& OutVertices, TArray<uint16>& OutIndices);
+
+	/** Returns false when the boxes do not cover enough of the mesh interior. */
+	static bool BuildBoxes(const TArray<FVector3f>& Vertices, const TArray<uint32>& Indices, const FOccluderProxyBuildSettings& Settings,
+	                       TArray<FBox3f>& OutBoxes);
+
+	/** Builds the proxy and boxes of the mesh LOD0 and stores it in the mesh asset user data. Returns false if the mesh was not changed. */
+	static bool BuildForStaticMesh(UStaticMesh* StaticMesh, const FOccluderProxyBuildSettings& Settings);
+};
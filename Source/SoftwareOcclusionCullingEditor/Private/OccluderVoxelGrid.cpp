@@ -0,0 +1,324 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#include "OccluderVoxelGrid.h"
+
+/** Fraction of the rows that may cross the mesh an odd number of times, e.g. because of tiny cracks */
+static constexpr float MAX_OPEN_ROW_RATIO = 0.01f;
+
+/** Grows the voxels in the triangle overlap test, so touching triangles count as overlapping */
+static constexpr float BOUNDARY_SLOP = 1.001f;
+
+/** Distance, in voxels, stepped off a face to find whether the union is on both of its sides. Thinner gaps count as seams. */
+static constexpr float SEAM_OFFSET = 0.01f;
+
+// Separating axis test between a triangle and a box centered at the origin
+static bool TriangleOverlapsBox(const FVector3f& V0, const FVector3f& V1, const FVector3f& V2, const FVector3f& HalfExtent)
+{
+	const FVector3f Edges[3] = { V1 - V0, V2 - V1, V0 - V2 };
+
+	auto IsSeparated = [&](const FVector3f& Axis)
+	{
+		const float P0 = FVector3f::DotProduct(Axis, V0);
+		const float P1 = FVector3f::DotProduct(Axis, V1);
+		const float P2 = FVector3f::DotProduct(Axis, V2);
+		const float R = HalfExtent.X * FMath::Abs(Axis.X) + HalfExtent.Y * FMath::Abs(Axis.Y) + HalfExtent.Z * FMath::Abs(Axis.Z);
+		return FMath::Min3(P0, P1, P2) > R || FMath::Max3(P0, P1, P2) < -R;
+	};
+
+	// Box face normals
+	for (int32 Axis = 0; Axis < 3; ++Axis)
+	{
+		if (FMath::Min3(V0[Axis], V1[Axis], V2[Axis]) > HalfExtent[Axis] || FMath::Max3(V0[Axis], V1[Axis], V2[Axis]) < -HalfExtent[Axis])
+		{
+			return false;
+		}
+	}
+
+	// Triangle normal
+	if (IsSeparated(FVector3f::CrossProduct(Edges[0], Edges[1])))
+	{
+		return false;
+	}
+
+	// Edge cross products
+	for (int32 Axis = 0; Axis < 3; ++Axis)
+	{
+		FVector3f BoxAxis = FVector3f::ZeroVector;
+		BoxAxis[Axis] = 1.f;
+
+		for (const FVector3f& Edge : Edges)
+		{
+			if (IsSeparated(FVector3f::CrossProduct(BoxAxis, Edge)))
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+// Whether a point is inside a closed mesh, from the parity of the crossings of a ray along X
+static bool IsInsideMesh(const FOccluderVoxelMesh& Mesh, const FVector3f& Point)
+{
+	int32 NumHits = 0;
+	const int32 NumTris = Mesh.Indices.Num() / 3;
+	for (int32 TriIdx = 0; TriIdx < NumTris; ++TriIdx)
+	{
+		const FVector3f& A = Mesh.Vertices[Mesh.Indices[TriIdx * 3 + 0]];
+		const FVector3f& B = Mesh.Vertices[Mesh.Indices[TriIdx * 3 + 1]];
+		const FVector3f& C = Mesh.Vertices[Mesh.Indices[TriIdx * 3 + 2]];
+
+		const float WA = (B.Y - Point.Y) * (C.Z - Point.Z) - (B.Z - Point.Z) * (C.Y - Point.Y);
+		const float WB = (C.Y - Point.Y) * (A.Z - Point.Z) - (C.Z - Point.Z) * (A.Y - Point.Y);
+		const float WC = (A.Y - Point.Y) * (B.Z - Point.Z) - (A.Z - Point.Z) * (B.Y - Point.Y);
+		const bool bInside = (WA >= 0.f && WB >= 0.f && WC >= 0.f) || (WA <= 0.f && WB <= 0.f && WC <= 0.f);
+		const float Area = WA + WB + WC;
+		if (bInside && !FMath::IsNearlyZero(Area) && (WA * A.X + WB * B.X + WC * C.X) / Area > Point.X)
+		{
+			NumHits++;
+		}
+	}
+	return NumHits % 2 != 0;
+}
+
+bool FOccluderVoxelGrid::Build(const TArray<FVector3f>& Vertices, const TArray<uint32>& Indices, const int32 Resolution)
+{
+	Solid.Reset();
+	Size = FIntVector::ZeroValue;
+
+	if (Vertices.Num() < 4 || Indices.Num() < 12 || !InitGrid(FBox3f(Vertices), Resolution))
+	{
+		return false;
+	}
+
+	int32 NumOpenRows = 0;
+	ClassifyInside(Vertices, Indices, Solid, NumOpenRows);
+	if (NumOpenRows > Size.Y * Size.Z * MAX_OPEN_ROW_RATIO)
+	{
+		Solid.Reset();
+		return false;
+	}
+
+	RemoveBoundary(Vertices, Indices);
+	return true;
+}
+
+bool FOccluderVoxelGrid::BuildUnion(const TConstArrayView<FOccluderVoxelMesh> Meshes, const int32 Resolution)
+{
+	Solid.Reset();
+	Size = FIntVector::ZeroValue;
+
+	FBox3f Bounds(ForceInit);
+	for (const FOccluderVoxelMesh& Mesh : Meshes)
+	{
+		Bounds += FBox3f(Mesh.Vertices);
+	}
+
+	if (!InitGrid(Bounds, Resolution))
+	{
+		return false;
+	}
+
+	// Voxel centers inside any of the closed meshes
+	TArray<const FOccluderVoxelMesh*> ClosedMeshes;
+	TBitArray<> MeshInside;
+	for (const FOccluderVoxelMesh& Mesh : Meshes)
+	{
+		if (Mesh.Vertices.Num() < 4 || Mesh.Indices.Num() < 12)
+		{
+			continue;
+		}
+
+		int32 NumOpenRows = 0;
+		MeshInside.Init(false, Solid.Num());
+		ClassifyInside(Mesh.Vertices, Mesh.Indices, MeshInside, NumOpenRows);
+		if (NumOpenRows > Size.Y * Size.Z * MAX_OPEN_ROW_RATIO)
+		{
+			continue;
+		}
+
+		Solid.CombineWithBitwiseOR(MeshInside, EBitwiseOperatorFlags::MaintainSize);
+		ClosedMeshes.Add(&Mesh);
+	}
+
+	// Faces of the pieces split voxels like in Build, unless they are seams between pieces
+	for (const FOccluderVoxelMesh* Mesh : ClosedMeshes)
+	{
+		RemoveBoundary(Mesh->Vertices, Mesh->Indices, ClosedMeshes);
+	}
+
+	return !ClosedMeshes.IsEmpty();
+}
+
+int32 FOccluderVoxelGrid::GetNumSolid() const
+{
+	return Solid.CountSetBits();
+}
+
+bool FOccluderVoxelGrid::InitGrid(const FBox3f& Bounds, const int32 Resolution)
+{
+	if (!Bounds.IsValid || Resolution < 1)
+	{
+		return false;
+	}
+
+	const FVector3f Extent = Bounds.GetSize();
+	VoxelSize = Extent.GetMax() / Resolution;
+	if (VoxelSize <= UE_KINDA_SMALL_NUMBER)
+	{
+		return false;
+	}
+
+	Size.X = FMath::Max(1, FMath::CeilToInt(Extent.X / VoxelSize));
+	Size.Y = FMath::Max(1, FMath::CeilToInt(Extent.Y / VoxelSize));
+	Size.Z = FMath::Max(1, FMath::CeilToInt(Extent.Z / VoxelSize));
+
+	// Center the grid on the mesh
+	Origin = Bounds.GetCenter() - FVector3f(Size) * VoxelSize * 0.5f;
+
+	Solid.Init(false, Size.X * Size.Y * Size.Z);
+	return true;
+}
+
+void FOccluderVoxelGrid::ClassifyInside(const TArray<FVector3f>& Vertices, const TArray<uint32>& Indices, TBitArray<>& OutInside, int32& OutNumOpenRows) const
+{
+	const int32 NumTris = Indices.Num() / 3;
+
+	// Bin triangles by the Z rows they span
+	TArray<TArray<int32>> RowTriangles;
+	RowTriangles.SetNum(Size.Z);
+	for (int32 TriIdx = 0; TriIdx < NumTris; ++TriIdx)
+	{
+		const float MinZ = FMath::Min3(Vertices[Indices[TriIdx * 3 + 0]].Z, Vertices[Indices[TriIdx * 3 + 1]].Z, Vertices[Indices[TriIdx * 3 + 2]].Z);
+		const float MaxZ = FMath::Max3(Vertices[Indices[TriIdx * 3 + 0]].Z, Vertices[Indices[TriIdx * 3 + 1]].Z, Vertices[Indices[TriIdx * 3 + 2]].Z);
+		const int32 Z0 = FMath::Clamp(FMath::FloorToInt((MinZ - Origin.Z) / VoxelSize), 0, Size.Z - 1);
+		const int32 Z1 = FMath::Clamp(FMath::FloorToInt((MaxZ - Origin.Z) / VoxelSize), 0, Size.Z - 1);
+		for (int32 Z = Z0; Z <= Z1; ++Z)
+		{
+			RowTriangles[Z].Add(TriIdx);
+		}
+	}
+
+	// Offset the rays off the voxel centers, so they do not run exactly through mesh edges
+	const float JitterY = VoxelSize * 0.00123f;
+	const float JitterZ = VoxelSize * 0.00271f;
+
+	TArray<float> Hits;
+	for (int32 Z = 0; Z < Size.Z; ++Z)
+	{
+		for (int32 Y = 0; Y < Size.Y; ++Y)
+		{
+			const float RayY = Origin.Y + (Y + 0.5f) * VoxelSize + JitterY;
+			const float RayZ = Origin.Z + (Z + 0.5f) * VoxelSize + JitterZ;
+
+			// Cast a ray along X and gather every crossing
+			Hits.Reset();
+			for (const int32 TriIdx : RowTriangles[Z])
+			{
+				const FVector3f& A = Vertices[Indices[TriIdx * 3 + 0]];
+				const FVector3f& B = Vertices[Indices[TriIdx * 3 + 1]];
+				const FVector3f& C = Vertices[Indices[TriIdx * 3 + 2]];
+
+				// Barycentric coordinates of the ray in the YZ plane
+				const float WA = (B.Y - RayY) * (C.Z - RayZ) - (B.Z - RayZ) * (C.Y - RayY);
+				const float WB = (C.Y - RayY) * (A.Z - RayZ) - (C.Z - RayZ) * (A.Y - RayY);
+				const float WC = (A.Y - RayY) * (B.Z - RayZ) - (A.Z - RayZ) * (B.Y - RayY);
+				const bool bInside = (WA >= 0.f && WB >= 0.f && WC >= 0.f) || (WA <= 0.f && WB <= 0.f && WC <= 0.f);
+				const float Area = WA + WB + WC;
+				if (!bInside || FMath::IsNearlyZero(Area))
+				{
+					continue;
+				}
+
+				Hits.Add((WA * A.X + WB * B.X + WC * C.X) / Area);
+			}
+
+			if (Hits.Num() % 2 != 0)
+			{
+				OutNumOpenRows++;
+				continue;
+			}
+
+			Hits.Sort();
+
+			// Voxels between pairs of crossings are inside
+			for (int32 HitIdx = 0; HitIdx < Hits.Num(); HitIdx += 2)
+			{
+				const int32 X0 = FMath::Max(0, FMath::CeilToInt((Hits[HitIdx] - Origin.X) / VoxelSize - 0.5f));
+				const int32 X1 = FMath::Min(Size.X - 1, FMath::FloorToInt((Hits[HitIdx + 1] - Origin.X) / VoxelSize - 0.5f));
+				for (int32 X = X0; X <= X1; ++X)
+				{
+					OutInside[GetIndex(X, Y, Z)] = true;
+				}
+			}
+		}
+	}
+}
+
+void FOccluderVoxelGrid::RemoveBoundary(const TArray<FVector3f>& Vertices, const TArray<uint32>& Indices, const TConstArrayView<const FOccluderVoxelMesh*> SeamMeshes)
+{
+	const FVector3f HalfExtent(VoxelSize * 0.5f * BOUNDARY_SLOP);
+	const int32 NumTris = Indices.Num() / 3;
+
+	for (int32 TriIdx = 0; TriIdx < NumTris; ++TriIdx)
+	{
+		const FVector3f& A = Vertices[Indices[TriIdx * 3 + 0]];
+		const FVector3f& B = Vertices[Indices[TriIdx * 3 + 1]];
+		const FVector3f& C = Vertices[Indices[TriIdx * 3 + 2]];
+
+		const FVector3f Min = (A.ComponentMin(B).ComponentMin(C) - Origin) / VoxelSize;
+		const FVector3f Max = (A.ComponentMax(B).ComponentMax(C) - Origin) / VoxelSize;
+		const FIntVector V0(FMath::Max(0, FMath::FloorToInt(Min.X) - 1), FMath::Max(0, FMath::FloorToInt(Min.Y) - 1), FMath::Max(0, FMath::FloorToInt(Min.Z) - 1));
+		const FIntVector V1(FMath::Min(Size.X - 1, FMath::FloorToInt(Max.X) + 1), FMath::Min(Size.Y - 1, FMath::FloorToInt(Max.Y) + 1), FMath::Min(Size.Z - 1, FMath::FloorToInt(Max.Z) + 1));
+
+		for (int32 Z = V0.Z; Z <= V1.Z; ++Z)
+		{
+			for (int32 Y = V0.Y; Y <= V1.Y; ++Y)
+			{
+				for (int32 X = V0.X; X <= V1.X; ++X)
+				{
+					const int32 Index = GetIndex(X, Y, Z);
+					if (!Solid[Index])
+					{
+						continue;
+					}
+
+					const FVector3f Center = Origin + (FVector3f(X, Y, Z) + 0.5f) * VoxelSize;
+					if (TriangleOverlapsBox(A - Center, B - Center, C - Center, HalfExtent) && (SeamMeshes.IsEmpty() || !IsSeam(A, B, C, Center, SeamMeshes)))
+					{
+						Solid[Index] = false;
+					}
+				}
+			}
+		}
+	}
+}
+
+bool FOccluderVoxelGrid::IsSeam(const FVector3f& A, const FVector3f& B, const FVector3f& C, const FVector3f& Point, const TConstArrayView<const FOccluderVoxelMesh*> Meshes) const
+{
+	const FVector3f Normal = FVector3f::CrossProduct(B - A, C - A).GetSafeNormal();
+	if (Normal.IsZero())
+	{
+		return false;
+	}
+
+	// Step off both sides of the face, with the ray offset off mesh edges
+	const FVector3f Closest(FMath::ClosestPointOnTriangleToPoint(FVector(Point), FVector(A), FVector(B), FVector(C)));
+	const FVector3f Offset = Normal * (VoxelSize * SEAM_OFFSET);
+	const FVector3f Jitter(0.f, VoxelSize * 0.00123f, VoxelSize * 0.00271f);
+
+	for (const FVector3f& SidePoint : { Closest + Offset + Jitter, Closest - Offset + Jitter })
+	{
+		const bool bInsideAny = Meshes.ContainsByPredicate([&SidePoint](const FOccluderVoxelMesh* Mesh)
+		{
+			return FBox3f(Mesh->Vertices).ExpandBy(UE_KINDA_SMALL_NUMBER).IsInside(SidePoint) && IsInsideMesh(*Mesh, SidePoint);
+		});
+
+		if (!bInsideAny)
+		{
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,79 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** Closed triangle mesh fed to the voxelization */
+struct FOccluderVoxelMesh
+{
+	TArray<FVector3f> Vertices;
+	TArray<uint32> Indices;
+};
+
+/**
+ * Conservative solid voxelization of a closed triangle mesh. A voxel is solid only when it is inside the mesh
+ * and no triangle touches it, so anything built from solid voxels stays inscribed in the mesh.
+ */
+class FOccluderVoxelGrid
+{
+public:
+	/**
+	 * Voxelizes the mesh with Resolution voxels along its longest axis.
+	 * Returns false when the mesh is not closed and has no well defined inside.
+	 */
+	bool Build(const TArray<FVector3f>& Vertices, const TArray<uint32>& Indices, int32 Resolution);
+
+	/**
+	 * Voxelizes the union of several closed meshes, e.g. modular pieces that touch each other. A voxel is solid when its
+	 * center is inside any of the meshes and only seams, faces with the union on both sides, touch it. Seams between the
+	 * pieces do not split the solid, while gaps between them stay open however thin. Open meshes are ignored.
+	 */
+	bool BuildUnion(TConstArrayView<FOccluderVoxelMesh> Meshes, int32 Resolution);
+
+	FORCEINLINE bool IsSolid(const int32 X, const int32 Y, const int32 Z) const
+	{
+		return X >= 0 && Y >= 0 && Z >= 0 && X < Size.X && Y < Size.Y && Z < Size.Z && Solid[GetIndex(X, Y, Z)];
+	}
+
+	FORCEINLINE bool IsSolid(const FIntVector& Voxel) const
+	{
+		return IsSolid(Voxel.X, Voxel.Y, Voxel.Z);
+	}
+
+	/** Position of a voxel corner, coordinates range from 0 to Size inclusive */
+	FORCEINLINE FVector3f GetCorner(const FIntVector& Corner) const
+	{
+		return Origin + FVector3f(Corner) * VoxelSize;
+	}
+
+	FORCEINLINE const FIntVector& GetSize() const
+	{
+		return Size;
+	}
+
+	int32 GetNumSolid() const;
+
+private:
+	FORCEINLINE int32 GetIndex(const int32 X, const int32 Y, const int32 Z) const
+	{
+		return (Z * Size.Y + Y) * Size.X + X;
+	}
+
+	/** Sets up a grid around the bounds. Returns false when the bounds are empty. */
+	bool InitGrid(const FBox3f& Bounds, int32 Resolution);
+
+	/** Sets the voxels whose center is inside the mesh */
+	void ClassifyInside(const TArray<FVector3f>& Vertices, const TArray<uint32>& Indices, TBitArray<>& OutInside, int32& OutNumOpenRows) const;
+
+	/** Clears the solid voxels that triangles touch, except where a triangle is a seam inside the union of SeamMeshes */
+	void RemoveBoundary(const TArray<FVector3f>& Vertices, const TArray<uint32>& Indices, TConstArrayView<const FOccluderVoxelMesh*> SeamMeshes = {});
+
+	/** Whether the triangle has the union of the meshes on both sides where it is closest to Point */
+	bool IsSeam(const FVector3f& A, const FVector3f& B, const FVector3f& C, const FVector3f& Point, TConstArrayView<const FOccluderVoxelMesh*> Meshes) const;
+
+	TBitArray<> Solid;
+	FIntVector Size = FIntVector::ZeroValue;
+	FVector3f Origin = FVector3f::ZeroVector;
+	float VoxelSize = 0.f;
+};
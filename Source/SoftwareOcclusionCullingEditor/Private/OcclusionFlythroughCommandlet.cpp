@@ -0,0 +1,305 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#include "OcclusionFlythroughCommandlet.h"
+#include "OcclusionCullingSubsystem.h"
+#include "EngineUtils.h"
+#include "Camera/CameraActor.h"
+#include "Camera/CameraComponent.h"
+#include "Camera/PlayerCameraManager.h"
+#include "Components/SplineComponent.h"
+#include "Engine/BookMark.h"
+#include "Engine/GameInstance.h"
+#include "Engine/LocalPlayer.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/WorldSettings.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/PackageName.h"
+#include "Misc/Paths.h"
+#include "RHI.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogOcclusionFlythrough, Log, All);
+
+UOcclusionFlythroughCommandlet::UOcclusionFlythroughCommandlet()
+{
+	IsClient = true;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+/** Camera transforms along the spline of the first actor with the given name or tag */
+static bool BuildSplinePath(UWorld* World, const FString& SplineName, const int32 NumSteps, TArray<FTransform>& OutPath)
+{
+	for (TActorIterator<AActor> It(World); It; ++It)
+	{
+		if (It->GetName() != SplineName && It->GetActorNameOrLabel() != SplineName && !It->ActorHasTag(*SplineName))
+		{
+			continue;
+		}
+
+		const USplineComponent* Spline = It->FindComponentByClass<USplineComponent>();
+		if (!Spline)
+		{
+			continue;
+		}
+
+		const float Length = Spline->GetSplineLength();
+		for (int32 Step = 0; Step < NumSteps; ++Step)
+		{
+			const float Distance = Length * Step / FMath::Max(1, NumSteps - 1);
+			OutPath.Emplace(Spline->GetRotationAtDistanceAlongSpline(Distance, ESplineCoordinateSpace::World),
+			                Spline->GetLocationAtDistanceAlongSpline(Distance, ESplineCoordinateSpace::World));
+		}
+		return true;
+	}
+	return false;
+}
+
+/** Camera transforms interpolated between the level bookmarks, in bookmark order */
+static bool BuildBookmarkPath(const UWorld* World, const int32 StepsPerBookmark, TArray<FTransform>& OutPath)
+{
+	TArray<const UBookMark*> BookMarks;
+	for (const UBookmarkBase* Bookmark : World->GetWorldSettings()->GetBookmarks())
+	{
+		if (const UBookMark* BookMark = Cast<UBookMark>(Bookmark))
+		{
+			BookMarks.Add(BookMark);
+		}
+	}
+
+	if (BookMarks.Num() < 2)
+	{
+		return false;
+	}
+
+	for (int32 Index = 0; Index + 1 < BookMarks.Num(); ++Index)
+	{
+		const UBookMark* From = BookMarks[Index];
+		const UBookMark* To = BookMarks[Index + 1];
+		for (int32 Step = 0; Step < StepsPerBookmark; ++Step)
+		{
+			const float Alpha = static_cast<float>(Step) / StepsPerBookmark;
+			OutPath.Emplace(FQuat::Slerp(From->Rotation.Quaternion(), To->Rotation.Quaternion(), Alpha), FMath::Lerp(From->Location, To->Location, Alpha));
+		}
+	}
+	OutPath.Emplace(BookMarks.Last()->Rotation, BookMarks.Last()->Location);
+	return true;
+}
+
+/** Nearest rank percentile of sorted values */
+static float GetPercentile(const TArray<float>& SortedValues, const float Percentile)
+{
+	if (SortedValues.IsEmpty())
+	{
+		return 0.f;
+	}
+
+	const int32 Rank = FMath::CeilToInt(Percentile / 100.f * SortedValues.Num());
+	return SortedValues[FMath::Clamp(Rank - 1, 0, SortedValues.Num() - 1)];
+}
+
+int32 UOcclusionFlythroughCommandlet::Main(const FString& Params)
+{
+	FString MapName;
+	if (!FParse::Value(*Params, TEXT("Map="), MapName))
+	{
+		UE_LOG(LogOcclusionFlythrough, Error, TEXT("Missing -Map=/Game/Path/To/Map"));
+		return 1;
+	}
+
+	FString SplineName;
+	FParse::Value(*Params, TEXT("Spline="), SplineName);
+
+	int32 NumSteps = 600;
+	FParse::Value(*Params, TEXT("Steps="), NumSteps);
+
+	int32 StepsPerBookmark = 60;
+	FParse::Value(*Params, TEXT("StepsPerBookmark="), StepsPerBookmark);
+
+	// Steps before the measurement, while the budget controller and occluder residency settle
+	int32 NumWarmupSteps = 30;
+	FParse::Value(*Params, TEXT("Warmup="), NumWarmupSteps);
+
+	float DeltaTime = 1.f / 30.f;
+	FParse::Value(*Params, TEXT("DeltaTime="), DeltaTime);
+
+	FString ReportName = FString::Printf(TEXT("Flythrough_%s"), *FPackageName::GetShortName(MapName));
+	FParse::Value(*Params, TEXT("Report="), ReportName);
+
+	// Thresholds, 0 disables a check
+	float MaxCostP95Ms = 0.f;
+	float MaxCostP99Ms = 0.f;
+	float MaxProcessP95Ms = 0.f;
+	int32 MaxLatency = 0;
+	float MinCullRate = 0.f;
+	FParse::Value(*Params, TEXT("MaxCostP95Ms="), MaxCostP95Ms);
+	FParse::Value(*Params, TEXT("MaxCostP99Ms="), MaxCostP99Ms);
+	FParse::Value(*Params, TEXT("MaxProcessP95Ms="), MaxProcessP95Ms);
+	FParse::Value(*Params, TEXT("MaxLatency="), MaxLatency);
+	FParse::Value(*Params, TEXT("MinCullRate="), MinCullRate);
+
+	// Every step is measured through the analytics of the subsystem
+	if (IConsoleVariable* AnalyticsVar = IConsoleManager::Get().FindConsoleVariable(TEXT("r.so.Analytics")); AnalyticsVar && AnalyticsVar->GetInt() == 0)
+	{
+		AnalyticsVar->Set(1, ECVF_SetByCommandline);
+	}
+
+	// Game world with a local player, which creates the occlusion subsystem like in a packaged game
+	UGameInstance* GameInstance = NewObject<UGameInstance>(GEngine);
+	GameInstance->InitializeStandalone();
+
+	FString Error;
+	ULocalPlayer* LocalPlayer = GameInstance->CreateInitialPlayer(Error);
+	FWorldContext* WorldContext = GameInstance->GetWorldContext();
+	if (!LocalPlayer || !GEngine->LoadMap(*WorldContext, FURL(*MapName), nullptr, Error))
+	{
+		UE_LOG(LogOcclusionFlythrough, Error, TEXT("Failed to load %s: %s"), *MapName, *Error);
+		return 1;
+	}
+
+	UWorld* World = WorldContext->World();
+	World->FlushLevelStreaming(EFlushLevelStreamingType::Full);
+
+	APlayerController* PlayerController = LocalPlayer->GetPlayerController(World);
+	UOcclusionCullingSubsystem* Subsystem = LocalPlayer->GetSubsystem<UOcclusionCullingSubsystem>();
+	if (!IsValid(PlayerController) || !IsValid(PlayerController->PlayerCameraManager) || !Subsystem)
+	{
+		UE_LOG(LogOcclusionFlythrough, Error, TEXT("%s has no player controller or occlusion subsystem"), *MapName);
+		return 1;
+	}
+
+	TArray<FTransform> Path;
+	const bool bHasPath = SplineName.IsEmpty() ? BuildBookmarkPath(World, StepsPerBookmark, Path) : BuildSplinePath(World, SplineName, NumSteps, Path);
+	if (!bHasPath || Path.Num() <= NumWarmupSteps)
+	{
+		UE_LOG(LogOcclusionFlythrough, Error, TEXT("No flythrough path in %s, add a spline actor named or tagged %s or at least two bookmarks"),
+			*MapName, SplineName.IsEmpty() ? TEXT("by -Spline") : *SplineName);
+		return 1;
+	}
+
+	// The camera actor drives the view, without a viewport the aspect ratio comes from the camera
+	ACameraActor* Camera = World->SpawnActor<ACameraActor>();
+	Camera->GetCameraComponent()->SetConstraintAspectRatio(true);
+	PlayerController->SetViewTarget(Camera);
+	PlayerController->PlayerCameraManager->UpdateCamera(DeltaTime);
+
+	if (!Subsystem->IsAllowedToTick())
+	{
+		UE_LOG(LogOcclusionFlythrough, Error, TEXT("Software occlusion culling is disabled, see r.SoftwareOcclusionCulling.Enable"));
+		return 1;
+	}
+
+	UE_LOG(LogOcclusionFlythrough, Display, TEXT("Flying %d steps through %s (%d warmup)"), Path.Num(), *MapName, NumWarmupSteps);
+	if (GUsingNullRHI)
+	{
+		UE_LOG(LogOcclusionFlythrough, Display, TEXT("False visible primitives are not measured with -nullrhi, nothing is rendered"));
+	}
+
+	Subsystem->ResetAnalytics();
+	for (int32 Step = 0; Step < Path.Num(); ++Step)
+	{
+		if (Step == NumWarmupSteps)
+		{
+			Subsystem->ResetAnalytics();
+		}
+
+		Camera->SetActorTransform(Path[Step]);
+		PlayerController->PlayerCameraManager->UpdateCamera(DeltaTime);
+
+		// The world is never ticked, so the levels and World Partition cells around the new view are loaded before measuring
+		World->FlushLevelStreaming(EFlushLevelStreamingType::Full);
+
+		// Same order as the engine loop, the frame counter dates the occlusion results
+		GFrameCounter++;
+		Subsystem->Tick(DeltaTime);
+	}
+
+	const TArray<FOcclusionFrameAnalytics>& Frames = Subsystem->GetAnalytics().GetFrames();
+	TArray<float> CostMs, GatherMs, ProcessMs, ApplyMs, FlushWaitMs, Occludees, Culled, Latency;
+	int64 NumOccludees = 0;
+	int64 NumCulled = 0;
+
+	for (const FOcclusionFrameAnalytics& Frame : Frames)
+	{
+		CostMs.Add(Frame.GetCostMs());
+		GatherMs.Add(Frame.GatherTimeMs);
+		ProcessMs.Add(Frame.ProcessTimeMs);
+		ApplyMs.Add(Frame.ApplyTimeMs);
+		FlushWaitMs.Add(Frame.FlushWaitTimeMs);
+		Occludees.Add(Frame.NumOccludees);
+		Culled.Add(Frame.NumCulled);
+		Latency.Add(Frame.ResultsLatency);
+		NumOccludees += Frame.NumOccludees;
+		NumCulled += Frame.NumCulled;
+	}
+
+	const TPair<const TCHAR*, TArray<float>*> Metrics[] =
+	{
+		{ TEXT("CostMs"), &CostMs },
+		{ TEXT("GatherMs"), &GatherMs },
+		{ TEXT("ProcessMs"), &ProcessMs },
+		{ TEXT("ApplyMs"), &ApplyMs },
+		{ TEXT("FlushWaitMs"), &FlushWaitMs },
+		{ TEXT("Occludees"), &Occludees },
+		{ TEXT("Culled"), &Culled },
+		{ TEXT("Latency"), &Latency },
+	};
+
+	FString Report = TEXT("Metric,Mean,P50,P90,P95,P99,Max\n");
+	UE_LOG(LogOcclusionFlythrough, Display, TEXT("%d measured frames"), Frames.Num());
+	UE_LOG(LogOcclusionFlythrough, Display, TEXT("%-12s %10s %10s %10s %10s %10s %10s"), TEXT("Metric"), TEXT("Mean"), TEXT("P50"), TEXT("P90"), TEXT("P95"), TEXT("P99"), TEXT("Max"));
+
+	for (const TPair<const TCHAR*, TArray<float>*>& Metric : Metrics)
+	{
+		TArray<float>& Values = *Metric.Value;
+		Values.Sort();
+
+		double Sum = 0.0;
+		for (const float Value : Values)
+		{
+			Sum += Value;
+		}
+		const float Mean = Values.Num() > 0 ? static_cast<float>(Sum / Values.Num()) : 0.f;
+
+		UE_LOG(LogOcclusionFlythrough, Display, TEXT("%-12s %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f"), Metric.Key, Mean,
+			GetPercentile(Values, 50.f), GetPercentile(Values, 90.f), GetPercentile(Values, 95.f), GetPercentile(Values, 99.f), GetPercentile(Values, 100.f));
+		Report += FString::Printf(TEXT("%s,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f\n"), Metric.Key, Mean,
+			GetPercentile(Values, 50.f), GetPercentile(Values, 90.f), GetPercentile(Values, 95.f), GetPercentile(Values, 99.f), GetPercentile(Values, 100.f));
+	}
+
+	const FString ReportPath = FPaths::Combine(FPaths::ProfilingDir(), TEXT("SoftwareOcclusion"), ReportName + TEXT("_Percentiles.csv"));
+	IFileManager::Get().MakeDirectory(*FPaths::GetPath(ReportPath), true);
+	if (!FFileHelper::SaveStringToFile(Report, *ReportPath))
+	{
+		UE_LOG(LogOcclusionFlythrough, Error, TEXT("Failed to write %s"), *ReportPath);
+	}
+	Subsystem->ExportAnalytics(ReportName);
+
+	int32 NumFailures = 0;
+	auto CheckThreshold = [&NumFailures](const TCHAR* Name, const float Value, const float Threshold, const bool bMinimum)
+	{
+		if (Threshold > 0.f && (bMinimum ? Value < Threshold : Value > Threshold))
+		{
+			UE_LOG(LogOcclusionFlythrough, Error, TEXT("%s %.3f is %s the threshold %.3f"), Name, Value, bMinimum ? TEXT("below") : TEXT("above"), Threshold);
+			NumFailures++;
+		}
+	};
+
+	const float CullRate = NumOccludees > 0 ? static_cast<float>(NumCulled) / NumOccludees : 0.f;
+	CheckThreshold(TEXT("Cost P95 (ms)"), GetPercentile(CostMs, 95.f), MaxCostP95Ms, false);
+	CheckThreshold(TEXT("Cost P99 (ms)"), GetPercentile(CostMs, 99.f), MaxCostP99Ms, false);
+	CheckThreshold(TEXT("Process P95 (ms)"), GetPercentile(ProcessMs, 95.f), MaxProcessP95Ms, false);
+	CheckThreshold(TEXT("Max latency (frames)"), GetPercentile(Latency, 100.f), MaxLatency, false);
+	CheckThreshold(TEXT("Cull rate"), CullRate, MinCullRate, true);
+
+	UE_LOG(LogOcclusionFlythrough, Display, TEXT("Cull rate %.1f %%, report written to %s, %d thresholds exceeded"), CullRate * 100.f, *ReportPath, NumFailures);
+
+	// Removing the local player flushes the last occlusion task
+	GameInstance->Shutdown();
+	World->DestroyWorld(true);
+	GEngine->DestroyWorldContext(World);
+
+	return NumFailures > 0 ? 1 : 0;
+}
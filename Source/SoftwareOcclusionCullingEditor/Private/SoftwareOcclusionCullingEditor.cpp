@@ -0,0 +1,114 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#include "SoftwareOcclusionCullingEditor.h"
+#include "ContentBrowserModule.h"
+#include "Editor.h"
+#include "IContentBrowserSingleton.h"
+#include "OccluderCellBaker.h"
+#include "OccluderFusion.h"
+#include "OccluderProxyBuilder.h"
+#include "Engine/StaticMesh.h"
+#include "ScopedTransaction.h"
+
+#define LOCTEXT_NAMESPACE "FSoftwareOcclusionCullingEditorModule"
+
+// Generates occluder proxies and boxes for the static meshes selected in the content browser
+static void GenerateOccluderDataForSelection()
+{
+	TArray<FAssetData> SelectedAssets;
+	FModuleManager::LoadModuleChecked<FContentBrowserModule>("ContentBrowser").Get().GetSelectedAssets(SelectedAssets);
+
+	const FScopedTransaction Transaction(LOCTEXT("GenerateOccluderData", "Generate Occluder Data"));
+	const FOccluderProxyBuildSettings Settings;
+	for (const FAssetData& Asset : SelectedAssets)
+	{
+		if (UStaticMesh* StaticMesh = Cast<UStaticMesh>(Asset.GetAsset()))
+		{
+			if (FOccluderProxyBuilder::BuildForStaticMesh(StaticMesh, Settings))
+			{
+				StaticMesh->MarkPackageDirty();
+			}
+		}
+	}
+}
+
+static FAutoConsoleCommand GenerateOccluderDataCommand(
+	TEXT("so.Editor.GenerateOccluderData"),
+	TEXT("Generates occluder proxies and inscribed boxes for the static meshes selected in the content browser."),
+	FConsoleCommandDelegate::CreateStatic(&GenerateOccluderDataForSelection)
+);
+
+// Fuses adjacent static meshes of every loaded level of the editor world into single occluders
+static void FuseOccluders(const TArray<FString>& Args)
+{
+	UWorld* World = GEditor ? GEditor->GetEditorWorldContext().World() : nullptr;
+	if (!World)
+	{
+		return;
+	}
+
+	FOccluderFusionSettings Settings;
+	if (Args.IsValidIndex(0))
+	{
+		LexFromString(Settings.CellSize, *Args[0]);
+	}
+	if (Args.IsValidIndex(1))
+	{
+		LexFromString(Settings.MaxPieceRadius, *Args[1]);
+	}
+
+	const FScopedTransaction Transaction(LOCTEXT("FuseOccluders", "Fuse Occluders"));
+	int32 NumFused = 0;
+	for (ULevel* Level : World->GetLevels())
+	{
+		NumFused += FOccluderFusion::FuseLevel(Level, Settings);
+	}
+	UE_LOG(LogTemp, Display, TEXT("Created %d fused occluders"), NumFused);
+}
+
+static FAutoConsoleCommand FuseOccludersCommand(
+	TEXT("so.Editor.FuseOccluders"),
+	TEXT("Clusters adjacent static meshes of the editor world into fused occluders. Arguments: [CellSize=4000] [MaxPieceRadius=1000]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&FuseOccluders)
+);
+
+// Bakes the potential occluders of every view cell of the editor world
+static void BakeOccluderCells(const TArray<FString>& Args)
+{
+	UWorld* World = GEditor ? GEditor->GetEditorWorldContext().World() : nullptr;
+	if (!World)
+	{
+		return;
+	}
+
+	FOccluderCellBakeSettings Settings;
+	if (Args.IsValidIndex(0))
+	{
+		LexFromString(Settings.CellSize, *Args[0]);
+	}
+	if (Args.IsValidIndex(1))
+	{
+		LexFromString(Settings.MaxOccludersPerCell, *Args[1]);
+	}
+
+	FString Path;
+	FOccluderCellBaker::Bake(World, Settings, Path);
+}
+
+static FAutoConsoleCommand BakeOccluderCellsCommand(
+	TEXT("so.Editor.BakeOccluderCells"),
+	TEXT("Bakes the static occluder candidates of every view cell of the editor world. Arguments: [CellSize=2000] [MaxOccludersPerCell=64]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BakeOccluderCells)
+);
+
+void FSoftwareOcclusionCullingEditorModule::StartupModule()
+{
+}
+
+void FSoftwareOcclusionCullingEditorModule::ShutdownModule()
+{
+}
+
+#undef LOCTEXT_NAMESPACE
+
+IMPLEMENT_MODULE(FSoftwareOcclusionCullingEditorModule, SoftwareOcclusionCullingEditor)
@@ -0,0 +1,80 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#include "Misc/AutomationTest.h"
+#include "OccluderVoxelGrid.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+static FOccluderVoxelMesh MakeBoxMesh(const FVector3f& Min, const FVector3f& Max)
+{
+	FOccluderVoxelMesh Mesh;
+	for (int32 Corner = 0; Corner < 8; ++Corner)
+	{
+		Mesh.Vertices.Add(FVector3f((Corner & 1) ? Max.X : Min.X, (Corner & 2) ? Max.Y : Min.Y, (Corner & 4) ? Max.Z : Min.Z));
+	}
+
+	Mesh.Indices = {
+		0, 2, 6, 0, 6, 4, 1, 7, 3, 1, 5, 7,
+		0, 5, 1, 0, 4, 5, 2, 3, 7, 2, 7, 6,
+		0, 1, 3, 0, 3, 2, 4, 7, 5, 4, 6, 7
+	};
+	return Mesh;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FOccluderVoxelGridUnionGapTest, "SoftwareOcclusionCulling.VoxelGrid.UnionGap",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FOccluderVoxelGridUnionGapTest::RunTest(const FString& Parameters)
+{
+	// Two boxes 4 units apart, with voxels of 10.2 units straddling the gap
+	constexpr float GapMin = 100.f;
+	constexpr float GapMax = 104.f;
+	const FOccluderVoxelMesh Meshes[] = { MakeBoxMesh(FVector3f(0.f), FVector3f(GapMin, 100.f, 100.f)), MakeBoxMesh(FVector3f(GapMax, 0.f, 0.f), FVector3f(204.f, 100.f, 100.f)) };
+
+	FOccluderVoxelGrid Grid;
+	if (!TestTrue(TEXT("Union is built"), Grid.BuildUnion(Meshes, 20)))
+	{
+		return false;
+	}
+
+	TestTrue(TEXT("Both boxes have solid voxels"), Grid.IsSolid(2, 4, 4) && Grid.IsSolid(17, 4, 4));
+
+	const FIntVector& Size = Grid.GetSize();
+	for (int32 Z = 0; Z < Size.Z; ++Z)
+	{
+		for (int32 Y = 0; Y < Size.Y; ++Y)
+		{
+			for (int32 X = 0; X < Size.X; ++X)
+			{
+				const float MinX = Grid.GetCorner(FIntVector(X, Y, Z)).X;
+				const float MaxX = Grid.GetCorner(FIntVector(X + 1, Y, Z)).X;
+				if (Grid.IsSolid(X, Y, Z) && MinX < GapMax && MaxX > GapMin)
+				{
+					AddError(FString::Printf(TEXT("Voxel %d %d %d [%f, %f] fills the gap between the boxes"), X, Y, Z, MinX, MaxX));
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FOccluderVoxelGridUnionSeamTest, "SoftwareOcclusionCulling.VoxelGrid.UnionSeam",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FOccluderVoxelGridUnionSeamTest::RunTest(const FString& Parameters)
+{
+	// Two touching boxes, with voxels of 9.52 units and voxel 9 straddling the seam at X = 90
+	const FOccluderVoxelMesh Meshes[] = { MakeBoxMesh(FVector3f(0.f), FVector3f(90.f, 100.f, 100.f)), MakeBoxMesh(FVector3f(90.f, 0.f, 0.f), FVector3f(200.f, 100.f, 100.f)) };
+
+	FOccluderVoxelGrid Grid;
+	if (!TestTrue(TEXT("Union is built"), Grid.BuildUnion(Meshes, 21)))
+	{
+		return false;
+	}
+
+	TestTrue(TEXT("The seam does not split the solid"), Grid.IsSolid(9, 5, 5));
+	return true;
+}
+
+#endif
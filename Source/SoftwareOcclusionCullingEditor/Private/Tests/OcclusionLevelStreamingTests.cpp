@@ -0,0 +1,47 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#include "Misc/AutomationTest.h"
+#include "OcclusionCullingSubsystem.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/Engine.h"
+#include "Engine/Level.h"
+#include "Engine/StaticMeshActor.h"
+#include "Engine/World.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FOcclusionLevelShownAgainTest, "SoftwareOcclusionCulling.Subsystem.LevelShownAgain",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FOcclusionLevelShownAgainTest::RunTest(const FString& Parameters)
+{
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false);
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+
+	const AStaticMeshActor* Actor = World->SpawnActor<AStaticMeshActor>();
+	UStaticMeshComponent* Component = Actor->GetStaticMeshComponent();
+	ULevel* Level = World->PersistentLevel;
+
+	// Without a player camera manager the subsystem never ticks, the level callbacks are driven by the test
+	UOcclusionCullingSubsystem* Subsystem = NewObject<UOcclusionCullingSubsystem>();
+	Subsystem->RegisterLevelPrimitives(Level);
+
+	UOcclusionPrimitiveContext* Context = Subsystem->FindPrimitiveContext(Component);
+	if (TestNotNull(TEXT("Primitive is registered with its level"), Context))
+	{
+		// Occluded when the level is hidden, then shown again
+		Context->SetHiddenInGame(true);
+		Subsystem->ReleaseLevelPrimitives(Level);
+		Subsystem->RegisterLevelPrimitives(Level);
+
+		TestFalse(TEXT("Primitive is visible once its level is shown again"), Component->bHiddenInGame);
+		TestNotNull(TEXT("Primitive is registered again"), Subsystem->FindPrimitiveContext(Component));
+	}
+
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+	return true;
+}
+
+#endif
@@ -0,0 +1,23 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "GenerateOccluderProxiesCommandlet.generated.h"
+
+/**
+ * Generates occluder proxies and inscribed boxes for every static mesh under a content path and saves the changed packages.
+ * Run before cooking: -run=GenerateOccluderProxies [-Path=/Game] [-MaxTriangles=128] [-Resolution=32] [-MinSourceTriangles=256]
+ *                     [-MaxBoxes=4] [-BoxCoverage=0.6] [-NoBoxes] [-Force]
+ */
+UCLASS()
+class UGenerateOccluderProxiesCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UGenerateOccluderProxiesCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,25 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "OcclusionFlythroughCommandlet.generated.h"
+
+/**
+ * Flies a camera through a map and ticks the occlusion subsystem at every step. Reports percentiles of the occlusion cost,
+ * cull counts and results latency, and fails when a threshold is exceeded. The path is the spline of the actor named or tagged
+ * by -Spline, otherwise the level bookmarks in order. Runs headless with -nullrhi:
+ * -run=OcclusionFlythrough -Map=/Game/Maps/City [-Spline=ActorNameOrTag] [-Steps=600] [-StepsPerBookmark=60] [-Warmup=30]
+ *                          [-Report=Name] [-MaxCostP95Ms=X] [-MaxCostP99Ms=X] [-MaxProcessP95Ms=X] [-MaxLatency=N] [-MinCullRate=X]
+ */
+UCLASS()
+class UOcclusionFlythroughCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UOcclusionFlythroughCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,31 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+using UnrealBuildTool;
+
+public class SoftwareOcclusionCullingEditor : ModuleRules
+{
+	public SoftwareOcclusionCullingEditor(ReadOnlyTargetRules Target) : base(Target)
+	{
+		PCHUsage = ModuleRules.PCHUsageMode.UseExplicitOrSharedPCHs;
+
+		PublicDependencyModuleNames.AddRange(
+			new string[]
+			{
+				"Core",
+			}
+			);
+
+		PrivateDependencyModuleNames.AddRange(
+			new string[]
+			{
+				"CoreUObject",
+				"Engine",
+				"UnrealEd",
+				"AssetRegistry",
+				"ContentBrowser",
+				"RHI",
+				"SoftwareOcclusionCulling"
+			}
+			);
+	}
+}
@@ -0,0 +1,21 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#include "OcclusionCaptureFile.h"
+
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+namespace SOTools
+{
+	bool LoadSceneCaptureFile(const std::string& Path, FScene& OutScene)
+	{
+		std::ifstream File(Path, std::ios::binary);
+		if (!File)
+		{
+			return false;
+		}
+		const std::vector<uint8_t> Bytes((std::istreambuf_iterator<char>(File)), std::istreambuf_iterator<char>());
+		return ReadSceneCapture(Bytes.data(), Bytes.size(), OutScene);
+	}
+}
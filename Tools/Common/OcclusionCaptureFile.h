@@ -0,0 +1,15 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#pragma once
+
+#include "OcclusionCoreCapture.h"
+
+#include <string>
+
+namespace SOTools
+{
+	using namespace SOCore;
+
+	/** Reads a capture written by so.CaptureScene. Returns false when the file is missing or not a valid capture. */
+	bool LoadSceneCaptureFile(const std::string& Path, FScene& OutScene);
+}
@@ -0,0 +1,60 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#include "OcclusionStageStats.h"
+
+#include <algorithm>
+
+namespace SOTools
+{
+	static const char* const StageNames[FStageStats::Stage_Num] = { "gather", "occluder", "occludee", "sort", "rasterize", "total" };
+
+	void FStageStats::Add(const SOCore::FStageTimings& Timings, const double GatherMs)
+	{
+		if (GatherMs >= 0.0)
+		{
+			Samples[Stage_Gather].push_back(GatherMs);
+		}
+		Samples[Stage_Occluder].push_back(Timings.OccluderMs);
+		Samples[Stage_Occludee].push_back(Timings.OccludeeMs);
+		Samples[Stage_Sort].push_back(Timings.SortMs);
+		Samples[Stage_Rasterize].push_back(Timings.RasterizeMs);
+		Samples[Stage_Total].push_back(Timings.GetTotalMs() + std::max(GatherMs, 0.0));
+	}
+
+	double FStageStats::GetPercentile(const EStage Stage, const double Percentile) const
+	{
+		std::vector<double> Sorted = Samples[Stage];
+		if (Sorted.empty())
+		{
+			return 0.0;
+		}
+		std::sort(Sorted.begin(), Sorted.end());
+		const size_t Rank = static_cast<size_t>(Percentile / 100.0 * static_cast<double>(Sorted.size()) + 0.5);
+		return Sorted[std::min(Sorted.size() - 1, Rank > 0 ? Rank - 1 : 0)];
+	}
+
+	double FStageStats::GetMean(const EStage Stage) const
+	{
+		double Sum = 0.0;
+		for (const double Sample : Samples[Stage])
+		{
+			Sum += Sample;
+		}
+		return Samples[Stage].empty() ? 0.0 : Sum / static_cast<double>(Samples[Stage].size());
+	}
+
+	void FStageStats::Print(FILE* Output) const
+	{
+		std::fprintf(Output, "  %-10s %9s %9s %9s %9s %9s\n", "stage", "p50 ms", "p90 ms", "p99 ms", "max ms", "mean ms");
+		for (int32_t StageIndex = 0; StageIndex < Stage_Num; ++StageIndex)
+		{
+			const EStage Stage = static_cast<EStage>(StageIndex);
+			if (Samples[Stage].empty())
+			{
+				continue;
+			}
+			std::fprintf(Output, "  %-10s %9.3f %9.3f %9.3f %9.3f %9.3f\n", StageNames[Stage],
+			             GetPercentile(Stage, 50.0), GetPercentile(Stage, 90.0), GetPercentile(Stage, 99.0), GetPercentile(Stage, 100.0), GetMean(Stage));
+		}
+	}
+}
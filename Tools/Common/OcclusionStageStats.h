@@ -0,0 +1,40 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#pragma once
+
+#include "OcclusionCoreFrame.h"
+
+#include <cstdio>
+#include <vector>
+
+namespace SOTools
+{
+	/** Per stage frame time samples of a tool run, printed as percentiles */
+	class FStageStats
+	{
+	public:
+		enum EStage
+		{
+			Stage_Gather,
+			Stage_Occluder,
+			Stage_Occludee,
+			Stage_Sort,
+			Stage_Rasterize,
+			Stage_Total,
+			Stage_Num
+		};
+
+		/** GatherMs is negative when the tool has no gather stage */
+		void Add(const SOCore::FStageTimings& Timings, double GatherMs = -1.0);
+
+		/** Nearest rank percentile of a stage, in milliseconds */
+		double GetPercentile(EStage Stage, double Percentile) const;
+		double GetMean(EStage Stage) const;
+		int32_t GetNumFrames() const { return static_cast<int32_t>(Samples[Stage_Total].size()); }
+
+		void Print(FILE* Output) const;
+
+	private:
+		std::vector<double> Samples[Stage_Num];
+	};
+}
@@ -0,0 +1,430 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#include "OcclusionSyntheticScenes.h"
+
+#include <algorithm>
+
+namespace SOTools
+{
+	static constexpr float OCCLUDER_DISTANCE_WEIGHT = 10000.f;
+	static const FVec3 UpVector = { 0.f, 0.f, 1.f };
+
+	FRandomStream::FRandomStream(const uint64_t Seed)
+		: State(Seed * 6364136223846793005ull + 1442695040888963407ull)
+	{
+	}
+
+	uint32_t FRandomStream::Next()
+	{
+		// PCG32
+		const uint64_t OldState = State;
+		State = OldState * 6364136223846793005ull + 1442695040888963407ull;
+		const uint32_t XorShifted = static_cast<uint32_t>(((OldState >> 18u) ^ OldState) >> 27u);
+		const uint32_t Rot = static_cast<uint32_t>(OldState >> 59u);
+		return (XorShifted >> Rot) | (XorShifted << ((32u - Rot) & 31u));
+	}
+
+	float FRandomStream::FRand()
+	{
+		return static_cast<float>(Next() >> 8) * (1.f / 16777216.f);
+	}
+
+	float FRandomStream::FRandRange(const float Min, const float Max)
+	{
+		return Min + (Max - Min) * FRand();
+	}
+
+	int32_t FRandomStream::RandRange(const int32_t Min, const int32_t Max)
+	{
+		return Min + static_cast<int32_t>(Next() % static_cast<uint32_t>(Max - Min + 1));
+	}
+
+	FCameraPose FWorld::GetCameraPose(const int32_t Frame, const int32_t NumFrames) const
+	{
+		if (CameraPath.size() < 2 || NumFrames < 2)
+		{
+			return CameraPath.empty() ? FCameraPose{ {}, { 1.f, 0.f, 0.f } } : CameraPath[0];
+		}
+
+		const float PathTime = static_cast<float>(Frame) / static_cast<float>(NumFrames - 1) * static_cast<float>(CameraPath.size() - 1);
+		const int32_t Key = std::min(static_cast<int32_t>(PathTime), static_cast<int32_t>(CameraPath.size()) - 2);
+		const float Alpha = PathTime - static_cast<float>(Key);
+
+		const FCameraPose& A = CameraPath[Key];
+		const FCameraPose& B = CameraPath[Key + 1];
+		return { A.Eye + (B.Eye - A.Eye) * Alpha, A.Target + (B.Target - A.Target) * Alpha };
+	}
+
+	// Flips triangles so they face away from the origin, the front facing convention of the occluder meshes
+	static void FixConvexWinding(const std::vector<FVec3>& Vertices, std::vector<uint16_t>& Indices)
+	{
+		for (size_t i = 0; i + 2 < Indices.size(); i += 3)
+		{
+			const FVec3& A = Vertices[Indices[i + 0]];
+			const FVec3& B = Vertices[Indices[i + 1]];
+			const FVec3& C = Vertices[Indices[i + 2]];
+			const FVec3 Normal = (C - A).Cross(B - A);
+			if (Normal.Dot(A + B + C) < 0.f)
+			{
+				std::swap(Indices[i + 1], Indices[i + 2]);
+			}
+		}
+	}
+
+	static FOccluderMesh MakeCylinderMesh(const int32_t NumSides)
+	{
+		std::vector<FVec3> Vertices;
+		std::vector<uint16_t> Indices;
+		for (int32_t Side = 0; Side < NumSides; ++Side)
+		{
+			const float Angle = 6.2831853f * static_cast<float>(Side) / static_cast<float>(NumSides);
+			Vertices.push_back({ std::cos(Angle), std::sin(Angle), -1.f });
+			Vertices.push_back({ std::cos(Angle), std::sin(Angle), 1.f });
+		}
+		const uint16_t BottomCenter = static_cast<uint16_t>(Vertices.size());
+		Vertices.push_back({ 0.f, 0.f, -1.f });
+		Vertices.push_back({ 0.f, 0.f, 1.f });
+
+		for (int32_t Side = 0; Side < NumSides; ++Side)
+		{
+			const uint16_t B0 = static_cast<uint16_t>(Side * 2);
+			const uint16_t T0 = static_cast<uint16_t>(B0 + 1);
+			const uint16_t B1 = static_cast<uint16_t>(((Side + 1) % NumSides) * 2);
+			const uint16_t T1 = static_cast<uint16_t>(B1 + 1);
+			Indices.insert(Indices.end(), { B0, B1, T1, B0, T1, T0, BottomCenter, B1, B0, static_cast<uint16_t>(BottomCenter + 1), T0, T1 });
+		}
+
+		FixConvexWinding(Vertices, Indices);
+		return BuildOccluderMesh(Vertices, Indices);
+	}
+
+	// City grid of box buildings with street props, the camera drives down a street
+	static void GenerateCity(FRandomStream& Random, FWorld& World)
+	{
+		constexpr int32_t NumBlocks = 24;
+		constexpr float BlockSize = 6000.f;
+		constexpr float StreetWidth = 2000.f;
+		constexpr float Pitch = BlockSize + StreetWidth;
+
+		for (int32_t BlockX = 0; BlockX < NumBlocks; ++BlockX)
+		{
+			for (int32_t BlockY = 0; BlockY < NumBlocks; ++BlockY)
+			{
+				const FVec3 BlockMin = { BlockX * Pitch, BlockY * Pitch, 0.f };
+				const float LotSize = BlockSize / 2.f;
+
+				for (int32_t Lot = 0; Lot < 4; ++Lot)
+				{
+					const float Height = Random.FRandRange(1500.f, 12000.f);
+					const float Inset = Random.FRandRange(100.f, 400.f);
+
+					FWorldObject Building;
+					Building.Extent = { LotSize / 2.f - Inset, LotSize / 2.f - Inset, Height / 2.f };
+					Building.Center = BlockMin + FVec3{ (Lot % 2 + 0.5f) * LotSize, (Lot / 2 + 0.5f) * LotSize, Height / 2.f };
+					Building.Occluder = EOccluderType::Box;
+					World.Objects.push_back(Building);
+				}
+
+				for (int32_t Prop = 0; Prop < 24; ++Prop)
+				{
+					// Cars and street furniture along both streets of the block
+					const bool bAlongX = (Prop % 2) == 0;
+					const float Along = Random.FRandRange(0.f, Pitch);
+					const float Across = BlockSize + Random.FRandRange(150.f, StreetWidth - 150.f);
+
+					FWorldObject PropObject;
+					PropObject.Extent = { Random.FRandRange(40.f, 220.f), Random.FRandRange(40.f, 100.f), Random.FRandRange(50.f, 200.f) };
+					PropObject.Center = BlockMin + (bAlongX ? FVec3{ Along, Across, 0.f } : FVec3{ Across, Along, 0.f });
+					PropObject.Center.Z = PropObject.Extent.Z;
+					World.Objects.push_back(PropObject);
+				}
+			}
+		}
+
+		const float StreetX = 3.f * Pitch + BlockSize + StreetWidth / 2.f;
+		const float CrossStreetY = 12.f * Pitch + BlockSize + StreetWidth / 2.f;
+		World.CameraPath =
+		{
+			{ { StreetX, 500.f, 180.f }, { StreetX + 100.f, 2500.f, 200.f } },
+			{ { StreetX, CrossStreetY, 180.f }, { StreetX - 100.f, CrossStreetY + 2000.f, 200.f } },
+			{ { StreetX, CrossStreetY, 180.f }, { StreetX + 2000.f, CrossStreetY, 200.f } },
+			{ { StreetX + 10.f * Pitch, CrossStreetY, 180.f }, { StreetX + 10.f * Pitch + 2000.f, CrossStreetY + 200.f, 200.f } },
+		};
+	}
+
+	// Dense forest: every tree is an occludee, trunks and rocks are mesh occluders
+	static void GenerateForest(FRandomStream& Random, FWorld& World)
+	{
+		constexpr int32_t NumTrees = 20000;
+		constexpr int32_t NumRocks = 300;
+		constexpr float ForestSize = 40000.f;
+
+		World.Meshes.push_back(MakeCylinderMesh(12));
+		const int32_t TrunkMesh = static_cast<int32_t>(World.Meshes.size()) - 1;
+
+		for (int32_t Tree = 0; Tree < NumTrees; ++Tree)
+		{
+			const float X = Random.FRandRange(0.f, ForestSize);
+			const float Y = Random.FRandRange(0.f, ForestSize);
+			const float Height = Random.FRandRange(600.f, 1500.f);
+			const float Radius = Random.FRandRange(20.f, 50.f);
+
+			FWorldObject Trunk;
+			Trunk.Center = { X, Y, Height / 2.f };
+			Trunk.Extent = { Radius, Radius, Height / 2.f };
+			Trunk.Occluder = EOccluderType::Mesh;
+			Trunk.MeshIndex = TrunkMesh;
+			World.Objects.push_back(Trunk);
+
+			FWorldObject Canopy;
+			const float CanopyRadius = Random.FRandRange(150.f, 400.f);
+			Canopy.Center = { X, Y, Height + CanopyRadius * 0.5f };
+			Canopy.Extent = { CanopyRadius, CanopyRadius, CanopyRadius };
+			World.Objects.push_back(Canopy);
+		}
+
+		for (int32_t Rock = 0; Rock < NumRocks; ++Rock)
+		{
+			FWorldObject RockObject;
+			RockObject.Extent = { Random.FRandRange(300.f, 1500.f), Random.FRandRange(300.f, 1500.f), Random.FRandRange(200.f, 800.f) };
+			RockObject.Center = { Random.FRandRange(0.f, ForestSize), Random.FRandRange(0.f, ForestSize), RockObject.Extent.Z * 0.5f };
+			RockObject.Occluder = EOccluderType::Mesh;
+			RockObject.MeshIndex = 0;
+			World.Objects.push_back(RockObject);
+		}
+
+		for (int32_t Key = 0; Key <= 8; ++Key)
+		{
+			const float Y = 1000.f + Key * (ForestSize - 2000.f) / 8.f;
+			const float X = ForestSize / 2.f + ((Key % 2) ? 2000.f : -2000.f);
+			World.CameraPath.push_back({ { X, Y, 170.f }, { X + ((Key % 2) ? -800.f : 800.f), Y + 2000.f, 200.f } });
+		}
+	}
+
+	// Indoor corridor maze with furnished cells, the camera walks down a corridor carved through the middle
+	static void GenerateMaze(FRandomStream& Random, FWorld& World)
+	{
+		constexpr int32_t NumCells = 32;
+		constexpr float CellSize = 800.f;
+		constexpr float WallHeight = 400.f;
+		constexpr float WallThickness = 10.f;
+		constexpr int32_t CorridorRow = NumCells / 2;
+
+		// Recursive backtracker, each cell keeps its east and north walls
+		std::vector<uint8_t> EastWall(NumCells * NumCells, 1);
+		std::vector<uint8_t> NorthWall(NumCells * NumCells, 1);
+		std::vector<uint8_t> Visited(NumCells * NumCells, 0);
+		std::vector<int32_t> Stack = { 0 };
+		Visited[0] = 1;
+
+		while (!Stack.empty())
+		{
+			const int32_t Cell = Stack.back();
+			const int32_t CellX = Cell % NumCells;
+			const int32_t CellY = Cell / NumCells;
+
+			int32_t Neighbors[4];
+			int32_t NumNeighbors = 0;
+			if (CellX > 0 && !Visited[Cell - 1]) Neighbors[NumNeighbors++] = Cell - 1;
+			if (CellX < NumCells - 1 && !Visited[Cell + 1]) Neighbors[NumNeighbors++] = Cell + 1;
+			if (CellY > 0 && !Visited[Cell - NumCells]) Neighbors[NumNeighbors++] = Cell - NumCells;
+			if (CellY < NumCells - 1 && !Visited[Cell + NumCells]) Neighbors[NumNeighbors++] = Cell + NumCells;
+
+			if (NumNeighbors == 0)
+			{
+				Stack.pop_back();
+				continue;
+			}
+
+			const int32_t Next = Neighbors[Random.RandRange(0, NumNeighbors - 1)];
+			if (Next == Cell + 1) EastWall[Cell] = 0;
+			if (Next == Cell - 1) EastWall[Next] = 0;
+			if (Next == Cell + NumCells) NorthWall[Cell] = 0;
+			if (Next == Cell - NumCells) NorthWall[Next] = 0;
+			Visited[Next] = 1;
+			Stack.push_back(Next);
+		}
+
+		for (int32_t CellX = 0; CellX < NumCells - 1; ++CellX)
+		{
+			EastWall[CorridorRow * NumCells + CellX] = 0;
+		}
+
+		for (int32_t CellY = 0; CellY < NumCells; ++CellY)
+		{
+			for (int32_t CellX = 0; CellX < NumCells; ++CellX)
+			{
+				const int32_t Cell = CellY * NumCells + CellX;
+				const FVec3 CellMin = { CellX * CellSize, CellY * CellSize, 0.f };
+
+				FWorldObject Wall;
+				Wall.Occluder = EOccluderType::Mesh;
+				Wall.MeshIndex = 0;
+				if (EastWall[Cell])
+				{
+					Wall.Center = CellMin + FVec3{ CellSize, CellSize / 2.f, WallHeight / 2.f };
+					Wall.Extent = { WallThickness, CellSize / 2.f, WallHeight / 2.f };
+					World.Objects.push_back(Wall);
+				}
+				if (NorthWall[Cell])
+				{
+					Wall.Center = CellMin + FVec3{ CellSize / 2.f, CellSize, WallHeight / 2.f };
+					Wall.Extent = { CellSize / 2.f, WallThickness, WallHeight / 2.f };
+					World.Objects.push_back(Wall);
+				}
+
+				for (int32_t Item = 0; Item < 6; ++Item)
+				{
+					FWorldObject Furniture;
+					Furniture.Extent = { Random.FRandRange(20.f, 80.f), Random.FRandRange(20.f, 80.f), Random.FRandRange(20.f, 100.f) };
+					Furniture.Center = CellMin + FVec3{ Random.FRandRange(100.f, CellSize - 100.f), Random.FRandRange(100.f, CellSize - 100.f), Furniture.Extent.Z };
+					World.Objects.push_back(Furniture);
+				}
+			}
+		}
+
+		const float CorridorY = (CorridorRow + 0.5f) * CellSize;
+		World.CameraPath =
+		{
+			{ { CellSize * 0.5f, CorridorY, 170.f }, { CellSize * 2.f, CorridorY + 100.f, 170.f } },
+			{ { CellSize * (NumCells - 1.5f), CorridorY, 170.f }, { CellSize * NumCells, CorridorY - 100.f, 170.f } },
+		};
+	}
+
+	// Worst case for the occludee stage: tens of thousands of tiny boxes behind a few walls
+	static void GenerateTinyOccludees(FRandomStream& Random, FWorld& World)
+	{
+		constexpr int32_t NumOccludees = 50000;
+		constexpr int32_t NumWalls = 40;
+
+		for (int32_t Wall = 0; Wall < NumWalls; ++Wall)
+		{
+			FWorldObject WallObject;
+			WallObject.Extent = { 50.f, Random.FRandRange(500.f, 1500.f), Random.FRandRange(300.f, 1000.f) };
+			WallObject.Center = { Random.FRandRange(2000.f, 8000.f), Random.FRandRange(-8000.f, 8000.f), WallObject.Extent.Z };
+			WallObject.Occluder = EOccluderType::Box;
+			World.Objects.push_back(WallObject);
+		}
+
+		for (int32_t Occludee = 0; Occludee < NumOccludees; ++Occludee)
+		{
+			FWorldObject Tiny;
+			const float Size = Random.FRandRange(3.f, 15.f);
+			Tiny.Extent = { Size, Size, Size };
+			Tiny.Center = { Random.FRandRange(1000.f, 20000.f), Random.FRandRange(-10000.f, 10000.f), Random.FRandRange(0.f, 3000.f) };
+			World.Objects.push_back(Tiny);
+		}
+
+		World.CameraPath =
+		{
+			{ { 0.f, -1000.f, 300.f }, { 1000.f, -600.f, 400.f } },
+			{ { 0.f, 0.f, 300.f }, { 1000.f, 0.f, 400.f } },
+			{ { 0.f, 1000.f, 300.f }, { 1000.f, 600.f, 400.f } },
+		};
+	}
+
+	const std::vector<std::string>& GetWorldNames()
+	{
+		static const std::vector<std::string> Names = { "city", "forest", "maze", "tiny" };
+		return Names;
+	}
+
+	bool GenerateWorld(const std::string& Name, const uint64_t Seed, FWorld& OutWorld)
+	{
+		OutWorld = FWorld();
+		OutWorld.Name = Name;
+		OutWorld.Meshes.push_back(GetUnitCubeMesh());
+
+		FRandomStream Random(Seed);
+		if (Name == "city")
+		{
+			GenerateCity(Random, OutWorld);
+		}
+		else if (Name == "forest")
+		{
+			GenerateForest(Random, OutWorld);
+		}
+		else if (Name == "maze")
+		{
+			GenerateMaze(Random, OutWorld);
+		}
+		else if (Name == "tiny")
+		{
+			GenerateTinyOccludees(Random, OutWorld);
+		}
+		else
+		{
+			return false;
+		}
+		return true;
+	}
+
+	// Same as ComputeBoundsScreenSize
+	static float ComputeBoundsScreenSize(const FVec3& RelativeOrigin, const float SphereRadius, const FMatrix44& Projection)
+	{
+		const float Distance = RelativeOrigin.Size();
+		const float ScreenMultiple = std::max(0.5f * Projection.M[0][0], 0.5f * Projection.M[1][1]);
+		return 2.f * ScreenMultiple * SphereRadius / std::max(1.f, Distance);
+	}
+
+	void GatherScene(const FWorld& World, const FCameraPose& Pose, const FGatherSettings& Settings, FScene& OutScene)
+	{
+		struct FPotentialOccluder
+		{
+			int32_t ObjectIndex;
+			float Weight;
+		};
+
+		const FMatrix44 Projection = FMatrix44::MakeReversedZPerspective(Settings.HalfFOV, Settings.ViewWidth, Settings.ViewHeight, Settings.NearPlane);
+		OutScene.ViewProj = FMatrix44::MakeLookAt(FVec3(), Pose.Target - Pose.Eye, UpVector) * Projection;
+		OutScene.Occluders.clear();
+		OutScene.OccluderBoxes.clear();
+		OutScene.OccludeeBoxMinMax.clear();
+
+		const float MaxDistanceSquared = Settings.MaxDistanceForOccluder * Settings.MaxDistanceForOccluder;
+		std::vector<FPotentialOccluder> PotentialOccluders;
+
+		for (int32_t ObjectIndex = 0; ObjectIndex < static_cast<int32_t>(World.Objects.size()); ++ObjectIndex)
+		{
+			const FWorldObject& Object = World.Objects[ObjectIndex];
+			const FVec3 RelativeCenter = Object.Center - Pose.Eye;
+
+			if (Object.Occluder != EOccluderType::None)
+			{
+				const float Radius = Object.Extent.Size();
+				const float DistanceSquared = std::max(OCCLUDER_DISTANCE_WEIGHT, RelativeCenter.Dot(RelativeCenter) - Radius * Radius);
+				const float ScreenSize = DistanceSquared < MaxDistanceSquared ? ComputeBoundsScreenSize(RelativeCenter, Radius, Projection) : 0.f;
+				if (Settings.MinScreenRadiusForOccluder < ScreenSize)
+				{
+					PotentialOccluders.push_back({ ObjectIndex, ScreenSize + OCCLUDER_DISTANCE_WEIGHT / DistanceSquared });
+				}
+			}
+
+			if (Object.bOccludee)
+			{
+				OutScene.OccludeeBoxMinMax.push_back(RelativeCenter - Object.Extent);
+				OutScene.OccludeeBoxMinMax.push_back(RelativeCenter + Object.Extent);
+			}
+		}
+
+		std::stable_sort(PotentialOccluders.begin(), PotentialOccluders.end(), [](const FPotentialOccluder& A, const FPotentialOccluder& B)
+		{
+			return A.Weight > B.Weight;
+		});
+
+		const size_t NumOccluders = std::min(PotentialOccluders.size(), static_cast<size_t>(std::max(Settings.MaxOccluderNum, 0)));
+		for (size_t i = 0; i < NumOccluders; ++i)
+		{
+			const FWorldObject& Object = World.Objects[PotentialOccluders[i].ObjectIndex];
+			const FMatrix44 LocalToWorld = FMatrix44::MakeScaleTranslation(Object.Extent, Object.Center - Pose.Eye);
+			if (Object.Occluder == EOccluderType::Box)
+			{
+				OutScene.OccluderBoxes.push_back(LocalToWorld);
+			}
+			else
+			{
+				OutScene.Occluders.push_back({ Object.MeshIndex, LocalToWorld });
+			}
+		}
+	}
+}
@@ -0,0 +1,90 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+#pragma once
+
+/*=============================================================================
+	Reproducible synthetic worlds for the standalone occlusion tools. Worlds are
+	generated from a seed, and the gather stage mirrors the occluder selection of
+	UOcclusionCullingSubsystem::CollectSceneData.
+=============================================================================*/
+
+#include "OcclusionCoreFrame.h"
+
+#include <string>
+#include <vector>
+
+namespace SOTools
+{
+	using namespace SOCore;
+
+	/** Small deterministic generator, independent of the standard library implementation */
+	class FRandomStream
+	{
+	public:
+		explicit FRandomStream(uint64_t Seed);
+
+		uint32_t Next();
+		float FRand();
+		float FRandRange(float Min, float Max);
+		int32_t RandRange(int32_t Min, int32_t Max);
+
+	private:
+		uint64_t State;
+	};
+
+	enum class EOccluderType : uint8_t
+	{
+		None,
+		Mesh,
+		Box,
+	};
+
+	/** Axis aligned world object, occluder meshes are authored in the [-1, 1] cube */
+	struct FWorldObject
+	{
+		FVec3 Center;
+		FVec3 Extent;
+		EOccluderType Occluder = EOccluderType::None;
+		int32_t MeshIndex = 0;
+		bool bOccludee = true;
+	};
+
+	struct FCameraPose
+	{
+		FVec3 Eye;
+		FVec3 Target;
+	};
+
+	struct FWorld
+	{
+		std::string Name;
+		std::vector<FOccluderMesh> Meshes;
+		std::vector<FWorldObject> Objects;
+
+		/** Camera keys, the path loops through them */
+		std::vector<FCameraPose> CameraPath;
+
+		FCameraPose GetCameraPose(int32_t Frame, int32_t NumFrames) const;
+	};
+
+	/** Defaults of r.so.MaxOccluderNum, r.so.MaxDistanceForOccluder and r.so.MinScreenRadiusForOccluder */
+	struct FGatherSettings
+	{
+		int32_t MaxOccluderNum = 150;
+		float MaxDistanceForOccluder = 20000.f;
+		float MinScreenRadiusForOccluder = 0.075f;
+		float HalfFOV = 0.785398f;
+		float ViewWidth = 1920.f;
+		float ViewHeight = 1080.f;
+		float NearPlane = 10.f;
+	};
+
+	/** Names accepted by GenerateWorld */
+	const std::vector<std::string>& GetWorldNames();
+
+	/** Returns false for unknown names */
+	bool GenerateWorld(const std::string& Name, uint64_t Seed, FWorld& OutWorld);
+
+	/** Selects the occluders and collects the occludees seen from the pose, relative to the eye */
+	void GatherScene(const FWorld& World, const FCameraPose& Pose, const FGatherSettings& Settings, FScene& OutScene);
+}
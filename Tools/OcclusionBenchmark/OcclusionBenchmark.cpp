@@ -0,0 +1,136 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+/*=============================================================================
+	Runs the occlusion pipeline over reproducible synthetic worlds and reports
+	per stage time percentiles, occluder triangle throughput and cull ratio.
+
+	OcclusionBenchmark [--scene city|forest|maze|tiny|all] [--frames N] [--seed S] [--max-occluders N]
+=============================================================================*/
+
+#include "OcclusionStageStats.h"
+#include "OcclusionSyntheticScenes.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace SOTools;
+
+namespace
+{
+	struct FBenchmarkOptions
+	{
+		std::string Scene = "all";
+		int32_t NumFrames = 300;
+		uint64_t Seed = 1;
+		FGatherSettings Gather;
+	};
+
+	bool ParseOptions(const int Argc, char** Argv, FBenchmarkOptions& OutOptions)
+	{
+		for (int i = 1; i < Argc; ++i)
+		{
+			const bool bHasValue = i + 1 < Argc;
+			if (!std::strcmp(Argv[i], "--scene") && bHasValue)
+			{
+				OutOptions.Scene = Argv[++i];
+			}
+			else if (!std::strcmp(Argv[i], "--frames") && bHasValue)
+			{
+				OutOptions.NumFrames = std::max(1, std::atoi(Argv[++i]));
+			}
+			else if (!std::strcmp(Argv[i], "--seed") && bHasValue)
+			{
+				OutOptions.Seed = std::strtoull(Argv[++i], nullptr, 10);
+			}
+			else if (!std::strcmp(Argv[i], "--max-occluders") && bHasValue)
+			{
+				OutOptions.Gather.MaxOccluderNum = std::atoi(Argv[++i]);
+			}
+			else
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void RunWorld(const FWorld& World, const FBenchmarkOptions& Options)
+	{
+		FStageStats Stats;
+		FScene Scene;
+		Scene.Meshes = World.Meshes;
+		FFrameResult Result;
+		FFrameProcessor Processor;
+
+		double NumOccluderTriangles = 0.0;
+		double NumOccluders = 0.0;
+		double NumOccludees = 0.0;
+		double NumVisible = 0.0;
+		double TriangleStageMs = 0.0;
+
+		for (int32_t Frame = 0; Frame < Options.NumFrames; ++Frame)
+		{
+			const auto GatherStart = std::chrono::steady_clock::now();
+			GatherScene(World, World.GetCameraPose(Frame, Options.NumFrames), Options.Gather, Scene);
+			const double GatherMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - GatherStart).count();
+
+			Processor.Process(Scene, Result);
+
+			Stats.Add(Result.Timings, GatherMs);
+
+			NumOccluderTriangles += Scene.GetNumOccluderTriangles();
+			NumOccluders += static_cast<double>(Scene.Occluders.size() + Scene.OccluderBoxes.size());
+			NumOccludees += Scene.GetNumOccludees();
+			NumVisible += Result.CountVisibleOccludees();
+			TriangleStageMs += Result.Timings.OccluderMs + Result.Timings.SortMs + Result.Timings.RasterizeMs;
+		}
+
+		const double NumFrames = static_cast<double>(Options.NumFrames);
+		std::printf("scene %s  frames %d  seed %llu  objects %zu  occluders/frame %.1f  occludees/frame %.0f\n",
+		            World.Name.c_str(), Options.NumFrames, static_cast<unsigned long long>(Options.Seed), World.Objects.size(),
+		            NumOccluders / NumFrames, NumOccludees / NumFrames);
+		Stats.Print(stdout);
+
+		const double TrianglesPerSecond = TriangleStageMs > 0.0 ? NumOccluderTriangles / (TriangleStageMs / 1000.0) : 0.0;
+		const double CullRatio = NumOccludees > 0.0 ? 1.0 - NumVisible / NumOccludees : 0.0;
+		std::printf("  occluder triangles/s %.2f M  cull ratio %.1f %%\n\n", TrianglesPerSecond / 1e6, CullRatio * 100.0);
+	}
+}
+
+int main(int Argc, char** Argv)
+{
+	FBenchmarkOptions Options;
+	if (!ParseOptions(Argc, Argv, Options))
+	{
+		std::fprintf(stderr, "Usage: %s [--scene city|forest|maze|tiny|all] [--frames N] [--seed S] [--max-occluders N]\n", Argv[0]);
+		return 1;
+	}
+
+	std::vector<std::string> Scenes;
+	if (Options.Scene == "all")
+	{
+		Scenes = GetWorldNames();
+	}
+	else
+	{
+		Scenes.push_back(Options.Scene);
+	}
+
+	for (const std::string& SceneName : Scenes)
+	{
+		FWorld World;
+		if (!GenerateWorld(SceneName, Options.Seed, World))
+		{
+			std::fprintf(stderr, "Unknown scene %s\n", SceneName.c_str());
+			return 1;
+		}
+		RunWorld(World, Options);
+	}
+
+	return 0;
+}
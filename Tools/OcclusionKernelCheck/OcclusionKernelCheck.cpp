@@ -0,0 +1,410 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+/*=============================================================================
+	Differential check of the kernel variants of SOCore against the scalar
+	reference, on randomized inputs, synthetic worlds and captured frames.
+	A variant passes when it matches the reference or stays conservative, i.e.
+	never hides an occludee the reference shows. Visibility queries against the
+	final coverage must not hide an occludee the frame shows either, except
+	boxes behind the view, which frames keep as near clipped. Also
+	reports the throughput of every variant.
+
+	OcclusionKernelCheck [--seed S] [--count N] [--iterations N] [--frames N] [Capture.socap...]
+=============================================================================*/
+
+#include "OcclusionCaptureFile.h"
+#include "OcclusionCoreQuery.h"
+#include "OcclusionSyntheticScenes.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace SOCore;
+using namespace SOTools;
+
+namespace
+{
+	struct FCheckOptions
+	{
+		uint64_t Seed = 1;
+		int32_t NumElements = 1 << 16;
+		int32_t NumIterations = 20;
+		int32_t NumFrames = 16;
+		std::vector<std::string> Captures;
+	};
+
+	/** Random kernel inputs around a camera at the origin */
+	struct FKernelInputs
+	{
+		FMatrix44 ViewProj;
+		FMatrix44 QuantToClip;
+		std::vector<FVec3> BoxMinMax;
+		std::vector<FVec3> Vertices;
+		std::vector<FQuantizedVertex> QuantizedVertices;
+	};
+
+	struct FVariantReport
+	{
+		// Occludee boxes
+		int64_t NumBoxesExact = 0;
+		int64_t NumBoxesConservative = 0;
+		int64_t NumBoxesViolating = 0;
+
+		// Vertices whose clip position differs, and whose clip flags differ
+		int64_t NumVerticesInexact = 0;
+		int64_t NumVerticesViolating = 0;
+		float MaxVertexError = 0.f;
+
+		// Occludees of full frames
+		int64_t NumOccludeesMoreVisible = 0;
+		int64_t NumOccludeesViolating = 0;
+
+		// Occludees of full frames queried against the reference coverage
+		int64_t NumQueriesMoreVisible = 0;
+		int64_t NumQueriesViolating = 0;
+		int64_t NumQueries = 0;
+		double QueryMs = 0.0;
+
+		double BoxesPerSecond = 0.0;
+		double VerticesPerSecond = 0.0;
+		double QuantizedVerticesPerSecond = 0.0;
+		double FrameMs = 0.0;
+
+		bool HasPassed() const { return NumBoxesViolating == 0 && NumVerticesViolating == 0 && NumOccludeesViolating == 0 && NumQueriesViolating == 0; }
+	};
+
+	FVec3 RandomPoint(FRandomStream& Random, const float Radius)
+	{
+		// Denser close to the camera, where near clipping happens
+		const float Distance = Radius * Random.FRand() * Random.FRand();
+		const FVec3 Direction = FVec3{ Random.FRandRange(-1.f, 1.f), Random.FRandRange(-1.f, 1.f), Random.FRandRange(-1.f, 1.f) }.GetSafeNormal();
+		return Direction * Distance;
+	}
+
+	void GenerateKernelInputs(const uint64_t Seed, const int32_t NumElements, FKernelInputs& OutInputs)
+	{
+		FRandomStream Random(Seed);
+		const FGatherSettings View;
+
+		const FVec3 Forward = FVec3{ Random.FRandRange(-1.f, 1.f), Random.FRandRange(-1.f, 1.f), Random.FRandRange(-0.3f, 0.3f) }.GetSafeNormal();
+		OutInputs.ViewProj = FMatrix44::MakeLookAt(FVec3(), Forward, { 0.f, 0.f, 1.f })
+			* FMatrix44::MakeReversedZPerspective(View.HalfFOV, View.ViewWidth, View.ViewHeight, View.NearPlane);
+
+		constexpr float QuantizedSize = 4000.f;
+		const float QuantizationStep = QuantizedSize / 65535.f;
+		OutInputs.QuantToClip = FMatrix44::MakeScaleTranslation({ QuantizationStep, QuantizationStep, QuantizationStep }, RandomPoint(Random, 5000.f) - FVec3{ 2000.f, 2000.f, 2000.f })
+			* OutInputs.ViewProj;
+
+		OutInputs.BoxMinMax.resize(NumElements * 2);
+		OutInputs.Vertices.resize(NumElements);
+		OutInputs.QuantizedVertices.resize(NumElements);
+
+		for (int32_t i = 0; i < NumElements; ++i)
+		{
+			const FVec3 Center = RandomPoint(Random, 30000.f);
+			const float Size = std::exp(Random.FRandRange(-1.f, 8.5f));
+			const FVec3 Extent = { Size * Random.FRand(), Size * Random.FRand(), Size * Random.FRand() };
+			OutInputs.BoxMinMax[i * 2] = Center - Extent;
+			OutInputs.BoxMinMax[i * 2 + 1] = Center + Extent;
+
+			OutInputs.Vertices[i] = RandomPoint(Random, 30000.f);
+			OutInputs.QuantizedVertices[i] = { static_cast<uint16_t>(Random.Next()), static_cast<uint16_t>(Random.Next()), static_cast<uint16_t>(Random.Next()) };
+		}
+	}
+
+	template <typename FunctionType>
+	double MeasureMs(const int32_t NumIterations, FunctionType&& Function)
+	{
+		const auto Start = std::chrono::steady_clock::now();
+		for (int32_t Iteration = 0; Iteration < NumIterations; ++Iteration)
+		{
+			Function();
+		}
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Start).count() / NumIterations;
+	}
+
+	struct FBoxOutput
+	{
+		std::vector<int32_t> Quads;
+		std::vector<float> Depths;
+		std::vector<int32_t> Clipped;
+
+		void Resize(const int32_t Num)
+		{
+			Quads.assign(Num * 4, 0);
+			Depths.assign(Num, 0.f);
+			Clipped.assign(Num, 0);
+		}
+	};
+
+	struct FVertexOutput
+	{
+		std::vector<FVec4> ClipVertices;
+		std::vector<uint8_t> ClipFlags;
+
+		void Resize(const int32_t Num)
+		{
+			ClipVertices.assign(Num, FVec4());
+			ClipFlags.assign(Num, 0);
+		}
+	};
+
+	void CompareBoxes(const FBoxOutput& Reference, const FBoxOutput& Variant, const int32_t Num, FVariantReport& Report)
+	{
+		for (int32_t i = 0; i < Num; ++i)
+		{
+			if (Reference.Clipped[i] != 0 || Variant.Clipped[i] != 0)
+			{
+				// Near clipped boxes are visible, the variant may only add some
+				if (Variant.Clipped[i] == Reference.Clipped[i])
+				{
+					Report.NumBoxesExact++;
+				}
+				else if (Variant.Clipped[i] != 0)
+				{
+					Report.NumBoxesConservative++;
+				}
+				else
+				{
+					Report.NumBoxesViolating++;
+				}
+				continue;
+			}
+
+			const int32_t* RefQuad = &Reference.Quads[i * 4];
+			const int32_t* Quad = &Variant.Quads[i * 4];
+			if (std::memcmp(RefQuad, Quad, sizeof(int32_t) * 4) == 0 && Reference.Depths[i] == Variant.Depths[i])
+			{
+				Report.NumBoxesExact++;
+				continue;
+			}
+
+			// A larger quad that is closer to the camera (reversed Z) can only pass more pixels
+			const bool bOffScreen = RefQuad[0] > RefQuad[2] || RefQuad[1] > RefQuad[3];
+			const bool bContains = Quad[0] <= RefQuad[0] && Quad[1] <= RefQuad[1] && Quad[2] >= RefQuad[2] && Quad[3] >= RefQuad[3];
+			if ((bOffScreen || bContains) && Variant.Depths[i] >= Reference.Depths[i])
+			{
+				Report.NumBoxesConservative++;
+			}
+			else
+			{
+				Report.NumBoxesViolating++;
+			}
+		}
+	}
+
+	void CompareVertices(const FVertexOutput& Reference, const FVertexOutput& Variant, const int32_t Num, FVariantReport& Report)
+	{
+		for (int32_t i = 0; i < Num; ++i)
+		{
+			const FVec4& A = Reference.ClipVertices[i];
+			const FVec4& B = Variant.ClipVertices[i];
+			if (A.X != B.X || A.Y != B.Y || A.Z != B.Z || A.W != B.W)
+			{
+				Report.NumVerticesInexact++;
+				const float Scale = std::max(1.f, std::fabs(A.W));
+				Report.MaxVertexError = std::max({ Report.MaxVertexError, std::fabs(A.X - B.X) / Scale, std::fabs(A.Y - B.Y) / Scale, std::fabs(A.W - B.W) / Scale });
+			}
+			if (Reference.ClipFlags[i] != Variant.ClipFlags[i])
+			{
+				Report.NumVerticesViolating++;
+			}
+		}
+	}
+
+	void CheckKernels(const FKernelInputs& Inputs, const int32_t NumIterations, std::vector<FVariantReport>& Reports)
+	{
+		const int32_t Num = static_cast<int32_t>(Inputs.Vertices.size());
+		const FMatrix44 WorldToFramebuffer = Inputs.ViewProj * MakeClipToFramebuffer();
+		const float WClip = Inputs.ViewProj.M[3][2];
+
+		FBoxOutput ReferenceBoxes, Boxes;
+		FVertexOutput ReferenceVertices, ReferenceQuantized, Vertices;
+		ReferenceBoxes.Resize(Num);
+		ReferenceVertices.Resize(Num);
+		ReferenceQuantized.Resize(Num);
+
+		const FKernelSet& Reference = GetScalarKernels();
+		Reference.ProjectOccludeeBoxes(WorldToFramebuffer, Inputs.BoxMinMax.data(), Num, ReferenceBoxes.Quads.data(), ReferenceBoxes.Depths.data(), ReferenceBoxes.Clipped.data());
+		Reference.TransformVertices(Inputs.ViewProj, Inputs.Vertices.data(), Num, WClip, ReferenceVertices.ClipVertices.data(), ReferenceVertices.ClipFlags.data());
+		Reference.TransformQuantizedVertices(Inputs.QuantToClip, Inputs.QuantizedVertices.data(), Num, WClip, ReferenceQuantized.ClipVertices.data(), ReferenceQuantized.ClipFlags.data());
+
+		for (int32_t VariantIndex = 0; VariantIndex < GetNumKernelSets(); ++VariantIndex)
+		{
+			const FKernelSet& Kernels = GetKernelSet(VariantIndex);
+			FVariantReport& Report = Reports[VariantIndex];
+
+			Boxes.Resize(Num);
+			const double BoxMs = MeasureMs(NumIterations, [&]()
+			{
+				Kernels.ProjectOccludeeBoxes(WorldToFramebuffer, Inputs.BoxMinMax.data(), Num, Boxes.Quads.data(), Boxes.Depths.data(), Boxes.Clipped.data());
+			});
+			CompareBoxes(ReferenceBoxes, Boxes, Num, Report);
+
+			Vertices.Resize(Num);
+			const double VertexMs = MeasureMs(NumIterations, [&]()
+			{
+				Kernels.TransformVertices(Inputs.ViewProj, Inputs.Vertices.data(), Num, WClip, Vertices.ClipVertices.data(), Vertices.ClipFlags.data());
+			});
+			CompareVertices(ReferenceVertices, Vertices, Num, Report);
+
+			Vertices.Resize(Num);
+			const double QuantizedMs = MeasureMs(NumIterations, [&]()
+			{
+				Kernels.TransformQuantizedVertices(Inputs.QuantToClip, Inputs.QuantizedVertices.data(), Num, WClip, Vertices.ClipVertices.data(), Vertices.ClipFlags.data());
+			});
+			CompareVertices(ReferenceQuantized, Vertices, Num, Report);
+
+			Report.BoxesPerSecond = BoxMs > 0.0 ? Num / (BoxMs / 1000.0) : 0.0;
+			Report.VerticesPerSecond = VertexMs > 0.0 ? Num / (VertexMs / 1000.0) : 0.0;
+			Report.QuantizedVerticesPerSecond = QuantizedMs > 0.0 ? Num / (QuantizedMs / 1000.0) : 0.0;
+		}
+	}
+
+	void CheckFrame(const FScene& Scene, std::vector<FVariantReport>& Reports)
+	{
+		FFrameResult ReferenceResult;
+		const std::unique_ptr<FCoverageDepth> CoverageDepth = std::make_unique<FCoverageDepth>();
+		FFrameProcessor(GetScalarKernels()).Process(Scene, ReferenceResult, CoverageDepth.get());
+
+		const FMatrix44 WorldToFramebuffer = Scene.ViewProj * MakeClipToFramebuffer();
+		const int32_t NumOccludees = Scene.GetNumOccludees();
+		std::vector<uint8_t> QueryVisibility(NumOccludees);
+
+		FFrameResult Result;
+		for (int32_t VariantIndex = 0; VariantIndex < GetNumKernelSets(); ++VariantIndex)
+		{
+			FFrameProcessor Processor(GetKernelSet(VariantIndex));
+			Processor.Process(Scene, Result);
+
+			FVariantReport& Report = Reports[VariantIndex];
+			Report.FrameMs += Result.Timings.GetTotalMs();
+			for (size_t i = 0; i < Result.OccludeeVisibility.size(); ++i)
+			{
+				const bool bReferenceVisible = ReferenceResult.OccludeeVisibility[i] != 0;
+				const bool bVisible = Result.OccludeeVisibility[i] != 0;
+				Report.NumOccludeesMoreVisible += (bVisible && !bReferenceVisible) ? 1 : 0;
+				Report.NumOccludeesViolating += (!bVisible && bReferenceVisible) ? 1 : 0;
+			}
+
+			Report.QueryMs += MeasureMs(1, [&]()
+			{
+				QueryBoxVisibility(GetKernelSet(VariantIndex), WorldToFramebuffer, ReferenceResult.Coverage, *CoverageDepth,
+				                   Scene.OccludeeBoxMinMax.data(), NumOccludees, QueryVisibility.data());
+			});
+			Report.NumQueries += NumOccludees;
+			for (int32_t i = 0; i < NumOccludees; ++i)
+			{
+				const bool bReferenceVisible = ReferenceResult.OccludeeVisibility[i] != 0;
+				const bool bVisible = QueryVisibility[i] != 0;
+				Report.NumQueriesMoreVisible += (bVisible && !bReferenceVisible) ? 1 : 0;
+				const bool bBehindView = IsBoxBehindView(WorldToFramebuffer, Scene.OccludeeBoxMinMax[i * 2], Scene.OccludeeBoxMinMax[i * 2 + 1]);
+				Report.NumQueriesViolating += (!bVisible && bReferenceVisible && !bBehindView) ? 1 : 0;
+			}
+		}
+	}
+
+	bool ParseOptions(const int Argc, char** Argv, FCheckOptions& OutOptions)
+	{
+		for (int i = 1; i < Argc; ++i)
+		{
+			if (!std::strcmp(Argv[i], "--seed") && i + 1 < Argc)
+			{
+				OutOptions.Seed = std::strtoull(Argv[++i], nullptr, 10);
+			}
+			else if (!std::strcmp(Argv[i], "--count") && i + 1 < Argc)
+			{
+				OutOptions.NumElements = std::max(1, std::atoi(Argv[++i]));
+			}
+			else if (!std::strcmp(Argv[i], "--iterations") && i + 1 < Argc)
+			{
+				OutOptions.NumIterations = std::max(1, std::atoi(Argv[++i]));
+			}
+			else if (!std::strcmp(Argv[i], "--frames") && i + 1 < Argc)
+			{
+				OutOptions.NumFrames = std::max(0, std::atoi(Argv[++i]));
+			}
+			else if (Argv[i][0] == '-')
+			{
+				return false;
+			}
+			else
+			{
+				OutOptions.Captures.push_back(Argv[i]);
+			}
+		}
+		return true;
+	}
+}
+
+int main(int Argc, char** Argv)
+{
+	FCheckOptions Options;
+	if (!ParseOptions(Argc, Argv, Options))
+	{
+		std::fprintf(stderr, "Usage: %s [--seed S] [--count N] [--iterations N] [--frames N] [Capture.socap...]\n", Argv[0]);
+		return 1;
+	}
+
+	std::vector<FVariantReport> Reports(GetNumKernelSets());
+
+	FKernelInputs Inputs;
+	GenerateKernelInputs(Options.Seed, Options.NumElements, Inputs);
+	CheckKernels(Inputs, Options.NumIterations, Reports);
+
+	int32_t NumFrames = 0;
+	for (const std::string& WorldName : GetWorldNames())
+	{
+		FWorld World;
+		GenerateWorld(WorldName, Options.Seed, World);
+
+		FScene Scene;
+		Scene.Meshes = World.Meshes;
+		for (int32_t Frame = 0; Frame < Options.NumFrames; ++Frame, ++NumFrames)
+		{
+			GatherScene(World, World.GetCameraPose(Frame, Options.NumFrames), FGatherSettings(), Scene);
+			CheckFrame(Scene, Reports);
+		}
+	}
+
+	for (const std::string& CapturePath : Options.Captures)
+	{
+		FScene Scene;
+		if (!LoadSceneCaptureFile(CapturePath, Scene))
+		{
+			std::fprintf(stderr, "Failed to read capture %s\n", CapturePath.c_str());
+			return 1;
+		}
+		CheckFrame(Scene, Reports);
+		NumFrames++;
+	}
+
+	std::printf("seed %llu  elements %d  iterations %d  frames %d  reference %s\n",
+	            static_cast<unsigned long long>(Options.Seed), Options.NumElements, Options.NumIterations, NumFrames, GetScalarKernels().Name);
+	std::printf("  variant   boxes M/s  vertices M/s  quantized M/s  frame ms   box exact/conservative/violating   vertex inexact/violating (max error)   occludees more visible/violating   queries M/s  more visible/violating  result\n");
+
+	bool bPassed = true;
+	for (int32_t VariantIndex = 0; VariantIndex < GetNumKernelSets(); ++VariantIndex)
+	{
+		const FVariantReport& Report = Reports[VariantIndex];
+		bPassed &= Report.HasPassed();
+		std::printf("  %-8s %10.1f %13.1f %14.1f %9.3f   %10lld / %lld / %lld   %17lld / %lld (%g)   %18lld / %lld   %11.1f   %12lld / %lld   %s\n",
+		            GetKernelSet(VariantIndex).Name, Report.BoxesPerSecond / 1e6, Report.VerticesPerSecond / 1e6, Report.QuantizedVerticesPerSecond / 1e6,
+		            NumFrames > 0 ? Report.FrameMs / NumFrames : 0.0,
+		            static_cast<long long>(Report.NumBoxesExact), static_cast<long long>(Report.NumBoxesConservative), static_cast<long long>(Report.NumBoxesViolating),
+		            static_cast<long long>(Report.NumVerticesInexact), static_cast<long long>(Report.NumVerticesViolating), Report.MaxVertexError,
+		            static_cast<long long>(Report.NumOccludeesMoreVisible), static_cast<long long>(Report.NumOccludeesViolating),
+		            Report.QueryMs > 0.0 ? Report.NumQueries / (Report.QueryMs / 1000.0) / 1e6 : 0.0,
+		            static_cast<long long>(Report.NumQueriesMoreVisible), static_cast<long long>(Report.NumQueriesViolating),
+		            Report.HasPassed() ? "pass" : "FAIL");
+	}
+
+	return bPassed ? 0 : 1;
+}
@@ -0,0 +1,145 @@
+// Copyright to Kat Code Labs, SRL. All Rights Reserved.
+
+/*=============================================================================
+	Replays frames captured with so.CaptureScene outside of the engine. Reports
+	stage timings over repeated runs and a hash of the occludee visibility, so
+	optimizations can be profiled and compared on production frames. Occluders
+	go through the same meshlet path as the engine, --no-cone-culling matches
+	r.so.ConeCulling 0.
+
+	OcclusionReplay [--iterations N] [--dump-visibility] [--no-cone-culling] Capture.socap...
+=============================================================================*/
+
+#include "OcclusionCaptureFile.h"
+#include "OcclusionStageStats.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace SOCore;
+using namespace SOTools;
+
+namespace
+{
+	struct FReplayOptions
+	{
+		int32_t NumIterations = 100;
+		bool bDumpVisibility = false;
+		bool bConeCulling = true;
+		std::vector<std::string> Captures;
+	};
+
+	// FNV-1a, identical results give identical hashes
+	uint64_t HashVisibility(const std::vector<uint8_t>& Visibility)
+	{
+		uint64_t Hash = 14695981039346656037ull;
+		for (const uint8_t bVisible : Visibility)
+		{
+			Hash = (Hash ^ (bVisible != 0 ? 1u : 0u)) * 1099511628211ull;
+		}
+		return Hash;
+	}
+
+	bool DumpVisibility(const std::string& Path, const FScene& Scene, const FFrameResult& Result)
+	{
+		std::FILE* File = std::fopen(Path.c_str(), "w");
+		if (!File)
+		{
+			return false;
+		}
+
+		std::fprintf(File, "Occludee,PrimitiveId,InstanceIndex,Visible\n");
+		for (size_t Index = 0; Index < Result.OccludeeVisibility.size(); ++Index)
+		{
+			const uint32_t PrimitiveId = Index < Scene.OccludeeIds.size() ? Scene.OccludeeIds[Index] : 0;
+			const int32_t InstanceIndex = Index < Scene.OccludeeInstanceIndices.size() ? Scene.OccludeeInstanceIndices[Index] : -1;
+			std::fprintf(File, "%zu,%u,%d,%d\n", Index, PrimitiveId, InstanceIndex, Result.OccludeeVisibility[Index] != 0 ? 1 : 0);
+		}
+		std::fclose(File);
+		return true;
+	}
+
+	bool ParseOptions(const int Argc, char** Argv, FReplayOptions& OutOptions)
+	{
+		for (int i = 1; i < Argc; ++i)
+		{
+			if (!std::strcmp(Argv[i], "--iterations") && i + 1 < Argc)
+			{
+				OutOptions.NumIterations = std::max(1, std::atoi(Argv[++i]));
+			}
+			else if (!std::strcmp(Argv[i], "--dump-visibility"))
+			{
+				OutOptions.bDumpVisibility = true;
+			}
+			else if (!std::strcmp(Argv[i], "--no-cone-culling"))
+			{
+				OutOptions.bConeCulling = false;
+			}
+			else if (Argv[i][0] == '-')
+			{
+				return false;
+			}
+			else
+			{
+				OutOptions.Captures.push_back(Argv[i]);
+			}
+		}
+		return !OutOptions.Captures.empty();
+	}
+}
+
+int main(int Argc, char** Argv)
+{
+	FReplayOptions Options;
+	if (!ParseOptions(Argc, Argv, Options))
+	{
+		std::fprintf(stderr, "Usage: %s [--iterations N] [--dump-visibility] [--no-cone-culling] Capture.socap...\n", Argv[0]);
+		return 1;
+	}
+
+	int32_t NumFailed = 0;
+	FFrameProcessor Processor;
+	Processor.SetConeCulling(Options.bConeCulling);
+	FFrameResult Result;
+
+	for (const std::string& CapturePath : Options.Captures)
+	{
+		FScene Scene;
+		if (!LoadSceneCaptureFile(CapturePath, Scene))
+		{
+			std::fprintf(stderr, "Failed to read capture %s\n", CapturePath.c_str());
+			NumFailed++;
+			continue;
+		}
+
+		FStageStats Stats;
+		for (int32_t Iteration = 0; Iteration < Options.NumIterations; ++Iteration)
+		{
+			Processor.Process(Scene, Result);
+			Stats.Add(Result.Timings);
+		}
+
+		const int32_t NumOccludees = Scene.GetNumOccludees();
+		const int32_t NumVisible = Result.CountVisibleOccludees();
+		std::printf("capture %s  iterations %d\n", CapturePath.c_str(), Options.NumIterations);
+		std::printf("  meshes %zu  mesh occluders %zu  box occluders %zu  occluder triangles %d  occludees %d\n",
+		            Scene.Meshes.size(), Scene.Occluders.size(), Scene.OccluderBoxes.size(), Scene.GetNumOccluderTriangles(), NumOccludees);
+		Stats.Print(stdout);
+		std::printf("  screen triangles %d  covered pixels %d  visible %d  cull ratio %.1f %%  visibility hash %016llx\n\n",
+		            Result.NumScreenTriangles, Result.Coverage.CountCoveredPixels(), NumVisible,
+		            NumOccludees > 0 ? 100.0 * (1.0 - static_cast<double>(NumVisible) / NumOccludees) : 0.0,
+		            static_cast<unsigned long long>(HashVisibility(Result.OccludeeVisibility)));
+
+		if (Options.bDumpVisibility && !DumpVisibility(CapturePath + ".visibility.csv", Scene, Result))
+		{
+			std::fprintf(stderr, "Failed to write the visibility of %s\n", CapturePath.c_str());
+			NumFailed++;
+		}
+	}
+
+	return NumFailed == 0 ? 0 : 1;
+}